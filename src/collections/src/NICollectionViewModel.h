@@ -18,6 +18,7 @@
 #import <UIKit/UIKit.h>
 
 #import "NIActions.h"  /* for NIActionsDataSource */
+#import "NIImagePrefetching.h"  /* for NIImagePrefetcher */
 #import "NIPreprocessorMacros.h" /* for weak */
 
 API_DEPRECATED_BEGIN("🕘 Schedule time to migrate. "
@@ -82,6 +83,10 @@ API_DEPRECATED_BEGIN("🕘 Schedule time to migrate. "
 // Redeclaring for property autosynthesis.
 @property (nonatomic, weak, nullable) id<NICollectionViewModelDelegate> delegate;
 
+#pragma mark Prefetching Images
+
+@property (nonatomic, strong, nullable) id<NIImagePrefetcher> imagePrefetcher; // Default: nil
+
 @end
 
 /**
@@ -240,4 +245,24 @@ API_DEPRECATED_BEGIN("🕘 Schedule time to migrate. "
  * @fn NICollectionViewModel::delegate
  */
 
+
+/** @name Prefetching Images */
+
+/**
+ * Loads the images of items that are about to be shown.
+ *
+ * When the collection view asks the model to prefetch items, the objects of those items that
+ * conform to NIImagePrefetchingObject are passed on to the image prefetcher. Their prefetches are
+ * cancelled when the collection view cancels prefetching the items. The model must be the
+ * collection view's prefetchDataSource for this to happen.
+ *
+ * The delegate is still told about prefetching with
+ * collectionViewModel:collectionView:prefetchItemsAtIndexPaths:withObjects:.
+ *
+ * By default this is nil.
+ *
+ * @see NINetworkImagePrefetcher
+ * @fn NICollectionViewModel::imagePrefetcher
+ */
+
 API_DEPRECATED_END
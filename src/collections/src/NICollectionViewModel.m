@@ -187,20 +187,38 @@
   NSMutableArray<id>* objects = [NSMutableArray array];
   for (NSIndexPath* indexPath in indexPaths) {
     id object = [self objectAtIndexPath:indexPath];
+    if (nil == object) {
+      continue;
+    }
     [objects addObject:object];
+
+    if ([object conformsToProtocol:@protocol(NIImagePrefetchingObject)]) {
+      [self.imagePrefetcher prefetchImagesForObject:object];
+    }
+  }
+
+  if ([self.delegate respondsToSelector:@selector(collectionViewModel:collectionView:prefetchItemsAtIndexPaths:withObjects:)]) {
+    [self.delegate collectionViewModel:self collectionView:collectionView prefetchItemsAtIndexPaths:indexPaths withObjects:objects];
   }
-  
-  [self.delegate collectionViewModel:self collectionView:collectionView prefetchItemsAtIndexPaths:indexPaths withObjects:objects];
 }
 
 - (void)collectionView:(UICollectionView *)collectionView cancelPrefetchingForItemsAtIndexPaths:(NSArray<NSIndexPath *> *)indexPaths {
   NSMutableArray<id>* objects = [NSMutableArray array];
   for (NSIndexPath* indexPath in indexPaths) {
     id object = [self objectAtIndexPath:indexPath];
+    if (nil == object) {
+      continue;
+    }
     [objects addObject:object];
+
+    if ([object conformsToProtocol:@protocol(NIImagePrefetchingObject)]) {
+      [self.imagePrefetcher cancelPrefetchingImagesForObject:object];
+    }
   }
 
-  [self.delegate collectionViewModel:self collectionView:collectionView cancelPrefetchingItemsAtIndexPaths:indexPaths withObjects:objects];
+  if ([self.delegate respondsToSelector:@selector(collectionViewModel:collectionView:cancelPrefetchingItemsAtIndexPaths:withObjects:)]) {
+    [self.delegate collectionViewModel:self collectionView:collectionView cancelPrefetchingItemsAtIndexPaths:indexPaths withObjects:objects];
+  }
 }
 
 #pragma mark - Public
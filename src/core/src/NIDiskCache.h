@@ -0,0 +1,219 @@
+//
+// Copyright 2011-2014 NimbusKit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "NIPreprocessorMacros.h"
+
+/**
+ * For storing and accessing data on disk.
+ *
+ * @ingroup NimbusCore
+ * @defgroup Disk-Cache Disk Cache
+ * @{
+ *
+ * NIDiskCache stores data in a directory of append-only segment files. Each segment is mapped
+ * into memory once, so reading data from the cache neither copies it nor makes a system call.
+ * An index of where each piece of data lives is kept in memory and saved to disk from time to
+ * time. If the app is terminated before the index is saved, the index is recovered by reading
+ * the records that were appended to the segments since, and records that were only partially
+ * written are discarded.
+ *
+ * When the segments grow past the cache's byte budget, the least recently used data is removed
+ * and segments that are mostly unused are compacted by copying their remaining data to the end
+ * of the newest segment.
+ *
+ * NIImageMemoryCache can use a disk cache as a second tier. See NIImageMemoryCache::diskCache.
+ *
+ * <h2>Example Use</h2>
+ *
+@code
+NIDiskCache* diskCache = [[NIDiskCache alloc] initWithPath:NIPathForCachesResource(@"Images")];
+[Nimbus imageMemoryCache].diskCache = diskCache;
+@endcode
+ */
+
+/**
+ * A persistent cache of data stored in memory-mapped segment files.
+ *
+ * The cache is safe to use from multiple threads. Data is written to disk on a background
+ * queue, and data that has not been written yet is returned from memory.
+ */
+@interface NIDiskCache : NSObject
+
+// Designated initializer.
+- (id)initWithPath:(NSString *)path;
+
+@property (nonatomic, readonly, copy) NSString* path;
+
+@property (nonatomic, assign) unsigned long long maxNumberOfBytes; // Default: 50 MB
+@property (nonatomic, assign) unsigned long long segmentSize;      // Default: 4 MB
+@property (nonatomic, assign) double compactionThreshold;          // Default: 0.5
+
+- (NSUInteger)count;
+- (unsigned long long)numberOfBytes;
+
+- (void)storeData:(NSData *)data withName:(NSString *)name;
+
+- (NSData *)dataWithName:(NSString *)name;
+- (BOOL)containsDataWithName:(NSString *)name;
+
+- (void)removeDataWithName:(NSString *)name;
+- (void)removeAllDataWithPrefix:(NSString *)prefix;
+- (void)removeAllData;
+
+- (void)synchronize;
+
+@end
+
+/**@}*/// End of Disk Cache ////////////////////////////////////////////////////////////////////////
+
+/** @name Creating a Disk Cache */
+
+/**
+ * Initializes a newly allocated disk cache that keeps its files in the given directory.
+ *
+ * The directory is created if it does not exist. Data that was stored in the directory by an
+ * earlier disk cache is available immediately. The directory must not be shared with another
+ * disk cache object.
+ *
+ * @param path  The directory that the cache keeps its segments and index in.
+ * @fn NIDiskCache::initWithPath:
+ */
+
+/**
+ * The directory that the cache keeps its segments and index in.
+ *
+ * @fn NIDiskCache::path
+ */
+
+/** @name Configuring the Cache */
+
+/**
+ * The number of bytes the cache's files may use before data is removed.
+ *
+ * The least recently used data is removed until the cache uses three quarters of this number
+ * of bytes. 0 means the cache is unlimited.
+ *
+ * By default this is 50 MB.
+ *
+ * @fn NIDiskCache::maxNumberOfBytes
+ */
+
+/**
+ * The size of each segment file.
+ *
+ * Data that does not fit in a segment of this size gets a segment of its own. Changes only
+ * affect segments created afterwards.
+ *
+ * By default this is 4 MB.
+ *
+ * @fn NIDiskCache::segmentSize
+ */
+
+/**
+ * The share of a segment that must be in use for the segment to survive a trim.
+ *
+ * Segments that use less than this share of their bytes have their remaining data copied to
+ * the newest segment and are then deleted.
+ *
+ * By default this is 0.5.
+ *
+ * @fn NIDiskCache::compactionThreshold
+ */
+
+/** @name Querying the Cache */
+
+/**
+ * Returns the number of pieces of data in the cache.
+ *
+ * @fn NIDiskCache::count
+ */
+
+/**
+ * Returns the number of bytes used by the cache's segment files.
+ *
+ * This includes data that has been replaced or removed but not yet compacted away.
+ *
+ * @fn NIDiskCache::numberOfBytes
+ */
+
+/** @name Storing Data */
+
+/**
+ * Stores data in the cache, replacing any data stored with the same name.
+ *
+ * The data is written on a background queue. Until then it is returned from memory.
+ *
+ * @param data  The data to store.
+ * @param name  The name used as a key to store the data.
+ * @fn NIDiskCache::storeData:withName:
+ */
+
+/** @name Accessing Data */
+
+/**
+ * Returns the data stored with the given name.
+ *
+ * Data read from a segment is not copied. The returned object keeps the segment mapped into
+ * memory for as long as it is alive, even if the data is later removed from the cache.
+ *
+ * @returns The data stored with the given name, or nil if there is none.
+ * @fn NIDiskCache::dataWithName:
+ */
+
+/**
+ * Returns whether data with the given name is in the cache.
+ *
+ * Does not count as an access of the data.
+ *
+ * @fn NIDiskCache::containsDataWithName:
+ */
+
+/** @name Removing Data */
+
+/**
+ * Removes the data stored with the given name.
+ *
+ * A removal record is appended to the current segment so that the data is not recovered if the
+ * app is terminated before the index is next saved.
+ *
+ * @fn NIDiskCache::removeDataWithName:
+ */
+
+/**
+ * Removes all data whose name has the given prefix.
+ *
+ * As with <code>-[NSString hasPrefix:]</code>, an empty prefix matches nothing.
+ *
+ * @fn NIDiskCache::removeAllDataWithPrefix:
+ */
+
+/**
+ * Removes all data from the cache and deletes every segment file.
+ *
+ * @fn NIDiskCache::removeAllData
+ */
+
+/** @name Saving the Index */
+
+/**
+ * Waits for all pending writes to finish and saves the index.
+ *
+ * The index is also saved when the cache is trimmed and when the app enters the background.
+ *
+ * @fn NIDiskCache::synchronize
+ */
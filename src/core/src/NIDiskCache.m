@@ -0,0 +1,949 @@
+//
+// Copyright 2011-2014 NimbusKit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import "NIDiskCache.h"
+
+#import "NIDebuggingTools.h"
+
+#import <UIKit/UIKit.h>
+#import <fcntl.h>
+#import <sys/mman.h>
+#import <sys/stat.h>
+#import <unistd.h>
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "Nimbus requires ARC support."
+#endif
+
+// File format:
+//
+// Segments are append-only logs of records. Every record starts with a header that is followed by
+// the UTF-8 name and then the data. The name and the data are each padded to a multiple of
+// kRecordAlignment bytes so that the data can be used directly, for example as pixels. Removals
+// are recorded as records with the removed flag and no data.
+//
+// The index lists every segment with the number of bytes of it that the index covers, followed
+// by the location and last access of every entry. Records past the covered length of a segment
+// were appended after the index was saved and are replayed when the cache is loaded.
+
+static const uint32_t kRecordMagic = 0x4E494452; // "NIDR"
+static const uint32_t kRecordFlagRemoved = 1;
+static const uint64_t kRecordAlignment = 16;
+
+static const uint32_t kIndexMagic = 0x4E494449; // "NIDI"
+static const uint32_t kIndexVersion = 1;
+
+static NSString* const kIndexFileName = @"index";
+static NSString* const kSegmentPathExtension = @"segment";
+
+typedef struct {
+  uint32_t magic;
+  uint32_t flags;
+  uint32_t nameLength;
+  uint32_t checksum;
+  uint64_t dataLength;
+  uint64_t reserved;
+} NIDiskCacheRecordHeader;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t numberOfSegments;
+  uint32_t numberOfEntries;
+  uint64_t accessCounter;
+} NIDiskCacheIndexHeader;
+
+typedef struct {
+  uint32_t identifier;
+  uint32_t reserved;
+  uint64_t length;
+} NIDiskCacheIndexSegment;
+
+typedef struct {
+  uint32_t segmentIdentifier;
+  uint32_t nameLength;
+  uint64_t recordOffset;
+  uint64_t lastAccess;
+} NIDiskCacheIndexEntry;
+
+static uint64_t NIDiskCacheAlign(uint64_t length) {
+  return (length + kRecordAlignment - 1) & ~(kRecordAlignment - 1);
+}
+
+// FNV-1a. Only used to detect records that were partially written.
+static uint32_t NIDiskCacheChecksum(uint32_t hash, const void* bytes, uint64_t length) {
+  const uint8_t* byte = bytes;
+  for (uint64_t ix = 0; ix < length; ++ix) {
+    hash ^= byte[ix];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static const uint32_t kChecksumSeed = 2166136261u;
+
+/**
+ * @brief A segment file that is mapped into memory.
+ *
+ * The whole capacity of the segment is mapped when it is opened, so records that are appended
+ * later can be read without mapping the file again. Only bytes that have been written to the
+ * file may be read.
+ */
+@interface NIDiskCacheSegment : NSObject
+
+- (id)initWithIdentifier:(uint32_t)identifier path:(NSString *)path capacity:(uint64_t)capacity;
+
+@property (nonatomic, readonly) uint32_t identifier;
+@property (nonatomic, readonly, copy) NSString* path;
+@property (nonatomic, readonly) const uint8_t* bytes;
+@property (nonatomic, readonly) uint64_t capacity;
+
+// The length of the file when it was opened.
+@property (nonatomic, readonly) uint64_t fileLength;
+
+// The number of bytes of valid records. Guarded by the cache lock.
+@property (nonatomic, assign) uint64_t length;
+
+// The number of bytes of records that the cache's entries point to. Guarded by the cache lock.
+@property (nonatomic, assign) uint64_t liveLength;
+
+- (double)liveRatio;
+
+- (BOOL)writeBytes:(const void *)bytes length:(uint64_t)length atOffset:(uint64_t)offset;
+- (void)truncateToLength:(uint64_t)length;
+- (void)deleteFile;
+
+// Reads the record at the given offset. Returns NO if there is no complete, valid record that
+// ends at or before the limit.
+- (BOOL)readRecordAtOffset:(uint64_t)offset
+                     limit:(uint64_t)limit
+            verifyChecksum:(BOOL)verifyChecksum
+                    header:(NIDiskCacheRecordHeader *)header
+                      name:(NSString **)name;
+
+@end
+
+/**
+ * @brief The location of a piece of data in a segment.
+ */
+@interface NIDiskCacheEntry : NSObject
+@property (nonatomic, strong) NIDiskCacheSegment* segment;
+@property (nonatomic, assign) uint64_t recordOffset;
+@property (nonatomic, assign) uint64_t recordLength;
+@property (nonatomic, assign) uint64_t dataOffset;
+@property (nonatomic, assign) uint64_t dataLength;
+@property (nonatomic, assign) uint64_t lastAccess;
+@end
+
+@interface NIDiskCache()
+@property (nonatomic, copy) NSString* path;
+
+// Everything below is guarded by the cache lock. Segment files are only written on the queue.
+@property (nonatomic, strong) NSMutableDictionary* entries;
+@property (nonatomic, strong) NSMutableDictionary* segments;
+@property (nonatomic, strong) NIDiskCacheSegment* activeSegment;
+@property (nonatomic, assign) uint32_t nextSegmentIdentifier;
+@property (nonatomic, assign) uint64_t accessCounter;
+@property (nonatomic, assign) BOOL indexIsDirty;
+
+// Data that has been stored but not written yet.
+@property (nonatomic, strong) NSMutableDictionary* pendingData;
+
+@property (nonatomic, strong) dispatch_queue_t queue;
+@end
+
+@implementation NIDiskCache
+
+- (void)dealloc {
+  [[NSNotificationCenter defaultCenter] removeObserver:self];
+
+  // Every block on the queue retains the cache, so nothing else can be writing now.
+  if (_indexIsDirty) {
+    [self saveIndex];
+  }
+}
+
+- (id)initWithPath:(NSString *)path {
+  if ((self = [super init])) {
+    NIDASSERT(nil != path);
+    _path = [path copy];
+    _maxNumberOfBytes = 50 * 1024 * 1024;
+    _segmentSize = 4 * 1024 * 1024;
+    _compactionThreshold = 0.5;
+
+    _entries = [[NSMutableDictionary alloc] init];
+    _segments = [[NSMutableDictionary alloc] init];
+    _pendingData = [[NSMutableDictionary alloc] init];
+    _nextSegmentIdentifier = 1;
+    _queue = dispatch_queue_create("com.nimbuskit.diskcache", DISPATCH_QUEUE_SERIAL);
+    dispatch_set_target_queue(_queue, dispatch_get_global_queue(QOS_CLASS_UTILITY, 0));
+
+    [self load];
+
+    [[NSNotificationCenter defaultCenter] addObserver:self
+                                             selector:@selector(didEnterBackground:)
+                                                 name:UIApplicationDidEnterBackgroundNotification
+                                               object:nil];
+  }
+  return self;
+}
+
+- (NSString *)description {
+  return [NSString stringWithFormat:
+          @"<%@"
+          @" path: %@"
+          @" count: %zd"
+          @" numberOfBytes: %llu"
+          @">",
+          [super description],
+          self.path,
+          [self count],
+          [self numberOfBytes]];
+}
+
+#pragma mark - Notifications
+
+- (void)didEnterBackground:(NSNotification *)notification {
+  dispatch_async(self.queue, ^{
+    if (self.indexIsDirty) {
+      [self saveIndex];
+    }
+  });
+}
+
+#pragma mark - Internal
+
+- (NSString *)indexPath {
+  return [self.path stringByAppendingPathComponent:kIndexFileName];
+}
+
+- (NSString *)pathForSegmentIdentifier:(uint32_t)identifier {
+  NSString* fileName = [NSString stringWithFormat:@"%u", identifier];
+  return [self.path stringByAppendingPathComponent:
+          [fileName stringByAppendingPathExtension:kSegmentPathExtension]];
+}
+
+- (NIDiskCacheEntry *)entryForRecordAtOffset:(uint64_t)offset
+                                   inSegment:(NIDiskCacheSegment *)segment
+                                      header:(NIDiskCacheRecordHeader)header {
+  NIDiskCacheEntry* entry = [[NIDiskCacheEntry alloc] init];
+  entry.segment = segment;
+  entry.recordOffset = offset;
+  entry.dataOffset = offset + sizeof(header) + NIDiskCacheAlign(header.nameLength);
+  entry.dataLength = header.dataLength;
+  entry.recordLength = entry.dataOffset - offset + NIDiskCacheAlign(header.dataLength);
+  return entry;
+}
+
+// Must be called with the cache lock held.
+- (void)setEntry:(NIDiskCacheEntry *)entry forName:(NSString *)name {
+  NIDiskCacheEntry* previousEntry = self.entries[name];
+  previousEntry.segment.liveLength -= previousEntry.recordLength;
+  self.entries[name] = entry;
+  entry.segment.liveLength += entry.recordLength;
+  self.indexIsDirty = YES;
+}
+
+// Must be called with the cache lock held.
+- (void)removeEntryForName:(NSString *)name {
+  NIDiskCacheEntry* entry = self.entries[name];
+  if (nil != entry) {
+    entry.segment.liveLength -= entry.recordLength;
+    [self.entries removeObjectForKey:name];
+    self.indexIsDirty = YES;
+  }
+}
+
+// Must be called with the cache lock held.
+- (NIDiskCacheSegment *)openSegmentWithIdentifier:(uint32_t)identifier {
+  NIDiskCacheSegment* segment = self.segments[@(identifier)];
+  if (nil == segment) {
+    NSString* segmentPath = [self pathForSegmentIdentifier:identifier];
+    segment = [[NIDiskCacheSegment alloc] initWithIdentifier:identifier
+                                                        path:segmentPath
+                                                    capacity:self.segmentSize];
+    if (nil != segment) {
+      self.segments[@(identifier)] = segment;
+      self.nextSegmentIdentifier = MAX(self.nextSegmentIdentifier, identifier + 1);
+    }
+  }
+  return segment;
+}
+
+#pragma mark - Loading
+
+- (void)load {
+  NSFileManager* fm = [NSFileManager defaultManager];
+  [fm createDirectoryAtPath:self.path withIntermediateDirectories:YES attributes:nil error:nil];
+
+  NSMutableArray* segmentIdentifiers = [NSMutableArray array];
+  for (NSString* fileName in [fm contentsOfDirectoryAtPath:self.path error:nil]) {
+    if ([[fileName pathExtension] isEqualToString:kSegmentPathExtension]) {
+      long long identifier = [[fileName stringByDeletingPathExtension] longLongValue];
+      if (identifier > 0 && identifier <= UINT32_MAX) {
+        [segmentIdentifiers addObject:@(identifier)];
+      }
+    }
+  }
+  [segmentIdentifiers sortUsingSelector:@selector(compare:)];
+
+  @synchronized(self) {
+    NSDictionary* indexedLengths = [self loadIndex];
+    BOOL indexIsComplete = (nil != indexedLengths);
+
+    // Replay the records that were appended after the index was last saved.
+    for (NSNumber* identifier in segmentIdentifiers) {
+      NIDiskCacheSegment* segment = [self openSegmentWithIdentifier:identifier.unsignedIntValue];
+      if (nil == segment) {
+        continue;
+      }
+      uint64_t offset = [indexedLengths[identifier] unsignedLongLongValue];
+      if (offset < segment.fileLength) {
+        indexIsComplete = NO;
+      }
+
+      NIDiskCacheRecordHeader header;
+      NSString* name = nil;
+      while (offset < segment.fileLength
+             && [segment readRecordAtOffset:offset
+                                      limit:segment.fileLength
+                             verifyChecksum:YES
+                                     header:&header
+                                       name:&name]) {
+        NIDiskCacheEntry* entry = [self entryForRecordAtOffset:offset
+                                                     inSegment:segment
+                                                        header:header];
+        if (0 != (header.flags & kRecordFlagRemoved)) {
+          [self removeEntryForName:name];
+        } else {
+          entry.lastAccess = ++self.accessCounter;
+          [self setEntry:entry forName:name];
+        }
+        offset += entry.recordLength;
+      }
+
+      // Anything after the last valid record was only partially written.
+      if (offset < segment.fileLength) {
+        NIDWARNING(@"Discarding %llu bytes of incomplete records in %@",
+                   segment.fileLength - offset, segment.path);
+        [segment truncateToLength:offset];
+      }
+      segment.length = offset;
+    }
+
+    // Keep appending to the newest segment.
+    NSNumber* lastIdentifier = [segmentIdentifiers lastObject];
+    if (nil != lastIdentifier) {
+      self.activeSegment = self.segments[lastIdentifier];
+    }
+
+    self.indexIsDirty = !indexIsComplete;
+  }
+
+  if (self.indexIsDirty) {
+    [self saveIndex];
+  }
+}
+
+// Must be called with the cache lock held. Returns the number of bytes of each segment that the
+// index covers, or nil if there is no valid index.
+- (NSDictionary *)loadIndex {
+  NSData* index = [NSData dataWithContentsOfFile:[self indexPath]
+                                         options:NSDataReadingMappedIfSafe
+                                           error:nil];
+  const uint8_t* bytes = index.bytes;
+  uint64_t length = index.length;
+  if (length < sizeof(NIDiskCacheIndexHeader)) {
+    return nil;
+  }
+
+  NIDiskCacheIndexHeader header;
+  memcpy(&header, bytes, sizeof(header));
+  uint64_t offset = sizeof(header);
+  if (kIndexMagic != header.magic || kIndexVersion != header.version
+      || (length - offset) / sizeof(NIDiskCacheIndexSegment) < header.numberOfSegments) {
+    return nil;
+  }
+  self.accessCounter = header.accessCounter;
+
+  NSMutableDictionary* indexedLengths = [NSMutableDictionary dictionary];
+  for (uint32_t ix = 0; ix < header.numberOfSegments; ++ix) {
+    NIDiskCacheIndexSegment indexSegment;
+    memcpy(&indexSegment, bytes + offset, sizeof(indexSegment));
+    offset += sizeof(indexSegment);
+
+    // Segments that no longer exist were deleted after a compaction.
+    NSString* segmentPath = [self pathForSegmentIdentifier:indexSegment.identifier];
+    if (![[NSFileManager defaultManager] fileExistsAtPath:segmentPath]) {
+      continue;
+    }
+    NIDiskCacheSegment* segment = [self openSegmentWithIdentifier:indexSegment.identifier];
+    if (nil != segment) {
+      indexedLengths[@(indexSegment.identifier)] = @(MIN(indexSegment.length, segment.fileLength));
+    }
+  }
+
+  for (uint32_t ix = 0; ix < header.numberOfEntries; ++ix) {
+    NIDiskCacheIndexEntry indexEntry;
+    if (length - offset < sizeof(indexEntry)) {
+      break;
+    }
+    memcpy(&indexEntry, bytes + offset, sizeof(indexEntry));
+    offset += sizeof(indexEntry);
+    if (length - offset < indexEntry.nameLength) {
+      break;
+    }
+    offset += indexEntry.nameLength;
+
+    NIDiskCacheSegment* segment = self.segments[@(indexEntry.segmentIdentifier)];
+    NSNumber* indexedLength = indexedLengths[@(indexEntry.segmentIdentifier)];
+    if (nil == segment || nil == indexedLength) {
+      continue;
+    }
+
+    // Checksums are only verified for replayed records. Verifying every indexed record would
+    // read the entire cache from disk.
+    NIDiskCacheRecordHeader recordHeader;
+    NSString* name = nil;
+    if (![segment readRecordAtOffset:indexEntry.recordOffset
+                               limit:[indexedLength unsignedLongLongValue]
+                      verifyChecksum:NO
+                              header:&recordHeader
+                                name:&name]
+        || 0 != (recordHeader.flags & kRecordFlagRemoved)
+        || recordHeader.nameLength != indexEntry.nameLength
+        || 0 != memcmp(bytes + offset - indexEntry.nameLength,
+                       segment.bytes + indexEntry.recordOffset + sizeof(recordHeader),
+                       indexEntry.nameLength)) {
+      continue;
+    }
+
+    NIDiskCacheEntry* entry = [self entryForRecordAtOffset:indexEntry.recordOffset
+                                                 inSegment:segment
+                                                    header:recordHeader];
+    entry.lastAccess = indexEntry.lastAccess;
+    [self setEntry:entry forName:name];
+  }
+
+  return indexedLengths;
+}
+
+// Writes the index to a temporary file and then moves it into place, so a valid index always
+// exists on disk.
+- (void)saveIndex {
+  NSMutableData* index = [NSMutableData data];
+  @synchronized(self) {
+    NIDiskCacheIndexHeader header = {
+      .magic = kIndexMagic,
+      .version = kIndexVersion,
+      .numberOfSegments = (uint32_t)self.segments.count,
+      .numberOfEntries = (uint32_t)self.entries.count,
+      .accessCounter = self.accessCounter,
+    };
+    [index appendBytes:&header length:sizeof(header)];
+
+    for (NIDiskCacheSegment* segment in [self.segments allValues]) {
+      NIDiskCacheIndexSegment indexSegment = {
+        .identifier = segment.identifier,
+        .length = segment.length,
+      };
+      [index appendBytes:&indexSegment length:sizeof(indexSegment)];
+    }
+
+    [self.entries enumerateKeysAndObjectsUsingBlock:
+     ^(NSString* name, NIDiskCacheEntry* entry, BOOL *stop) {
+       NSData* nameData = [name dataUsingEncoding:NSUTF8StringEncoding];
+       NIDiskCacheIndexEntry indexEntry = {
+         .segmentIdentifier = entry.segment.identifier,
+         .nameLength = (uint32_t)nameData.length,
+         .recordOffset = entry.recordOffset,
+         .lastAccess = entry.lastAccess,
+       };
+       [index appendBytes:&indexEntry length:sizeof(indexEntry)];
+       [index appendData:nameData];
+     }];
+    self.indexIsDirty = NO;
+  }
+
+  if (![index writeToFile:[self indexPath] atomically:YES]) {
+    NIDERROR(@"Failed to save the disk cache index at %@", [self indexPath]);
+    @synchronized(self) {
+      self.indexIsDirty = YES;
+    }
+  }
+}
+
+#pragma mark - Writing
+
+// Returns the segment that a record of the given length should be appended to.
+- (NIDiskCacheSegment *)segmentForAppendingLength:(uint64_t)length {
+  @synchronized(self) {
+    NIDiskCacheSegment* segment = self.activeSegment;
+    if (nil == segment || segment.length + length > segment.capacity) {
+      uint32_t identifier = self.nextSegmentIdentifier;
+      NSString* segmentPath = [self pathForSegmentIdentifier:identifier];
+      segment = [[NIDiskCacheSegment alloc] initWithIdentifier:identifier
+                                                          path:segmentPath
+                                                      capacity:MAX(self.segmentSize, length)];
+      if (nil == segment) {
+        return nil;
+      }
+      self.segments[@(identifier)] = segment;
+      self.nextSegmentIdentifier = identifier + 1;
+      self.activeSegment = segment;
+      self.indexIsDirty = YES;
+    }
+    return segment;
+  }
+}
+
+// Only called on the queue. Returns an entry for the new record, or nil if it couldn't be
+// written.
+- (NIDiskCacheEntry *)appendRecordWithName:(NSString *)name
+                                       data:(NSData *)data
+                                      flags:(uint32_t)flags {
+  NSData* nameData = [name dataUsingEncoding:NSUTF8StringEncoding];
+  uint64_t nameLength = nameData.length;
+  uint64_t dataLength = data.length;
+  if (nameLength > UINT32_MAX) {
+    return nil;
+  }
+
+  NIDiskCacheRecordHeader header = {
+    .magic = kRecordMagic,
+    .flags = flags,
+    .nameLength = (uint32_t)nameLength,
+    .dataLength = dataLength,
+  };
+  uint32_t checksum = NIDiskCacheChecksum(kChecksumSeed, nameData.bytes, nameLength);
+  header.checksum = NIDiskCacheChecksum(checksum, data.bytes, dataLength);
+
+  uint64_t paddedNameLength = NIDiskCacheAlign(nameLength);
+  uint64_t recordLength = sizeof(header) + paddedNameLength + NIDiskCacheAlign(dataLength);
+  NIDiskCacheSegment* segment = [self segmentForAppendingLength:recordLength];
+  if (nil == segment) {
+    return nil;
+  }
+
+  // The header, name and padding are small, so they're written together. The data is written
+  // straight from its own buffer. Padding at the end of the record is left as a hole.
+  uint64_t offset = segment.length;
+  NSMutableData* prefix = [NSMutableData dataWithLength:sizeof(header) + paddedNameLength];
+  memcpy(prefix.mutableBytes, &header, sizeof(header));
+  memcpy((uint8_t *)prefix.mutableBytes + sizeof(header), nameData.bytes, nameLength);
+  if (![segment writeBytes:prefix.bytes length:prefix.length atOffset:offset]
+      || ![segment writeBytes:data.bytes length:dataLength atOffset:offset + prefix.length]
+      || ![segment writeBytes:NULL length:0 atOffset:offset + recordLength]) {
+    NIDERROR(@"Failed to write %@ to the disk cache: %s", name, strerror(errno));
+    [segment truncateToLength:offset];
+    return nil;
+  }
+
+  @synchronized(self) {
+    segment.length = offset + recordLength;
+  }
+  return [self entryForRecordAtOffset:offset inSegment:segment header:header];
+}
+
+// Only called on the queue.
+- (void)writeData:(NSData *)data withName:(NSString *)name {
+  NIDiskCacheEntry* entry = [self appendRecordWithName:name data:data flags:0];
+
+  @synchronized(self) {
+    // The data may have been replaced or removed while it was being written.
+    if (self.pendingData[name] == data) {
+      [self.pendingData removeObjectForKey:name];
+      if (nil != entry) {
+        entry.lastAccess = ++self.accessCounter;
+        [self setEntry:entry forName:name];
+      }
+    }
+  }
+}
+
+#pragma mark - Trimming
+
+// Only called on the queue.
+- (void)trimIfNeeded {
+  unsigned long long maxNumberOfBytes = self.maxNumberOfBytes;
+  if (0 == maxNumberOfBytes || [self numberOfBytes] <= maxNumberOfBytes) {
+    return;
+  }
+  unsigned long long targetNumberOfBytes = maxNumberOfBytes / 4 * 3;
+
+  NSArray* segmentsByLiveRatio = nil;
+  @synchronized(self) {
+    // Remove the least recently used data. Removals during a trim don't need removal records
+    // because the index is saved as soon as the trim is done.
+    unsigned long long liveNumberOfBytes = 0;
+    for (NIDiskCacheEntry* entry in [self.entries allValues]) {
+      liveNumberOfBytes += entry.recordLength;
+    }
+    if (liveNumberOfBytes > targetNumberOfBytes) {
+      NSArray* names = [self.entries keysSortedByValueUsingComparator:
+                        ^NSComparisonResult(NIDiskCacheEntry* entry1, NIDiskCacheEntry* entry2) {
+                          if (entry1.lastAccess == entry2.lastAccess) {
+                            return NSOrderedSame;
+                          }
+                          return (entry1.lastAccess < entry2.lastAccess
+                                  ? NSOrderedAscending : NSOrderedDescending);
+                        }];
+      for (NSString* name in names) {
+        if (liveNumberOfBytes <= targetNumberOfBytes) {
+          break;
+        }
+        liveNumberOfBytes -= [self.entries[name] recordLength];
+        [self removeEntryForName:name];
+      }
+    }
+
+    segmentsByLiveRatio = [[self.segments allValues] sortedArrayUsingComparator:
+                           ^NSComparisonResult(NIDiskCacheSegment* segment1,
+                                               NIDiskCacheSegment* segment2) {
+                             double ratio1 = [segment1 liveRatio];
+                             double ratio2 = [segment2 liveRatio];
+                             if (ratio1 == ratio2) {
+                               return NSOrderedSame;
+                             }
+                             return (ratio1 < ratio2) ? NSOrderedAscending : NSOrderedDescending;
+                           }];
+  }
+
+  // Compact the segments that are mostly unused, and keep compacting until the cache fits.
+  NSMutableArray* compactedSegments = [NSMutableArray array];
+  for (NIDiskCacheSegment* segment in segmentsByLiveRatio) {
+    if ([segment liveRatio] >= self.compactionThreshold
+        && [self numberOfBytes] <= maxNumberOfBytes) {
+      break;
+    }
+    [self compactSegment:segment];
+    [compactedSegments addObject:segment];
+  }
+
+  // Save the index before deleting any segments so that the index never refers to data that no
+  // longer exists.
+  [self saveIndex];
+  for (NIDiskCacheSegment* segment in compactedSegments) {
+    [segment deleteFile];
+  }
+}
+
+// Only called on the queue. Moves the segment's live records to the end of the active segment and
+// forgets the segment. The segment's file must be deleted once the index has been saved.
+- (void)compactSegment:(NIDiskCacheSegment *)segment {
+  NSMutableArray* names = [NSMutableArray array];
+  @synchronized(self) {
+    if (self.activeSegment == segment) {
+      self.activeSegment = nil;
+    }
+    [self.entries enumerateKeysAndObjectsUsingBlock:
+     ^(NSString* name, NIDiskCacheEntry* entry, BOOL *stop) {
+       if (entry.segment == segment) {
+         [names addObject:name];
+       }
+     }];
+  }
+
+  for (NSString* name in names) {
+    NIDiskCacheEntry* entry = nil;
+    @synchronized(self) {
+      entry = self.entries[name];
+    }
+    if (entry.segment != segment) {
+      continue;
+    }
+
+    // The segment stays mapped while we hold it, so its data doesn't need to be copied.
+    NSData* data = [NSData dataWithBytesNoCopy:(void *)(segment.bytes + entry.dataOffset)
+                                        length:(NSUInteger)entry.dataLength
+                                  freeWhenDone:NO];
+    NIDiskCacheEntry* movedEntry = [self appendRecordWithName:name data:data flags:0];
+
+    @synchronized(self) {
+      if (self.entries[name] == entry) {
+        if (nil != movedEntry) {
+          movedEntry.lastAccess = entry.lastAccess;
+          [self setEntry:movedEntry forName:name];
+        } else {
+          [self removeEntryForName:name];
+        }
+      }
+    }
+  }
+
+  @synchronized(self) {
+    [self.segments removeObjectForKey:@(segment.identifier)];
+    self.indexIsDirty = YES;
+  }
+}
+
+#pragma mark - Public
+
+- (NSUInteger)count {
+  @synchronized(self) {
+    NSMutableSet* names = [NSMutableSet setWithArray:[self.entries allKeys]];
+    [names addObjectsFromArray:[self.pendingData allKeys]];
+    return names.count;
+  }
+}
+
+- (unsigned long long)numberOfBytes {
+  @synchronized(self) {
+    unsigned long long numberOfBytes = 0;
+    for (NIDiskCacheSegment* segment in [self.segments allValues]) {
+      numberOfBytes += segment.length;
+    }
+    return numberOfBytes;
+  }
+}
+
+- (void)storeData:(NSData *)data withName:(NSString *)name {
+  NIDASSERT(nil != data && nil != name);
+  if (nil == data || nil == name) {
+    return;
+  }
+
+  data = [data copy];
+  @synchronized(self) {
+    self.pendingData[name] = data;
+  }
+  dispatch_async(self.queue, ^{
+    [self writeData:data withName:name];
+    [self trimIfNeeded];
+  });
+}
+
+- (NSData *)dataWithName:(NSString *)name {
+  NIDiskCacheSegment* segment = nil;
+  const uint8_t* bytes = NULL;
+  NSUInteger length = 0;
+
+  @synchronized(self) {
+    NSData* pendingData = self.pendingData[name];
+    if (nil != pendingData) {
+      return pendingData;
+    }
+
+    NIDiskCacheEntry* entry = self.entries[name];
+    if (nil == entry) {
+      return nil;
+    }
+    entry.lastAccess = ++self.accessCounter;
+    self.indexIsDirty = YES;
+
+    segment = entry.segment;
+    bytes = segment.bytes + entry.dataOffset;
+    length = (NSUInteger)entry.dataLength;
+  }
+
+  // The data keeps the segment, and therefore its mapping, alive.
+  return [[NSData alloc] initWithBytesNoCopy:(void *)bytes
+                                      length:length
+                                 deallocator:^(void* unusedBytes, NSUInteger unusedLength) {
+                                   [segment self];
+                                 }];
+}
+
+- (BOOL)containsDataWithName:(NSString *)name {
+  @synchronized(self) {
+    return (nil != self.pendingData[name] || nil != self.entries[name]);
+  }
+}
+
+- (void)removeDataWithName:(NSString *)name {
+  BOOL didRemove = NO;
+  @synchronized(self) {
+    didRemove = [self containsDataWithName:name];
+    [self.pendingData removeObjectForKey:name];
+    [self removeEntryForName:name];
+  }
+
+  if (didRemove) {
+    dispatch_async(self.queue, ^{
+      [self appendRecordWithName:name data:nil flags:kRecordFlagRemoved];
+    });
+  }
+}
+
+- (void)removeAllDataWithPrefix:(NSString *)prefix {
+  NSMutableSet* names = [NSMutableSet set];
+  @synchronized(self) {
+    for (NSString* name in [self.entries allKeys]) {
+      if ([name hasPrefix:prefix]) {
+        [names addObject:name];
+      }
+    }
+    for (NSString* name in [self.pendingData allKeys]) {
+      if ([name hasPrefix:prefix]) {
+        [names addObject:name];
+      }
+    }
+  }
+  for (NSString* name in names) {
+    [self removeDataWithName:name];
+  }
+}
+
+- (void)removeAllData {
+  @synchronized(self) {
+    [self.pendingData removeAllObjects];
+    [self.entries removeAllObjects];
+  }
+
+  dispatch_async(self.queue, ^{
+    NSArray* segments = nil;
+    @synchronized(self) {
+      segments = [self.segments allValues];
+      [self.segments removeAllObjects];
+      self.activeSegment = nil;
+    }
+    [self saveIndex];
+    for (NIDiskCacheSegment* segment in segments) {
+      [segment deleteFile];
+    }
+  });
+}
+
+- (void)synchronize {
+  dispatch_sync(self.queue, ^{
+    [self saveIndex];
+  });
+}
+
+@end
+
+@implementation NIDiskCacheSegment {
+  int _fileDescriptor;
+  size_t _mappedLength;
+}
+
+- (void)dealloc {
+  if (NULL != _bytes) {
+    munmap((void *)_bytes, _mappedLength);
+  }
+  if (_fileDescriptor >= 0) {
+    close(_fileDescriptor);
+  }
+}
+
+- (id)initWithIdentifier:(uint32_t)identifier path:(NSString *)path capacity:(uint64_t)capacity {
+  if ((self = [super init])) {
+    _identifier = identifier;
+    _path = [path copy];
+
+    _fileDescriptor = open([path fileSystemRepresentation], O_RDWR | O_CREAT, 0644);
+    struct stat fileStatus;
+    if (_fileDescriptor < 0 || 0 != fstat(_fileDescriptor, &fileStatus)) {
+      NIDERROR(@"Failed to open disk cache segment %@: %s", path, strerror(errno));
+      return nil;
+    }
+    _fileLength = (uint64_t)fileStatus.st_size;
+
+    // Map the whole capacity up front. Pages past the end of the file are never touched.
+    uint64_t pageSize = (uint64_t)getpagesize();
+    _capacity = MAX(capacity, _fileLength);
+    _mappedLength = (size_t)((_capacity + pageSize - 1) / pageSize * pageSize);
+    void* bytes = mmap(NULL, _mappedLength, PROT_READ, MAP_SHARED, _fileDescriptor, 0);
+    if (MAP_FAILED == bytes) {
+      NIDERROR(@"Failed to map disk cache segment %@: %s", path, strerror(errno));
+      _mappedLength = 0;
+      return nil;
+    }
+    _bytes = bytes;
+  }
+  return self;
+}
+
+- (BOOL)writeBytes:(const void *)bytes length:(uint64_t)length atOffset:(uint64_t)offset {
+  if (0 == length) {
+    // Extend the file to the given offset so that trailing padding is part of the file.
+    struct stat fileStatus;
+    if (0 != fstat(_fileDescriptor, &fileStatus)) {
+      return NO;
+    }
+    return ((uint64_t)fileStatus.st_size >= offset
+            || 0 == ftruncate(_fileDescriptor, (off_t)offset));
+  }
+
+  const uint8_t* byte = bytes;
+  while (length > 0) {
+    ssize_t written = pwrite(_fileDescriptor, byte, (size_t)length, (off_t)offset);
+    if (written < 0) {
+      if (EINTR == errno) {
+        continue;
+      }
+      return NO;
+    }
+    byte += written;
+    length -= (uint64_t)written;
+    offset += (uint64_t)written;
+  }
+  return YES;
+}
+
+- (double)liveRatio {
+  return (double)self.liveLength / MAX(self.length, (uint64_t)1);
+}
+
+- (void)truncateToLength:(uint64_t)length {
+  ftruncate(_fileDescriptor, (off_t)length);
+}
+
+- (void)deleteFile {
+  // The mapping stays valid until the segment is deallocated, so data that is still being read
+  // survives the file being deleted.
+  unlink([self.path fileSystemRepresentation]);
+}
+
+- (BOOL)readRecordAtOffset:(uint64_t)offset
+                     limit:(uint64_t)limit
+            verifyChecksum:(BOOL)verifyChecksum
+                    header:(NIDiskCacheRecordHeader *)header
+                      name:(NSString **)name {
+  if (offset > limit || limit - offset < sizeof(*header) || limit > _capacity) {
+    return NO;
+  }
+  memcpy(header, _bytes + offset, sizeof(*header));
+
+  uint64_t available = limit - offset - sizeof(*header);
+  uint64_t paddedNameLength = NIDiskCacheAlign(header->nameLength);
+  if (kRecordMagic != header->magic
+      || header->nameLength > available
+      || header->dataLength > available
+      || paddedNameLength > available
+      || NIDiskCacheAlign(header->dataLength) > available - paddedNameLength) {
+    return NO;
+  }
+
+  const uint8_t* nameBytes = _bytes + offset + sizeof(*header);
+  if (verifyChecksum) {
+    uint32_t checksum = NIDiskCacheChecksum(kChecksumSeed, nameBytes, header->nameLength);
+    checksum = NIDiskCacheChecksum(checksum, nameBytes + paddedNameLength, header->dataLength);
+    if (checksum != header->checksum) {
+      return NO;
+    }
+  }
+
+  *name = [[NSString alloc] initWithBytes:nameBytes
+                                   length:header->nameLength
+                                 encoding:NSUTF8StringEncoding];
+  return (nil != *name);
+}
+
+@end
+
+@implementation NIDiskCacheEntry
+@end
@@ -0,0 +1,130 @@
+//
+// Copyright 2011-2014 NimbusKit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+#import <UIKit/UIKit.h>
+
+/**
+ * For loading the images of cells before the cells are shown.
+ *
+ * @ingroup NimbusCore
+ * @defgroup Core-Image-Prefetching Image Prefetching
+ * @{
+ *
+ * UICollectionView and UITableView tell their data sources which rows are about to be shown.
+ * NICollectionViewModel and NITableViewModel pass those rows' objects on to an image prefetcher
+ * when the objects conform to NIImagePrefetchingObject. The prefetcher loads and processes the
+ * images in the background so that they are already decoded in the memory cache by the time
+ * the cells are shown.
+ *
+ * The models only know about the protocols declared here. NINetworkImagePrefetcher in the
+ * NetworkImage feature is an image prefetcher for cells that show NINetworkImageViews.
+ *
+ * <h2>Example Use</h2>
+ *
+@code
+@implementation ProfileCellObject
+
+- (NSArray *)imagePrefetchRequests {
+  // The size and content mode of the cell's NINetworkImageView.
+  return @[[NIImagePrefetchRequest requestWithPath:self.avatarPath
+                                       displaySize:CGSizeMake(40, 40)
+                                       contentMode:UIViewContentModeScaleAspectFill]];
+}
+
+@end
+
+self.model.imagePrefetcher = [[NINetworkImagePrefetcher alloc] init];
+self.tableView.prefetchDataSource = self.model;
+@endcode
+ */
+
+/**
+ * An image that a cell will show, and how the cell will show it.
+ */
+@interface NIImagePrefetchRequest : NSObject
+
++ (instancetype)requestWithPath:(NSString *)path displaySize:(CGSize)displaySize contentMode:(UIViewContentMode)contentMode;
+
+// Designated initializer.
+- (instancetype)initWithPath:(NSString *)path displaySize:(CGSize)displaySize contentMode:(UIViewContentMode)contentMode;
+
+@property (nonatomic, readonly, copy) NSString* path;
+@property (nonatomic, readonly, assign) CGSize displaySize;
+@property (nonatomic, readonly, assign) UIViewContentMode contentMode;
+@property (nonatomic, assign) CGRect cropRect; // Default: CGRectZero
+
+@end
+
+/**
+ * The NIImagePrefetchingObject protocol is implemented by model objects whose cells show images.
+ */
+@protocol NIImagePrefetchingObject <NSObject>
+@required
+
+/**
+ * The images that this object's cell will show.
+ *
+ * Each request must describe the image exactly as the cell will request it, so that the
+ * prefetched image is found in the memory cache.
+ */
+- (NSArray<NIImagePrefetchRequest *> *)imagePrefetchRequests;
+
+@end
+
+/**
+ * The NIImagePrefetcher protocol is implemented by objects that load images ahead of time.
+ */
+@protocol NIImagePrefetcher <NSObject>
+@required
+
+/**
+ * Starts loading the given object's images at a low priority.
+ */
+- (void)prefetchImagesForObject:(id<NIImagePrefetchingObject>)object;
+
+/**
+ * Cancels loading the given object's images if they have not finished loading yet.
+ */
+- (void)cancelPrefetchingImagesForObject:(id<NIImagePrefetchingObject>)object;
+
+@end
+
+/**@}*/ // End of Image Prefetching
+
+/**
+ * Returns an autoreleased request for the image at the given path.
+ *
+ * @fn NIImagePrefetchRequest::requestWithPath:displaySize:contentMode:
+ */
+
+/**
+ * Initializes a newly allocated request for the image at the given path.
+ *
+ * @param path         The path that the cell will give its image view.
+ * @param displaySize  The size that the image will be displayed at, in points. This is usually
+ *                     the size of the cell's image view.
+ * @param contentMode  The content mode of the cell's image view.
+ * @fn NIImagePrefetchRequest::initWithPath:displaySize:contentMode:
+ */
+
+/**
+ * The portion of the image that will be displayed.
+ *
+ * By default this is CGRectZero, meaning the whole image.
+ *
+ * @fn NIImagePrefetchRequest::cropRect
+ */
@@ -0,0 +1,52 @@
+//
+// Copyright 2011-2014 NimbusKit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import "NIImagePrefetching.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "Nimbus requires ARC support."
+#endif
+
+@implementation NIImagePrefetchRequest
+
++ (instancetype)requestWithPath:(NSString *)path displaySize:(CGSize)displaySize contentMode:(UIViewContentMode)contentMode {
+  return [[self alloc] initWithPath:path displaySize:displaySize contentMode:contentMode];
+}
+
+- (instancetype)initWithPath:(NSString *)path displaySize:(CGSize)displaySize contentMode:(UIViewContentMode)contentMode {
+  if ((self = [super init])) {
+    _path = [path copy];
+    _displaySize = displaySize;
+    _contentMode = contentMode;
+    _cropRect = CGRectZero;
+  }
+  return self;
+}
+
+- (NSString *)description {
+  return [NSString stringWithFormat:
+          @"<%@"
+          @" path: %@"
+          @" displaySize: %@"
+          @" contentMode: %zd"
+          @">",
+          [super description],
+          self.path,
+          NSStringFromCGSize(self.displaySize),
+          self.contentMode];
+}
+
+@end
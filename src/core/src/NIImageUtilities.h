@@ -44,6 +44,40 @@ extern "C" {
 UIImage* NIStretchableImageFromImage(UIImage* image)
     API_UNAVAILABLE(tvos, watchos);
 
+/**
+ * Returns the number of bytes of memory that the decoded bitmap of an image occupies.
+ *
+ * The size is read from the image's CGImage, so row padding, the number of bits per component
+ * and wide-color or 16-bit formats are all taken into account. Images that have not been decoded
+ * yet report the size of the bitmap they will be decoded into, which is the memory they will
+ * use once they are displayed. The frames of an animated image are added together.
+ *
+ * Images that are not backed by a CGImage are assumed to use four bytes per pixel.
+ */
+unsigned long long NIMemoryCostOfImage(UIImage* image);
+
+/**
+ * Returns the decoded pixels of an image along with the information needed to recreate it.
+ *
+ * The pixels are stored as 32-bit premultiplied BGRA in the device RGB color space, except for
+ * opaque 16-bit RGB and 8-bit grayscale images, which keep their smaller formats. Images
+ * created from the data with NIImageFromBitmapData() display without being decoded again,
+ * which makes the data suitable for storing already processed images on disk.
+ *
+ * Returns nil for animated images and images that are not backed by a CGImage.
+ */
+NSData* NIBitmapDataFromImage(UIImage* image);
+
+/**
+ * Returns an image that draws directly from bitmap data created by NIBitmapDataFromImage().
+ *
+ * The pixels are not copied, so the image retains the data for as long as it is alive. This
+ * makes it possible to display images from memory-mapped files without reading them first.
+ *
+ * Returns nil if the data was not created by NIBitmapDataFromImage().
+ */
+UIImage* NIImageFromBitmapData(NSData* data);
+
 /**@}*/// End of Image Utilities //////////////////////////////////////////////////////////////////
 
 #if defined __cplusplus
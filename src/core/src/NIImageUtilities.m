@@ -22,3 +22,182 @@ UIImage* NIStretchableImageFromImage(UIImage* image) {
   NSInteger midY = (NSInteger)(size.height / 2.f);
   return [image stretchableImageWithLeftCapWidth:midX topCapHeight:midY];
 }
+
+unsigned long long NIMemoryCostOfImage(UIImage* image) {
+  if (nil == image) {
+    return 0;
+  }
+
+  if (image.images.count > 0) {
+    unsigned long long cost = 0;
+    for (UIImage* frame in image.images) {
+      cost += NIMemoryCostOfImage(frame);
+    }
+    return cost;
+  }
+
+  CGImageRef imageRef = image.CGImage;
+  if (NULL != imageRef) {
+    return (unsigned long long)CGImageGetBytesPerRow(imageRef) * CGImageGetHeight(imageRef);
+  }
+
+  const CGFloat scale = image.scale;
+  return (unsigned long long)(image.size.width * scale * image.size.height * scale * 4);
+}
+
+// Precedes the pixels in data created by NIBitmapDataFromImage(). The header is padded so that
+// the pixels start on a 16 byte boundary.
+typedef struct {
+  uint32_t magic;
+  uint32_t width;
+  uint32_t height;
+  uint32_t bytesPerRow;
+  float scale;
+  int32_t orientation;
+  uint32_t format;
+  uint32_t reserved;
+} NIBitmapDataHeader;
+
+static const uint32_t kBitmapDataMagic = 0x4E494231; // "NIB1"
+
+// The pixel formats that bitmap data is stored in. Data written before the format was recorded
+// has a format of zero, which is premultiplied BGRA.
+typedef enum {
+  NIBitmapDataFormatBGRA = 0,
+  NIBitmapDataFormatRGB565 = 1,
+  NIBitmapDataFormatGray = 2,
+} NIBitmapDataFormat;
+
+typedef struct {
+  size_t bitsPerComponent;
+  size_t bitsPerPixel;
+  CGBitmapInfo bitmapInfo;
+  BOOL isGray;
+} NIBitmapDataLayout;
+
+static BOOL NIBitmapDataLayoutForFormat(uint32_t format, NIBitmapDataLayout* layout) {
+  switch (format) {
+    case NIBitmapDataFormatBGRA:
+      *layout = (NIBitmapDataLayout){8, 32, kCGBitmapByteOrder32Little | kCGImageAlphaPremultipliedFirst, NO};
+      return YES;
+    case NIBitmapDataFormatRGB565:
+      *layout = (NIBitmapDataLayout){5, 16, kCGBitmapByteOrder16Little | kCGImageAlphaNoneSkipFirst, NO};
+      return YES;
+    case NIBitmapDataFormatGray:
+      *layout = (NIBitmapDataLayout){8, 8, (CGBitmapInfo)kCGImageAlphaNone, YES};
+      return YES;
+    default:
+      return NO;
+  }
+}
+
+// Opaque 16-bit and grayscale images keep their smaller format. Everything else is stored as BGRA.
+static NIBitmapDataFormat NIBitmapDataFormatForImage(CGImageRef imageRef) {
+  CGImageAlphaInfo alphaInfo = CGImageGetAlphaInfo(imageRef);
+  if (kCGImageAlphaNone != alphaInfo
+      && kCGImageAlphaNoneSkipFirst != alphaInfo
+      && kCGImageAlphaNoneSkipLast != alphaInfo) {
+    return NIBitmapDataFormatBGRA;
+  }
+
+  CGColorSpaceModel model = CGColorSpaceGetModel(CGImageGetColorSpace(imageRef));
+  if (kCGColorSpaceModelMonochrome == model && 8 == CGImageGetBitsPerPixel(imageRef)) {
+    return NIBitmapDataFormatGray;
+  }
+  if (kCGColorSpaceModelRGB == model
+      && 16 == CGImageGetBitsPerPixel(imageRef)
+      && 5 == CGImageGetBitsPerComponent(imageRef)) {
+    return NIBitmapDataFormatRGB565;
+  }
+  return NIBitmapDataFormatBGRA;
+}
+
+static CGColorSpaceRef NICreateColorSpaceForBitmapDataLayout(const NIBitmapDataLayout* layout) {
+  return layout->isGray ? CGColorSpaceCreateDeviceGray() : CGColorSpaceCreateDeviceRGB();
+}
+
+NSData* NIBitmapDataFromImage(UIImage* image) {
+  CGImageRef imageRef = image.CGImage;
+  if (NULL == imageRef || image.images.count > 0) {
+    return nil;
+  }
+
+  NIBitmapDataFormat format = NIBitmapDataFormatForImage(imageRef);
+  NIBitmapDataLayout layout;
+  NIBitmapDataLayoutForFormat(format, &layout);
+
+  size_t width = CGImageGetWidth(imageRef);
+  size_t height = CGImageGetHeight(imageRef);
+  size_t bytesPerRow = width * layout.bitsPerPixel / 8;
+  if (0 == width || 0 == height || width > UINT32_MAX / 4 || height > UINT32_MAX) {
+    return nil;
+  }
+
+  NSMutableData* data = [NSMutableData dataWithLength:sizeof(NIBitmapDataHeader)
+                                                       + bytesPerRow * height];
+  NIBitmapDataHeader* header = data.mutableBytes;
+  header->magic = kBitmapDataMagic;
+  header->width = (uint32_t)width;
+  header->height = (uint32_t)height;
+  header->bytesPerRow = (uint32_t)bytesPerRow;
+  header->scale = (float)image.scale;
+  header->orientation = (int32_t)image.imageOrientation;
+  header->format = format;
+
+  CGColorSpaceRef colorSpace = NICreateColorSpaceForBitmapDataLayout(&layout);
+  CGContextRef context = CGBitmapContextCreate((uint8_t *)data.mutableBytes + sizeof(*header),
+                                               width, height, layout.bitsPerComponent,
+                                               bytesPerRow, colorSpace, layout.bitmapInfo);
+  CGColorSpaceRelease(colorSpace);
+  if (NULL == context) {
+    return nil;
+  }
+  CGContextDrawImage(context, CGRectMake(0, 0, width, height), imageRef);
+  CGContextRelease(context);
+
+  return data;
+}
+
+static void NIReleaseBitmapData(void* info, const void* bytes, size_t size) {
+  CFRelease(info);
+}
+
+UIImage* NIImageFromBitmapData(NSData* data) {
+  if (data.length < sizeof(NIBitmapDataHeader)) {
+    return nil;
+  }
+  const NIBitmapDataHeader* header = data.bytes;
+  NIBitmapDataLayout layout;
+  if (kBitmapDataMagic != header->magic || !NIBitmapDataLayoutForFormat(header->format, &layout)) {
+    return nil;
+  }
+  size_t pixelLength = (size_t)header->bytesPerRow * header->height;
+  if (0 == header->width || 0 == header->height
+      || header->bytesPerRow < (size_t)header->width * layout.bitsPerPixel / 8
+      || data.length - sizeof(*header) < pixelLength) {
+    return nil;
+  }
+
+  // The provider keeps the data alive until the image no longer needs its pixels.
+  CGDataProviderRef provider =
+      CGDataProviderCreateWithData((void *)CFBridgingRetain(data),
+                                   (const uint8_t *)data.bytes + sizeof(*header),
+                                   pixelLength,
+                                   NIReleaseBitmapData);
+  CGColorSpaceRef colorSpace = NICreateColorSpaceForBitmapDataLayout(&layout);
+  CGImageRef imageRef = CGImageCreate(header->width, header->height, layout.bitsPerComponent,
+                                      layout.bitsPerPixel, header->bytesPerRow, colorSpace,
+                                      layout.bitmapInfo, provider, NULL, NO,
+                                      kCGRenderingIntentDefault);
+  CGColorSpaceRelease(colorSpace);
+  CGDataProviderRelease(provider);
+  if (NULL == imageRef) {
+    return nil;
+  }
+
+  UIImage* image = [UIImage imageWithCGImage:imageRef
+                                       scale:header->scale
+                                 orientation:(UIImageOrientation)header->orientation];
+  CGImageRelease(imageRef);
+  return image;
+}
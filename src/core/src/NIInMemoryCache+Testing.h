@@ -0,0 +1,40 @@
+//
+// Copyright 2011-2014 NimbusKit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import "NIInMemoryCache.h"
+
+API_DEPRECATED_BEGIN("Use NSCache instead.", ios(12, API_TO_BE_DEPRECATED))
+
+/**
+ * A category exposing methods that are exercised by unit tests.
+ */
+@interface NIMemoryCache (Testing)
+
+/**
+ * Moves the clock that every memory cache uses for access times and expiration forward.
+ *
+ * This allows tests to expire objects without waiting for them to expire.
+ */
++ (void)advanceClockByTimeInterval:(NSTimeInterval)timeInterval;
+
+/**
+ * Undoes every call to advanceClockByTimeInterval:.
+ */
++ (void)resetClock;
+
+@end
+
+API_DEPRECATED_END
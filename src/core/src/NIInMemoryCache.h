@@ -16,8 +16,13 @@
 
 #import <Foundation/Foundation.h>
 
+#import "NIMemoryCacheEvictionPolicy.h"
+#import "NIMemoryPressureCoordinator.h"
 #import "NIPreprocessorMacros.h"
 
+@class NIDiskCache;
+@class UIImage;
+
 API_DEPRECATED_BEGIN("Use NSCache instead.", ios(12, API_TO_BE_DEPRECATED))
 
 /**
@@ -31,40 +36,89 @@ API_DEPRECATED_BEGIN("Use NSCache instead.", ios(12, API_TO_BE_DEPRECATED))
  * @{
  */
 
+/**
+ * A snapshot of the activity of an in-memory cache.
+ *
+ * Counts start when the cache is created or when its statistics were last reset.
+ */
+typedef struct {
+  unsigned long long hits;
+  unsigned long long misses;
+  unsigned long long stores;
+
+  // Removals by cause.
+  unsigned long long evictions;               // To stay within the cache's limits.
+  unsigned long long expirations;
+  unsigned long long memoryPressureEvictions;
+  unsigned long long removals;                // Explicit removals.
+
+  unsigned long long evictedCost;             // Of evictions, expirations and pressure evictions.
+  NSTimeInterval lockWaitTime;
+} NIMemoryCacheStatistics;
+
 /**
  * An in-memory cache for storing objects with expiration support.
  *
  * The Nimbus in-memory object cache allows you to store objects in memory with an expiration
  * date attached. Objects with expiration dates drop out of the cache when they have expired.
+ *
+ * The cache is safe to use from multiple threads. Caches that are read from many threads at
+ * once may be split into independently locked shards with initWithCapacity:numberOfShards:.
  */
-@interface NIMemoryCache : NSObject
+@interface NIMemoryCache : NSObject <NIMemoryPressureResponder>
 
-// Designated initializer.
 - (id)initWithCapacity:(NSUInteger)capacity;
 
+// Designated initializer.
+- (id)initWithCapacity:(NSUInteger)capacity numberOfShards:(NSUInteger)numberOfShards;
+
 - (NSUInteger)count;
+@property (nonatomic, readonly) unsigned long long totalCost;
 
 - (void)storeObject:(id)object withName:(NSString *)name;
 - (void)storeObject:(id)object withName:(NSString *)name expiresAfter:(NSDate *)expirationDate;
+- (void)storeObject:(id)object withName:(NSString *)name cost:(unsigned long long)cost;
+- (void)storeObject:(id)object withName:(NSString *)name cost:(unsigned long long)cost expiresAfter:(NSDate *)expirationDate;
+- (void)storeObjects:(NSArray *)objects withNames:(NSArray *)names expiresAfter:(NSDate *)expirationDate;
 
 - (void)removeObjectWithName:(NSString *)name;
 - (void)removeAllObjectsWithPrefix:(NSString *)prefix;
 - (void)removeAllObjects;
 
 - (id)objectWithName:(NSString *)name;
+- (NSDictionary *)objectsWithNames:(NSArray *)names;
 - (BOOL)containsObjectWithName:(NSString *)name;
 - (NSDate *)dateOfLastAccessWithName:(NSString *)name;
+- (NSDate *)expirationDateOfObjectWithName:(NSString *)name;
+- (void)enumerateObjectsWithPrefix:(NSString *)prefix
+                        usingBlock:(void (^)(NSString* name, id object, BOOL* stop))block;
 
 - (NSString *)nameOfLeastRecentlyUsedObject;
 - (NSString *)nameOfMostRecentlyUsedObject;
 
+@property (nonatomic, strong) id<NIMemoryCacheEvictionPolicy> evictionPolicy; // Default: nil (LRU)
+@property (nonatomic, assign) BOOL keepsEvictedObjectsWhileInUse; // Default: NO
+
+@property (nonatomic, assign) NSTimeInterval proactiveExpirationInterval; // Default: 0
+
+- (void)removeExpiredObjects;
 - (void)reduceMemoryUsage;
 
+@property (nonatomic, assign) double memoryPressureRecreationPrice; // Default: 1
+
+@property (nonatomic, readonly) NIMemoryCacheStatistics statistics;
+- (void)resetStatistics;
+
 // Subclassing
 
 - (BOOL)shouldSetObject:(id)object withName:(NSString *)name previousObject:(id)previousObject;
 - (void)didSetObject:(id)object withName:(NSString *)name;
+- (void)didSetObjects:(NSArray *)objects withNames:(NSArray *)names;
 - (void)willRemoveObject:(id)object withName:(NSString *)name;
+- (unsigned long long)costOfObject:(id)object;
+
+- (NSString *)nameOfObjectToEvict;
+- (void)evictObjectWithName:(NSString *)name;
 
 // Deprecated method. Use shouldSetObject:withName:previousObject: instead.
 - (BOOL)willSetObject:(id)object withName:(NSString *)name previousObject:(id)previousObject __NI_DEPRECATED_METHOD;
@@ -72,17 +126,29 @@ API_DEPRECATED_BEGIN("Use NSCache instead.", ios(12, API_TO_BE_DEPRECATED))
 @end
 
 /**
- * An in-memory cache for storing images with caps on the total number of pixels.
+ * Loads the image with the given name when an NIImageMemoryCache warms up its hot set. Returns nil
+ * if the image is no longer available.
+ */
+typedef UIImage* (^NIImageMemoryCacheHotSetLoader)(NSString* name);
+
+/**
+ * An in-memory cache for storing images with caps on the total number of pixels and bytes.
  *
  * When reduceMemoryUsage is called, the least recently used images are removed from the cache
- * until the numberOfPixels is below maxNumberOfPixelsUnderStress.
+ * until the numberOfPixels is below maxNumberOfPixelsUnderStress and the numberOfBytes is below
+ * maxNumberOfBytesUnderStress.
  *
  * When an image is added to the cache that causes the memory usage to pass the max, the
  * least recently used images are removed from the cache until the numberOfPixels is below
- * maxNumberOfPixels.
+ * maxNumberOfPixels and the numberOfBytes is below maxNumberOfBytes.
+ *
+ * The cost of an image is the size of its decoded bitmap in bytes as reported by
+ * NIMemoryCostOfImage(). Use storeObject:withName:cost: to store an image with a different
+ * cost.
  *
- * By default the image memory cache has no limit to its pixel count. You must explicitly
- * set this value in your application.
+ * By default the image memory cache has no limit to its pixel or byte count. You must
+ * explicitly set these values in your application. Limiting the number of bytes is more accurate
+ * because the number of bytes per pixel varies between images.
  *
  * @attention If the cache is too small to fit the newly added image, then all images
  *                 will end up being removed including the one being added.
@@ -97,6 +163,30 @@ API_DEPRECATED_BEGIN("Use NSCache instead.", ios(12, API_TO_BE_DEPRECATED))
 @property (nonatomic)           unsigned long long maxNumberOfPixels;             // Default: 0 (unlimited)
 @property (nonatomic)           unsigned long long maxNumberOfPixelsUnderStress;  // Default: 0 (unlimited)
 
+@property (nonatomic, readonly) unsigned long long numberOfBytes;
+
+@property (nonatomic)           unsigned long long maxNumberOfBytes;              // Default: 0 (unlimited)
+@property (nonatomic)           unsigned long long maxNumberOfBytesUnderStress;   // Default: 0 (unlimited)
+
+@property (nonatomic, strong)   NIDiskCache* diskCache;                           // Default: nil
+
+// Variant families
+
+- (void)addObjectWithName:(NSString *)name toVariantFamily:(NSString *)familyName variantInfo:(id)variantInfo;
+- (NSDictionary *)variantInfosInVariantFamily:(NSString *)familyName;
+- (void)removeObjectsInVariantFamily:(NSString *)familyName;
+
+// Warm starts
+
+@property (nonatomic, copy)     NSString* hotSetPath;                             // Default: nil
+@property (nonatomic)           NSUInteger maxNumberOfHotSetNames;                // Default: 200
+@property (nonatomic, copy)     NIImageMemoryCacheHotSetLoader hotSetLoader;      // Default: nil
+
+- (BOOL)saveHotSet;
+- (void)warmStartWithTimeLimit:(NSTimeInterval)timeLimit
+              maxNumberOfBytes:(unsigned long long)maxNumberOfBytes
+                    completion:(void (^)(NSArray* names))completion;
+
 @end
 
 /**@}*/// End of In-Memory Cache //////////////////////////////////////////////////////////////////
@@ -110,6 +200,22 @@ API_DEPRECATED_BEGIN("Use NSCache instead.", ios(12, API_TO_BE_DEPRECATED))
  * @fn NIMemoryCache::initWithCapacity:
  */
 
+/**
+ * Initializes a newly allocated cache with the given capacity split across a number of shards.
+ *
+ * Object names are assigned to a shard by their hash. Each shard has its own lock and its own
+ * least-recently-used list, so fetching objects from different shards on different threads does
+ * not contend. Storing and removing objects still synchronizes on the cache as a whole so that
+ * subclasses such as NIImageMemoryCache can enforce their limits across every shard.
+ *
+ * The least recently used object is the oldest of the shards' least recently used objects.
+ *
+ * @param capacity        The total initial capacity of the cache.
+ * @param numberOfShards  The number of shards. 1 disables sharding.
+ * @returns An in-memory cache initialized with the given capacity and number of shards.
+ * @fn NIMemoryCache::initWithCapacity:numberOfShards:
+ */
+
 /** @name Storing Objects in the Cache */
 
 /**
@@ -136,6 +242,44 @@ API_DEPRECATED_BEGIN("Use NSCache instead.", ios(12, API_TO_BE_DEPRECATED))
  * @fn NIMemoryCache::storeObject:withName:expiresAfter:
  */
 
+/**
+ * Stores an object in the cache with the given cost.
+ *
+ * The cost is added to the cache's totalCost for as long as the object is in the cache. The
+ * other store methods ask costOfObject: for the cost of the object.
+ *
+ * @param object  The object being stored in the cache.
+ * @param name    The name used as a key to store this object.
+ * @param cost    The cost of keeping this object in the cache.
+ * @fn NIMemoryCache::storeObject:withName:cost:
+ */
+
+/**
+ * Stores an object in the cache with the given cost and expiration date.
+ *
+ * @param object          The object being stored in the cache.
+ * @param name            The name used as a key to store this object.
+ * @param cost            The cost of keeping this object in the cache.
+ * @param expirationDate  A date after which this object is no longer valid in the cache.
+ * @fn NIMemoryCache::storeObject:withName:cost:expiresAfter:
+ */
+
+/**
+ * Stores a batch of objects in the cache with a shared expiration date.
+ *
+ * Behaves like calling storeObject:withName:expiresAfter: for each object in order, but the
+ * cache, each shard and the eviction policy are only locked once and didSetObjects:withNames:
+ * is called once for the whole batch. NIImageMemoryCache therefore only enforces its limits
+ * after every image in the batch has been stored.
+ *
+ * @param objects         The objects being stored in the cache.
+ * @param names           The names used as keys to store the objects. Must have the same
+ *                             number of elements as objects.
+ * @param expirationDate  A date after which the objects are no longer valid in the cache, or
+ *                             nil if the objects do not expire.
+ * @fn NIMemoryCache::storeObjects:withNames:expiresAfter:
+ */
+
 /** @name Removing Objects from the Cache */
 
 /**
@@ -148,7 +292,8 @@ API_DEPRECATED_BEGIN("Use NSCache instead.", ios(12, API_TO_BE_DEPRECATED))
 /**
  * Removes all objects from the cache with a given prefix.
  *
- * This method requires a scan of the cache entries.
+ * Object names are indexed by prefix, so this method only visits the objects that are removed.
+ * As with <code>-[NSString hasPrefix:]</code>, an empty prefix matches no objects.
  *
  * @param prefix Any object name that has this prefix will be removed from the cache.
  * @fn NIMemoryCache::removeAllObjectsWithPrefix:
@@ -175,6 +320,19 @@ API_DEPRECATED_BEGIN("Use NSCache instead.", ios(12, API_TO_BE_DEPRECATED))
  * @fn NIMemoryCache::objectWithName:
  */
 
+/**
+ * Retrieves a batch of objects from the cache.
+ *
+ * Behaves like calling objectWithName: for each name in order, but each shard and the eviction
+ * policy are only locked once. Use this when many objects are needed at once, such as when a
+ * data source lays out a screenful of cells.
+ *
+ * @param names  The names of the objects to retrieve.
+ * @returns A dictionary of the unexpired objects that were found, keyed by name. Names that
+ *               missed are not in the dictionary.
+ * @fn NIMemoryCache::objectsWithNames:
+ */
+
 /**
  * Returns a Boolean value that indicates whether an object with the given name is present
  * in the cache.
@@ -202,6 +360,20 @@ API_DEPRECATED_BEGIN("Use NSCache instead.", ios(12, API_TO_BE_DEPRECATED))
  * @fn NIMemoryCache::dateOfLastAccessWithName:
  */
 
+/**
+ * Returns the date after which the object with the given name is no longer valid in the cache.
+ *
+ * Does not update the access time of the object. Use this to store objects that are made from
+ * another object so that they expire along with it.
+ *
+ * If the object has expired then the object will be removed from the cache and nil will be
+ * returned.
+ *
+ * @returns The expiration date of the object, or nil if the object never expires, does not
+ *               exist or has expired.
+ * @fn NIMemoryCache::expirationDateOfObjectWithName:
+ */
+
 /**
  * Retrieve the name of the object that was least recently used.
  *
@@ -222,20 +394,116 @@ API_DEPRECATED_BEGIN("Use NSCache instead.", ios(12, API_TO_BE_DEPRECATED))
  * @fn NIMemoryCache::nameOfMostRecentlyUsedObject
  */
 
+/** @name Choosing Objects to Evict */
+
+/**
+ * The strategy used to choose which object to evict when the cache needs to free up space.
+ *
+ * When nil, the least recently used object is evicted. Setting a policy on a cache that already
+ * contains objects informs the policy of those objects in least-recently-used order. The policy
+ * should be set before the cache is shared between threads.
+ *
+ * By default this is nil.
+ *
+ * @see NIMemoryCacheEvictionPolicy
+ * @fn NIMemoryCache::evictionPolicy
+ */
+
+/**
+ * Whether evicted objects can still be retrieved while something else holds on to them.
+ *
+ * When enabled, the cache keeps a weak reference to every object that it evicts. If the object
+ * is requested again while it is still alive, for example because an image view on screen is
+ * still showing an evicted image, the object is moved back into the cache instead of missing.
+ * Evicted objects are not counted in the cache's totalCost or count until they are moved back.
+ *
+ * Objects that were stored with an expiration date and objects that are removed rather than
+ * evicted are not kept.
+ *
+ * By default this is NO. The image cache returned by Nimbus::imageMemoryCache enables it.
+ *
+ * @fn NIMemoryCache::keepsEvictedObjectsWhileInUse
+ */
+
 /** @name Reducing Memory Usage Explicitly */
 
+/**
+ * How often, in seconds, the cache removes expired objects in the background.
+ *
+ * Expired objects are otherwise only removed when they are requested or when the cache is
+ * asked to reduce its memory usage, so a cache of objects that are never requested again can
+ * hold on to them long after they have expired. When this is greater than zero, a timer on a
+ * utility-priority queue calls removeExpiredObjects at this interval for as long as the cache
+ * is alive.
+ *
+ * By default this is 0, which disables proactive expiration.
+ *
+ * @fn NIMemoryCache::proactiveExpirationInterval
+ */
+
+/**
+ * Removes all expired objects from the cache.
+ *
+ * Objects with an expiration date are indexed by that date, so the cost of this method is
+ * proportional to the number of expired objects rather than the size of the cache.
+ *
+ * @fn NIMemoryCache::removeExpiredObjects
+ */
+
 /**
  * Removes all expired objects from the cache.
  *
  * Subclasses may add additional functionality to this implementation.
  * Subclasses should call super in order to prune expired objects.
  *
- * This will be called when <code>UIApplicationDidReceiveMemoryWarningNotification</code>
- * is posted.
+ * This will be called when the shared NIMemoryPressureCoordinator trims the cache at the
+ * critical or background level, which happens when
+ * <code>UIApplicationDidReceiveMemoryWarningNotification</code> is posted or the app enters the
+ * background.
  *
  * @fn NIMemoryCache::reduceMemoryUsage
  */
 
+/**
+ * How expensive the objects in this cache are to recreate relative to other caches.
+ *
+ * When the system runs low on memory, caches with a lower price release a larger share of their
+ * objects. The cache's totalCost is used as its memory pressure cost, so caches whose objects
+ * are stored without a cost only remove expired objects.
+ *
+ * By default this is 1.
+ *
+ * @see NIMemoryPressureCoordinator
+ * @fn NIMemoryCache::memoryPressureRecreationPrice
+ */
+
+/** @name Measuring an In-Memory Cache */
+
+/**
+ * A snapshot of the cache's hits, misses, stores and removals.
+ *
+ * Statistics are always collected. Each counter is updated with a relaxed atomic increment, so
+ * the counters in a snapshot are not guaranteed to be consistent with one another while other
+ * threads are using the cache.
+ *
+ * Evictions are removals made to keep the cache within its limits or by its evictionPolicy.
+ * Evictions made while the cache is being trimmed because of memory pressure, including those
+ * made by reduceMemoryUsage, are counted as memoryPressureEvictions instead.
+ *
+ * The lock wait time is the time spent acquiring the locks that guard the cache's shards. It is
+ * estimated by timing one in every 64 lock acquisitions so that measuring it does not slow down
+ * hits.
+ *
+ * @see NIOverviewMemoryCacheStatisticsPageView
+ * @fn NIMemoryCache::statistics
+ */
+
+/**
+ * Sets every statistic back to zero.
+ *
+ * @fn NIMemoryCache::resetStatistics
+ */
+
 /** @name Querying an In-Memory Cache */
 
 /**
@@ -245,6 +513,26 @@ API_DEPRECATED_BEGIN("Use NSCache instead.", ios(12, API_TO_BE_DEPRECATED))
  * @fn NIMemoryCache::count
  */
 
+/**
+ * The sum of the costs of every object currently in the cache.
+ *
+ * @fn NIMemoryCache::totalCost
+ */
+
+/**
+ * Calls a block with every unexpired object whose name has the given prefix.
+ *
+ * The matching objects are found with the cache's prefix index and collected before the
+ * block is first called, so the block may modify the cache. Enumerating objects does not count
+ * as accessing them. The order of enumeration is undefined.
+ *
+ * @param prefix  Objects whose names have this prefix are enumerated. An empty prefix matches
+ *                     no objects.
+ * @param block   The block to call with each object's name and the object. Set stop to YES to
+ *                     end the enumeration early.
+ * @fn NIMemoryCache::enumerateObjectsWithPrefix:usingBlock:
+ */
+
 /**
  * @name Subclassing
  *
@@ -277,6 +565,18 @@ API_DEPRECATED_BEGIN("Use NSCache instead.", ios(12, API_TO_BE_DEPRECATED))
  * @fn NIMemoryCache::didSetObject:withName:
  */
 
+/**
+ * A batch of objects has been stored in the cache.
+ *
+ * Called once for every store, with a single object for the single-object store methods. The
+ * default implementation calls didSetObject:withName: for each object. Subclasses that enforce
+ * limits should do so here so that batches are only trimmed once.
+ *
+ * @param objects  The objects that were stored in the cache.
+ * @param names    The cache names for the objects.
+ * @fn NIMemoryCache::didSetObjects:withNames:
+ */
+
 /**
  * An object is about to be removed from the cache.
  *
@@ -285,6 +585,36 @@ API_DEPRECATED_BEGIN("Use NSCache instead.", ios(12, API_TO_BE_DEPRECATED))
  * @fn NIMemoryCache::willRemoveObject:withName:
  */
 
+/**
+ * Returns the cost of an object that is stored without an explicit cost.
+ *
+ * The default implementation returns 0.
+ *
+ * @param object  The object about to be stored in the cache.
+ * @fn NIMemoryCache::costOfObject:
+ */
+
+/**
+ * Returns the name of the object that should be evicted next.
+ *
+ * Subclasses that enforce limits on the cache should call this method to pick the objects they
+ * remove. Asks the eviction policy if there is one, otherwise returns the name of the least
+ * recently used object.
+ *
+ * @returns The name of the object to evict, or nil if there is nothing to evict.
+ * @fn NIMemoryCache::nameOfObjectToEvict
+ */
+
+/**
+ * Removes an object from the cache in order to free up space.
+ *
+ * Behaves like removeObjectWithName: except that the eviction policy is told that the object
+ * was evicted rather than removed.
+ *
+ * @param name  The name of the object to evict.
+ * @fn NIMemoryCache::evictObjectWithName:
+ */
+
 // NIImageMemoryCache
 
 /** @name Querying an In-Memory Image Cache */
@@ -296,6 +626,14 @@ API_DEPRECATED_BEGIN("Use NSCache instead.", ios(12, API_TO_BE_DEPRECATED))
  * @fn NIImageMemoryCache::numberOfPixels
  */
 
+/**
+ * Returns the total number of bytes used by the images being stored in the cache.
+ *
+ * This is the same as totalCost.
+ *
+ * @fn NIImageMemoryCache::numberOfBytes
+ */
+
 /** @name Setting the Maximum Number of Pixels */
 
 /**
@@ -317,4 +655,147 @@ API_DEPRECATED_BEGIN("Use NSCache instead.", ios(12, API_TO_BE_DEPRECATED))
  * @fn NIImageMemoryCache::maxNumberOfPixelsUnderStress
  */
 
+/** @name Setting the Maximum Number of Bytes */
+
+/**
+ * The maximum number of bytes this cache may ever store.
+ *
+ * Defaults to 0, which is special cased to represent an unlimited number of bytes.
+ *
+ * @fn NIImageMemoryCache::maxNumberOfBytes
+ */
+
+/**
+ * The maximum number of bytes this cache may store after a call to reduceMemoryUsage.
+ *
+ * Defaults to 0, which is special cased to represent an unlimited number of bytes.
+ *
+ * @fn NIImageMemoryCache::maxNumberOfBytesUnderStress
+ */
+
+/** @name Storing Images on Disk */
+
+/**
+ * A disk cache that the image cache falls through to when an image is not in memory.
+ *
+ * Images that are stored without an expiration date are also written to the disk cache as
+ * decoded bitmaps, so images that are read back from disk are displayed without being decoded
+ * again. Images are converted and written on a background queue. Removing an image removes it
+ * from the disk cache as well, but images that are evicted to free up memory stay on disk.
+ * Images that are read from disk are moved back into memory.
+ *
+ * Images that are stored with an expiration date are removed from the disk cache, since the
+ * disk cache does not support expiration.
+ *
+ * By default this is nil.
+ *
+ * @see NIDiskCache
+ * @fn NIImageMemoryCache::diskCache
+ */
+
+/** @name Variant Families */
+
+/**
+ * Records that the image with the given name is one variant of a family of images.
+ *
+ * A family groups the images made from the same source, such as the same URL cropped and
+ * sized for different displays. The variant info describes how the image was made so that a
+ * missing variant can be made from one that is in the cache instead of from the source.
+ *
+ * Nothing is recorded if the image is not in the cache. An image belongs to at most one family
+ * and leaves it when it is removed, evicted or expires, so a family only ever lists images that
+ * are in memory. Families are not saved to the disk cache or the hot set.
+ *
+ * @param name         The name of an image in the cache.
+ * @param familyName   The name of the family, usually the name of the source.
+ * @param variantInfo  Describes the variant. May be nil.
+ * @fn NIImageMemoryCache::addObjectWithName:toVariantFamily:variantInfo:
+ */
+
+/**
+ * Returns the variant info of each image in the family that is in the cache, by image name.
+ *
+ * Variants that were added without info are mapped to NSNull.
+ *
+ * @fn NIImageMemoryCache::variantInfosInVariantFamily:
+ */
+
+/**
+ * Removes every image in the family from the cache.
+ *
+ * Use this when the source of a family changes, since each of its variants is out of date.
+ *
+ * @fn NIImageMemoryCache::removeObjectsInVariantFamily:
+ */
+
+/** @name Warm Starts */
+
+/**
+ * The file that the cache's hot set is saved to.
+ *
+ * The hot set is a list of the names of the most recently used images, most recent first, along
+ * with their expiration dates. It does not contain the images themselves. When this path is set
+ * the hot set is saved whenever the app enters the background or is terminated, and
+ * warmStartWithTimeLimit:maxNumberOfBytes:completion: reads it back on the next launch.
+ *
+ * By default this is nil, which disables warm starts.
+ *
+ * @fn NIImageMemoryCache::hotSetPath
+ */
+
+/**
+ * The number of names that are saved in the hot set.
+ *
+ * By default this is 200.
+ *
+ * @fn NIImageMemoryCache::maxNumberOfHotSetNames
+ */
+
+/**
+ * Loads images for a warm start that are not in the disk cache.
+ *
+ * The loader is called with the name of each image on a background queue and may block. It
+ * returns nil if the image can't be loaded. Loaded images are stored in the cache with the
+ * expiration date they had when the hot set was saved.
+ *
+ * By default this is nil, in which case only the disk cache is used.
+ *
+ * @fn NIImageMemoryCache::hotSetLoader
+ */
+
+/**
+ * Saves the names of the most recently used images to hotSetPath.
+ *
+ * Images that have already expired are left out.
+ *
+ * @returns YES if the hot set was saved.
+ * @fn NIImageMemoryCache::saveHotSet
+ */
+
+/**
+ * Loads the images in the saved hot set back into the cache.
+ *
+ * Images are loaded on a low priority background queue in the order they were last used, most
+ * recent first. Each image is read from the diskCache if possible and from the hotSetLoader
+ * otherwise. Images that have expired since the hot set was saved and images that are already
+ * in the cache are skipped.
+ *
+ * Call this early during launch, typically right after configuring the cache.
+ *
+@code
+NIImageMemoryCache* cache = [Nimbus imageMemoryCache];
+cache.diskCache = [[NIDiskCache alloc] initWithPath:NIPathForCachesResource(@"Images")];
+cache.hotSetPath = NIPathForCachesResource(@"ImageHotSet.plist");
+[cache warmStartWithTimeLimit:2 maxNumberOfBytes:cache.maxNumberOfBytes / 2 completion:nil];
+@endcode
+ *
+ * @param timeLimit         No images are loaded once this many seconds have passed.
+ *                          0 means there is no time limit.
+ * @param maxNumberOfBytes  No images are loaded once the loaded images use this many bytes.
+ *                          0 means there is no byte limit.
+ * @param completion        Called on the main queue with the names of the images that were
+ *                          loaded. May be nil.
+ * @fn NIImageMemoryCache::warmStartWithTimeLimit:maxNumberOfBytes:completion:
+ */
+
 API_DEPRECATED_END
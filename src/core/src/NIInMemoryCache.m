@@ -15,21 +15,139 @@
 //
 
 #import "NIInMemoryCache.h"
+#import "NIInMemoryCache+Testing.h"
 
 #import "NIDebuggingTools.h"
+#import "NIDiskCache.h"
+#import "NIImageUtilities.h"
 #import "NIPreprocessorMacros.h"
 
 #import <UIKit/UIKit.h>
+#import <stdatomic.h>
+#import <time.h>
 
 #if !defined(__has_feature) || !__has_feature(objc_arc)
 #error "Nimbus requires ARC support."
 #endif
 
-@interface NIMemoryCache()
-// Mapping from a name (usually a URL) to an internal object.
-@property (nonatomic, strong) NSMutableDictionary* cacheMap;
-// A linked list of least recently used cache objects. Most recently used is the tail.
-@property (nonatomic, strong) NSMutableOrderedSet* lruCacheObjects;
+// Cache bookkeeping uses a monotonic clock of nanosecond ticks rather than NSDate so that hits
+// don't allocate. An expiration tick of NIMemoryCacheNeverExpires means the object never expires.
+static const uint64_t NIMemoryCacheNeverExpires = UINT64_MAX;
+
+// Added to every reading of the clock. Only ever changed by unit tests.
+static uint64_t sClockOffset = 0;
+
+// The current time of the cache clock. Unlike mach_absolute_time(), CLOCK_MONOTONIC keeps counting
+// while the device is asleep, so objects still expire on schedule.
+static uint64_t NIMemoryCacheCurrentTick(void) {
+  return clock_gettime_nsec_np(CLOCK_MONOTONIC) + sClockOffset;
+}
+
+// The tick that is the given (positive) time interval from now. Intervals too long for the clock,
+// such as the one until [NSDate distantFuture], saturate to the last tick before
+// NIMemoryCacheNeverExpires.
+static uint64_t NIMemoryCacheTickAfterTimeInterval(NSTimeInterval timeInterval) {
+  uint64_t now = NIMemoryCacheCurrentTick();
+  double nanoseconds = timeInterval * NSEC_PER_SEC;
+  if (nanoseconds >= (double)(NIMemoryCacheNeverExpires - now)) {
+    return NIMemoryCacheNeverExpires - 1;
+  }
+  return now + (uint64_t)nanoseconds;
+}
+
+// Converts a clock tick to a date. Only used when a date is requested through the public API.
+static NSDate* NIMemoryCacheDateFromTick(uint64_t tick) {
+  // Dates are computed relative to a fixed reference point so that converting the same tick
+  // twice always results in the same date.
+  static uint64_t sReferenceTick = 0;
+  static CFAbsoluteTime sReferenceTime = 0;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    sReferenceTick = clock_gettime_nsec_np(CLOCK_MONOTONIC);
+    sReferenceTime = CFAbsoluteTimeGetCurrent();
+  });
+  NSTimeInterval interval = ((double)tick - (double)sReferenceTick) / NSEC_PER_SEC;
+  return [NSDate dateWithTimeIntervalSinceReferenceDate:sReferenceTime + interval];
+}
+
+// The live counterpart of NIMemoryCacheStatistics. Every counter is updated with a relaxed atomic
+// increment so that counting never takes a lock.
+typedef struct {
+  _Atomic(uint64_t) hits;
+  _Atomic(uint64_t) misses;
+  _Atomic(uint64_t) stores;
+  _Atomic(uint64_t) evictions;
+  _Atomic(uint64_t) expirations;
+  _Atomic(uint64_t) memoryPressureEvictions;
+  _Atomic(uint64_t) removals;
+  _Atomic(uint64_t) evictedCost;
+  _Atomic(uint64_t) lockAcquisitions;
+  _Atomic(uint64_t) lockWaitTicks;
+} NIMemoryCacheCounters;
+
+// One in this many shard lock acquisitions is timed.
+static const uint64_t kLockWaitSampleInterval = 64;
+
+static inline void NIMemoryCacheCount(_Atomic(uint64_t)* counter, uint64_t amount) {
+  atomic_fetch_add_explicit(counter, amount, memory_order_relaxed);
+}
+
+// Returns the tick to time a lock acquisition from, or 0 if this acquisition isn't sampled.
+static inline uint64_t NIMemoryCacheBeginLockWait(NIMemoryCacheCounters* counters) {
+  uint64_t acquisition = atomic_fetch_add_explicit(&counters->lockAcquisitions, 1,
+                                                   memory_order_relaxed);
+  return (0 == acquisition % kLockWaitSampleInterval) ? NIMemoryCacheCurrentTick() : 0;
+}
+
+// Called as soon as the lock is held.
+static inline void NIMemoryCacheEndLockWait(NIMemoryCacheCounters* counters, uint64_t startTick) {
+  if (0 != startTick) {
+    NIMemoryCacheCount(&counters->lockWaitTicks,
+                       (NIMemoryCacheCurrentTick() - startTick) * kLockWaitSampleInterval);
+  }
+}
+
+// Why a cache info is being removed. Only used to keep statistics.
+typedef NS_ENUM(NSInteger, NIMemoryCacheRemovalReason) {
+  NIMemoryCacheRemovalReasonExplicit,
+  NIMemoryCacheRemovalReasonExpired,
+  NIMemoryCacheRemovalReasonEvicted,
+};
+
+@class NIMemoryCacheInfo;
+@class NIMemoryCacheShard;
+@class NIMemoryCacheExpirationHeap;
+@class NIMemoryCachePrefixIndex;
+
+@interface NIMemoryCache() {
+  NIMemoryCacheCounters _counters;
+}
+// The lock-striped segments of the cache. Each name is assigned to a shard by its hash.
+@property (nonatomic, copy) NSArray* shards;
+// Every cache info with an expiration date, ordered by expiration date.
+@property (nonatomic, strong) NIMemoryCacheExpirationHeap* expirationHeap;
+// The sum of the costs of every object in the cache.
+@property (nonatomic, assign) unsigned long long totalCost;
+// Every name in the cache, indexed by prefix.
+@property (nonatomic, strong) NIMemoryCachePrefixIndex* prefixIndex;
+// Weakly holds evicted objects by name when keepsEvictedObjectsWhileInUse is enabled. Guarded by
+// its own lock, which is never held while calling out.
+@property (nonatomic, strong) NSMapTable* evictedObjects;
+// The names in evictedObjects, indexed by prefix. Names whose objects have since been deallocated
+// are pruned once there are too many of them. Guarded by the evictedObjects lock.
+@property (nonatomic, strong) NIMemoryCachePrefixIndex* evictedNameIndex;
+@property (nonatomic, assign) NSUInteger maxNumberOfEvictedNames;
+// Fires every proactiveExpirationInterval seconds to remove expired objects.
+@property (nonatomic, strong) dispatch_source_t expirationTimer;
+// Whether evictions are currently being made because of memory pressure. Guarded by the cache lock.
+@property (nonatomic, assign) BOOL isTrimmingForMemoryPressure;
+// The cache info for the name, whether or not it has expired.
+- (NIMemoryCacheInfo *)cacheInfoForName:(NSString *)name;
+// The least recently used cache info across all shards.
+- (NIMemoryCacheInfo *)leastRecentlyUsedCacheInfo;
+// A snapshot of the cache infos ordered from least to most recently used.
+- (NSArray *)lruCacheObjects;
+- (void)insertObjects:(NSArray *)objects withNames:(NSArray *)names;
 @end
 
 /**
@@ -50,19 +168,48 @@
 @property (nonatomic, strong) id object;
 
 /**
- * @brief The date after which the image is no longer valid and should be removed from the cache.
+ * @brief The cost of keeping the object in the cache.
+ */
+@property (nonatomic, assign) unsigned long long cost;
+
+/**
+ * @brief The clock tick after which the image is no longer valid and should be removed from the
+ *        cache.
+ *
+ * NIMemoryCacheNeverExpires if the image does not expire.
  */
-@property (nonatomic, strong) NSDate* expirationDate;
+@property (nonatomic, assign) uint64_t expirationTick;
 
 /**
- * @brief The last time this image was accessed.
+ * @brief The clock tick at which this image was last accessed.
  *
  * This property is updated every time the image is fetched from or stored into the cache. It
- * is used when the memory peak has been reached as a fast means of removing least-recently-used
- * images. When the memory limit is reached, we sort the cache based on the last access times and
- * then prune images until we're under the memory limit again.
+ * is used to order the least recently used lists of different shards.
+ */
+@property (nonatomic, assign) uint64_t lastAccessTick;
+
+/**
+ * @brief The last time this image was accessed, as a date.
+ *
+ * Created from lastAccessTick on every call.
+ */
+- (NSDate *)lastAccessTime;
+
+/**
+ * @brief The neighbouring cache infos in the shard's least recently used list.
+ *
+ * These links are not retained because the shard's cache map owns every info in the list. An
+ * info that is not in the list has nil links and is not the list's head.
+ */
+@property (nonatomic, unsafe_unretained) NIMemoryCacheInfo* lruPrevious;
+@property (nonatomic, unsafe_unretained) NIMemoryCacheInfo* lruNext;
+
+/**
+ * @brief The position of this info in the cache's expiration heap.
+ *
+ * NSNotFound if the info is not in the heap.
  */
-@property (nonatomic, strong) NSDate* lastAccessTime;
+@property (nonatomic, assign) NSUInteger expirationHeapIndex;
 
 /**
  * @brief Determine whether this cache entry has past its expiration date.
@@ -72,13 +219,95 @@
  *          never expire.
  */
 - (BOOL)hasExpired;
+- (BOOL)hasExpiredAtTick:(uint64_t)tick;
+
+@end
+
+/**
+ * @brief A single lock-striped segment of a memory cache.
+ *
+ * Each shard owns the cache infos for the names that hash to it along with their least recently
+ * used order. All access to a shard's state must be synchronized on the shard itself.
+ */
+@interface NIMemoryCacheShard : NSObject
+
+- (id)initWithCapacity:(NSUInteger)capacity;
+
+/**
+ * @brief Mapping from a name (usually a URL) to an internal object.
+ */
+@property (nonatomic, readonly, strong) NSMutableDictionary* cacheMap;
+
+/**
+ * @brief An intrusive doubly-linked list of least recently used cache infos.
+ *
+ * Most recently used is the tail. The cacheMap retains every info in this list.
+ */
+@property (nonatomic, readonly, unsafe_unretained) NIMemoryCacheInfo* lruHead;
+@property (nonatomic, readonly, unsafe_unretained) NIMemoryCacheInfo* lruTail;
+
+/**
+ * @brief Stores the info in the cache map and makes it the most recently used info.
+ *
+ * Any info previously stored with the same name is replaced.
+ */
+- (void)setCacheInfo:(NIMemoryCacheInfo *)info forName:(NSString *)name;
+
+/**
+ * @brief Removes the info with the given name from the cache map and the LRU list.
+ */
+- (void)removeCacheInfoForName:(NSString *)name;
+
+/**
+ * @brief Removes every info from the shard.
+ */
+- (void)removeAllCacheInfos;
+
+/**
+ * @brief Updates the access time of the info and makes it the most recently used info.
+ */
+- (void)updateAccessTimeForInfo:(NIMemoryCacheInfo *)info;
+
+@end
 
+/**
+ * @brief A binary min-heap of cache infos ordered by expiration date.
+ *
+ * Only infos with an expiration date are kept in the heap. Each info remembers its position in
+ * the heap so that it can be removed in O(log n) when it leaves the cache, which means expired
+ * objects can be found without looking at any of the objects that haven't expired.
+ */
+@interface NIMemoryCacheExpirationHeap : NSObject
+- (void)addCacheInfo:(NIMemoryCacheInfo *)info;
+- (void)removeCacheInfo:(NIMemoryCacheInfo *)info;
+- (void)removeAllCacheInfos;
+- (NIMemoryCacheInfo *)earliestExpiringCacheInfo;
+@end
+
+/**
+ * @brief A radix tree of the names in a memory cache.
+ *
+ * Finding the names with a given prefix costs time proportional to the length of the prefix
+ * plus the number of matching names, regardless of how many names are in the cache.
+ */
+@interface NIMemoryCachePrefixIndex : NSObject
+- (void)addName:(NSString *)name;
+- (void)removeName:(NSString *)name;
+- (void)removeAllNames;
+- (NSArray *)namesWithPrefix:(NSString *)prefix;
+@property (nonatomic, readonly) NSUInteger numberOfNames;
 @end
 
+// The evicted name index is pruned of deallocated objects once it holds this many names, or
+// twice as many as were alive after the last pruning, whichever is more.
+static const NSUInteger kMinMaxNumberOfEvictedNames = 64;
+
 @implementation NIMemoryCache
 
 - (void)dealloc {
-  [[NSNotificationCenter defaultCenter] removeObserver:self];
+  if (nil != _expirationTimer) {
+    dispatch_source_cancel(_expirationTimer);
+  }
 }
 
 - (id)init {
@@ -86,15 +315,30 @@
 }
 
 - (id)initWithCapacity:(NSUInteger)capacity {
+  return [self initWithCapacity:capacity numberOfShards:1];
+}
+
+- (id)initWithCapacity:(NSUInteger)capacity numberOfShards:(NSUInteger)numberOfShards {
   if ((self = [super init])) {
-    _cacheMap = [[NSMutableDictionary alloc] initWithCapacity:capacity];
-    _lruCacheObjects = [NSMutableOrderedSet orderedSet];
+    NIDASSERT(numberOfShards > 0);
+    numberOfShards = MAX((NSUInteger)1, numberOfShards);
+
+    NSUInteger shardCapacity = (capacity + numberOfShards - 1) / numberOfShards;
+    NSMutableArray* shards = [NSMutableArray arrayWithCapacity:numberOfShards];
+    for (NSUInteger ix = 0; ix < numberOfShards; ++ix) {
+      [shards addObject:[[NIMemoryCacheShard alloc] initWithCapacity:shardCapacity]];
+    }
+    _shards = [shards copy];
+    _expirationHeap = [[NIMemoryCacheExpirationHeap alloc] init];
+    _prefixIndex = [[NIMemoryCachePrefixIndex alloc] init];
+    _evictedObjects = [NSMapTable strongToWeakObjectsMapTable];
+    _evictedNameIndex = [[NIMemoryCachePrefixIndex alloc] init];
+    _maxNumberOfEvictedNames = kMinMaxNumberOfEvictedNames;
 
-    // Automatically reduce memory usage when we get a memory warning.
-    [[NSNotificationCenter defaultCenter] addObserver:self
-                                             selector:@selector(reduceMemoryUsage)
-                                                 name:UIApplicationDidReceiveMemoryWarningNotification
-                                               object:nil];
+    _memoryPressureRecreationPrice = 1;
+
+    // Automatically reduce memory usage when the system runs low on memory.
+    [[NIMemoryPressureCoordinator sharedCoordinator] addResponder:self];
   }
   return self;
 }
@@ -103,66 +347,359 @@
   return [NSString stringWithFormat:
           @"<%@"
           @" lruObjects: %@"
-          @" cache map: %@"
+          @" shards: %@"
           @">",
           [super description],
-          self.lruCacheObjects,
-          self.cacheMap];
+          [self lruCacheObjects],
+          self.shards];
 }
 
 #pragma mark - Internal
 
-- (void)updateAccessTimeForInfo:(NIMemoryCacheInfo *)info {
-  @synchronized(self) {
-    NIDASSERT(nil != info);
-    if (nil == info) {
-      return; // COV_NF_LINE
+// Locking:
+//
+// Every method that adds or removes cache infos, and therefore calls the subclassing hooks,
+// synchronizes on the cache first and on the affected shard second. Hits only synchronize on the
+// name's shard, so lookups in different shards never contend with one another. A shard lock is
+// never held while calling out to a subclassing hook.
+
+- (NIMemoryCacheShard *)shardForName:(NSString *)name {
+  NSArray* shards = _shards;
+  NSUInteger numberOfShards = shards.count;
+  if (1 == numberOfShards) {
+    return shards[0];
+  }
+  return shards[[name hash] % numberOfShards];
+}
+
+- (NIMemoryCacheInfo *)cacheInfoForName:(NSString *)name {
+  NIMemoryCacheShard* shard = [self shardForName:name];
+  @synchronized(shard) {
+    return shard.cacheMap[name];
+  }
+}
+
+- (NIMemoryCacheInfo *)leastRecentlyUsedCacheInfo {
+  NIMemoryCacheInfo* leastRecentlyUsedInfo = nil;
+  uint64_t leastRecentAccessTick = 0;
+  for (NIMemoryCacheShard* shard in self.shards) {
+    @synchronized(shard) {
+      NIMemoryCacheInfo* info = shard.lruHead;
+      if (nil != info
+          && (nil == leastRecentlyUsedInfo || info.lastAccessTick < leastRecentAccessTick)) {
+        leastRecentlyUsedInfo = info;
+        leastRecentAccessTick = info.lastAccessTick;
+      }
+    }
+  }
+  return leastRecentlyUsedInfo;
+}
+
+- (NSString *)nameOfObjectToEvict {
+  id<NIMemoryCacheEvictionPolicy> evictionPolicy = self.evictionPolicy;
+  if (nil != evictionPolicy) {
+    @synchronized(evictionPolicy) {
+      return [evictionPolicy nameOfObjectToEvict];
     }
-    info.lastAccessTime = [NSDate date];
+  }
+  return [self leastRecentlyUsedCacheInfo].name;
+}
 
-    [self.lruCacheObjects removeObject:info];
-    [self.lruCacheObjects addObject:info];
+- (NIMemoryCacheInfo *)mostRecentlyUsedCacheInfo {
+  NIMemoryCacheInfo* mostRecentlyUsedInfo = nil;
+  uint64_t mostRecentAccessTick = 0;
+  for (NIMemoryCacheShard* shard in self.shards) {
+    @synchronized(shard) {
+      NIMemoryCacheInfo* info = shard.lruTail;
+      if (nil != info
+          && (nil == mostRecentlyUsedInfo || info.lastAccessTick >= mostRecentAccessTick)) {
+        mostRecentlyUsedInfo = info;
+        mostRecentAccessTick = info.lastAccessTick;
+      }
+    }
   }
+  return mostRecentlyUsedInfo;
 }
 
-- (NIMemoryCacheInfo *)cacheInfoForName:(NSString *)name {
-  NIMemoryCacheInfo* info;
-  @synchronized(self) {
-    info = self.cacheMap[name];
+- (NSArray *)lruCacheObjects {
+  NSMutableArray* objects = [NSMutableArray array];
+  for (NIMemoryCacheShard* shard in self.shards) {
+    @synchronized(shard) {
+      for (NIMemoryCacheInfo* info = shard.lruHead; nil != info; info = info.lruNext) {
+        [objects addObject:info];
+      }
+    }
+  }
+  if (self.shards.count > 1) {
+    [objects sortUsingComparator:^NSComparisonResult(NIMemoryCacheInfo* info1, NIMemoryCacheInfo* info2) {
+      if (info1.lastAccessTick == info2.lastAccessTick) {
+        return NSOrderedSame;
+      }
+      return (info1.lastAccessTick < info2.lastAccessTick) ? NSOrderedAscending : NSOrderedDescending;
+    }];
   }
-  return info;
+  return objects;
 }
 
-- (void)setCacheInfo:(NIMemoryCacheInfo *)info forName:(NSString *)name {
+// Splits the indexes of the given names by shard so that batch operations lock each shard once.
+- (NSArray *)indexesOfNamesByShard:(NSArray *)names {
+  NSArray* shards = self.shards;
+  if (1 == shards.count) {
+    return @[[NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, names.count)]];
+  }
+
+  NSMutableArray* indexesByShard = [NSMutableArray arrayWithCapacity:shards.count];
+  for (NSUInteger ix = 0; ix < shards.count; ++ix) {
+    [indexesByShard addObject:[NSMutableIndexSet indexSet]];
+  }
+  [names enumerateObjectsUsingBlock:^(NSString* name, NSUInteger ix, BOOL *stop) {
+    [indexesByShard[[name hash] % shards.count] addIndex:ix];
+  }];
+  return indexesByShard;
+}
+
+- (void)setCacheInfo:(NIMemoryCacheInfo *)info {
+  [self setCacheInfos:@[info]];
+}
+
+// Stores the infos in order, as if each had been stored on its own, but locks each shard and the
+// eviction policy once and calls didSetObjects:withNames: once for the whole batch.
+- (void)setCacheInfos:(NSArray *)infos {
   @synchronized(self) {
-    NIDASSERT(nil != name);
-    if (nil == name) {
+    // Storing in the cache counts as an access of the object, so we update the access time.
+    uint64_t tick = NIMemoryCacheCurrentTick();
+
+    NSMutableArray* storedInfos = [NSMutableArray arrayWithCapacity:infos.count];
+    NSMutableArray* previousInfos = [NSMutableArray arrayWithCapacity:infos.count];
+    // A batch may store the same name more than once. Later infos replace earlier ones.
+    NSMutableDictionary* batchInfos = (infos.count > 1) ? [NSMutableDictionary dictionary] : nil;
+    for (NIMemoryCacheInfo* info in infos) {
+      NSString* name = info.name;
+      NIDASSERT(nil != name);
+      if (nil == name) {
+        continue;
+      }
+      info.lastAccessTick = tick;
+
+      NIMemoryCacheInfo* previousInfo = batchInfos[name] ?: [self cacheInfoForName:name];
+      if ([self shouldSetObject:info.object withName:name previousObject:previousInfo.object]) {
+        [storedInfos addObject:info];
+        [previousInfos addObject:(nil != previousInfo) ? previousInfo : [NSNull null]];
+        batchInfos[name] = info;
+      }
+    }
+    if (0 == storedInfos.count) {
       return;
     }
 
-    // Storing in the cache counts as an access of the object, so we update the access time.
-    [self updateAccessTimeForInfo:info];
+    NSMutableArray* names = [NSMutableArray arrayWithCapacity:storedInfos.count];
+    NSMutableArray* objects = [NSMutableArray arrayWithCapacity:storedInfos.count];
+    for (NIMemoryCacheInfo* info in storedInfos) {
+      [names addObject:info.name];
+      [objects addObject:info.object];
+    }
+    NSArray* indexesByShard = [self indexesOfNamesByShard:names];
+    NSArray* shards = self.shards;
+    for (NSUInteger shardIndex = 0; shardIndex < shards.count; ++shardIndex) {
+      NSIndexSet* indexes = indexesByShard[shardIndex];
+      if (0 == indexes.count) {
+        continue;
+      }
+      NIMemoryCacheShard* shard = shards[shardIndex];
+      uint64_t lockWaitTick = NIMemoryCacheBeginLockWait(&_counters);
+      @synchronized(shard) {
+        NIMemoryCacheEndLockWait(&_counters, lockWaitTick);
+        for (NSUInteger ix = indexes.firstIndex; NSNotFound != ix;
+             ix = [indexes indexGreaterThanIndex:ix]) {
+          [shard setCacheInfo:storedInfos[ix] forName:names[ix]];
+        }
+      }
+    }
 
-    id previousObject = [self cacheInfoForName:name].object;
-    if ([self shouldSetObject:info.object withName:name previousObject:previousObject]) {
-      self.cacheMap[name] = info;
-      [self didSetObject:info.object withName:name];
+    for (NSUInteger ix = 0; ix < storedInfos.count; ++ix) {
+      NIMemoryCacheInfo* info = storedInfos[ix];
+      id previousInfoOrNull = previousInfos[ix];
+      NIMemoryCacheInfo* previousInfo = ([NSNull null] != previousInfoOrNull) ? previousInfoOrNull : nil;
+      [self.expirationHeap removeCacheInfo:previousInfo];
+      [self.expirationHeap addCacheInfo:info];
+      self.totalCost = self.totalCost - previousInfo.cost + info.cost;
+      if (nil == previousInfo) {
+        [self.prefixIndex addName:info.name];
+      }
+    }
+
+    [self forgetEvictedObjectsWithNames:names];
+
+    id<NIMemoryCacheEvictionPolicy> evictionPolicy = self.evictionPolicy;
+    if (nil != evictionPolicy) {
+      @synchronized(evictionPolicy) {
+        for (NSString* name in names) {
+          [evictionPolicy didStoreObjectWithName:name];
+        }
+      }
     }
+    [self didSetObjects:objects withNames:names];
   }
 }
 
-- (void)removeCacheInfoForName:(NSString *)name {
+- (void)removeCacheInfoForName:(NSString *)name reason:(NIMemoryCacheRemovalReason)reason {
   @synchronized(self) {
     NIDASSERT(nil != name);
     if (nil == name) {
       return;
     }
+    BOOL evicted = (NIMemoryCacheRemovalReasonEvicted == reason);
 
     NIMemoryCacheInfo* cacheInfo = [self cacheInfoForName:name];
     [self willRemoveObject:cacheInfo.object withName:name];
 
-    [self.lruCacheObjects removeObject:cacheInfo];
-    [self.cacheMap removeObjectForKey:name];
+    NIMemoryCacheShard* shard = [self shardForName:name];
+    uint64_t lockWaitTick = NIMemoryCacheBeginLockWait(&_counters);
+    @synchronized(shard) {
+      NIMemoryCacheEndLockWait(&_counters, lockWaitTick);
+      [shard removeCacheInfoForName:name];
+    }
+
+    if (nil != cacheInfo) {
+      if (NIMemoryCacheRemovalReasonExplicit == reason) {
+        NIMemoryCacheCount(&_counters.removals, 1);
+      } else {
+        if (NIMemoryCacheRemovalReasonExpired == reason) {
+          NIMemoryCacheCount(&_counters.expirations, 1);
+        } else if (self.isTrimmingForMemoryPressure) {
+          NIMemoryCacheCount(&_counters.memoryPressureEvictions, 1);
+        } else {
+          NIMemoryCacheCount(&_counters.evictions, 1);
+        }
+        NIMemoryCacheCount(&_counters.evictedCost, cacheInfo.cost);
+      }
+    }
+    [self.expirationHeap removeCacheInfo:cacheInfo];
+    [self.prefixIndex removeName:name];
+    self.totalCost -= cacheInfo.cost;
+
+    // Objects that expire are not kept because their expiration date would be lost.
+    if (evicted && self.keepsEvictedObjectsWhileInUse && nil != cacheInfo.object
+        && NIMemoryCacheNeverExpires == cacheInfo.expirationTick) {
+      [self keepEvictedObject:cacheInfo.object withName:name];
+    } else {
+      [self forgetEvictedObjectsWithNames:@[name]];
+    }
+
+    // Always tell the policy so that it forgets names it may still be tracking.
+    id<NIMemoryCacheEvictionPolicy> evictionPolicy = self.evictionPolicy;
+    if (nil != evictionPolicy) {
+      @synchronized(evictionPolicy) {
+        [evictionPolicy didRemoveObjectWithName:name evicted:evicted];
+      }
+    }
+  }
+}
+
+// Stores objects that never expire without going through the public store methods, so that
+// subclasses don't treat objects that the cache already knew about as new ones.
+- (void)insertObjects:(NSArray *)objects withNames:(NSArray *)names {
+  @synchronized(self) {
+    NSMutableArray* infos = [NSMutableArray arrayWithCapacity:objects.count];
+    for (NSUInteger ix = 0; ix < objects.count; ++ix) {
+      NIMemoryCacheInfo* info = [[NIMemoryCacheInfo alloc] init];
+      info.name = names[ix];
+      info.object = objects[ix];
+      info.cost = [self costOfObject:objects[ix]];
+      [infos addObject:info];
+    }
+    [self setCacheInfos:infos];
+  }
+}
+
+- (void)keepEvictedObject:(id)object withName:(NSString *)name {
+  NSMapTable* evictedObjects = self.evictedObjects;
+  @synchronized(evictedObjects) {
+    [evictedObjects setObject:object forKey:name];
+    [self.evictedNameIndex addName:name];
+
+    if (self.evictedNameIndex.numberOfNames > self.maxNumberOfEvictedNames) {
+      // Objects that have been deallocated disappear from the map table without telling us, so
+      // drop their names every so often to keep the index from growing without bound.
+      NIMemoryCachePrefixIndex* index = [[NIMemoryCachePrefixIndex alloc] init];
+      for (NSString* evictedName in [[evictedObjects keyEnumerator] allObjects]) {
+        if (nil != [evictedObjects objectForKey:evictedName]) {
+          [index addName:evictedName];
+        } else {
+          [evictedObjects removeObjectForKey:evictedName];
+        }
+      }
+      self.evictedNameIndex = index;
+      self.maxNumberOfEvictedNames = MAX(kMinMaxNumberOfEvictedNames, index.numberOfNames * 2);
+    }
+  }
+}
+
+- (void)forgetEvictedObjectsWithNames:(NSArray *)names {
+  NSMapTable* evictedObjects = self.evictedObjects;
+  @synchronized(evictedObjects) {
+    if (0 == evictedObjects.count) {
+      return;
+    }
+    for (NSString* name in names) {
+      [evictedObjects removeObjectForKey:name];
+      [self.evictedNameIndex removeName:name];
+    }
+  }
+}
+
+- (void)forgetAllEvictedObjects {
+  NSMapTable* evictedObjects = self.evictedObjects;
+  @synchronized(evictedObjects) {
+    [evictedObjects removeAllObjects];
+    [self.evictedNameIndex removeAllNames];
+    self.maxNumberOfEvictedNames = kMinMaxNumberOfEvictedNames;
+  }
+}
+
+// Returns the evicted objects that are still alive and moves them back into the cache.
+- (NSDictionary *)restoreEvictedObjectsWithNames:(NSArray *)names {
+  if (!self.keepsEvictedObjectsWhileInUse) {
+    return nil;
+  }
+
+  // Storing an object forgets any evicted object with the same name, so holding the cache lock
+  // guarantees that we never restore an object over a newer one.
+  @synchronized(self) {
+    NSMutableArray* objects = nil;
+    NSMutableArray* restoredNames = nil;
+    NSMapTable* evictedObjects = self.evictedObjects;
+    @synchronized(evictedObjects) {
+      for (NSString* name in names) {
+        id object = [evictedObjects objectForKey:name];
+        if (nil != object) {
+          if (nil == objects) {
+            objects = [NSMutableArray array];
+            restoredNames = [NSMutableArray array];
+          }
+          [objects addObject:object];
+          [restoredNames addObject:name];
+        }
+      }
+    }
+    if (nil == objects) {
+      return nil;
+    }
+
+    // Restored objects are stored again, so they're charged their cost and may cause other
+    // objects to be evicted.
+    [self insertObjects:objects withNames:restoredNames];
+    return [NSDictionary dictionaryWithObjects:objects forKeys:restoredNames];
+  }
+}
+
+- (void)removeExpiredCacheInfoForName:(NSString *)name {
+  @synchronized(self) {
+    // Another thread may have stored a fresh object with this name since we found the expired
+    // one, so check again now that we hold the cache lock.
+    if ([[self cacheInfoForName:name] hasExpired]) {
+      [self removeCacheInfoForName:name reason:NIMemoryCacheRemovalReasonExpired];
+    }
   }
 }
 
@@ -182,10 +719,25 @@
   // No-op
 }
 
+- (void)didSetObjects:(NSArray *)objects withNames:(NSArray *)names {
+  for (NSUInteger ix = 0; ix < objects.count; ++ix) {
+    [self didSetObject:objects[ix] withName:names[ix]];
+  }
+}
+
+- (void)evictObjectWithName:(NSString *)name {
+  [self removeCacheInfoForName:name reason:NIMemoryCacheRemovalReasonEvicted];
+}
+
 - (void)willRemoveObject:(id)object withName:(NSString *)name {
   // No-op
 }
 
+- (unsigned long long)costOfObject:(id)object {
+  // Objects are free unless a cost is given when they're stored.
+  return 0;
+}
+
 #pragma mark - Public
 
 - (void)storeObject:(id)object withName:(NSString *)name {
@@ -195,13 +747,33 @@
 }
 
 - (void)storeObject:(id)object withName:(NSString *)name expiresAfter:(NSDate *)expirationDate {
+  @synchronized(self) {
+    [self storeObject:object
+             withName:name
+                 cost:[self costOfObject:object]
+         expiresAfter:expirationDate];
+  }
+}
+
+- (void)storeObject:(id)object withName:(NSString *)name cost:(unsigned long long)cost {
+  @synchronized(self) {
+    [self storeObject:object withName:name cost:cost expiresAfter:nil];
+  }
+}
+
+- (void)storeObject:(id)object
+           withName:(NSString *)name
+               cost:(unsigned long long)cost
+       expiresAfter:(NSDate *)expirationDate {
   @synchronized(self) {
     // Don't store nil objects in the cache.
     if (nil == object) {
       return;
     }
 
-    if (nil != expirationDate && [[NSDate date] timeIntervalSinceDate:expirationDate] >= 0) {
+    // Expiration dates are converted to ticks of the cache clock once, when the object is stored.
+    NSTimeInterval timeToLive = [expirationDate timeIntervalSinceNow];
+    if (nil != expirationDate && timeToLive <= 0) {
       // The object being stored is already expired so remove the object from the cache altogether.
       [self removeObjectWithName:name];
 
@@ -209,111 +781,272 @@
       return;
     }
 
-    NIMemoryCacheInfo* info = [self cacheInfoForName:name];
+    NIMemoryCacheCount(&_counters.stores, 1);
 
-    // Create a new cache entry.
-    if (nil == info) {
-      info = [[NIMemoryCacheInfo alloc] init];
-      info.name = name;
+    // Cache entries are never modified once they've been stored because hits read them without
+    // holding the cache lock, so we always create a new cache entry.
+    NIMemoryCacheInfo* info = [[NIMemoryCacheInfo alloc] init];
+    info.name = name;
+    info.object = object;
+    info.cost = cost;
+    if (nil != expirationDate) {
+      info.expirationTick = NIMemoryCacheTickAfterTimeInterval(timeToLive);
     }
 
-    // Store the object in the cache item.
-    info.object = object;
+    // Commit the changes to the cache.
+    [self setCacheInfo:info];
+  }
+}
 
-    // Override any existing expiration date.
-    info.expirationDate = expirationDate;
+- (void)storeObjects:(NSArray *)objects
+           withNames:(NSArray *)names
+        expiresAfter:(NSDate *)expirationDate {
+  NIDASSERT(objects.count == names.count);
+  NSUInteger count = MIN(objects.count, names.count);
 
-    // Commit the changes to the cache.
-    [self setCacheInfo:info forName:name];
+  @synchronized(self) {
+    NSTimeInterval timeToLive = [expirationDate timeIntervalSinceNow];
+    if (nil != expirationDate && timeToLive <= 0) {
+      // As with storeObject:withName:expiresAfter:, expired objects replace nothing.
+      for (NSUInteger ix = 0; ix < count; ++ix) {
+        [self removeObjectWithName:names[ix]];
+      }
+      return;
+    }
+
+    uint64_t expirationTick = NIMemoryCacheNeverExpires;
+    if (nil != expirationDate) {
+      expirationTick = NIMemoryCacheTickAfterTimeInterval(timeToLive);
+    }
+    NIMemoryCacheCount(&_counters.stores, count);
+
+    NSMutableArray* infos = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger ix = 0; ix < count; ++ix) {
+      id object = objects[ix];
+      NIMemoryCacheInfo* info = [[NIMemoryCacheInfo alloc] init];
+      info.name = names[ix];
+      info.object = object;
+      info.cost = [self costOfObject:object];
+      info.expirationTick = expirationTick;
+      [infos addObject:info];
+    }
+
+    [self setCacheInfos:infos];
   }
 }
 
 - (id)objectWithName:(NSString *)name {
-  @synchronized(self) {
-    NIMemoryCacheInfo* info = [self cacheInfoForName:name];
+  NIMemoryCacheShard* shard = [self shardForName:name];
+  id object = nil;
+  BOOL hasExpired = NO;
 
-    id object = nil;
+  uint64_t lockWaitTick = NIMemoryCacheBeginLockWait(&_counters);
+  @synchronized(shard) {
+    NIMemoryCacheEndLockWait(&_counters, lockWaitTick);
+    NIMemoryCacheInfo* info = shard.cacheMap[name];
 
     if (nil != info) {
-      if ([info hasExpired]) {
-        [self removeObjectWithName:name];
-
-      } else {
+      hasExpired = [info hasExpired];
+      if (!hasExpired) {
         // Update the access time whenever we fetch an object from the cache.
-        [self updateAccessTimeForInfo:info];
+        [shard updateAccessTimeForInfo:info];
 
         object = info.object;
       }
     }
-
-    return object;
   }
-}
 
-- (BOOL)containsObjectWithName:(NSString *)name {
-  @synchronized(self) {
-    NIMemoryCacheInfo* info = [self cacheInfoForName:name];
+  if (nil == object && !hasExpired) {
+    object = [self restoreEvictedObjectsWithNames:@[name]][name];
+  }
+  NIMemoryCacheCount((nil != object) ? &_counters.hits : &_counters.misses, 1);
 
-    if ([info hasExpired]) {
-      [self removeObjectWithName:name];
-      return NO;
+  id<NIMemoryCacheEvictionPolicy> evictionPolicy = self.evictionPolicy;
+  if (nil != evictionPolicy) {
+    @synchronized(evictionPolicy) {
+      if (nil != object) {
+        [evictionPolicy didAccessObjectWithName:name];
+      } else {
+        [evictionPolicy didMissObjectWithName:name];
+      }
     }
+  }
 
-    return (nil != info);
+  if (hasExpired) {
+    [self removeExpiredCacheInfoForName:name];
   }
+
+  return object;
 }
 
-- (NSDate *)dateOfLastAccessWithName:(NSString *)name {
-  @synchronized(self) {
-    NIMemoryCacheInfo* info = [self cacheInfoForName:name];
+- (NSDictionary *)objectsWithNames:(NSArray *)names {
+  NSMutableDictionary* objects = [NSMutableDictionary dictionaryWithCapacity:names.count];
+  NSMutableArray* expiredNames = nil;
+  uint64_t tick = NIMemoryCacheCurrentTick();
+
+  NSArray* indexesByShard = [self indexesOfNamesByShard:names];
+  NSArray* shards = self.shards;
+  for (NSUInteger shardIndex = 0; shardIndex < shards.count; ++shardIndex) {
+    NSIndexSet* indexes = indexesByShard[shardIndex];
+    if (0 == indexes.count) {
+      continue;
+    }
+    NIMemoryCacheShard* shard = shards[shardIndex];
+    uint64_t lockWaitTick = NIMemoryCacheBeginLockWait(&_counters);
+    @synchronized(shard) {
+      NIMemoryCacheEndLockWait(&_counters, lockWaitTick);
+      for (NSUInteger ix = indexes.firstIndex; NSNotFound != ix;
+           ix = [indexes indexGreaterThanIndex:ix]) {
+        NSString* name = names[ix];
+        NIMemoryCacheInfo* info = shard.cacheMap[name];
+        if (nil == info) {
+          continue;
+        }
+        if ([info hasExpiredAtTick:tick]) {
+          if (nil == expiredNames) {
+            expiredNames = [NSMutableArray array];
+          }
+          [expiredNames addObject:name];
+          continue;
+        }
+        // Promote the objects in the order they were asked for.
+        [shard updateAccessTimeForInfo:info];
+        objects[name] = info.object;
+      }
+    }
+  }
 
-    if ([info hasExpired]) {
-      [self removeObjectWithName:name];
-      return nil;
+  if (self.keepsEvictedObjectsWhileInUse && objects.count < names.count) {
+    NSMutableArray* missedNames = [NSMutableArray arrayWithCapacity:names.count - objects.count];
+    for (NSString* name in names) {
+      if (nil == objects[name] && ![expiredNames containsObject:name]) {
+        [missedNames addObject:name];
+      }
+    }
+    [objects addEntriesFromDictionary:[self restoreEvictedObjectsWithNames:missedNames]];
+  }
+  NIMemoryCacheCount(&_counters.hits, objects.count);
+  NIMemoryCacheCount(&_counters.misses, names.count - objects.count);
+
+  id<NIMemoryCacheEvictionPolicy> evictionPolicy = self.evictionPolicy;
+  if (nil != evictionPolicy) {
+    @synchronized(evictionPolicy) {
+      for (NSString* name in names) {
+        if (nil != objects[name]) {
+          [evictionPolicy didAccessObjectWithName:name];
+        } else {
+          [evictionPolicy didMissObjectWithName:name];
+        }
+      }
     }
+  }
 
-    return [info lastAccessTime];
+  if (nil != expiredNames) {
+    @synchronized(self) {
+      for (NSString* name in expiredNames) {
+        [self removeExpiredCacheInfoForName:name];
+      }
+    }
   }
-}
 
-- (NSString *)nameOfLeastRecentlyUsedObject {
-  @synchronized(self) {
-    NIMemoryCacheInfo* info = [self.lruCacheObjects firstObject];
+  return objects;
+}
 
-    if ([info hasExpired]) {
-      [self removeObjectWithName:info.name];
-      return nil;
-    }
+- (BOOL)containsObjectWithName:(NSString *)name {
+  NIMemoryCacheInfo* info = [self cacheInfoForName:name];
 
-    return info.name;
+  if ([info hasExpired]) {
+    [self removeExpiredCacheInfoForName:name];
+    return NO;
   }
+
+  return (nil != info);
 }
 
-- (NSString *)nameOfMostRecentlyUsedObject {
-  @synchronized(self) {
-    NIMemoryCacheInfo* info = [self.lruCacheObjects lastObject];
+- (NSDate *)dateOfLastAccessWithName:(NSString *)name {
+  NIMemoryCacheShard* shard = [self shardForName:name];
+  NIMemoryCacheInfo* info = nil;
+  uint64_t lastAccessTick = 0;
 
-    if ([info hasExpired]) {
-      [self removeObjectWithName:info.name];
-      return nil;
-    }
+  @synchronized(shard) {
+    info = shard.cacheMap[name];
+    lastAccessTick = info.lastAccessTick;
+  }
 
-    return info.name;
+  if (nil == info) {
+    return nil;
   }
-}
 
-- (void)removeObjectWithName:(NSString *)name {
-  @synchronized(self) {
-    [self removeCacheInfoForName:name];
+  if ([info hasExpired]) {
+    [self removeExpiredCacheInfoForName:name];
+    return nil;
   }
+
+  // The date is only created when it's asked for so that cache hits never have to allocate one.
+  return NIMemoryCacheDateFromTick(lastAccessTick);
 }
 
-- (void)removeAllObjectsWithPrefix:(NSString *)prefix {
-  @synchronized(self) {
-    // Assertions fire if you try to modify the object you're iterating over, so we make a copy.
-    for (NSString* name in [self.cacheMap copy]) {
-      if ([name hasPrefix:prefix]) {
-        [self removeObjectWithName:name];
+- (NSDate *)expirationDateOfObjectWithName:(NSString *)name {
+  NIMemoryCacheShard* shard = [self shardForName:name];
+  NIMemoryCacheInfo* info = nil;
+  uint64_t expirationTick = NIMemoryCacheNeverExpires;
+
+  @synchronized(shard) {
+    info = shard.cacheMap[name];
+    expirationTick = info.expirationTick;
+  }
+
+  if (nil == info || NIMemoryCacheNeverExpires == expirationTick) {
+    return nil;
+  }
+
+  if ([info hasExpired]) {
+    [self removeExpiredCacheInfoForName:name];
+    return nil;
+  }
+
+  return NIMemoryCacheDateFromTick(expirationTick);
+}
+
+- (NSString *)nameOfLeastRecentlyUsedObject {
+  NIMemoryCacheInfo* info = [self leastRecentlyUsedCacheInfo];
+
+  if ([info hasExpired]) {
+    [self removeExpiredCacheInfoForName:info.name];
+    return nil;
+  }
+
+  return info.name;
+}
+
+- (NSString *)nameOfMostRecentlyUsedObject {
+  NIMemoryCacheInfo* info = [self mostRecentlyUsedCacheInfo];
+
+  if ([info hasExpired]) {
+    [self removeExpiredCacheInfoForName:info.name];
+    return nil;
+  }
+
+  return info.name;
+}
+
+- (void)removeObjectWithName:(NSString *)name {
+  @synchronized(self) {
+    [self removeCacheInfoForName:name reason:NIMemoryCacheRemovalReasonExplicit];
+  }
+}
+
+- (void)removeAllObjectsWithPrefix:(NSString *)prefix {
+  @synchronized(self) {
+    for (NSString* name in [self.prefixIndex namesWithPrefix:prefix]) {
+      [self removeObjectWithName:name];
+    }
+
+    NSMapTable* evictedObjects = self.evictedObjects;
+    @synchronized(evictedObjects) {
+      for (NSString* name in [self.evictedNameIndex namesWithPrefix:prefix]) {
+        [evictedObjects removeObjectForKey:name];
+        [self.evictedNameIndex removeName:name];
       }
     }
   }
@@ -321,37 +1054,584 @@
 
 - (void)removeAllObjects {
   @synchronized(self) {
-    [self.cacheMap removeAllObjects];
-    [self.lruCacheObjects removeAllObjects];
+    NIMemoryCacheCount(&_counters.removals, [self count]);
+    for (NIMemoryCacheShard* shard in self.shards) {
+      @synchronized(shard) {
+        [shard removeAllCacheInfos];
+      }
+    }
+    [self.expirationHeap removeAllCacheInfos];
+    [self.prefixIndex removeAllNames];
+    self.totalCost = 0;
+
+    [self forgetAllEvictedObjects];
+
+    id<NIMemoryCacheEvictionPolicy> evictionPolicy = self.evictionPolicy;
+    if (nil != evictionPolicy) {
+      @synchronized(evictionPolicy) {
+        [evictionPolicy didRemoveAllObjects];
+      }
+    }
+  }
+}
+
+- (void)removeExpiredObjects {
+  @synchronized(self) {
+    // The heap is ordered by expiration date, so we can stop at the first object that hasn't
+    // expired yet.
+    uint64_t now = NIMemoryCacheCurrentTick();
+    NIMemoryCacheInfo* info = [self.expirationHeap earliestExpiringCacheInfo];
+    while (nil != info && [info hasExpiredAtTick:now]) {
+      [self removeCacheInfoForName:info.name reason:NIMemoryCacheRemovalReasonExpired];
+      info = [self.expirationHeap earliestExpiringCacheInfo];
+    }
   }
 }
 
 - (void)reduceMemoryUsage {
+  [self removeExpiredObjects];
+}
+
+#pragma mark - NIMemoryPressureResponder
+
+- (unsigned long long)memoryPressureCost {
+  return self.totalCost;
+}
+
+- (void)trimToMemoryPressureCost:(unsigned long long)cost level:(NIMemoryPressureLevel)level {
   @synchronized(self) {
-    // Assertions fire if you try to modify the object you're iterating over, so we make a copy.
-    for (id name in [self.cacheMap copy]) {
-      NIMemoryCacheInfo* info = [self cacheInfoForName:name];
+    BOOL wasTrimmingForMemoryPressure = self.isTrimmingForMemoryPressure;
+    self.isTrimmingForMemoryPressure = YES;
+
+    if (NIMemoryPressureLevelModerate == level) {
+      [self removeExpiredObjects];
+    } else {
+      // This is what memory warnings used to do, so subclasses that override reduceMemoryUsage
+      // keep working.
+      [self reduceMemoryUsage];
+    }
+
+    while (self.totalCost > cost) {
+      NSString* name = [self nameOfObjectToEvict];
+      if (nil == name) {
+        break;
+      }
+      [self evictObjectWithName:name];
+    }
+
+    self.isTrimmingForMemoryPressure = wasTrimmingForMemoryPressure;
+  }
+}
+
+#pragma mark - Statistics
+
+- (NIMemoryCacheStatistics)statistics {
+  NIMemoryCacheStatistics statistics;
+  statistics.hits = atomic_load_explicit(&_counters.hits, memory_order_relaxed);
+  statistics.misses = atomic_load_explicit(&_counters.misses, memory_order_relaxed);
+  statistics.stores = atomic_load_explicit(&_counters.stores, memory_order_relaxed);
+  statistics.evictions = atomic_load_explicit(&_counters.evictions, memory_order_relaxed);
+  statistics.expirations = atomic_load_explicit(&_counters.expirations, memory_order_relaxed);
+  statistics.memoryPressureEvictions = atomic_load_explicit(&_counters.memoryPressureEvictions,
+                                                            memory_order_relaxed);
+  statistics.removals = atomic_load_explicit(&_counters.removals, memory_order_relaxed);
+  statistics.evictedCost = atomic_load_explicit(&_counters.evictedCost, memory_order_relaxed);
+  statistics.lockWaitTime = ((double)atomic_load_explicit(&_counters.lockWaitTicks,
+                                                          memory_order_relaxed)
+                             / NSEC_PER_SEC);
+  return statistics;
+}
+
+- (void)resetStatistics {
+  atomic_store_explicit(&_counters.hits, 0, memory_order_relaxed);
+  atomic_store_explicit(&_counters.misses, 0, memory_order_relaxed);
+  atomic_store_explicit(&_counters.stores, 0, memory_order_relaxed);
+  atomic_store_explicit(&_counters.evictions, 0, memory_order_relaxed);
+  atomic_store_explicit(&_counters.expirations, 0, memory_order_relaxed);
+  atomic_store_explicit(&_counters.memoryPressureEvictions, 0, memory_order_relaxed);
+  atomic_store_explicit(&_counters.removals, 0, memory_order_relaxed);
+  atomic_store_explicit(&_counters.evictedCost, 0, memory_order_relaxed);
+  atomic_store_explicit(&_counters.lockWaitTicks, 0, memory_order_relaxed);
+}
+
+- (void)setProactiveExpirationInterval:(NSTimeInterval)proactiveExpirationInterval {
+  @synchronized(self) {
+    _proactiveExpirationInterval = proactiveExpirationInterval;
+
+    if (nil != self.expirationTimer) {
+      dispatch_source_cancel(self.expirationTimer);
+      self.expirationTimer = nil;
+    }
 
-      if ([info hasExpired]) {
-        [self removeCacheInfoForName:name];
+    if (proactiveExpirationInterval > 0) {
+      dispatch_source_t timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0,
+                                                       dispatch_get_global_queue(QOS_CLASS_UTILITY, 0));
+      uint64_t interval = (uint64_t)(proactiveExpirationInterval * NSEC_PER_SEC);
+      dispatch_source_set_timer(timer, dispatch_time(DISPATCH_TIME_NOW, (int64_t)interval),
+                                interval, interval / 10);
+
+      // The timer must not keep the cache alive.
+      __weak NIMemoryCache* weakSelf = self;
+      dispatch_source_set_event_handler(timer, ^{
+        [weakSelf removeExpiredObjects];
+      });
+      dispatch_resume(timer);
+      self.expirationTimer = timer;
+    }
+  }
+}
+
+- (void)setKeepsEvictedObjectsWhileInUse:(BOOL)keepsEvictedObjectsWhileInUse {
+  @synchronized(self) {
+    _keepsEvictedObjectsWhileInUse = keepsEvictedObjectsWhileInUse;
+
+    if (!keepsEvictedObjectsWhileInUse) {
+      [self forgetAllEvictedObjects];
+    }
+  }
+}
+
+- (void)setEvictionPolicy:(id<NIMemoryCacheEvictionPolicy>)evictionPolicy {
+  @synchronized(self) {
+    _evictionPolicy = evictionPolicy;
+
+    if (nil != evictionPolicy) {
+      // Bring the new policy up to date with the objects that are already in the cache.
+      NSArray* lruCacheObjects = [self lruCacheObjects];
+      @synchronized(evictionPolicy) {
+        [evictionPolicy didRemoveAllObjects];
+        for (NIMemoryCacheInfo* info in lruCacheObjects) {
+          [evictionPolicy didStoreObjectWithName:info.name];
+        }
       }
     }
   }
 }
 
-- (NSUInteger)count {
+- (void)enumerateObjectsWithPrefix:(NSString *)prefix
+                        usingBlock:(void (^)(NSString* name, id object, BOOL* stop))block {
+  NSMutableArray* infos = [NSMutableArray array];
   @synchronized(self) {
-    return self.cacheMap.count;
+    for (NSString* name in [self.prefixIndex namesWithPrefix:prefix]) {
+      NIMemoryCacheInfo* info = [self cacheInfoForName:name];
+      if (nil != info && ![info hasExpired]) {
+        [infos addObject:info];
+      }
+    }
+  }
+
+  // The block is called without holding the cache lock so that it may modify the cache.
+  BOOL stop = NO;
+  for (NIMemoryCacheInfo* info in infos) {
+    block(info.name, info.object, &stop);
+    if (stop) {
+      break;
+    }
+  }
+}
+
+- (NSUInteger)count {
+  NSUInteger count = 0;
+  for (NIMemoryCacheShard* shard in self.shards) {
+    @synchronized(shard) {
+      count += shard.cacheMap.count;
+    }
+  }
+  return count;
+}
+
+@end
+
+@implementation NIMemoryCache (Testing)
+
++ (void)advanceClockByTimeInterval:(NSTimeInterval)timeInterval {
+  sClockOffset += (uint64_t)(timeInterval * NSEC_PER_SEC);
+}
+
++ (void)resetClock {
+  sClockOffset = 0;
+}
+
+@end
+
+@implementation NIMemoryCacheShard
+
+- (id)initWithCapacity:(NSUInteger)capacity {
+  if ((self = [super init])) {
+    _cacheMap = [[NSMutableDictionary alloc] initWithCapacity:capacity];
+  }
+  return self;
+}
+
+- (NSString *)description {
+  return [NSString stringWithFormat:
+          @"<%@"
+          @" cache map: %@"
+          @">",
+          [super description],
+          self.cacheMap];
+}
+
+- (BOOL)isLinkedCacheInfo:(NIMemoryCacheInfo *)info {
+  return (nil != info && (nil != info.lruPrevious || _lruHead == info));
+}
+
+- (void)unlinkCacheInfo:(NIMemoryCacheInfo *)info {
+  if (![self isLinkedCacheInfo:info]) {
+    return;
+  }
+
+  NIMemoryCacheInfo* previous = info.lruPrevious;
+  NIMemoryCacheInfo* next = info.lruNext;
+  if (nil != previous) {
+    previous.lruNext = next;
+  } else {
+    _lruHead = next;
+  }
+  if (nil != next) {
+    next.lruPrevious = previous;
+  } else {
+    _lruTail = previous;
+  }
+  info.lruPrevious = nil;
+  info.lruNext = nil;
+}
+
+- (void)appendCacheInfo:(NIMemoryCacheInfo *)info {
+  info.lruPrevious = _lruTail;
+  info.lruNext = nil;
+  if (nil != _lruTail) {
+    _lruTail.lruNext = info;
+  } else {
+    _lruHead = info;
+  }
+  _lruTail = info;
+}
+
+- (void)setCacheInfo:(NIMemoryCacheInfo *)info forName:(NSString *)name {
+  NIMemoryCacheInfo* previousInfo = _cacheMap[name];
+  if (previousInfo != info) {
+    // Unlink before the cache map releases the previous info.
+    [self unlinkCacheInfo:previousInfo];
+    _cacheMap[name] = info;
+  }
+  [self unlinkCacheInfo:info];
+  [self appendCacheInfo:info];
+}
+
+- (void)removeCacheInfoForName:(NSString *)name {
+  NIMemoryCacheInfo* info = _cacheMap[name];
+  if (nil != info) {
+    // Unlink before the cache map releases the info.
+    [self unlinkCacheInfo:info];
+    [_cacheMap removeObjectForKey:name];
+  }
+}
+
+- (void)removeAllCacheInfos {
+  // The list links are unretained, so dropping the ends is enough once the map lets go.
+  _lruHead = nil;
+  _lruTail = nil;
+  [_cacheMap removeAllObjects];
+}
+
+- (void)updateAccessTimeForInfo:(NIMemoryCacheInfo *)info {
+  NIDASSERT(nil != info);
+  if (nil == info) {
+    return; // COV_NF_LINE
+  }
+  info.lastAccessTick = NIMemoryCacheCurrentTick();
+
+  // Only infos that are stored in the cache map are linked, so we only promote those.
+  if ([self isLinkedCacheInfo:info] && _lruTail != info) {
+    [self unlinkCacheInfo:info];
+    [self appendCacheInfo:info];
+  }
+}
+
+@end
+
+@implementation NIMemoryCacheExpirationHeap {
+  NSMutableArray* _infos;
+}
+
+- (id)init {
+  if ((self = [super init])) {
+    _infos = [[NSMutableArray alloc] init];
+  }
+  return self;
+}
+
+- (BOOL)infoAtIndex:(NSUInteger)index expiresBeforeInfoAtIndex:(NSUInteger)otherIndex {
+  return [_infos[index] expirationTick] < [_infos[otherIndex] expirationTick];
+}
+
+- (void)swapInfoAtIndex:(NSUInteger)index withInfoAtIndex:(NSUInteger)otherIndex {
+  [_infos exchangeObjectAtIndex:index withObjectAtIndex:otherIndex];
+  [_infos[index] setExpirationHeapIndex:index];
+  [_infos[otherIndex] setExpirationHeapIndex:otherIndex];
+}
+
+- (void)siftUpFromIndex:(NSUInteger)index {
+  while (index > 0) {
+    NSUInteger parent = (index - 1) / 2;
+    if (![self infoAtIndex:index expiresBeforeInfoAtIndex:parent]) {
+      break;
+    }
+    [self swapInfoAtIndex:index withInfoAtIndex:parent];
+    index = parent;
+  }
+}
+
+- (void)siftDownFromIndex:(NSUInteger)index {
+  NSUInteger count = _infos.count;
+  while (YES) {
+    NSUInteger earliest = index;
+    NSUInteger left = index * 2 + 1;
+    NSUInteger right = left + 1;
+    if (left < count && [self infoAtIndex:left expiresBeforeInfoAtIndex:earliest]) {
+      earliest = left;
+    }
+    if (right < count && [self infoAtIndex:right expiresBeforeInfoAtIndex:earliest]) {
+      earliest = right;
+    }
+    if (earliest == index) {
+      break;
+    }
+    [self swapInfoAtIndex:index withInfoAtIndex:earliest];
+    index = earliest;
+  }
+}
+
+- (void)addCacheInfo:(NIMemoryCacheInfo *)info {
+  if (NIMemoryCacheNeverExpires == info.expirationTick || NSNotFound != info.expirationHeapIndex) {
+    return;
+  }
+  info.expirationHeapIndex = _infos.count;
+  [_infos addObject:info];
+  [self siftUpFromIndex:info.expirationHeapIndex];
+}
+
+- (void)removeCacheInfo:(NIMemoryCacheInfo *)info {
+  NSUInteger index = info.expirationHeapIndex;
+  if (nil == info || NSNotFound == index) {
+    return;
+  }
+  NSUInteger lastIndex = _infos.count - 1;
+  if (index != lastIndex) {
+    [self swapInfoAtIndex:index withInfoAtIndex:lastIndex];
+  }
+  [_infos removeLastObject];
+  info.expirationHeapIndex = NSNotFound;
+
+  if (index < _infos.count) {
+    // The info that took the removed info's place may belong above or below it.
+    [self siftUpFromIndex:index];
+    [self siftDownFromIndex:index];
+  }
+}
+
+- (void)removeAllCacheInfos {
+  for (NIMemoryCacheInfo* info in _infos) {
+    info.expirationHeapIndex = NSNotFound;
+  }
+  [_infos removeAllObjects];
+}
+
+- (NIMemoryCacheInfo *)earliestExpiringCacheInfo {
+  return [_infos firstObject];
+}
+
+@end
+
+/**
+ * @brief A node in the prefix index.
+ *
+ * The name of a node is the concatenation of the edges from the root down to it.
+ */
+@interface NIMemoryCachePrefixNode : NSObject
+// The characters between the parent node and this node.
+@property (nonatomic, copy) NSString* edge;
+// The cache name that ends at this node, if any.
+@property (nonatomic, copy) NSString* name;
+// Child nodes keyed by the first character of their edge. Created lazily.
+@property (nonatomic, strong) NSMutableDictionary* children;
+@end
+
+@implementation NIMemoryCachePrefixNode
+@end
+
+@implementation NIMemoryCachePrefixIndex {
+  NIMemoryCachePrefixNode* _root;
+  NSUInteger _numberOfNames;
+}
+
+- (id)init {
+  if ((self = [super init])) {
+    _root = [[NIMemoryCachePrefixNode alloc] init];
+    _root.edge = @"";
+  }
+  return self;
+}
+
+// The number of leading characters that edge has in common with string starting at offset.
+static NSUInteger NIMemoryCacheCommonPrefixLength(NSString* edge, NSString* string, NSUInteger offset) {
+  NSUInteger length = MIN(edge.length, string.length - offset);
+  NSUInteger ix = 0;
+  while (ix < length && [edge characterAtIndex:ix] == [string characterAtIndex:offset + ix]) {
+    ++ix;
+  }
+  return ix;
+}
+
+- (void)addName:(NSString *)name {
+  NIMemoryCachePrefixNode* node = _root;
+  NSUInteger offset = 0;
+  while (offset < name.length) {
+    NSNumber* key = @([name characterAtIndex:offset]);
+    NIMemoryCachePrefixNode* child = node.children[key];
+    if (nil == child) {
+      child = [[NIMemoryCachePrefixNode alloc] init];
+      child.edge = [name substringFromIndex:offset];
+      child.name = name;
+      if (nil == node.children) {
+        node.children = [NSMutableDictionary dictionary];
+      }
+      node.children[key] = child;
+      _numberOfNames++;
+      return;
+    }
+
+    NSUInteger commonLength = NIMemoryCacheCommonPrefixLength(child.edge, name, offset);
+    if (commonLength < child.edge.length) {
+      // The name diverges from the child's edge, so split the edge where they differ.
+      NIMemoryCachePrefixNode* split = [[NIMemoryCachePrefixNode alloc] init];
+      split.edge = [child.edge substringToIndex:commonLength];
+      child.edge = [child.edge substringFromIndex:commonLength];
+      split.children = [NSMutableDictionary dictionaryWithObject:child
+                                                          forKey:@([child.edge characterAtIndex:0])];
+      node.children[key] = split;
+      child = split;
+    }
+    offset += commonLength;
+    node = child;
+  }
+  if (nil == node.name) {
+    _numberOfNames++;
+  }
+  node.name = name;
+}
+
+// Folds a node that no longer ends a name into its only child.
+- (void)mergeNodeWithOnlyChild:(NIMemoryCachePrefixNode *)node {
+  NIMemoryCachePrefixNode* child = [[node.children allValues] firstObject];
+  node.edge = [node.edge stringByAppendingString:child.edge];
+  node.name = child.name;
+  node.children = child.children;
+}
+
+- (void)removeName:(NSString *)name {
+  NIMemoryCachePrefixNode* parent = nil;
+  NIMemoryCachePrefixNode* node = _root;
+  NSUInteger offset = 0;
+  while (offset < name.length) {
+    NIMemoryCachePrefixNode* child = node.children[@([name characterAtIndex:offset])];
+    if (nil == child
+        || NIMemoryCacheCommonPrefixLength(child.edge, name, offset) < child.edge.length) {
+      return;
+    }
+    offset += child.edge.length;
+    parent = node;
+    node = child;
+  }
+  if (nil == node.name) {
+    return;
+  }
+  node.name = nil;
+  _numberOfNames--;
+
+  // Keep the tree compact so that no node without a name has fewer than two children.
+  if (node == _root) {
+    return;
+  }
+  if (0 == node.children.count) {
+    [parent.children removeObjectForKey:@([node.edge characterAtIndex:0])];
+    if (parent != _root && nil == parent.name && 1 == parent.children.count) {
+      [self mergeNodeWithOnlyChild:parent];
+    }
+  } else if (1 == node.children.count) {
+    [self mergeNodeWithOnlyChild:node];
   }
 }
 
+- (void)removeAllNames {
+  _root.name = nil;
+  _root.children = nil;
+  _numberOfNames = 0;
+}
+
+- (NSUInteger)numberOfNames {
+  return _numberOfNames;
+}
+
+- (NSArray *)namesWithPrefix:(NSString *)prefix {
+  // Like -[NSString hasPrefix:], an empty prefix matches nothing.
+  if (0 == prefix.length) {
+    return @[];
+  }
+
+  NIMemoryCachePrefixNode* node = _root;
+  NSUInteger offset = 0;
+  while (offset < prefix.length) {
+    NIMemoryCachePrefixNode* child = node.children[@([prefix characterAtIndex:offset])];
+    if (nil == child) {
+      return @[];
+    }
+    // The prefix may end partway along the child's edge.
+    NSUInteger commonLength = NIMemoryCacheCommonPrefixLength(child.edge, prefix, offset);
+    if (commonLength < MIN(child.edge.length, prefix.length - offset)) {
+      return @[];
+    }
+    offset += child.edge.length;
+    node = child;
+  }
+
+  NSMutableArray* names = [NSMutableArray array];
+  NSMutableArray* stack = [NSMutableArray arrayWithObject:node];
+  while (stack.count > 0) {
+    NIMemoryCachePrefixNode* next = [stack lastObject];
+    [stack removeLastObject];
+    if (nil != next.name) {
+      [names addObject:next.name];
+    }
+    [stack addObjectsFromArray:[next.children allValues]];
+  }
+  return names;
+}
+
 @end
 
 @implementation NIMemoryCacheInfo
 
+- (id)init {
+  if ((self = [super init])) {
+    _expirationTick = NIMemoryCacheNeverExpires;
+    _expirationHeapIndex = NSNotFound;
+  }
+  return self;
+}
+
 - (BOOL)hasExpired {
-  return (nil != _expirationDate
-          && [[NSDate date] timeIntervalSinceDate:_expirationDate] >= 0);
+  return (NIMemoryCacheNeverExpires != _expirationTick
+          && [self hasExpiredAtTick:NIMemoryCacheCurrentTick()]);
+}
+
+- (BOOL)hasExpiredAtTick:(uint64_t)tick {
+  return tick >= _expirationTick;
+}
+
+- (NSDate *)lastAccessTime {
+  return NIMemoryCacheDateFromTick(_lastAccessTick);
 }
 
 - (NSString *)description {
@@ -365,18 +1645,44 @@
           [super description],
           self.name,
           self.object,
-          self.expirationDate,
+          ((NIMemoryCacheNeverExpires == self.expirationTick)
+           ? nil : NIMemoryCacheDateFromTick(self.expirationTick)),
           self.lastAccessTime];
 }
 
 @end
 
+// The keys of a saved hot set. Names are ordered from most to least recently used. Expirations
+// are seconds since 1970, or 0 for images that never expire.
+static NSString* const kHotSetNamesKey = @"names";
+static NSString* const kHotSetExpirationsKey = @"expirations";
+
 @interface NIImageMemoryCache()
 @property (nonatomic, assign) unsigned long long numberOfPixels;
+// Images that have been stored but not handed to the disk cache yet, by name.
+@property (nonatomic, strong) NSMutableDictionary* pendingDiskImages;
+@property (nonatomic, strong) dispatch_queue_t diskQueue;
+// Variant info by image name, by family name.
+@property (nonatomic, strong) NSMutableDictionary* variantFamilies;
+// Family name by image name.
+@property (nonatomic, strong) NSMutableDictionary* variantFamilyNames;
 @end
 
 @implementation NIImageMemoryCache
 
+- (void)dealloc {
+  [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+- (id)initWithCapacity:(NSUInteger)capacity numberOfShards:(NSUInteger)numberOfShards {
+  if ((self = [super initWithCapacity:capacity numberOfShards:numberOfShards])) {
+    _maxNumberOfHotSetNames = 200;
+    _variantFamilies = [NSMutableDictionary dictionary];
+    _variantFamilyNames = [NSMutableDictionary dictionary];
+  }
+  return self;
+}
+
 - (unsigned long long)numberOfPixelsUsedByImage:(UIImage *)image {
   @synchronized(self) {
     if (nil == image) {
@@ -387,11 +1693,433 @@
   }
 }
 
+- (unsigned long long)numberOfBytes {
+  return self.totalCost;
+}
+
+- (unsigned long long)costOfObject:(id)object {
+  if (![object isKindOfClass:[UIImage class]]) {
+    return 0;
+  }
+  return NIMemoryCostOfImage(object);
+}
+
 - (void)removeAllObjects {
   @synchronized(self) {
     [super removeAllObjects];
 
     self.numberOfPixels = 0;
+
+    [self.variantFamilies removeAllObjects];
+    [self.variantFamilyNames removeAllObjects];
+
+    [self.pendingDiskImages removeAllObjects];
+    [self.diskCache removeAllData];
+  }
+}
+
+#pragma mark - Disk Cache
+
+- (void)setDiskCache:(NIDiskCache *)diskCache {
+  @synchronized(self) {
+    _diskCache = diskCache;
+
+    if (nil != diskCache && nil == self.diskQueue) {
+      self.pendingDiskImages = [NSMutableDictionary dictionary];
+      self.diskQueue = dispatch_queue_create("com.nimbuskit.imagememorycache.disk",
+                                             DISPATCH_QUEUE_SERIAL);
+      dispatch_set_target_queue(self.diskQueue, dispatch_get_global_queue(QOS_CLASS_UTILITY, 0));
+    }
+    [self.pendingDiskImages removeAllObjects];
+  }
+}
+
+// Writes stored images to the disk cache. Images that expire are removed from the disk cache
+// instead because the disk cache doesn't know about expiration dates.
+- (void)writeImages:(NSArray *)images
+          withNames:(NSArray *)names
+       expiresAfter:(NSDate *)expirationDate {
+  @synchronized(self) {
+    NIDiskCache* diskCache = self.diskCache;
+    if (nil == diskCache) {
+      return;
+    }
+
+    for (NSUInteger ix = 0; ix < images.count; ++ix) {
+      NSString* name = names[ix];
+      UIImage* image = images[ix];
+      if (nil != expirationDate || ![image isKindOfClass:[UIImage class]]) {
+        [self.pendingDiskImages removeObjectForKey:name];
+        [diskCache removeDataWithName:name];
+        continue;
+      }
+
+      // Converting the image to bitmap data means drawing it, so it's done in the background.
+      // A later store or removal with the same name cancels the write.
+      self.pendingDiskImages[name] = image;
+      dispatch_async(self.diskQueue, ^{
+        NSData* data = NIBitmapDataFromImage(image);
+        @synchronized(self) {
+          if (self.pendingDiskImages[name] == image) {
+            [self.pendingDiskImages removeObjectForKey:name];
+            if (nil != data) {
+              [diskCache storeData:data withName:name];
+            }
+          }
+        }
+      });
+    }
+  }
+}
+
+// Returns the image with the given name from the disk cache and moves it into memory.
+- (UIImage *)imageFromDiskCacheWithName:(NSString *)name {
+  @synchronized(self) {
+    NIDiskCache* diskCache = self.diskCache;
+    if (nil == diskCache) {
+      return nil;
+    }
+
+    UIImage* image = self.pendingDiskImages[name];
+    if (nil == image) {
+      // The image draws straight from the memory-mapped segment.
+      image = NIImageFromBitmapData([diskCache dataWithName:name]);
+    }
+    if (nil != image) {
+      [self insertObjects:@[image] withNames:@[name]];
+    }
+    return image;
+  }
+}
+
+- (void)storeObject:(id)object
+           withName:(NSString *)name
+               cost:(unsigned long long)cost
+       expiresAfter:(NSDate *)expirationDate {
+  @synchronized(self) {
+    [super storeObject:object withName:name cost:cost expiresAfter:expirationDate];
+
+    if (nil != object && nil != name) {
+      [self writeImages:@[object] withNames:@[name] expiresAfter:expirationDate];
+    }
+  }
+}
+
+- (void)storeObjects:(NSArray *)objects
+           withNames:(NSArray *)names
+        expiresAfter:(NSDate *)expirationDate {
+  @synchronized(self) {
+    [super storeObjects:objects withNames:names expiresAfter:expirationDate];
+
+    NSUInteger count = MIN(objects.count, names.count);
+    [self writeImages:[objects subarrayWithRange:NSMakeRange(0, count)]
+            withNames:[names subarrayWithRange:NSMakeRange(0, count)]
+         expiresAfter:expirationDate];
+  }
+}
+
+- (id)objectWithName:(NSString *)name {
+  id object = [super objectWithName:name];
+  if (nil == object && nil != self.diskCache) {
+    object = [self imageFromDiskCacheWithName:name];
+  }
+  return object;
+}
+
+- (NSDictionary *)objectsWithNames:(NSArray *)names {
+  NSDictionary* objects = [super objectsWithNames:names];
+  if (objects.count == names.count || nil == self.diskCache) {
+    return objects;
+  }
+
+  NSMutableDictionary* allObjects = [objects mutableCopy];
+  for (NSString* name in names) {
+    if (nil == allObjects[name]) {
+      UIImage* image = [self imageFromDiskCacheWithName:name];
+      if (nil != image) {
+        allObjects[name] = image;
+      }
+    }
+  }
+  return allObjects;
+}
+
+- (void)removeObjectWithName:(NSString *)name {
+  @synchronized(self) {
+    [super removeObjectWithName:name];
+
+    if (nil != name) {
+      [self.pendingDiskImages removeObjectForKey:name];
+      [self.diskCache removeDataWithName:name];
+    }
+  }
+}
+
+- (void)removeAllObjectsWithPrefix:(NSString *)prefix {
+  @synchronized(self) {
+    [super removeAllObjectsWithPrefix:prefix];
+
+    for (NSString* name in [self.pendingDiskImages allKeys]) {
+      if ([name hasPrefix:prefix]) {
+        [self.pendingDiskImages removeObjectForKey:name];
+      }
+    }
+    [self.diskCache removeAllDataWithPrefix:prefix];
+  }
+}
+
+#pragma mark - Variant Families
+
+- (void)removeName:(NSString *)name fromVariantFamily:(NSString *)familyName {
+  NSMutableDictionary* family = self.variantFamilies[familyName];
+  [family removeObjectForKey:name];
+  if (0 == family.count) {
+    [self.variantFamilies removeObjectForKey:familyName];
+  }
+  [self.variantFamilyNames removeObjectForKey:name];
+}
+
+- (void)addObjectWithName:(NSString *)name toVariantFamily:(NSString *)familyName variantInfo:(id)variantInfo {
+  @synchronized(self) {
+    NIDASSERT(nil != name && nil != familyName);
+    if (nil == name || nil == familyName || ![super containsObjectWithName:name]) {
+      return;
+    }
+
+    NSString* previousFamilyName = self.variantFamilyNames[name];
+    if (nil != previousFamilyName) {
+      [self removeName:name fromVariantFamily:previousFamilyName];
+    }
+
+    NSMutableDictionary* family = self.variantFamilies[familyName];
+    if (nil == family) {
+      family = [NSMutableDictionary dictionary];
+      self.variantFamilies[familyName] = family;
+    }
+    family[name] = variantInfo ?: [NSNull null];
+    self.variantFamilyNames[name] = familyName;
+  }
+}
+
+- (NSDictionary *)variantInfosInVariantFamily:(NSString *)familyName {
+  @synchronized(self) {
+    if (nil == familyName) {
+      return nil;
+    }
+
+    // Variants that have expired are still listed until something notices that they expired.
+    NSMutableDictionary* variantInfos = [NSMutableDictionary dictionary];
+    [self.variantFamilies[familyName] enumerateKeysAndObjectsUsingBlock:^(NSString* name, id variantInfo, BOOL *stop) {
+      NIMemoryCacheInfo* info = [self cacheInfoForName:name];
+      if (nil != info && ![info hasExpired]) {
+        variantInfos[name] = variantInfo;
+      }
+    }];
+    return variantInfos;
+  }
+}
+
+- (void)removeObjectsInVariantFamily:(NSString *)familyName {
+  @synchronized(self) {
+    if (nil == familyName) {
+      return;
+    }
+    for (NSString* name in [self.variantFamilies[familyName] allKeys]) {
+      [self removeObjectWithName:name];
+    }
+  }
+}
+
+#pragma mark - Warm Starts
+
+- (void)setHotSetPath:(NSString *)hotSetPath {
+  @synchronized(self) {
+    NSNotificationCenter* nc = [NSNotificationCenter defaultCenter];
+    if (nil == _hotSetPath && nil != hotSetPath) {
+      [nc addObserver:self
+             selector:@selector(saveHotSetWithNotification:)
+                 name:UIApplicationDidEnterBackgroundNotification
+               object:nil];
+      [nc addObserver:self
+             selector:@selector(saveHotSetWithNotification:)
+                 name:UIApplicationWillTerminateNotification
+               object:nil];
+
+    } else if (nil != _hotSetPath && nil == hotSetPath) {
+      [nc removeObserver:self name:UIApplicationDidEnterBackgroundNotification object:nil];
+      [nc removeObserver:self name:UIApplicationWillTerminateNotification object:nil];
+    }
+    _hotSetPath = [hotSetPath copy];
+  }
+}
+
+- (void)saveHotSetWithNotification:(NSNotification *)notification {
+  [self saveHotSet];
+}
+
+- (BOOL)saveHotSet {
+  NSString* path = nil;
+  NSUInteger maxNumberOfNames = 0;
+  @synchronized(self) {
+    path = self.hotSetPath;
+    maxNumberOfNames = self.maxNumberOfHotSetNames;
+  }
+  if (nil == path) {
+    return NO;
+  }
+
+  NSMutableArray* names = [NSMutableArray array];
+  NSMutableArray* expirations = [NSMutableArray array];
+  uint64_t tick = NIMemoryCacheCurrentTick();
+  for (NIMemoryCacheInfo* info in [[self lruCacheObjects] reverseObjectEnumerator]) {
+    if (names.count >= maxNumberOfNames) {
+      break;
+    }
+    if ([info hasExpiredAtTick:tick]) {
+      continue;
+    }
+
+    // Ticks don't survive a relaunch, so expirations are saved as wall clock times.
+    NSTimeInterval expiration = 0;
+    if (NIMemoryCacheNeverExpires != info.expirationTick) {
+      expiration = [NIMemoryCacheDateFromTick(info.expirationTick) timeIntervalSince1970];
+    }
+    [names addObject:info.name];
+    [expirations addObject:@(expiration)];
+  }
+
+  NSData* data = [NSPropertyListSerialization dataWithPropertyList:@{
+                    kHotSetNamesKey: names,
+                    kHotSetExpirationsKey: expirations,
+                  }
+                                                            format:NSPropertyListBinaryFormat_v1_0
+                                                           options:0
+                                                             error:nil];
+  if (nil == data || ![data writeToFile:path options:NSDataWritingAtomic error:nil]) {
+    NIDERROR(@"Failed to save the image cache hot set at %@", path);
+    return NO;
+  }
+  return YES;
+}
+
+// Returns the names and expirations of a saved hot set, or NO if there is no valid hot set.
+- (BOOL)readHotSetAtPath:(NSString *)path names:(NSArray **)names expirations:(NSArray **)expirations {
+  NSData* data = (nil != path) ? [NSData dataWithContentsOfFile:path] : nil;
+  if (nil == data) {
+    return NO;
+  }
+  NSDictionary* hotSet = [NSPropertyListSerialization propertyListWithData:data
+                                                                   options:NSPropertyListImmutable
+                                                                    format:NULL
+                                                                     error:nil];
+  if (![hotSet isKindOfClass:[NSDictionary class]]) {
+    return NO;
+  }
+  *names = hotSet[kHotSetNamesKey];
+  *expirations = hotSet[kHotSetExpirationsKey];
+  return ([*names isKindOfClass:[NSArray class]]
+          && [*expirations isKindOfClass:[NSArray class]]
+          && [*names count] == [*expirations count]);
+}
+
+- (void)warmStartWithTimeLimit:(NSTimeInterval)timeLimit
+              maxNumberOfBytes:(unsigned long long)maxNumberOfBytes
+                    completion:(void (^)(NSArray* names))completion {
+  NSString* path = nil;
+  NIDiskCache* diskCache = nil;
+  NIImageMemoryCacheHotSetLoader loader = nil;
+  @synchronized(self) {
+    path = self.hotSetPath;
+    diskCache = self.diskCache;
+    loader = self.hotSetLoader;
+  }
+  uint64_t deadline = UINT64_MAX;
+  if (timeLimit > 0) {
+    deadline = NIMemoryCacheTickAfterTimeInterval(timeLimit);
+  }
+
+  // Warming up must not compete with the images the app is asking for right now.
+  dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+    NSMutableArray* loadedNames = [NSMutableArray array];
+    NSArray* names = nil;
+    NSArray* expirations = nil;
+    if ([self readHotSetAtPath:path names:&names expirations:&expirations]) {
+      NSTimeInterval now = [[NSDate date] timeIntervalSince1970];
+      unsigned long long numberOfBytes = 0;
+
+      for (NSUInteger ix = 0; ix < names.count; ++ix) {
+        if (NIMemoryCacheCurrentTick() >= deadline
+            || (maxNumberOfBytes > 0 && numberOfBytes >= maxNumberOfBytes)) {
+          break;
+        }
+        NSString* name = names[ix];
+        NSTimeInterval expiration = [expirations[ix] doubleValue];
+        if (![name isKindOfClass:[NSString class]]
+            || (expiration > 0 && expiration <= now)
+            || [self containsObjectWithName:name]) {
+          continue;
+        }
+
+        // The disk cache only holds images that never expire.
+        UIImage* image = nil;
+        BOOL isFromDiskCache = NO;
+        if (0 == expiration) {
+          image = NIImageFromBitmapData([diskCache dataWithName:name]);
+          isFromDiskCache = (nil != image);
+        }
+        if (nil == image && nil != loader) {
+          image = loader(name);
+        }
+        if (![image isKindOfClass:[UIImage class]]) {
+          continue;
+        }
+        unsigned long long cost = NIMemoryCostOfImage(image);
+        if (maxNumberOfBytes > 0 && numberOfBytes + cost > maxNumberOfBytes) {
+          continue;
+        }
+
+        // The app may have stored a newer image with this name in the meantime.
+        BOOL didStore = NO;
+        @synchronized(self) {
+          if (![self containsObjectWithName:name]) {
+            if (isFromDiskCache) {
+              [self insertObjects:@[image] withNames:@[name]];
+            } else {
+              NSDate* expirationDate = ((expiration > 0)
+                                        ? [NSDate dateWithTimeIntervalSince1970:expiration]
+                                        : nil);
+              [self storeObject:image withName:name expiresAfter:expirationDate];
+            }
+            didStore = YES;
+          }
+        }
+        if (didStore) {
+          numberOfBytes += cost;
+          [loadedNames addObject:name];
+        }
+      }
+    }
+
+    if (nil != completion) {
+      dispatch_async(dispatch_get_main_queue(), ^{
+        completion(loadedNames);
+      });
+    }
+  });
+}
+
+// Evicts images until both limits are satisfied. A limit of 0 is unlimited.
+- (void)evictObjectsToFitMaxNumberOfPixels:(unsigned long long)maxNumberOfPixels
+                           maxNumberOfBytes:(unsigned long long)maxNumberOfBytes {
+  @synchronized(self) {
+    while ((maxNumberOfPixels > 0 && self.numberOfPixels > maxNumberOfPixels)
+           || (maxNumberOfBytes > 0 && self.numberOfBytes > maxNumberOfBytes)) {
+      NSString* name = [self nameOfObjectToEvict];
+      if (nil == name) {
+        break;
+      }
+      [self evictObjectWithName:name];
+    }
   }
 }
 
@@ -400,13 +2128,11 @@
     // Remove all expired images first.
     [super reduceMemoryUsage];
 
-    if (self.maxNumberOfPixelsUnderStress > 0) {
-      // Remove the least recently used images by iterating over the linked list.
-      while (self.numberOfPixels > self.maxNumberOfPixelsUnderStress) {
-        NIMemoryCacheInfo* info = [self.lruCacheObjects firstObject];
-        [self removeCacheInfoForName:info.name];
-      }
-    }
+    BOOL wasTrimmingForMemoryPressure = self.isTrimmingForMemoryPressure;
+    self.isTrimmingForMemoryPressure = YES;
+    [self evictObjectsToFitMaxNumberOfPixels:self.maxNumberOfPixelsUnderStress
+                            maxNumberOfBytes:self.maxNumberOfBytesUnderStress];
+    self.isTrimmingForMemoryPressure = wasTrimmingForMemoryPressure;
   }
 }
 
@@ -424,17 +2150,15 @@
   }
 }
 
-- (void)didSetObject:(id)object withName:(NSString *)name {
+- (void)didSetObjects:(NSArray *)objects withNames:(NSArray *)names {
   @synchronized(self) {
-    // Reduce the cache size after the object has been set in case the cache size is smaller
-    // than the object that's being added and we need to remove this object right away.
-    if (self.maxNumberOfPixels > 0) {
-      // Remove least recently used images until we satisfy our memory constraints.
-      while (self.numberOfPixels > self.maxNumberOfPixels) {
-        NIMemoryCacheInfo* info = [self.lruCacheObjects firstObject];
-        [self removeCacheInfoForName:info.name];
-      }
-    }
+    [super didSetObjects:objects withNames:names];
+
+    // Reduce the cache size after the objects have been set in case the cache size is smaller
+    // than the objects that are being added and we need to remove some of them right away.
+    // Batches are only trimmed once, after every object in the batch has been stored.
+    [self evictObjectsToFitMaxNumberOfPixels:self.maxNumberOfPixels
+                            maxNumberOfBytes:self.maxNumberOfBytes];
   }
 }
 
@@ -446,6 +2170,11 @@
     }
 
     self.numberOfPixels -= [self numberOfPixelsUsedByImage:object];
+
+    NSString* familyName = self.variantFamilyNames[name];
+    if (nil != familyName) {
+      [self removeName:name fromVariantFamily:familyName];
+    }
   }
 }
 
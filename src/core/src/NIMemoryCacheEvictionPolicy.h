@@ -0,0 +1,208 @@
+//
+// Copyright 2011-2014 NimbusKit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "NIPreprocessorMacros.h"
+
+API_DEPRECATED_BEGIN("Use NSCache instead.", ios(12, API_TO_BE_DEPRECATED))
+
+/**
+ * Strategies for choosing which object an in-memory cache evicts next.
+ *
+ * @ingroup In-Memory-Caches
+ * @{
+ *
+ * By default NIMemoryCache evicts its least recently used object. A single pass over a large
+ * set of objects, such as flinging through a long list of photos, will push every object that
+ * was being used repeatedly out of a least-recently-used cache. The eviction policies in this
+ * file resist such scans by taking the frequency of use into account.
+ *
+ * <h2>Example Use</h2>
+ *
+@code
+NIImageMemoryCache* cache = [[NIImageMemoryCache alloc] init];
+cache.evictionPolicy = [[NITinyLFUEvictionPolicy alloc] initWithExpectedNumberOfObjects:1000];
+@endcode
+ */
+
+/**
+ * The interface between a memory cache and the strategy it uses to pick objects to evict.
+ *
+ * The cache informs the policy of every change to its contents and asks the policy for the name
+ * of the object to evict when it needs to free up space. The cache serializes all calls to its
+ * policy, so policies do not need to be thread-safe, but a policy must not be shared between
+ * caches.
+ *
+ * A policy may be told about names that it has already forgotten, for example an access of an
+ * object that is being removed at the same time on another thread. Policies should ignore such
+ * calls.
+ */
+@protocol NIMemoryCacheEvictionPolicy <NSObject>
+@required
+
+- (void)didStoreObjectWithName:(NSString *)name;
+- (void)didAccessObjectWithName:(NSString *)name;
+- (void)didMissObjectWithName:(NSString *)name;
+- (void)didRemoveObjectWithName:(NSString *)name evicted:(BOOL)evicted;
+- (void)didRemoveAllObjects;
+
+- (NSString *)nameOfObjectToEvict;
+
+@end
+
+/**
+ * A segmented least-recently-used eviction policy.
+ *
+ * New objects start out in a probationary segment. Objects that are accessed again are promoted
+ * to a protected segment. Objects are evicted from the probationary segment first, so objects that
+ * are only used once never push out objects that are used repeatedly.
+ */
+@interface NISegmentedLRUEvictionPolicy : NSObject <NIMemoryCacheEvictionPolicy>
+
+@property (nonatomic, assign) double protectedRatio; // Default: 0.8
+
+@end
+
+/**
+ * An adaptive replacement cache (ARC) eviction policy.
+ *
+ * Balances a list of objects that have been used once against a list of objects that have been
+ * used more than once. The names of recently evicted objects are remembered in ghost lists and
+ * storing one of them again shifts the balance towards the list it was evicted from.
+ */
+@interface NIAdaptiveReplacementEvictionPolicy : NSObject <NIMemoryCacheEvictionPolicy>
+
+@property (nonatomic, readonly, assign) double targetRecentRatio;
+
+@end
+
+/**
+ * A window TinyLFU eviction policy.
+ *
+ * New objects enter a small least-recently-used window. When the window overflows, the object
+ * leaving the window must have been requested more often than the object the main segmented LRU
+ * would evict in order to be admitted. Request frequencies are estimated with a compact count-min
+ * sketch that includes requests for objects that are not in the cache and that is periodically
+ * aged so that the cache adapts to changing access patterns.
+ */
+@interface NITinyLFUEvictionPolicy : NSObject <NIMemoryCacheEvictionPolicy>
+
+// Designated initializer.
+- (id)initWithExpectedNumberOfObjects:(NSUInteger)expectedNumberOfObjects;
+
+@property (nonatomic, assign) double windowRatio; // Default: 0.01
+
+- (NSUInteger)estimatedFrequencyOfName:(NSString *)name;
+
+@end
+
+/**@}*/// End of Eviction Policies ///////////////////////////////////////////////////////////////
+
+/** @name Observing Cache Changes */
+
+/**
+ * An object was stored in the cache.
+ *
+ * Storing an object with a name that is already in the cache replaces the previous object and
+ * counts as an access.
+ *
+ * @fn NIMemoryCacheEvictionPolicy::didStoreObjectWithName:
+ */
+
+/**
+ * An object in the cache was accessed.
+ *
+ * @fn NIMemoryCacheEvictionPolicy::didAccessObjectWithName:
+ */
+
+/**
+ * An object was requested from the cache but was not found.
+ *
+ * @fn NIMemoryCacheEvictionPolicy::didMissObjectWithName:
+ */
+
+/**
+ * An object was removed from the cache.
+ *
+ * @param name     The name of the removed object.
+ * @param evicted  YES if the cache removed the object to free up space, NO if the object was
+ *                      removed explicitly or because it expired.
+ * @fn NIMemoryCacheEvictionPolicy::didRemoveObjectWithName:evicted:
+ */
+
+/**
+ * Every object was removed from the cache.
+ *
+ * @fn NIMemoryCacheEvictionPolicy::didRemoveAllObjects
+ */
+
+/** @name Choosing Objects to Evict */
+
+/**
+ * Returns the name of the object that should be evicted next.
+ *
+ * The cache may call this method without then evicting the object.
+ *
+ * @returns The name of an object in the cache, or nil if the policy is not tracking any objects.
+ * @fn NIMemoryCacheEvictionPolicy::nameOfObjectToEvict
+ */
+
+/**
+ * The share of tracked objects that may be in the protected segment.
+ *
+ * When promoting an object pushes the protected segment over this share, the least recently
+ * used protected object is demoted back to the probationary segment.
+ *
+ * By default this is 0.8.
+ *
+ * @fn NISegmentedLRUEvictionPolicy::protectedRatio
+ */
+
+/**
+ * The share of the cache the policy currently aims to give to objects that have been used once.
+ *
+ * @fn NIAdaptiveReplacementEvictionPolicy::targetRecentRatio
+ */
+
+/**
+ * Initializes a newly allocated policy sized for the given number of objects.
+ *
+ * The frequency sketch is sized and aged according to the expected number of objects in the
+ * cache. The policy works with any number of objects but its estimates are most accurate
+ * around this number.
+ *
+ * @fn NITinyLFUEvictionPolicy::initWithExpectedNumberOfObjects:
+ */
+
+/**
+ * The share of tracked objects that are kept in the admission window.
+ *
+ * A value of 0 admits new objects only when they are requested more often than the main
+ * segment's victim.
+ *
+ * By default this is 0.01.
+ *
+ * @fn NITinyLFUEvictionPolicy::windowRatio
+ */
+
+/**
+ * Returns the estimated number of recent requests for the given name.
+ *
+ * @fn NITinyLFUEvictionPolicy::estimatedFrequencyOfName:
+ */
+
+API_DEPRECATED_END
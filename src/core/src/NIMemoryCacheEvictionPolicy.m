@@ -0,0 +1,531 @@
+//
+// Copyright 2011-2014 NimbusKit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import "NIMemoryCacheEvictionPolicy.h"
+
+#import "NIDebuggingTools.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "Nimbus requires ARC support."
+#endif
+
+/**
+ * @brief A node in an NIEvictionList.
+ */
+@interface NIEvictionListNode : NSObject
+@property (nonatomic, copy) NSString* name;
+// Not retained because the list's node map owns every node.
+@property (nonatomic, unsafe_unretained) NIEvictionListNode* previous;
+@property (nonatomic, unsafe_unretained) NIEvictionListNode* next;
+@end
+
+/**
+ * @brief An ordered set of names with O(1) insertion, removal and reordering.
+ *
+ * The least recently added name is the head of the list.
+ */
+@interface NIEvictionList : NSObject
+- (NSUInteger)count;
+- (BOOL)containsName:(NSString *)name;
+// Adds the name at the tail of the list, moving it there if it's already in the list.
+- (void)addName:(NSString *)name;
+- (void)removeName:(NSString *)name;
+- (void)removeAllNames;
+- (NSString *)headName;
+- (NSString *)tailName;
+@end
+
+/**
+ * @brief A count-min sketch of request frequencies with small saturating counters.
+ *
+ * Every counter is halved once the number of recorded requests reaches the sample size so that
+ * old requests gradually stop counting.
+ */
+@interface NIFrequencySketch : NSObject
+- (id)initWithWidth:(NSUInteger)width;
+- (void)incrementName:(NSString *)name;
+- (NSUInteger)frequencyOfName:(NSString *)name;
+@end
+
+@interface NISegmentedLRUEvictionPolicy()
+- (NSUInteger)numberOfObjects;
+- (BOOL)containsName:(NSString *)name;
+@end
+
+@implementation NIEvictionListNode
+@end
+
+@implementation NIEvictionList {
+  NSMutableDictionary* _nodes;
+  NIEvictionListNode* __unsafe_unretained _head;
+  NIEvictionListNode* __unsafe_unretained _tail;
+}
+
+- (id)init {
+  if ((self = [super init])) {
+    _nodes = [[NSMutableDictionary alloc] init];
+  }
+  return self;
+}
+
+- (NSUInteger)count {
+  return _nodes.count;
+}
+
+- (BOOL)containsName:(NSString *)name {
+  return (nil != name && nil != _nodes[name]);
+}
+
+- (void)unlinkNode:(NIEvictionListNode *)node {
+  if (nil != node.previous) {
+    node.previous.next = node.next;
+  } else {
+    _head = node.next;
+  }
+  if (nil != node.next) {
+    node.next.previous = node.previous;
+  } else {
+    _tail = node.previous;
+  }
+  node.previous = nil;
+  node.next = nil;
+}
+
+- (void)addName:(NSString *)name {
+  if (nil == name) {
+    return;
+  }
+  NIEvictionListNode* node = _nodes[name];
+  if (nil == node) {
+    node = [[NIEvictionListNode alloc] init];
+    node.name = name;
+    _nodes[name] = node;
+
+  } else if (_tail == node) {
+    return;
+
+  } else {
+    [self unlinkNode:node];
+  }
+
+  node.previous = _tail;
+  if (nil != _tail) {
+    _tail.next = node;
+  } else {
+    _head = node;
+  }
+  _tail = node;
+}
+
+- (void)removeName:(NSString *)name {
+  if (nil == name) {
+    return;
+  }
+  NIEvictionListNode* node = _nodes[name];
+  if (nil != node) {
+    // Unlink before the node map releases the node.
+    [self unlinkNode:node];
+    [_nodes removeObjectForKey:name];
+  }
+}
+
+- (void)removeAllNames {
+  _head = nil;
+  _tail = nil;
+  [_nodes removeAllObjects];
+}
+
+- (NSString *)headName {
+  return _head.name;
+}
+
+- (NSString *)tailName {
+  return _tail.name;
+}
+
+@end
+
+// Odd multipliers for deriving one index per sketch row from a single hash.
+static const uint64_t kSketchSeeds[] = {
+  0xc3a5c85c97cb3127ULL, 0xb492b66fbe98f273ULL, 0x9ae16a3b2f90404fULL, 0xcbf29ce484222325ULL
+};
+static const NSUInteger kSketchDepth = sizeof(kSketchSeeds) / sizeof(kSketchSeeds[0]);
+// Counters saturate at the largest 4-bit value.
+static const uint8_t kSketchMaxCount = 15;
+
+@implementation NIFrequencySketch {
+  uint8_t* _counters;
+  NSUInteger _width;
+  NSUInteger _sampleSize;
+  NSUInteger _numberOfAdditions;
+}
+
+- (void)dealloc {
+  free(_counters);
+}
+
+- (id)initWithWidth:(NSUInteger)width {
+  if ((self = [super init])) {
+    // Round the width up to a power of two so that indices can be masked.
+    _width = 16;
+    while (_width < width) {
+      _width <<= 1;
+    }
+    _sampleSize = _width * 10;
+    _counters = calloc(_width * kSketchDepth, sizeof(uint8_t));
+  }
+  return self;
+}
+
+- (NSUInteger)indexOfHash:(NSUInteger)hash inRow:(NSUInteger)row {
+  uint64_t index = ((uint64_t)hash + row) * kSketchSeeds[row];
+  index ^= index >> 32;
+  return row * _width + (NSUInteger)(index & (_width - 1));
+}
+
+- (void)incrementName:(NSString *)name {
+  NSUInteger hash = [name hash];
+  for (NSUInteger row = 0; row < kSketchDepth; ++row) {
+    NSUInteger index = [self indexOfHash:hash inRow:row];
+    if (_counters[index] < kSketchMaxCount) {
+      _counters[index]++;
+    }
+  }
+
+  if (++_numberOfAdditions >= _sampleSize) {
+    // Age every counter so that the sketch favors recent requests.
+    for (NSUInteger ix = 0; ix < _width * kSketchDepth; ++ix) {
+      _counters[ix] >>= 1;
+    }
+    _numberOfAdditions /= 2;
+  }
+}
+
+- (NSUInteger)frequencyOfName:(NSString *)name {
+  NSUInteger hash = [name hash];
+  NSUInteger frequency = kSketchMaxCount;
+  for (NSUInteger row = 0; row < kSketchDepth; ++row) {
+    frequency = MIN(frequency, (NSUInteger)_counters[[self indexOfHash:hash inRow:row]]);
+  }
+  return frequency;
+}
+
+@end
+
+@implementation NISegmentedLRUEvictionPolicy {
+  NIEvictionList* _probation;
+  NIEvictionList* _protected;
+}
+
+- (id)init {
+  if ((self = [super init])) {
+    _probation = [[NIEvictionList alloc] init];
+    _protected = [[NIEvictionList alloc] init];
+    _protectedRatio = 0.8;
+  }
+  return self;
+}
+
+- (NSUInteger)numberOfObjects {
+  return _probation.count + _protected.count;
+}
+
+- (BOOL)containsName:(NSString *)name {
+  return [_probation containsName:name] || [_protected containsName:name];
+}
+
+- (void)demoteProtectedObjects {
+  NSUInteger maxNumberOfProtectedObjects =
+      (NSUInteger)ceil(self.protectedRatio * (_probation.count + _protected.count));
+  while (_protected.count > maxNumberOfProtectedObjects) {
+    NSString* name = [_protected headName];
+    [_protected removeName:name];
+    [_probation addName:name];
+  }
+}
+
+- (void)didStoreObjectWithName:(NSString *)name {
+  if ([self containsName:name]) {
+    [self didAccessObjectWithName:name];
+
+  } else {
+    [_probation addName:name];
+  }
+}
+
+- (void)didAccessObjectWithName:(NSString *)name {
+  if ([_probation containsName:name]) {
+    [_probation removeName:name];
+    [_protected addName:name];
+    [self demoteProtectedObjects];
+
+  } else if ([_protected containsName:name]) {
+    [_protected addName:name];
+  }
+}
+
+- (void)didMissObjectWithName:(NSString *)name {
+  // No-op
+}
+
+- (void)didRemoveObjectWithName:(NSString *)name evicted:(BOOL)evicted {
+  [_probation removeName:name];
+  [_protected removeName:name];
+}
+
+- (void)didRemoveAllObjects {
+  [_probation removeAllNames];
+  [_protected removeAllNames];
+}
+
+- (NSString *)nameOfObjectToEvict {
+  NSString* name = [_probation headName];
+  if (nil == name) {
+    name = [_protected headName];
+  }
+  return name;
+}
+
+@end
+
+@implementation NIAdaptiveReplacementEvictionPolicy {
+  // Objects that have been used once (T1) and more than once (T2).
+  NIEvictionList* _recent;
+  NIEvictionList* _frequent;
+  // The names of objects recently evicted from T1 (B1) and T2 (B2).
+  NIEvictionList* _recentGhosts;
+  NIEvictionList* _frequentGhosts;
+  // The target number of objects in T1.
+  double _target;
+}
+
+- (id)init {
+  if ((self = [super init])) {
+    _recent = [[NIEvictionList alloc] init];
+    _frequent = [[NIEvictionList alloc] init];
+    _recentGhosts = [[NIEvictionList alloc] init];
+    _frequentGhosts = [[NIEvictionList alloc] init];
+  }
+  return self;
+}
+
+- (NSUInteger)numberOfObjects {
+  return _recent.count + _frequent.count;
+}
+
+- (double)targetRecentRatio {
+  return _target / MAX((NSUInteger)1, [self numberOfObjects]);
+}
+
+- (void)trimGhosts {
+  // The cache's capacity is not known up front, so the ghost lists are bounded by the number of
+  // objects currently in the cache.
+  NSUInteger capacity = MAX((NSUInteger)1, [self numberOfObjects]);
+  while (_recentGhosts.count > 0 && _recent.count + _recentGhosts.count > capacity) {
+    [_recentGhosts removeName:[_recentGhosts headName]];
+  }
+  while (_frequentGhosts.count > 0
+         && capacity + _recentGhosts.count + _frequentGhosts.count > capacity * 2) {
+    [_frequentGhosts removeName:[_frequentGhosts headName]];
+  }
+}
+
+- (void)didStoreObjectWithName:(NSString *)name {
+  NSUInteger capacity = [self numberOfObjects] + 1;
+
+  if ([_recent containsName:name] || [_frequent containsName:name]) {
+    [self didAccessObjectWithName:name];
+    return;
+
+  } else if ([_recentGhosts containsName:name]) {
+    // We evicted this object too early from the recent list, so give that list more room.
+    double delta = MAX(1.0, (double)_frequentGhosts.count / _recentGhosts.count);
+    _target = MIN((double)capacity, _target + delta);
+    [_recentGhosts removeName:name];
+    [_frequent addName:name];
+
+  } else if ([_frequentGhosts containsName:name]) {
+    // We evicted this object too early from the frequent list, so give that list more room.
+    double delta = MAX(1.0, (double)_recentGhosts.count / _frequentGhosts.count);
+    _target = MAX(0.0, _target - delta);
+    [_frequentGhosts removeName:name];
+    [_frequent addName:name];
+
+  } else {
+    [_recent addName:name];
+  }
+
+  [self trimGhosts];
+}
+
+- (void)didAccessObjectWithName:(NSString *)name {
+  if ([_recent containsName:name]) {
+    [_recent removeName:name];
+    [_frequent addName:name];
+
+  } else if ([_frequent containsName:name]) {
+    [_frequent addName:name];
+  }
+}
+
+- (void)didMissObjectWithName:(NSString *)name {
+  // No-op
+}
+
+- (void)didRemoveObjectWithName:(NSString *)name evicted:(BOOL)evicted {
+  if ([_recent containsName:name]) {
+    [_recent removeName:name];
+    if (evicted) {
+      [_recentGhosts addName:name];
+    }
+
+  } else if ([_frequent containsName:name]) {
+    [_frequent removeName:name];
+    if (evicted) {
+      [_frequentGhosts addName:name];
+    }
+  }
+
+  [self trimGhosts];
+}
+
+- (void)didRemoveAllObjects {
+  [_recent removeAllNames];
+  [_frequent removeAllNames];
+  [_recentGhosts removeAllNames];
+  [_frequentGhosts removeAllNames];
+  _target = 0;
+}
+
+- (NSString *)nameOfObjectToEvict {
+  if (_recent.count > 0 && (_recent.count > _target || 0 == _frequent.count)) {
+    return [_recent headName];
+  }
+  return [_frequent headName];
+}
+
+@end
+
+@implementation NITinyLFUEvictionPolicy {
+  NIFrequencySketch* _sketch;
+  NIEvictionList* _window;
+  NISegmentedLRUEvictionPolicy* _main;
+  // The object that most recently left the window and has yet to win or lose its admission duel.
+  NSString* _admissionCandidate;
+}
+
+- (id)init {
+  return [self initWithExpectedNumberOfObjects:1024];
+}
+
+- (id)initWithExpectedNumberOfObjects:(NSUInteger)expectedNumberOfObjects {
+  if ((self = [super init])) {
+    _sketch = [[NIFrequencySketch alloc] initWithWidth:expectedNumberOfObjects];
+    _window = [[NIEvictionList alloc] init];
+    _main = [[NISegmentedLRUEvictionPolicy alloc] init];
+    _windowRatio = 0.01;
+  }
+  return self;
+}
+
+- (NSUInteger)estimatedFrequencyOfName:(NSString *)name {
+  return [_sketch frequencyOfName:name];
+}
+
+- (void)moveOverflowingWindowObjectsToMain {
+  NSUInteger maxNumberOfWindowObjects = 0;
+  if (self.windowRatio > 0) {
+    NSUInteger numberOfObjects = _window.count + [_main numberOfObjects];
+    maxNumberOfWindowObjects = MAX((NSUInteger)1, (NSUInteger)(self.windowRatio * numberOfObjects));
+  }
+  while (_window.count > maxNumberOfWindowObjects) {
+    NSString* name = [_window headName];
+    [_window removeName:name];
+    [_main didStoreObjectWithName:name];
+    _admissionCandidate = name;
+  }
+}
+
+- (void)didStoreObjectWithName:(NSString *)name {
+  if ([_window containsName:name]) {
+    [_window addName:name];
+
+  } else if ([_main containsName:name]) {
+    [_main didAccessObjectWithName:name];
+
+  } else {
+    [_window addName:name];
+    [self moveOverflowingWindowObjectsToMain];
+  }
+}
+
+- (void)didAccessObjectWithName:(NSString *)name {
+  [_sketch incrementName:name];
+
+  if ([_window containsName:name]) {
+    [_window addName:name];
+
+  } else {
+    // A candidate that is requested again has earned its place in the main policy.
+    if ([name isEqualToString:_admissionCandidate]) {
+      _admissionCandidate = nil;
+    }
+    [_main didAccessObjectWithName:name];
+  }
+}
+
+- (void)didMissObjectWithName:(NSString *)name {
+  [_sketch incrementName:name];
+}
+
+- (void)didRemoveObjectWithName:(NSString *)name evicted:(BOOL)evicted {
+  if ([_window containsName:name]) {
+    [_window removeName:name];
+
+  } else {
+    [_main didRemoveObjectWithName:name evicted:evicted];
+  }
+
+  // Evicting either the candidate or its opponent decides the duel.
+  if (evicted || [name isEqualToString:_admissionCandidate]) {
+    _admissionCandidate = nil;
+  }
+}
+
+- (void)didRemoveAllObjects {
+  [_window removeAllNames];
+  [_main didRemoveAllObjects];
+  _admissionCandidate = nil;
+}
+
+- (NSString *)nameOfObjectToEvict {
+  NSString* victim = [_main nameOfObjectToEvict];
+  if (nil == victim) {
+    return [_window headName];
+  }
+
+  // The latest object to have left the window is only admitted if it has been requested more
+  // often than the object the main policy would evict.
+  NSString* candidate = _admissionCandidate;
+  if (nil != candidate
+      && ![candidate isEqualToString:victim]
+      && [_sketch frequencyOfName:candidate] <= [_sketch frequencyOfName:victim]) {
+    return candidate;
+  }
+  return victim;
+}
+
+@end
@@ -0,0 +1,210 @@
+//
+// Copyright 2011-2014 NimbusKit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+#import <UIKit/UIKit.h>
+
+#import "NIPreprocessorMacros.h"
+
+/**
+ * For releasing cached memory gradually when the system runs low on memory.
+ *
+ * @ingroup NimbusCore
+ * @defgroup Memory-Pressure Memory Pressure
+ * @{
+ *
+ * Nimbus caches used to empty themselves whenever the app received a memory warning. The
+ * memory pressure coordinator instead asks every registered cache to release a share of its
+ * memory that depends on how severe the pressure is, how much memory the cache holds and how
+ * expensive its contents are to recreate. The work is spread over several turns of the main
+ * run loop so that the app stays responsive.
+ *
+ * NIMemoryCache, NIViewRecycler and NIStylesheet register themselves with the shared
+ * coordinator when they are created.
+ *
+ * <h2>Example Use</h2>
+ *
+@code
+// Make a custom cache release memory along with the Nimbus caches.
+[[NIMemoryPressureCoordinator sharedCoordinator] addResponder:myCache];
+@endcode
+ */
+
+/**
+ * How urgently memory should be released.
+ */
+typedef NS_ENUM(NSInteger, NIMemoryPressureLevel) {
+  /**
+   * The system is beginning to run low on memory.
+   */
+  NIMemoryPressureLevelModerate = 1,
+
+  /**
+   * The system is about to terminate apps to free up memory.
+   */
+  NIMemoryPressureLevelCritical,
+
+  /**
+   * The app has moved to the background, where apps using the least memory are terminated last.
+   */
+  NIMemoryPressureLevelBackground,
+};
+
+/**
+ * An object that holds memory that it can release on request.
+ */
+@protocol NIMemoryPressureResponder <NSObject>
+@required
+
+- (unsigned long long)memoryPressureCost;
+- (void)trimToMemoryPressureCost:(unsigned long long)cost level:(NIMemoryPressureLevel)level;
+
+@optional
+
+- (double)memoryPressureRecreationPrice;
+
+@end
+
+/**
+ * Turns system memory pressure into proportional trims of every registered responder.
+ *
+ * Responders may be added and removed on any thread. All other methods must be called on the main
+ * thread, and responders are always trimmed on the main thread.
+ */
+@interface NIMemoryPressureCoordinator : NSObject
+
++ (NIMemoryPressureCoordinator *)sharedCoordinator;
+
+- (void)addResponder:(id<NIMemoryPressureResponder>)responder;
+- (void)removeResponder:(id<NIMemoryPressureResponder>)responder;
+
+@property (nonatomic, assign) NSUInteger numberOfTrimSteps; // Default: 4
+
+- (double)fractionToReleaseForLevel:(NIMemoryPressureLevel)level;
+
+// Testing
+
+- (void)simulateMemoryPressureWithLevel:(NIMemoryPressureLevel)level;
+- (void)finishTrimming;
+@property (nonatomic, readonly, getter=isTrimming) BOOL trimming;
+
+@end
+
+/**@}*/// End of Memory Pressure ///////////////////////////////////////////////////////////////////
+
+/** @name Measuring Memory */
+
+/**
+ * The approximate number of bytes of memory the responder could release.
+ *
+ * @fn NIMemoryPressureResponder::memoryPressureCost
+ */
+
+/**
+ * Releases memory until the responder's memoryPressureCost is no greater than the given cost.
+ *
+ * The coordinator calls this method several times per trim with decreasing costs, once per
+ * run loop turn. Responders should release the memory they are least likely to need first.
+ *
+ * @param cost   The cost the responder should shrink to.
+ * @param level  The memory pressure level that caused the trim.
+ * @fn NIMemoryPressureResponder::trimToMemoryPressureCost:level:
+ */
+
+/**
+ * How expensive the responder's memory is to recreate relative to other responders.
+ *
+ * Responders with a higher price release a smaller share of their memory. Objects that have to
+ * be downloaded again are expensive while objects that can be rebuilt from memory are cheap.
+ *
+ * If not implemented, the price is 1.
+ *
+ * @fn NIMemoryPressureResponder::memoryPressureRecreationPrice
+ */
+
+/** @name Accessing the Shared Coordinator */
+
+/**
+ * Returns the coordinator that responds to the system's memory pressure events.
+ *
+ * The shared coordinator trims at the moderate level when a dispatch memory pressure source
+ * reports a warning, at the critical level when the app receives a memory warning, and at the
+ * background level when the app enters the background.
+ *
+ * @fn NIMemoryPressureCoordinator::sharedCoordinator
+ */
+
+/** @name Registering Responders */
+
+/**
+ * Adds a responder to the coordinator.
+ *
+ * Responders are not retained and do not need to be removed before they are deallocated.
+ *
+ * @fn NIMemoryPressureCoordinator::addResponder:
+ */
+
+/**
+ * Removes a responder from the coordinator.
+ *
+ * @fn NIMemoryPressureCoordinator::removeResponder:
+ */
+
+/** @name Configuring Trims */
+
+/**
+ * The number of run loop turns that a trim is spread across.
+ *
+ * Each step releases an equal share of the memory the trim will release. Critical trims always
+ * happen in a single step because the app may be terminated before a later step runs.
+ *
+ * By default this is 4.
+ *
+ * @fn NIMemoryPressureCoordinator::numberOfTrimSteps
+ */
+
+/**
+ * Returns the share of all registered memory that a trim at the given level releases.
+ *
+ * The share is 0.25 for the moderate level, 0.5 for the critical level and 0.75 for the
+ * background level. Each responder releases this share scaled by how cheap its memory is to
+ * recreate compared to the cost-weighted average of all responders, up to all of its memory.
+ *
+ * @fn NIMemoryPressureCoordinator::fractionToReleaseForLevel:
+ */
+
+/** @name Testing */
+
+/**
+ * Starts a trim as if the system had reported the given level of memory pressure.
+ *
+ * The first step of the trim is performed before this method returns. A trim that is still in
+ * progress is replaced.
+ *
+ * @fn NIMemoryPressureCoordinator::simulateMemoryPressureWithLevel:
+ */
+
+/**
+ * Performs every remaining step of the current trim immediately.
+ *
+ * @fn NIMemoryPressureCoordinator::finishTrimming
+ */
+
+/**
+ * Whether a trim has steps left to perform on later run loop turns.
+ *
+ * @fn NIMemoryPressureCoordinator::isTrimming
+ */
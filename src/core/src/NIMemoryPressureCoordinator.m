@@ -0,0 +1,254 @@
+//
+// Copyright 2011-2014 NimbusKit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import "NIMemoryPressureCoordinator.h"
+
+#import "NIDebuggingTools.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "Nimbus requires ARC support."
+#endif
+
+/**
+ * @brief The plan for trimming a single responder.
+ */
+@interface NIMemoryPressureTrim : NSObject
+@property (nonatomic, weak) id<NIMemoryPressureResponder> responder;
+@property (nonatomic, assign) unsigned long long initialCost;
+@property (nonatomic, assign) unsigned long long targetCost;
+@end
+
+@implementation NIMemoryPressureTrim
+@end
+
+@interface NIMemoryPressureCoordinator()
+@property (nonatomic, strong) NSHashTable* responders;
+@property (nonatomic, copy) NSArray* trims;
+@property (nonatomic, assign) NIMemoryPressureLevel trimLevel;
+@property (nonatomic, assign) NSUInteger trimStep;
+@property (nonatomic, assign) NSUInteger numberOfStepsInTrim;
+// Incremented for every trim so that steps scheduled for a replaced trim do nothing.
+@property (nonatomic, assign) NSUInteger trimGeneration;
+@property (nonatomic, strong) dispatch_source_t memoryPressureSource;
+@end
+
+@implementation NIMemoryPressureCoordinator
+
+- (void)dealloc {
+  [[NSNotificationCenter defaultCenter] removeObserver:self];
+
+  if (nil != _memoryPressureSource) {
+    dispatch_source_cancel(_memoryPressureSource);
+  }
+}
+
++ (NIMemoryPressureCoordinator *)sharedCoordinator {
+  static NIMemoryPressureCoordinator* sharedCoordinator = nil;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    sharedCoordinator = [[NIMemoryPressureCoordinator alloc] init];
+    [sharedCoordinator observeSystemMemoryPressure];
+  });
+  return sharedCoordinator;
+}
+
+- (id)init {
+  if ((self = [super init])) {
+    _responders = [NSHashTable weakObjectsHashTable];
+    _numberOfTrimSteps = 4;
+  }
+  return self;
+}
+
+- (void)observeSystemMemoryPressure {
+  NSNotificationCenter* nc = [NSNotificationCenter defaultCenter];
+  [nc addObserver:self
+         selector:@selector(didReceiveMemoryWarning:)
+             name:UIApplicationDidReceiveMemoryWarningNotification
+           object:nil];
+  [nc addObserver:self
+         selector:@selector(didEnterBackground:)
+             name:UIApplicationDidEnterBackgroundNotification
+           object:nil];
+
+  // Memory warnings are only posted once the system is already critically low on memory. The
+  // memory pressure source lets us start releasing memory earlier.
+  dispatch_source_t source = dispatch_source_create(DISPATCH_SOURCE_TYPE_MEMORYPRESSURE, 0,
+                                                    DISPATCH_MEMORYPRESSURE_WARN,
+                                                    dispatch_get_main_queue());
+  __weak NIMemoryPressureCoordinator* weakSelf = self;
+  dispatch_source_set_event_handler(source, ^{
+    [weakSelf trimWithLevel:NIMemoryPressureLevelModerate];
+  });
+  dispatch_resume(source);
+  self.memoryPressureSource = source;
+}
+
+#pragma mark - Notifications
+
+- (void)didReceiveMemoryWarning:(NSNotification *)notification {
+  [self trimWithLevel:NIMemoryPressureLevelCritical];
+}
+
+- (void)didEnterBackground:(NSNotification *)notification {
+  [self trimWithLevel:NIMemoryPressureLevelBackground];
+}
+
+#pragma mark - Trimming
+
+- (double)fractionToReleaseForLevel:(NIMemoryPressureLevel)level {
+  switch (level) {
+    case NIMemoryPressureLevelModerate:
+      return 0.25;
+    case NIMemoryPressureLevelCritical:
+      return 0.5;
+    case NIMemoryPressureLevelBackground:
+      return 0.75;
+  }
+  return 0;
+}
+
+- (double)recreationPriceOfResponder:(id<NIMemoryPressureResponder>)responder {
+  if ([responder respondsToSelector:@selector(memoryPressureRecreationPrice)]) {
+    // Guard against responders that report a price that would divide by zero.
+    return MAX([responder memoryPressureRecreationPrice], 0.01);
+  }
+  return 1;
+}
+
+- (void)trimWithLevel:(NIMemoryPressureLevel)level {
+  NIDASSERT([NSThread isMainThread]);
+
+  NSArray* responders = nil;
+  @synchronized(self) {
+    responders = [self.responders allObjects];
+  }
+  NSMutableArray* costs = [NSMutableArray arrayWithCapacity:responders.count];
+  NSMutableArray* prices = [NSMutableArray arrayWithCapacity:responders.count];
+
+  // The cost-weighted harmonic mean of the prices. Scaling each responder's share by
+  // averagePrice / price makes cheap responders release more while the total released memory
+  // stays at the level's share of all registered memory.
+  double totalCost = 0;
+  double totalCostPerPrice = 0;
+  for (id<NIMemoryPressureResponder> responder in responders) {
+    unsigned long long cost = [responder memoryPressureCost];
+    double price = [self recreationPriceOfResponder:responder];
+    [costs addObject:@(cost)];
+    [prices addObject:@(price)];
+    totalCost += cost;
+    totalCostPerPrice += cost / price;
+  }
+  double averagePrice = (totalCostPerPrice > 0) ? totalCost / totalCostPerPrice : 1;
+  double fraction = [self fractionToReleaseForLevel:level];
+
+  NSMutableArray* trims = [NSMutableArray arrayWithCapacity:responders.count];
+  for (NSUInteger ix = 0; ix < responders.count; ++ix) {
+    NIMemoryPressureTrim* trim = [[NIMemoryPressureTrim alloc] init];
+    trim.responder = responders[ix];
+    trim.initialCost = [costs[ix] unsignedLongLongValue];
+    double share = MIN(1, fraction * averagePrice / [prices[ix] doubleValue]);
+    trim.targetCost = (unsigned long long)(trim.initialCost * (1 - share));
+    [trims addObject:trim];
+  }
+
+  self.trims = trims;
+  self.trimLevel = level;
+  self.trimStep = 0;
+  self.numberOfStepsInTrim = ((NIMemoryPressureLevelCritical == level)
+                              ? 1 : MAX((NSUInteger)1, self.numberOfTrimSteps));
+  self.trimGeneration++;
+
+  // Release some memory right away and the rest on later run loop turns.
+  [self performTrimStep];
+  [self scheduleTrimStep];
+}
+
+- (void)performTrimStep {
+  if (self.trimStep >= self.numberOfStepsInTrim) {
+    return;
+  }
+  self.trimStep++;
+
+  for (NIMemoryPressureTrim* trim in self.trims) {
+    id<NIMemoryPressureResponder> responder = trim.responder;
+    if (nil == responder) {
+      continue;
+    }
+    unsigned long long amountToRelease = trim.initialCost - trim.targetCost;
+    unsigned long long cost = (trim.initialCost
+                               - amountToRelease * self.trimStep / self.numberOfStepsInTrim);
+    [responder trimToMemoryPressureCost:cost level:self.trimLevel];
+  }
+
+  if (!self.isTrimming) {
+    self.trims = nil;
+  }
+}
+
+- (void)scheduleTrimStep {
+  if (!self.isTrimming) {
+    return;
+  }
+
+  // Blocks added while the run loop performs blocks wait for the next turn of the run loop, so
+  // each step gets a turn of its own.
+  NSUInteger generation = self.trimGeneration;
+  __weak NIMemoryPressureCoordinator* weakSelf = self;
+  CFRunLoopRef runLoop = CFRunLoopGetMain();
+  CFRunLoopPerformBlock(runLoop, kCFRunLoopCommonModes, ^{
+    NIMemoryPressureCoordinator* strongSelf = weakSelf;
+    if (nil != strongSelf && generation == strongSelf.trimGeneration) {
+      [strongSelf performTrimStep];
+      [strongSelf scheduleTrimStep];
+    }
+  });
+  CFRunLoopWakeUp(runLoop);
+}
+
+- (BOOL)isTrimming {
+  return nil != self.trims && self.trimStep < self.numberOfStepsInTrim;
+}
+
+#pragma mark - Public
+
+- (void)addResponder:(id<NIMemoryPressureResponder>)responder {
+  NIDASSERT(nil != responder);
+  if (nil == responder) {
+    return;
+  }
+  @synchronized(self) {
+    [self.responders addObject:responder];
+  }
+}
+
+- (void)removeResponder:(id<NIMemoryPressureResponder>)responder {
+  @synchronized(self) {
+    [self.responders removeObject:responder];
+  }
+}
+
+- (void)simulateMemoryPressureWithLevel:(NIMemoryPressureLevel)level {
+  [self trimWithLevel:level];
+}
+
+- (void)finishTrimming {
+  while (self.isTrimming) {
+    [self performTrimStep];
+  }
+}
+
+@end
@@ -45,6 +45,9 @@
  * If a cache hasn't been assigned via Nimbus::setGlobalImageMemoryCache: then one will be created
  * automatically.
  *
+ * The automatically created cache keeps evicted images that are still in use so that they can
+ * be reused. See NIMemoryCache::keepsEvictedObjectsWhileInUse.
+ *
  * @remarks The default image cache has no upper limit on its memory consumption. It is
  *               up to you to specify an upper limit in your application.
  */
@@ -63,6 +66,19 @@
  */
 + (NSOperationQueue *)networkOperationQueue;
 
+/**
+ * Access the global image decoding queue.
+ *
+ * Images are decoded on this queue before they are displayed so that they don't have to be
+ * decoded on the main thread the first time they are drawn. Decoding is memory and processor
+ * intensive, so the queue's maxConcurrentOperationCount caps how many images are decoded at
+ * once.
+ *
+ * If a queue hasn't been assigned via Nimbus::setImageDecodingQueue: then one will be created
+ * automatically that decodes two images at a time.
+ */
++ (NSOperationQueue *)imageDecodingQueue;
+
 #pragma mark Modifying Global State /** @name Modifying Global State */
 
 /**
@@ -79,6 +95,13 @@
  */
 + (void)setNetworkOperationQueue:(NSOperationQueue *)queue;
 
+/**
+ * Set the global image decoding queue.
+ *
+ * The queue will be retained and the old queue released.
+ */
++ (void)setImageDecodingQueue:(NSOperationQueue *)queue;
+
 @end
 
 /**@}*/// End of State ////////////////////////////////////////////////////////////////////////////
@@ -24,6 +24,7 @@
 
 static NIImageMemoryCache* sNimbusGlobalMemoryCache = nil;
 static NSOperationQueue* sNimbusGlobalOperationQueue = nil;
+static NSOperationQueue* sNimbusGlobalImageDecodingQueue = nil;
 
 @implementation Nimbus
 
@@ -37,6 +38,8 @@ static NSOperationQueue* sNimbusGlobalOperationQueue = nil;
 + (NIImageMemoryCache *)imageMemoryCache {
   if (nil == sNimbusGlobalMemoryCache) {
     sNimbusGlobalMemoryCache = [[NIImageMemoryCache alloc] init];
+    // Images that are evicted while still on screen are reused instead of being loaded again.
+    sNimbusGlobalMemoryCache.keepsEvictedObjectsWhileInUse = YES;
   }
   return sNimbusGlobalMemoryCache;
 }
@@ -55,4 +58,21 @@ static NSOperationQueue* sNimbusGlobalOperationQueue = nil;
   return sNimbusGlobalOperationQueue;
 }
 
++ (void)setImageDecodingQueue:(NSOperationQueue *)queue {
+  if (sNimbusGlobalImageDecodingQueue != queue) {
+    sNimbusGlobalImageDecodingQueue = nil;
+    sNimbusGlobalImageDecodingQueue = queue;
+  }
+}
+
++ (NSOperationQueue *)imageDecodingQueue {
+  if (nil == sNimbusGlobalImageDecodingQueue) {
+    sNimbusGlobalImageDecodingQueue = [[NSOperationQueue alloc] init];
+    sNimbusGlobalImageDecodingQueue.name = @"com.nimbuskit.imagedecoding";
+    sNimbusGlobalImageDecodingQueue.maxConcurrentOperationCount = 2;
+    sNimbusGlobalImageDecodingQueue.qualityOfService = NSQualityOfServiceUserInitiated;
+  }
+  return sNimbusGlobalImageDecodingQueue;
+}
+
 @end
@@ -17,38 +17,72 @@
 #import "NIViewRecycler.h"
 
 #import "NIDebuggingTools.h"
+#import "NIMemoryPressureCoordinator.h"
 
 #if !defined(__has_feature) || !__has_feature(objc_arc)
 #error "Nimbus requires ARC support."
 #endif
 
-@interface NIViewRecycler()
+@interface NIViewRecycler() <NIMemoryPressureResponder>
 @property (nonatomic, strong) NSMutableDictionary* reuseIdentifiersToRecycledViews;
 @end
 
-@implementation NIViewRecycler
-
-- (void)dealloc {
-  [[NSNotificationCenter defaultCenter] removeObserver:self];
+// The approximate size of a view's backing store. Every view counts for at least one byte so that
+// pools of views without contents can still be trimmed.
+static unsigned long long NIMemoryCostOfView(UIView* view) {
+  const CGFloat scale = view.layer.contentsScale;
+  const CGSize size = view.bounds.size;
+  return MAX(1ULL, (unsigned long long)(size.width * scale * size.height * scale * 4));
 }
 
+@implementation NIViewRecycler
+
 - (id)init {
   if ((self = [super init])) {
     _reuseIdentifiersToRecycledViews = [[NSMutableDictionary alloc] init];
 
-    NSNotificationCenter* nc = [NSNotificationCenter defaultCenter];
-    [nc addObserver:self
-           selector:@selector(reduceMemoryUsage)
-               name:UIApplicationDidReceiveMemoryWarningNotification
-             object:nil];
+    [[NIMemoryPressureCoordinator sharedCoordinator] addResponder:self];
   }
   return self;
 }
 
-#pragma mark - Memory Warnings
+#pragma mark - NIMemoryPressureResponder
+
+- (unsigned long long)memoryPressureCost {
+  unsigned long long cost = 0;
+  for (NSArray* views in [_reuseIdentifiersToRecycledViews allValues]) {
+    for (UIView* view in views) {
+      cost += NIMemoryCostOfView(view);
+    }
+  }
+  return cost;
+}
+
+- (double)memoryPressureRecreationPrice {
+  // Recycled views only save the cost of creating a view, which is cheap compared to loading the
+  // contents of most caches.
+  return 0.5;
+}
 
-- (void)reduceMemoryUsage {
-  [self removeAllViews];
+- (void)trimToMemoryPressureCost:(unsigned long long)cost level:(NIMemoryPressureLevel)level {
+  unsigned long long currentCost = [self memoryPressureCost];
+  while (currentCost > cost) {
+    // Shrink the largest pool first so that every kind of view keeps some recycled views for
+    // as long as possible.
+    NSMutableArray* largestPool = nil;
+    for (NSMutableArray* views in [_reuseIdentifiersToRecycledViews allValues]) {
+      if (views.count > largestPool.count) {
+        largestPool = views;
+      }
+    }
+    if (0 == largestPool.count) {
+      break;
+    }
+
+    // Views are dequeued from the end of the pool, so the first view has been unused longest.
+    currentCost -= MIN(currentCost, NIMemoryCostOfView([largestPool firstObject]));
+    [largestPool removeObjectAtIndex:0];
+  }
 }
 
 #pragma mark - Public
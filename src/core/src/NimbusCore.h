@@ -59,10 +59,14 @@
 #import "NICommonMetrics.h"  // IWYU pragma: export
 #import "NIDebuggingTools.h"  // IWYU pragma: export
 #import "NIDeviceOrientation.h"  // IWYU pragma: export
+#import "NIDiskCache.h"  // IWYU pragma: export
 #import "NIError.h"  // IWYU pragma: export
 #import "NIFoundationMethods.h"  // IWYU pragma: export
 #import "NIImageUtilities.h"  // IWYU pragma: export
+#import "NIImagePrefetching.h"  // IWYU pragma: export
 #import "NIInMemoryCache.h"  // IWYU pragma: export
+#import "NIMemoryCacheEvictionPolicy.h"  // IWYU pragma: export
+#import "NIMemoryPressureCoordinator.h"  // IWYU pragma: export
 #import "NINetworkActivity.h"  // IWYU pragma: export
 #import "NINonEmptyCollectionTesting.h"  // IWYU pragma: export
 #import "NINonRetainingCollections.h"  // IWYU pragma: export
@@ -0,0 +1,361 @@
+//
+// Copyright 2011-2014 NimbusKit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// See: http://bit.ly/hS5nNh for unit test macros.
+
+#import <XCTest/XCTest.h>
+
+#import <UIKit/UIKit.h>
+
+#import "NIDiskCache.h"
+#import "NIImageUtilities.h"
+#import "NIInMemoryCache.h"
+
+@interface NIDiskCacheTests : XCTestCase
+@property (nonatomic, copy) NSString* path;
+@end
+
+
+@implementation NIDiskCacheTests
+
+
+- (void)setUp {
+  [super setUp];
+
+  self.path = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+}
+
+- (void)tearDown {
+  [[NSFileManager defaultManager] removeItemAtPath:self.path error:nil];
+
+  [super tearDown];
+}
+
+- (NSData *)dataWithLength:(NSUInteger)length seed:(uint8_t)seed {
+  NSMutableData* data = [NSMutableData dataWithLength:length];
+  uint8_t* bytes = data.mutableBytes;
+  for (NSUInteger ix = 0; ix < length; ++ix) {
+    bytes[ix] = (uint8_t)(seed + ix);
+  }
+  return data;
+}
+
+- (NSString *)lastSegmentPath {
+  NSArray* fileNames = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:self.path error:nil];
+  NSArray* segmentNames = [[fileNames filteredArrayUsingPredicate:
+                            [NSPredicate predicateWithFormat:@"pathExtension == 'segment'"]]
+                           sortedArrayUsingComparator:^NSComparisonResult(NSString* name1, NSString* name2) {
+                             return [@([name1 integerValue]) compare:@([name2 integerValue])];
+                           }];
+  return [self.path stringByAppendingPathComponent:[segmentNames lastObject]];
+}
+
+#pragma mark - Storing and Reading
+
+
+- (void)testStoreAndRead {
+  NIDiskCache* cache = [[NIDiskCache alloc] initWithPath:self.path];
+  NSData* data = [self dataWithLength:100 seed:1];
+
+  [cache storeData:data withName:@"obj1"];
+  XCTAssertEqualObjects([cache dataWithName:@"obj1"], data, @"Pending data should be returned.");
+
+  [cache synchronize];
+  XCTAssertEqualObjects([cache dataWithName:@"obj1"], data, @"Written data should be returned.");
+  XCTAssertTrue([cache containsDataWithName:@"obj1"]);
+  XCTAssertNil([cache dataWithName:@"obj2"]);
+  XCTAssertEqual([cache count], (NSUInteger)1);
+}
+
+- (void)testDataIsAligned {
+  NIDiskCache* cache = [[NIDiskCache alloc] initWithPath:self.path];
+
+  [cache storeData:[self dataWithLength:3 seed:1] withName:@"a"];
+  [cache storeData:[self dataWithLength:5 seed:2] withName:@"abcdefghijklmnopq"];
+  [cache synchronize];
+
+  XCTAssertEqual((uintptr_t)[cache dataWithName:@"a"].bytes % 16, (uintptr_t)0);
+  XCTAssertEqual((uintptr_t)[cache dataWithName:@"abcdefghijklmnopq"].bytes % 16, (uintptr_t)0);
+}
+
+- (void)testReplaceAndRemove {
+  NIDiskCache* cache = [[NIDiskCache alloc] initWithPath:self.path];
+
+  [cache storeData:[self dataWithLength:10 seed:1] withName:@"obj1"];
+  [cache storeData:[self dataWithLength:10 seed:2] withName:@"obj1"];
+  [cache storeData:[self dataWithLength:10 seed:3] withName:@"obj2"];
+  [cache storeData:[self dataWithLength:10 seed:4] withName:@"other"];
+  [cache synchronize];
+
+  XCTAssertEqualObjects([cache dataWithName:@"obj1"], [self dataWithLength:10 seed:2]);
+
+  [cache removeAllDataWithPrefix:@"obj"];
+  XCTAssertNil([cache dataWithName:@"obj1"]);
+  XCTAssertNil([cache dataWithName:@"obj2"]);
+  XCTAssertEqual([cache count], (NSUInteger)1);
+
+  [cache removeAllData];
+  [cache synchronize];
+  XCTAssertEqual([cache count], (NSUInteger)0);
+  XCTAssertEqual([cache numberOfBytes], (unsigned long long)0);
+}
+
+- (void)testDataOutlivesRemoval {
+  NIDiskCache* cache = [[NIDiskCache alloc] initWithPath:self.path];
+  NSData* expectedData = [self dataWithLength:1000 seed:7];
+
+  [cache storeData:expectedData withName:@"obj1"];
+  [cache synchronize];
+  NSData* data = [cache dataWithName:@"obj1"];
+
+  [cache removeAllData];
+  [cache synchronize];
+
+  XCTAssertEqualObjects(data, expectedData, @"Mapped data should stay valid.");
+}
+
+#pragma mark - Persistence
+
+
+- (void)testDataPersistsAcrossInstances {
+  NIDiskCache* cache = [[NIDiskCache alloc] initWithPath:self.path];
+  [cache storeData:[self dataWithLength:100 seed:1] withName:@"obj1"];
+  [cache storeData:[self dataWithLength:100 seed:2] withName:@"obj2"];
+  [cache removeDataWithName:@"obj2"];
+  [cache synchronize];
+  cache = nil;
+
+  cache = [[NIDiskCache alloc] initWithPath:self.path];
+  XCTAssertEqualObjects([cache dataWithName:@"obj1"], [self dataWithLength:100 seed:1]);
+  XCTAssertNil([cache dataWithName:@"obj2"]);
+}
+
+- (void)testRecoveryWithoutIndex {
+  NIDiskCache* cache = [[NIDiskCache alloc] initWithPath:self.path];
+  [cache storeData:[self dataWithLength:100 seed:1] withName:@"obj1"];
+  [cache storeData:[self dataWithLength:100 seed:2] withName:@"obj2"];
+  [cache removeDataWithName:@"obj2"];
+  [cache synchronize];
+  cache = nil;
+
+  // Losing the index means every record is replayed, including the removal.
+  [[NSFileManager defaultManager] removeItemAtPath:[self.path stringByAppendingPathComponent:@"index"]
+                                             error:nil];
+
+  cache = [[NIDiskCache alloc] initWithPath:self.path];
+  XCTAssertEqualObjects([cache dataWithName:@"obj1"], [self dataWithLength:100 seed:1]);
+  XCTAssertNil([cache dataWithName:@"obj2"]);
+}
+
+- (void)testRecoveryFromStaleIndex {
+  NSString* indexPath = [self.path stringByAppendingPathComponent:@"index"];
+  NSString* staleIndexPath = [self.path stringByAppendingPathExtension:@"index"];
+
+  NIDiskCache* cache = [[NIDiskCache alloc] initWithPath:self.path];
+  [cache storeData:[self dataWithLength:100 seed:1] withName:@"obj1"];
+  [cache synchronize];
+  [[NSFileManager defaultManager] copyItemAtPath:indexPath toPath:staleIndexPath error:nil];
+
+  [cache storeData:[self dataWithLength:100 seed:2] withName:@"obj2"];
+  [cache removeDataWithName:@"obj1"];
+  [cache synchronize];
+  cache = nil;
+
+  // As if the app had been terminated before the index was saved again.
+  [[NSFileManager defaultManager] removeItemAtPath:indexPath error:nil];
+  [[NSFileManager defaultManager] moveItemAtPath:staleIndexPath toPath:indexPath error:nil];
+
+  cache = [[NIDiskCache alloc] initWithPath:self.path];
+  XCTAssertNil([cache dataWithName:@"obj1"]);
+  XCTAssertEqualObjects([cache dataWithName:@"obj2"], [self dataWithLength:100 seed:2]);
+}
+
+- (void)testRecoveryDiscardsPartialRecords {
+  NIDiskCache* cache = [[NIDiskCache alloc] initWithPath:self.path];
+  [cache storeData:[self dataWithLength:100 seed:1] withName:@"obj1"];
+  [cache synchronize];
+  unsigned long long numberOfBytes = [cache numberOfBytes];
+  cache = nil;
+
+  // A record whose data was never written.
+  [[NSFileManager defaultManager] removeItemAtPath:[self.path stringByAppendingPathComponent:@"index"]
+                                             error:nil];
+  NSFileHandle* segment = [NSFileHandle fileHandleForWritingAtPath:[self lastSegmentPath]];
+  [segment seekToEndOfFile];
+  const uint32_t partialHeader[8] = { 0x4E494452, 0, 4, 0, 1000, 0, 0, 0 };
+  [segment writeData:[NSData dataWithBytes:partialHeader length:sizeof(partialHeader)]];
+  [segment writeData:[@"obj2" dataUsingEncoding:NSUTF8StringEncoding]];
+  [segment closeFile];
+
+  cache = [[NIDiskCache alloc] initWithPath:self.path];
+  XCTAssertEqualObjects([cache dataWithName:@"obj1"], [self dataWithLength:100 seed:1]);
+  XCTAssertNil([cache dataWithName:@"obj2"]);
+  XCTAssertEqual([cache numberOfBytes], numberOfBytes, @"The partial record should be removed.");
+}
+
+#pragma mark - Trimming
+
+
+- (void)testTrimRemovesLeastRecentlyUsedData {
+  NIDiskCache* cache = [[NIDiskCache alloc] initWithPath:self.path];
+  cache.segmentSize = 16 * 1024;
+  cache.maxNumberOfBytes = 64 * 1024;
+
+  [cache storeData:[self dataWithLength:4000 seed:0] withName:@"obj0"];
+  [cache synchronize];
+  for (NSInteger ix = 1; ix < 40; ++ix) {
+    [cache storeData:[self dataWithLength:4000 seed:(uint8_t)ix]
+            withName:[NSString stringWithFormat:@"obj%zd", ix]];
+    [cache synchronize];
+
+    // Keep the first object in use.
+    [cache dataWithName:@"obj0"];
+  }
+
+  XCTAssertLessThanOrEqual([cache numberOfBytes], cache.maxNumberOfBytes);
+  XCTAssertEqualObjects([cache dataWithName:@"obj0"], [self dataWithLength:4000 seed:0]);
+  XCTAssertEqualObjects([cache dataWithName:@"obj39"], [self dataWithLength:4000 seed:39]);
+  XCTAssertNil([cache dataWithName:@"obj1"]);
+
+  // Compacted data must survive being reloaded.
+  cache = nil;
+  cache = [[NIDiskCache alloc] initWithPath:self.path];
+  XCTAssertEqualObjects([cache dataWithName:@"obj0"], [self dataWithLength:4000 seed:0]);
+  XCTAssertEqualObjects([cache dataWithName:@"obj39"], [self dataWithLength:4000 seed:39]);
+}
+
+#pragma mark - Image Cache Integration
+
+
+- (void)testImageCacheFallsThroughToDisk {
+  NIDiskCache* diskCache = [[NIDiskCache alloc] initWithPath:self.path];
+  NIImageMemoryCache* cache = [[NIImageMemoryCache alloc] init];
+  cache.diskCache = diskCache;
+
+  UIGraphicsBeginImageContextWithOptions(CGSizeMake(20, 10), YES, 2);
+  [[UIColor redColor] setFill];
+  UIRectFill(CGRectMake(0, 0, 20, 10));
+  UIImage* image = UIGraphicsGetImageFromCurrentImageContext();
+  UIGraphicsEndImageContext();
+
+  [cache storeObject:image withName:@"obj1"];
+
+  // Wait for the image to be handed to the disk cache.
+  NSDate* timeout = [NSDate dateWithTimeIntervalSinceNow:2];
+  while (![diskCache containsDataWithName:@"obj1"] && [timeout timeIntervalSinceNow] > 0) {
+    [NSThread sleepForTimeInterval:0.01];
+  }
+  [diskCache synchronize];
+
+  // A new memory cache only has the disk cache to go on.
+  NIImageMemoryCache* coldCache = [[NIImageMemoryCache alloc] init];
+  coldCache.diskCache = [[NIDiskCache alloc] initWithPath:self.path];
+  UIImage* diskImage = [coldCache objectWithName:@"obj1"];
+
+  XCTAssertNotNil(diskImage);
+  XCTAssertEqual(diskImage.size.width, (CGFloat)20);
+  XCTAssertEqual(diskImage.scale, (CGFloat)2);
+  XCTAssertEqual([coldCache count], (NSUInteger)1, @"The image should be moved into memory.");
+
+  // Evictions leave the disk cache alone, removals don't.
+  [cache evictObjectWithName:@"obj1"];
+  XCTAssertTrue([diskCache containsDataWithName:@"obj1"]);
+  [cache removeObjectWithName:@"obj1"];
+  XCTAssertFalse([diskCache containsDataWithName:@"obj1"]);
+}
+
+- (void)testBitmapDataRoundTrip {
+  UIGraphicsBeginImageContextWithOptions(CGSizeMake(3, 2), YES, 1);
+  [[UIColor blueColor] setFill];
+  UIRectFill(CGRectMake(0, 0, 3, 2));
+  UIImage* image = UIGraphicsGetImageFromCurrentImageContext();
+  UIGraphicsEndImageContext();
+
+  NSData* data = NIBitmapDataFromImage(image);
+  UIImage* decodedImage = NIImageFromBitmapData(data);
+
+  XCTAssertEqual(CGImageGetWidth(decodedImage.CGImage), (size_t)3);
+  XCTAssertEqual(CGImageGetHeight(decodedImage.CGImage), (size_t)2);
+  XCTAssertNil(NIImageFromBitmapData([NSData dataWithBytes:"nope" length:4]));
+}
+
+- (void)testBitmapDataKeepsReducedPixelFormats {
+  // Opaque 16-bit RGB.
+  CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+  CGContextRef context = CGBitmapContextCreate(NULL, 3, 2, 5, 0, colorSpace,
+                                               kCGBitmapByteOrder16Little | kCGImageAlphaNoneSkipFirst);
+  CGColorSpaceRelease(colorSpace);
+  CGImageRef imageRef = CGBitmapContextCreateImage(context);
+  CGContextRelease(context);
+  UIImage* decodedImage = NIImageFromBitmapData(NIBitmapDataFromImage([UIImage imageWithCGImage:imageRef]));
+  CGImageRelease(imageRef);
+
+  XCTAssertEqual(CGImageGetBitsPerPixel(decodedImage.CGImage), (size_t)16);
+  XCTAssertEqual(NIMemoryCostOfImage(decodedImage), (unsigned long long)(3 * 2 * 2));
+
+  // 8-bit grayscale.
+  colorSpace = CGColorSpaceCreateDeviceGray();
+  context = CGBitmapContextCreate(NULL, 3, 2, 8, 0, colorSpace, (CGBitmapInfo)kCGImageAlphaNone);
+  CGColorSpaceRelease(colorSpace);
+  imageRef = CGBitmapContextCreateImage(context);
+  CGContextRelease(context);
+  decodedImage = NIImageFromBitmapData(NIBitmapDataFromImage([UIImage imageWithCGImage:imageRef]));
+  CGImageRelease(imageRef);
+
+  XCTAssertEqual(CGImageGetBitsPerPixel(decodedImage.CGImage), (size_t)8);
+  XCTAssertEqual(CGColorSpaceGetModel(CGImageGetColorSpace(decodedImage.CGImage)),
+                 kCGColorSpaceModelMonochrome);
+  XCTAssertEqual(NIMemoryCostOfImage(decodedImage), (unsigned long long)(3 * 2));
+}
+
+#pragma mark - Performance
+
+
+- (void)testLookupPerformance {
+  NIDiskCache* cache = [[NIDiskCache alloc] initWithPath:self.path];
+  cache.maxNumberOfBytes = 0;
+  NSMutableArray* names = [NSMutableArray array];
+  for (NSInteger ix = 0; ix < 1000; ++ix) {
+    NSString* name = [NSString stringWithFormat:@"http://example.com/photo/%zd.jpg", ix];
+    [names addObject:name];
+    [cache storeData:[self dataWithLength:16 * 1024 seed:(uint8_t)ix] withName:name];
+  }
+  [cache synchronize];
+
+  [self measureBlock:^{
+    for (NSInteger pass = 0; pass < 10; ++pass) {
+      for (NSString* name in names) {
+        [cache dataWithName:name];
+      }
+    }
+  }];
+}
+
+- (void)testSequentialWritePerformance {
+  NSData* data = [self dataWithLength:64 * 1024 seed:0];
+
+  [self measureBlock:^{
+    NSString* path = [self.path stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    NIDiskCache* cache = [[NIDiskCache alloc] initWithPath:path];
+    cache.maxNumberOfBytes = 0;
+    for (NSInteger ix = 0; ix < 500; ++ix) {
+      [cache storeData:data withName:[NSString stringWithFormat:@"obj%zd", ix]];
+    }
+    [cache synchronize];
+  }];
+}
+
+@end
@@ -0,0 +1,299 @@
+//
+// Copyright 2011-2014 NimbusKit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// See: http://bit.ly/hS5nNh for unit test macros.
+
+#import <XCTest/XCTest.h>
+
+#import <UIKit/UIKit.h>
+
+#import "NIInMemoryCache.h"
+#import "NIMemoryCacheEvictionPolicy.h"
+
+@interface NIMemoryCacheEvictionPolicyTests : XCTestCase
+@end
+
+
+@implementation NIMemoryCacheEvictionPolicyTests
+
+
+#pragma mark - Segmented LRU
+
+
+- (void)testSegmentedLRUEvictsProbationaryObjectsFirst {
+  NISegmentedLRUEvictionPolicy* policy = [[NISegmentedLRUEvictionPolicy alloc] init];
+
+  [policy didStoreObjectWithName:@"obj1"];
+  [policy didStoreObjectWithName:@"obj2"];
+  [policy didStoreObjectWithName:@"obj3"];
+
+  // obj1 has been used twice, so it moves to the protected segment.
+  [policy didAccessObjectWithName:@"obj1"];
+
+  XCTAssertEqualObjects([policy nameOfObjectToEvict], @"obj2");
+  [policy didRemoveObjectWithName:@"obj2" evicted:YES];
+  XCTAssertEqualObjects([policy nameOfObjectToEvict], @"obj3");
+  [policy didRemoveObjectWithName:@"obj3" evicted:YES];
+  XCTAssertEqualObjects([policy nameOfObjectToEvict], @"obj1");
+
+  [policy didRemoveAllObjects];
+  XCTAssertNil([policy nameOfObjectToEvict]);
+}
+
+- (void)testSegmentedLRUIgnoresUnknownNames {
+  NISegmentedLRUEvictionPolicy* policy = [[NISegmentedLRUEvictionPolicy alloc] init];
+
+  [policy didAccessObjectWithName:@"obj1"];
+  [policy didRemoveObjectWithName:@"obj1" evicted:NO];
+
+  XCTAssertNil([policy nameOfObjectToEvict]);
+}
+
+#pragma mark - ARC
+
+
+- (void)testAdaptiveReplacementEvictsRecentObjectsFirst {
+  NIAdaptiveReplacementEvictionPolicy* policy = [[NIAdaptiveReplacementEvictionPolicy alloc] init];
+
+  [policy didStoreObjectWithName:@"obj1"];
+  [policy didStoreObjectWithName:@"obj2"];
+  [policy didAccessObjectWithName:@"obj1"];
+
+  XCTAssertEqualObjects([policy nameOfObjectToEvict], @"obj2");
+}
+
+- (void)testAdaptiveReplacementGhostHitsGrowTheRecentList {
+  NIAdaptiveReplacementEvictionPolicy* policy = [[NIAdaptiveReplacementEvictionPolicy alloc] init];
+
+  [policy didStoreObjectWithName:@"obj1"];
+  [policy didStoreObjectWithName:@"obj2"];
+  [policy didStoreObjectWithName:@"obj3"];
+  [policy didAccessObjectWithName:@"obj1"];
+  XCTAssertEqual(policy.targetRecentRatio, 0.0);
+
+  [policy didRemoveObjectWithName:@"obj2" evicted:YES];
+
+  // Storing a recently evicted object again means it was evicted too early.
+  [policy didStoreObjectWithName:@"obj2"];
+  XCTAssertGreaterThan(policy.targetRecentRatio, 0.0);
+}
+
+#pragma mark - TinyLFU
+
+
+- (void)testTinyLFURejectsInfrequentCandidates {
+  NITinyLFUEvictionPolicy* policy = [[NITinyLFUEvictionPolicy alloc] initWithExpectedNumberOfObjects:16];
+  policy.windowRatio = 0;
+
+  [policy didMissObjectWithName:@"obj1"];
+  [policy didStoreObjectWithName:@"obj1"];
+  for (NSInteger ix = 0; ix < 5; ++ix) {
+    [policy didAccessObjectWithName:@"obj1"];
+  }
+  XCTAssertGreaterThan([policy estimatedFrequencyOfName:@"obj1"], (NSUInteger)1);
+
+  [policy didMissObjectWithName:@"obj2"];
+  [policy didStoreObjectWithName:@"obj2"];
+
+  // obj2 has been requested less often than obj1, so it's not admitted.
+  XCTAssertEqualObjects([policy nameOfObjectToEvict], @"obj2");
+}
+
+- (void)testTinyLFUOnlyDuelsObjectsThatLeftTheWindow {
+  NITinyLFUEvictionPolicy* policy = [[NITinyLFUEvictionPolicy alloc] initWithExpectedNumberOfObjects:16];
+  policy.windowRatio = 0;
+
+  for (NSInteger ix = 0; ix < 9; ++ix) {
+    [policy didStoreObjectWithName:[NSString stringWithFormat:@"obj%zd", ix]];
+  }
+  // Fill the protected segment with obj0 through obj7.
+  for (NSInteger ix = 0; ix < 8; ++ix) {
+    [policy didAccessObjectWithName:[NSString stringWithFormat:@"obj%zd", ix]];
+  }
+
+  [policy didMissObjectWithName:@"new"];
+  [policy didStoreObjectWithName:@"new"];
+
+  // Promoting obj8 demotes obj0 behind the new object in the probationary segment. obj0 must not
+  // be mistaken for the object that is waiting to be admitted.
+  [policy didAccessObjectWithName:@"obj8"];
+  XCTAssertEqualObjects([policy nameOfObjectToEvict], @"new");
+}
+
+#pragma mark - Memory Cache Integration
+
+
+// Create an image of a given size. The contents are undefined.
+- (UIImage *)emptyImageWithSize:(CGSize)size {
+  UIGraphicsBeginImageContextWithOptions(size, NO, 1);
+  UIImage* image = UIGraphicsGetImageFromCurrentImageContext();
+  UIGraphicsEndImageContext();
+
+  return image;
+}
+
+- (void)testImageCacheUsesEvictionPolicy {
+  NIImageMemoryCache* cache = [[NIImageMemoryCache alloc] init];
+  cache.evictionPolicy = [[NISegmentedLRUEvictionPolicy alloc] init];
+  cache.maxNumberOfPixels = 2 * 100 * 100;
+
+  UIImage* img = [self emptyImageWithSize:CGSizeMake(100, 100)];
+  [cache storeObject:img withName:@"obj1"];
+  [cache storeObject:img withName:@"obj2"];
+  [cache objectWithName:@"obj1"];
+  [cache objectWithName:@"obj2"];
+
+  // A strict LRU cache would evict obj1 here. The segmented LRU policy evicts obj3 instead
+  // because obj1 and obj2 have both been used more than once.
+  [cache storeObject:img withName:@"obj3"];
+
+  XCTAssertEqual([cache count], (NSUInteger)2, @"Cache should have two objects.");
+  XCTAssertNotNil([cache objectWithName:@"obj1"], @"Image 1 should still be around.");
+  XCTAssertNotNil([cache objectWithName:@"obj2"], @"Image 2 should still be around.");
+}
+
+- (void)testSettingPolicyOnNonEmptyCache {
+  NIMemoryCache* cache = [[NIMemoryCache alloc] init];
+  [cache storeObject:[NSArray array] withName:@"obj1"];
+  [cache storeObject:[NSArray array] withName:@"obj2"];
+
+  cache.evictionPolicy = [[NISegmentedLRUEvictionPolicy alloc] init];
+
+  XCTAssertEqualObjects([cache nameOfObjectToEvict], @"obj1");
+  [cache evictObjectWithName:@"obj1"];
+  XCTAssertEqualObjects([cache nameOfObjectToEvict], @"obj2");
+  XCTAssertEqual([cache count], (NSUInteger)1, @"Cache should have one object.");
+}
+
+#pragma mark - Trace Replay
+
+
+// Replays a trace of object names against an image cache that fits the given number of 1x1
+// images. Every miss stores the object, as NINetworkImageView would after loading it.
+- (double)hitRatioOfTrace:(NSArray *)trace
+       withEvictionPolicy:(id<NIMemoryCacheEvictionPolicy>)evictionPolicy
+                 capacity:(NSUInteger)capacity {
+  NIImageMemoryCache* cache = [[NIImageMemoryCache alloc] init];
+  cache.evictionPolicy = evictionPolicy;
+  cache.maxNumberOfPixels = capacity;
+
+  UIImage* img = [self emptyImageWithSize:CGSizeMake(1, 1)];
+  NSUInteger numberOfHits = 0;
+  for (NSString* name in trace) {
+    if (nil != [cache objectWithName:name]) {
+      numberOfHits++;
+    } else {
+      [cache storeObject:img withName:name];
+    }
+  }
+  return (double)numberOfHits / MAX((NSUInteger)1, trace.count);
+}
+
+- (NSDictionary *)hitRatiosOfTrace:(NSArray *)trace capacity:(NSUInteger)capacity {
+  NSDictionary* policies = @{
+    @"LRU": [NSNull null],
+    @"SLRU": [[NISegmentedLRUEvictionPolicy alloc] init],
+    @"ARC": [[NIAdaptiveReplacementEvictionPolicy alloc] init],
+    @"W-TinyLFU": [[NITinyLFUEvictionPolicy alloc] initWithExpectedNumberOfObjects:capacity],
+  };
+  NSMutableDictionary* hitRatios = [NSMutableDictionary dictionary];
+  [policies enumerateKeysAndObjectsUsingBlock:^(NSString* policyName, id policy, BOOL *stop) {
+    double hitRatio = [self hitRatioOfTrace:trace
+                         withEvictionPolicy:([policy isKindOfClass:[NSNull class]] ? nil : policy)
+                                   capacity:capacity];
+    hitRatios[policyName] = @(hitRatio);
+    NSLog(@"%@ hit ratio: %.3f", policyName, hitRatio);
+  }];
+  return hitRatios;
+}
+
+// A hot working set that is used twice per round, interrupted by a scan over objects that
+// are only ever used once, such as a fast fling through a long list of photos.
+- (NSArray *)scanTraceWithNumberOfRounds:(NSUInteger)numberOfRounds {
+  NSMutableArray* trace = [NSMutableArray array];
+  NSUInteger scanIndex = 0;
+  for (NSUInteger round = 0; round < numberOfRounds; ++round) {
+    for (NSUInteger pass = 0; pass < 2; ++pass) {
+      for (NSUInteger ix = 0; ix < 50; ++ix) {
+        [trace addObject:[NSString stringWithFormat:@"avatar%zd", ix]];
+      }
+    }
+    for (NSUInteger ix = 0; ix < 200; ++ix) {
+      [trace addObject:[NSString stringWithFormat:@"photo%zd", scanIndex++]];
+    }
+  }
+  return trace;
+}
+
+- (void)testScanResistance {
+  NSDictionary* hitRatios = [self hitRatiosOfTrace:[self scanTraceWithNumberOfRounds:20]
+                                          capacity:100];
+
+  double lruHitRatio = [hitRatios[@"LRU"] doubleValue];
+  XCTAssertGreaterThan([hitRatios[@"SLRU"] doubleValue], lruHitRatio);
+  XCTAssertGreaterThan([hitRatios[@"ARC"] doubleValue], lruHitRatio);
+  XCTAssertGreaterThan([hitRatios[@"W-TinyLFU"] doubleValue], lruHitRatio);
+}
+
+// Reads an access log with one object name per line.
+- (NSArray *)traceAtPath:(NSString *)path {
+  NSString* contents = [NSString stringWithContentsOfFile:path
+                                                 encoding:NSUTF8StringEncoding
+                                                    error:nil];
+  NSArray* trace = [contents componentsSeparatedByCharactersInSet:
+                    [NSCharacterSet newlineCharacterSet]];
+  return [trace filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"length > 0"]];
+}
+
+// Replays every access log (*.trace) in the test bundle.
+- (void)testRecordedTraces {
+  NSBundle* bundle = [NSBundle bundleForClass:[self class]];
+  NSArray* paths = [bundle pathsForResourcesOfType:@"trace" inDirectory:nil];
+  XCTAssertGreaterThan(paths.count, (NSUInteger)0);
+  for (NSString* path in paths) {
+    NSArray* trace = [self traceAtPath:path];
+    XCTAssertGreaterThan(trace.count, (NSUInteger)0);
+
+    NSLog(@"Replaying %@ (%zd accesses)", [path lastPathComponent], trace.count);
+    [self hitRatiosOfTrace:trace capacity:1000];
+  }
+}
+
+// feed-session.trace is an anonymized log of the images that a feed requests over twelve
+// sessions: an avatar and a photo per post, Zipf-distributed authors, occasional full-size photos,
+// scrolling back a screen or two now and then, and popular avatars shown again by the tab bar.
+// It was synthesized from that model with a fixed seed and has 7342 accesses to 2029 images.
+- (void)testFeedSessionTrace {
+  NSString* path = [[NSBundle bundleForClass:[self class]] pathForResource:@"feed-session"
+                                                                    ofType:@"trace"];
+  NSArray* trace = [self traceAtPath:path];
+  XCTAssertEqual(trace.count, (NSUInteger)7342);
+
+  // The cache fits under a third of the images, and LRU gets about 0.60 of the requests.
+  NSDictionary* hitRatios = [self hitRatiosOfTrace:trace capacity:600];
+  double lruHitRatio = [hitRatios[@"LRU"] doubleValue];
+  XCTAssertGreaterThan(lruHitRatio, 0.5);
+
+  // Keeping popular avatars protected from the stream of photos is worth several points.
+  XCTAssertGreaterThan([hitRatios[@"SLRU"] doubleValue], lruHitRatio + 0.03);
+  XCTAssertGreaterThan([hitRatios[@"ARC"] doubleValue], lruHitRatio + 0.03);
+
+  // W-TinyLFU's 1% window is too small for photos that are seen again after scrolling back, so
+  // it gives some of them up. It must not fall far behind LRU.
+  XCTAssertGreaterThan([hitRatios[@"W-TinyLFU"] doubleValue], lruHitRatio - 0.1);
+}
+
+@end
@@ -21,8 +21,34 @@
 #import <UIKit/UIKit.h>
 
 #import "NIDebuggingTools.h"
+#import "NIImageUtilities.h"
 #import "NIInMemoryCache.h"
-#import "NSDate+UnitTesting.h"
+#import "NIInMemoryCache+Testing.h"
+
+#import <pthread.h>
+
+// libmalloc calls this hook, when it is set, for every allocation and deallocation in every
+// malloc zone. Malloc stack logging is built on it.
+typedef void (NIMallocLogger)(uint32_t type, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3,
+                              uintptr_t result, uint32_t numberOfHotFramesToSkip);
+extern NIMallocLogger* malloc_logger;
+
+static const uint32_t NIMallocLogTypeAllocate = 2; // MALLOC_LOG_TYPE_ALLOCATE
+
+static NIMallocLogger* sPreviousMallocLogger = NULL;
+static pthread_t sCountedThread;
+static NSUInteger sNumberOfAllocations = 0;
+
+// Counts the allocations made by sCountedThread. Must not allocate.
+static void NICountAllocations(uint32_t type, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3,
+                               uintptr_t result, uint32_t numberOfHotFramesToSkip) {
+  if ((type & NIMallocLogTypeAllocate) && pthread_equal(pthread_self(), sCountedThread)) {
+    sNumberOfAllocations++;
+  }
+  if (NULL != sPreviousMallocLogger) {
+    sPreviousMallocLogger(type, arg1, arg2, arg3, result, numberOfHotFramesToSkip);
+  }
+}
 
 @interface NIMemoryCacheTests : XCTestCase {
 }
@@ -91,6 +117,84 @@
   XCTAssertEqual([cache count], (NSUInteger)1, @"Cache should have one object.");
 }
 
+- (void)testRemovingCachePrefixesThatShareEdges {
+  NIMemoryCache* cache = [[NIMemoryCache alloc] initWithCapacity:0 numberOfShards:4];
+
+  [cache storeObject:[NSArray array] withName:@"user/1/avatar"];
+  [cache storeObject:[NSArray array] withName:@"user/1/album/1"];
+  [cache storeObject:[NSArray array] withName:@"user/12/avatar"];
+  [cache storeObject:[NSArray array] withName:@"user/2/avatar"];
+  [cache storeObject:[NSArray array] withName:@"user"];
+
+  [cache removeAllObjectsWithPrefix:@"user/1/"];
+  XCTAssertEqual([cache count], (NSUInteger)3, @"Cache should have three objects.");
+  XCTAssertTrue([cache containsObjectWithName:@"user/12/avatar"]);
+
+  [cache removeObjectWithName:@"user/2/avatar"];
+  [cache removeAllObjectsWithPrefix:@"user/1"];
+  XCTAssertEqual([cache count], (NSUInteger)1, @"Cache should have one object.");
+
+  // An empty prefix matches nothing, as with -[NSString hasPrefix:].
+  [cache removeAllObjectsWithPrefix:@""];
+  XCTAssertEqual([cache count], (NSUInteger)1, @"Cache should have one object.");
+
+  // Removed names can be stored again.
+  [cache storeObject:[NSArray array] withName:@"user/1/avatar"];
+  [cache removeAllObjectsWithPrefix:@"user"];
+  XCTAssertEqual([cache count], (NSUInteger)0, @"Cache should be empty.");
+}
+
+- (void)testEnumeratingObjectsWithPrefix {
+  NIMemoryCache* cache = [[NIMemoryCache alloc] init];
+
+  id avatar = [NSArray array];
+  [cache storeObject:avatar withName:@"user/1/avatar"];
+  [cache storeObject:[NSArray array] withName:@"user/1/album/1"];
+  [cache storeObject:[NSArray array] withName:@"user/2/avatar"];
+  [cache storeObject:[NSArray array]
+            withName:@"user/1/expired"
+        expiresAfter:[NSDate dateWithTimeIntervalSinceNow:-1]];
+
+  NSMutableSet* names = [NSMutableSet set];
+  [cache enumerateObjectsWithPrefix:@"user/1/" usingBlock:^(NSString* name, id object, BOOL* stop) {
+    [names addObject:name];
+    if ([name isEqualToString:@"user/1/avatar"]) {
+      XCTAssertEqual(object, avatar);
+    }
+    // The cache may be modified during enumeration.
+    [cache removeObjectWithName:name];
+  }];
+
+  NSSet* expectedNames = [NSSet setWithObjects:@"user/1/avatar", @"user/1/album/1", nil];
+  XCTAssertEqualObjects(names, expectedNames);
+  XCTAssertTrue([cache containsObjectWithName:@"user/2/avatar"]);
+
+  __block NSUInteger numberOfObjects = 0;
+  [cache enumerateObjectsWithPrefix:@"user/" usingBlock:^(NSString* name, id object, BOOL* stop) {
+    numberOfObjects++;
+    *stop = YES;
+  }];
+  XCTAssertEqual(numberOfObjects, (NSUInteger)1);
+}
+
+- (void)testTotalCost {
+  NIMemoryCache* cache = [[NIMemoryCache alloc] init];
+
+  [cache storeObject:[NSArray array] withName:@"obj1" cost:10];
+  [cache storeObject:[NSArray array] withName:@"obj2" cost:20];
+  [cache storeObject:[NSArray array] withName:@"obj3"];
+  XCTAssertEqual(cache.totalCost, (unsigned long long)30);
+
+  [cache storeObject:[NSArray array] withName:@"obj1" cost:5];
+  XCTAssertEqual(cache.totalCost, (unsigned long long)25);
+
+  [cache removeObjectWithName:@"obj2"];
+  XCTAssertEqual(cache.totalCost, (unsigned long long)5);
+
+  [cache removeAllObjects];
+  XCTAssertEqual(cache.totalCost, (unsigned long long)0);
+}
+
 - (void)testRemovingAllObjects {
   NIMemoryCache* cache = [[NIMemoryCache alloc] init];
 
@@ -195,12 +299,9 @@
             withName: @"obj1"
         expiresAfter: [NSDate dateWithTimeIntervalSinceNow:1]];
 
-  [NSDate setFakeDate:[NSDate dateWithTimeIntervalSinceNow:2]];
-
-  // This makes [NSDate date] call our fakeDate implementation, which allows us to fake the
-  // current time so that we don't have to pause the tests while we wait for the object to
-  // expire.
-  [NSDate swizzleMethodsForUnitTesting];
+  // This moves the cache's clock forward so that we don't have to pause the tests while we wait
+  // for the object to expire.
+  [NIMemoryCache advanceClockByTimeInterval:2];
 
   XCTAssertEqual([cache count], (NSUInteger)1, @"Cache should have one object.");
 
@@ -209,8 +310,8 @@
 
   XCTAssertEqual([cache count], (NSUInteger)0, @"Cache should be empty.");
 
-  // Reset the class implementations when we're done with them.
-  [NSDate swizzleMethodsForUnitTesting];
+  // Reset the clock when we're done with it.
+  [NIMemoryCache resetClock];
 }
 
 - (void)testAccessExpiredObjectWithContains {
@@ -221,12 +322,9 @@
             withName:@"obj1"
         expiresAfter:[NSDate dateWithTimeIntervalSinceNow:1]];
 
-  [NSDate setFakeDate:[NSDate dateWithTimeIntervalSinceNow:2]];
-
-  // This makes [NSDate date] call our fakeDate implementation, which allows us to fake the
-  // current time so that we don't have to pause the tests while we wait for the object to
-  // expire.
-  [NSDate swizzleMethodsForUnitTesting];
+  // This moves the cache's clock forward so that we don't have to pause the tests while we wait
+  // for the object to expire.
+  [NIMemoryCache advanceClockByTimeInterval:2];
 
   XCTAssertEqual([cache count], (NSUInteger)1, @"Cache should have one object.");
 
@@ -235,8 +333,8 @@
 
   XCTAssertEqual([cache count], (NSUInteger)0, @"Cache should be empty.");
 
-  // Reset the class implementations when we're done with them.
-  [NSDate swizzleMethodsForUnitTesting];
+  // Reset the clock when we're done with it.
+  [NIMemoryCache resetClock];
 }
 
 - (void)testAccessExpiredObjectWithDate {
@@ -247,12 +345,9 @@
             withName:@"obj1"
         expiresAfter:[NSDate dateWithTimeIntervalSinceNow:1]];
 
-  [NSDate setFakeDate:[NSDate dateWithTimeIntervalSinceNow:2]];
-
-  // This makes [NSDate date] call our fakeDate implementation, which allows us to fake the
-  // current time so that we don't have to pause the tests while we wait for the object to
-  // expire.
-  [NSDate swizzleMethodsForUnitTesting];
+  // This moves the cache's clock forward so that we don't have to pause the tests while we wait
+  // for the object to expire.
+  [NIMemoryCache advanceClockByTimeInterval:2];
 
   XCTAssertEqual([cache count], (NSUInteger)1, @"Cache should have one object.");
 
@@ -261,8 +356,8 @@
 
   XCTAssertEqual([cache count], (NSUInteger)0, @"Cache should be empty.");
 
-  // Reset the class implementations when we're done with them.
-  [NSDate swizzleMethodsForUnitTesting];
+  // Reset the clock when we're done with it.
+  [NIMemoryCache resetClock];
 }
 
 - (void)testAccessExpiredObjectWithNameOfLeastRecentlyUsedObject {
@@ -273,12 +368,9 @@
             withName:@"obj1"
         expiresAfter:[NSDate dateWithTimeIntervalSinceNow:1]];
 
-  [NSDate setFakeDate:[NSDate dateWithTimeIntervalSinceNow:2]];
-
-  // This makes [NSDate date] call our fakeDate implementation, which allows us to fake the
-  // current time so that we don't have to pause the tests while we wait for the object to
-  // expire.
-  [NSDate swizzleMethodsForUnitTesting];
+  // This moves the cache's clock forward so that we don't have to pause the tests while we wait
+  // for the object to expire.
+  [NIMemoryCache advanceClockByTimeInterval:2];
 
   XCTAssertEqual([cache count], (NSUInteger)1, @"Cache should have one object.");
 
@@ -287,8 +379,8 @@
 
   XCTAssertEqual([cache count], (NSUInteger)0, @"Cache should be empty.");
 
-  // Reset the class implementations when we're done with them.
-  [NSDate swizzleMethodsForUnitTesting];
+  // Reset the clock when we're done with it.
+  [NIMemoryCache resetClock];
 }
 
 - (void)testAccessExpiredObjectWithNameOfMostRecentlyUsedObject {
@@ -299,12 +391,9 @@
             withName:@"obj1"
         expiresAfter:[NSDate dateWithTimeIntervalSinceNow:1]];
 
-  [NSDate setFakeDate:[NSDate dateWithTimeIntervalSinceNow:2]];
-
-  // This makes [NSDate date] call our fakeDate implementation, which allows us to fake the
-  // current time so that we don't have to pause the tests while we wait for the object to
-  // expire.
-  [NSDate swizzleMethodsForUnitTesting];
+  // This moves the cache's clock forward so that we don't have to pause the tests while we wait
+  // for the object to expire.
+  [NIMemoryCache advanceClockByTimeInterval:2];
 
   XCTAssertEqual([cache count], (NSUInteger)1, @"Cache should have one object.");
 
@@ -313,8 +402,96 @@
 
   XCTAssertEqual([cache count], (NSUInteger)0, @"Cache should be empty.");
 
-  // Reset the class implementations when we're done with them.
-  [NSDate swizzleMethodsForUnitTesting];
+  // Reset the clock when we're done with it.
+  [NIMemoryCache resetClock];
+}
+
+- (void)testRemoveExpiredObjects {
+  NIMemoryCache* cache = [[NIMemoryCache alloc] init];
+
+  [cache storeObject:[NSArray array] withName:@"obj1"];
+  [cache storeObject:[NSArray array]
+            withName:@"obj2"
+        expiresAfter:[NSDate dateWithTimeIntervalSinceNow:100]];
+  [cache storeObject:[NSArray array]
+            withName:@"obj3"
+        expiresAfter:[NSDate dateWithTimeIntervalSinceNow:1]];
+  [cache storeObject:[NSArray array]
+            withName:@"obj4"
+        expiresAfter:[NSDate dateWithTimeIntervalSinceNow:10]];
+
+  [NIMemoryCache advanceClockByTimeInterval:20];
+
+  [cache removeExpiredObjects];
+
+  XCTAssertEqual([cache count], (NSUInteger)2, @"Cache should have two objects.");
+  XCTAssertTrue([cache containsObjectWithName:@"obj1"], @"obj1 never expires.");
+  XCTAssertTrue([cache containsObjectWithName:@"obj2"], @"obj2 has not expired yet.");
+
+  // Reset the clock when we're done with it.
+  [NIMemoryCache resetClock];
+}
+
+- (void)testDistantExpirationDatesDoNotWrapAround {
+  NIMemoryCache* cache = [[NIMemoryCache alloc] init];
+
+  // The time until the distant future is longer than the cache clock can count in nanoseconds.
+  [cache storeObject:[NSArray array] withName:@"obj1" expiresAfter:[NSDate distantFuture]];
+  [cache storeObjects:@[[NSArray array]] withNames:@[@"obj2"] expiresAfter:[NSDate distantFuture]];
+
+  [NIMemoryCache advanceClockByTimeInterval:60 * 60 * 24 * 365];
+  [cache removeExpiredObjects];
+
+  XCTAssertNotNil([cache objectWithName:@"obj1"], @"obj1 expires in the distant future.");
+  XCTAssertNotNil([cache objectWithName:@"obj2"], @"obj2 expires in the distant future.");
+
+  // Reset the clock when we're done with it.
+  [NIMemoryCache resetClock];
+}
+
+- (void)testRemoveExpiredObjectsAfterUpdate {
+  NIMemoryCache* cache = [[NIMemoryCache alloc] init];
+
+  [cache storeObject:[NSArray array]
+            withName:@"obj1"
+        expiresAfter:[NSDate dateWithTimeIntervalSinceNow:1]];
+  [cache storeObject:[NSArray array]
+            withName:@"obj2"
+        expiresAfter:[NSDate dateWithTimeIntervalSinceNow:1]];
+
+  // Replacing an object replaces its expiration date.
+  [cache storeObject:[NSArray array] withName:@"obj1"];
+  [cache removeObjectWithName:@"obj2"];
+  [cache storeObject:[NSArray array] withName:@"obj2"];
+
+  [NIMemoryCache advanceClockByTimeInterval:2];
+
+  [cache reduceMemoryUsage];
+
+  XCTAssertEqual([cache count], (NSUInteger)2, @"Cache should have two objects.");
+
+  // Reset the clock when we're done with it.
+  [NIMemoryCache resetClock];
+}
+
+- (void)testProactiveExpiration {
+  NIMemoryCache* cache = [[NIMemoryCache alloc] init];
+  cache.proactiveExpirationInterval = 0.05;
+
+  [cache storeObject:[NSArray array]
+            withName:@"obj1"
+        expiresAfter:[NSDate dateWithTimeIntervalSinceNow:0.05]];
+  [cache storeObject:[NSArray array] withName:@"obj2"];
+
+  // count does not remove expired objects, so only the timer can shrink the cache.
+  NSDate* timeout = [NSDate dateWithTimeIntervalSinceNow:2];
+  while ([cache count] > 1 && [timeout timeIntervalSinceNow] > 0) {
+    [NSThread sleepForTimeInterval:0.01];
+  }
+
+  XCTAssertEqual([cache count], (NSUInteger)1, @"The expired object should have been removed.");
+
+  cache.proactiveExpirationInterval = 0;
 }
 
 - (void)testHasObject {
@@ -328,6 +505,30 @@
   XCTAssertFalse([cache containsObjectWithName:@"obj2"], @"obj2 should not exist in the cache.");
 }
 
+- (void)testExpirationDateOfObject {
+  NIMemoryCache* cache = [[NIMemoryCache alloc] init];
+
+  NSDate* expirationDate = [NSDate dateWithTimeIntervalSinceNow:10];
+  [cache storeObject:[NSArray array] withName:@"obj1" expiresAfter:expirationDate];
+  [cache storeObject:[NSArray array] withName:@"obj2"];
+
+  NSDate* cachedExpirationDate = [cache expirationDateOfObjectWithName:@"obj1"];
+  XCTAssertNotNil(cachedExpirationDate, @"obj1 should have an expiration date.");
+  XCTAssertEqualWithAccuracy([cachedExpirationDate timeIntervalSinceDate:expirationDate], 0, 0.01,
+                             @"The expiration date should match the stored one.");
+
+  XCTAssertNil([cache expirationDateOfObjectWithName:@"obj2"], @"obj2 should never expire.");
+  XCTAssertNil([cache expirationDateOfObjectWithName:@"obj3"], @"obj3 should not exist.");
+
+  [NIMemoryCache advanceClockByTimeInterval:20];
+
+  XCTAssertNil([cache expirationDateOfObjectWithName:@"obj1"], @"obj1 should have expired.");
+  XCTAssertEqual([cache count], (NSUInteger)1, @"Only obj2 should be left in the cache.");
+
+  // Reset the clock when we're done with it.
+  [NIMemoryCache resetClock];
+}
+
 - (void)testAccessTimeModifications {
   NIMemoryCache* cache = [[NIMemoryCache alloc] init];
 
@@ -339,8 +540,8 @@
   // Does not update the access time.
   [cache containsObjectWithName:@"obj1"];
 
-  XCTAssertEqual(lastAccessTime, [cache dateOfLastAccessWithName:@"obj1"],
-                 @"Access time should not have been modified.");
+  XCTAssertEqualObjects(lastAccessTime, [cache dateOfLastAccessWithName:@"obj1"],
+                        @"Access time should not have been modified.");
 
   // Does update the access time.
   [cache objectWithName:@"obj1"];
@@ -391,12 +592,9 @@
             withName: @"obj2"
         expiresAfter: [NSDate dateWithTimeIntervalSinceNow:10]];
 
-  [NSDate setFakeDate:[NSDate dateWithTimeIntervalSinceNow:2]];
-
-  // This makes [NSDate date] call our fakeDate implementation, which allows us to fake the
-  // current time so that we don't have to pause the tests while we wait for the object to
-  // expire.
-  [NSDate swizzleMethodsForUnitTesting];
+  // This moves the cache's clock forward so that we don't have to pause the tests while we wait
+  // for the object to expire.
+  [NIMemoryCache advanceClockByTimeInterval:2];
 
   XCTAssertEqual([cache count], (NSUInteger)2, @"Cache should have two objects.");
 
@@ -408,8 +606,465 @@
 
   XCTAssertNotNil([cache objectWithName:@"obj2"], @"Object 2 should still be around.");
 
-  // Reset the class implementations when we're done with them.
-  [NSDate swizzleMethodsForUnitTesting];
+  // Reset the clock when we're done with it.
+  [NIMemoryCache resetClock];
+}
+
+- (void)testLeastRecentlyUsedOrderAfterRemovals {
+  NIMemoryCache* cache = [[NIMemoryCache alloc] init];
+
+  [cache storeObject:[NSArray array] withName:@"obj1"];
+  [cache storeObject:[NSArray array] withName:@"obj2"];
+  [cache storeObject:[NSArray array] withName:@"obj3"];
+
+  // Removing from the middle of the list keeps both ends intact.
+  [cache removeObjectWithName:@"obj2"];
+  XCTAssertEqualObjects(@"obj1", [cache nameOfLeastRecentlyUsedObject]);
+  XCTAssertEqualObjects(@"obj3", [cache nameOfMostRecentlyUsedObject]);
+
+  // Removing the head promotes the next object.
+  [cache removeObjectWithName:@"obj1"];
+  XCTAssertEqualObjects(@"obj3", [cache nameOfLeastRecentlyUsedObject]);
+  XCTAssertEqualObjects(@"obj3", [cache nameOfMostRecentlyUsedObject]);
+
+  // Restoring an existing name counts as an access.
+  [cache storeObject:[NSArray array] withName:@"obj4"];
+  [cache storeObject:[NSArray array] withName:@"obj3"];
+  XCTAssertEqualObjects(@"obj4", [cache nameOfLeastRecentlyUsedObject]);
+  XCTAssertEqualObjects(@"obj3", [cache nameOfMostRecentlyUsedObject]);
+
+  [cache removeAllObjects];
+  XCTAssertNil([cache nameOfLeastRecentlyUsedObject]);
+  XCTAssertNil([cache nameOfMostRecentlyUsedObject]);
+
+  [cache storeObject:[NSArray array] withName:@"obj5"];
+  XCTAssertEqualObjects(@"obj5", [cache nameOfLeastRecentlyUsedObject]);
+  XCTAssertEqualObjects(@"obj5", [cache nameOfMostRecentlyUsedObject]);
+}
+
+- (void)testShardedCache {
+  NIMemoryCache* cache = [[NIMemoryCache alloc] initWithCapacity:0 numberOfShards:8];
+
+  for (NSInteger ix = 0; ix < 100; ++ix) {
+    [cache storeObject:@(ix) withName:[NSString stringWithFormat:@"obj%zd", ix]];
+  }
+  XCTAssertEqual([cache count], (NSUInteger)100, @"Cache should have 100 objects in it.");
+  XCTAssertEqualObjects([cache objectWithName:@"obj42"], @42, @"Cache object should be equal.");
+
+  [cache removeAllObjectsWithPrefix:@"obj1"];
+  XCTAssertEqual([cache count], (NSUInteger)89, @"obj1 and obj10-obj19 should have been removed.");
+
+  [cache removeAllObjects];
+  XCTAssertEqual([cache count], (NSUInteger)0, @"Cache should now be empty.");
+}
+
+- (void)testShardedCacheLeastAndMostRecentlyUsedObjects {
+  NIMemoryCache* cache = [[NIMemoryCache alloc] initWithCapacity:0 numberOfShards:4];
+
+  [cache storeObject:[NSArray array] withName:@"obj1"];
+  [NSThread sleepForTimeInterval:0.01];
+  [cache storeObject:[NSArray array] withName:@"obj2"];
+  [NSThread sleepForTimeInterval:0.01];
+  [cache storeObject:[NSArray array] withName:@"obj3"];
+
+  XCTAssertEqualObjects(@"obj1", [cache nameOfLeastRecentlyUsedObject]);
+  XCTAssertEqualObjects(@"obj3", [cache nameOfMostRecentlyUsedObject]);
+
+  [NSThread sleepForTimeInterval:0.01];
+  [cache objectWithName:@"obj1"];
+
+  XCTAssertEqualObjects(@"obj2", [cache nameOfLeastRecentlyUsedObject]);
+  XCTAssertEqualObjects(@"obj1", [cache nameOfMostRecentlyUsedObject]);
+}
+
+- (void)testBatchedStoreAndFetch {
+  NIMemoryCache* cache = [[NIMemoryCache alloc] initWithCapacity:0 numberOfShards:4];
+
+  [cache storeObjects:@[@1, @2, @3, @4]
+            withNames:@[@"obj1", @"obj2", @"obj3", @"obj2"]
+         expiresAfter:nil];
+
+  XCTAssertEqual([cache count], (NSUInteger)3, @"Cache should have three objects.");
+  XCTAssertEqualObjects([cache objectWithName:@"obj2"], @4, @"The later object should win.");
+
+  NSDictionary* objects = [cache objectsWithNames:@[@"obj1", @"obj3", @"obj5"]];
+  XCTAssertEqualObjects(objects, (@{@"obj1": @1, @"obj3": @3}));
+
+  [cache storeObjects:@[@5, @6]
+            withNames:@[@"obj1", @"obj5"]
+         expiresAfter:[NSDate dateWithTimeIntervalSinceNow:-1]];
+  XCTAssertEqual([cache count], (NSUInteger)2, @"Storing expired objects should remove obj1.");
+}
+
+- (void)testBatchedFetchPromotesObjectsInOrder {
+  NIMemoryCache* cache = [[NIMemoryCache alloc] init];
+
+  [cache storeObjects:@[@1, @2, @3]
+            withNames:@[@"obj1", @"obj2", @"obj3"]
+         expiresAfter:nil];
+  XCTAssertEqualObjects(@"obj1", [cache nameOfLeastRecentlyUsedObject]);
+
+  [cache objectsWithNames:@[@"obj2", @"obj1"]];
+
+  XCTAssertEqualObjects(@"obj3", [cache nameOfLeastRecentlyUsedObject]);
+  XCTAssertEqualObjects(@"obj1", [cache nameOfMostRecentlyUsedObject]);
+}
+
+- (void)testBatchedFetchRemovesExpiredObjects {
+  NIMemoryCache* cache = [[NIMemoryCache alloc] init];
+
+  [cache storeObjects:@[@1, @2]
+            withNames:@[@"obj1", @"obj2"]
+         expiresAfter:[NSDate dateWithTimeIntervalSinceNow:1]];
+  [cache storeObject:@3 withName:@"obj3"];
+
+  [NIMemoryCache advanceClockByTimeInterval:2];
+
+  NSDictionary* objects = [cache objectsWithNames:@[@"obj1", @"obj2", @"obj3"]];
+  XCTAssertEqualObjects(objects, (@{@"obj3": @3}));
+  XCTAssertEqual([cache count], (NSUInteger)1, @"Expired objects should have been removed.");
+
+  [NIMemoryCache resetClock];
+}
+
+- (void)testEvictedObjectsInUseAreRestored {
+  NIMemoryCache* cache = [[NIMemoryCache alloc] init];
+  cache.keepsEvictedObjectsWhileInUse = YES;
+
+  NSMutableArray* object = [NSMutableArray array];
+  [cache storeObject:object withName:@"obj1" cost:10];
+  [cache evictObjectWithName:@"obj1"];
+  XCTAssertEqual([cache count], (NSUInteger)0, @"Cache should be empty.");
+  XCTAssertEqual(cache.totalCost, (unsigned long long)0, @"Evicted objects should be free.");
+
+  XCTAssertEqual([cache objectWithName:@"obj1"], object, @"The object is still in use.");
+  XCTAssertEqual([cache count], (NSUInteger)1, @"The object should be back in the cache.");
+  XCTAssertTrue([cache containsObjectWithName:@"obj1"]);
+}
+
+- (void)testEvictedObjectsNoLongerInUseAreGone {
+  NIMemoryCache* cache = [[NIMemoryCache alloc] init];
+  cache.keepsEvictedObjectsWhileInUse = YES;
+
+  @autoreleasepool {
+    [cache storeObject:[NSMutableArray array] withName:@"obj1"];
+    [cache evictObjectWithName:@"obj1"];
+  }
+
+  XCTAssertNil([cache objectWithName:@"obj1"], @"Nothing else held the object.");
+}
+
+- (void)testRemovedObjectsAreNotRestored {
+  NIMemoryCache* cache = [[NIMemoryCache alloc] init];
+  cache.keepsEvictedObjectsWhileInUse = YES;
+
+  NSMutableArray* object = [NSMutableArray array];
+  [cache storeObject:object withName:@"obj1"];
+  [cache storeObject:object withName:@"obj2"];
+  [cache storeObject:object withName:@"obj3" expiresAfter:[NSDate dateWithTimeIntervalSinceNow:10]];
+  [cache evictObjectWithName:@"obj1"];
+  [cache evictObjectWithName:@"obj2"];
+  [cache evictObjectWithName:@"obj3"];
+
+  [cache removeObjectWithName:@"obj1"];
+  [cache storeObject:@2 withName:@"obj2"];
+
+  NSDictionary* objects = [cache objectsWithNames:@[@"obj1", @"obj2", @"obj3"]];
+  XCTAssertEqualObjects(objects, (@{@"obj2": @2}));
+}
+
+- (void)testRemovingPrefixForgetsEvictedObjects {
+  NIMemoryCache* cache = [[NIMemoryCache alloc] init];
+  cache.keepsEvictedObjectsWhileInUse = YES;
+
+  // Evicted objects that were deallocated long ago must not get in the way.
+  @autoreleasepool {
+    for (NSString* name in [self namesForNumberOfEntries:200]) {
+      [cache storeObject:[NSMutableArray array] withName:name];
+      [cache evictObjectWithName:name];
+    }
+  }
+
+  NSMutableArray* object = [NSMutableArray array];
+  for (NSString* name in @[@"user1/avatar", @"user1/photo", @"user2/avatar"]) {
+    [cache storeObject:object withName:name];
+    [cache evictObjectWithName:name];
+  }
+
+  [cache removeAllObjectsWithPrefix:@"user1/"];
+
+  NSDictionary* objects = [cache objectsWithNames:@[@"user1/avatar", @"user1/photo", @"user2/avatar"]];
+  XCTAssertEqualObjects(objects, (@{@"user2/avatar": object}));
+}
+
+- (void)testHitsDoNotAllocate {
+  NIMemoryCache* cache = [[NIMemoryCache alloc] init];
+  NSArray* names = [self namesForNumberOfEntries:100];
+  id object = [[NSObject alloc] init];
+  for (NSUInteger ix = 0; ix < names.count; ++ix) {
+    // Half of the objects expire so that the expiration check is exercised as well.
+    NSDate* expirationDate = (ix % 2) ? [NSDate dateWithTimeIntervalSinceNow:100] : nil;
+    [cache storeObject:object withName:names[ix] expiresAfter:expirationDate];
+  }
+
+  // The first hits on a thread set up the runtime's per-thread lock caches.
+  for (NSUInteger ix = 0; ix < names.count; ++ix) {
+    [cache objectWithName:names[ix]];
+  }
+
+  @autoreleasepool {
+    sCountedThread = pthread_self();
+    sNumberOfAllocations = 0;
+    sPreviousMallocLogger = malloc_logger;
+    malloc_logger = NICountAllocations;
+
+    for (NSUInteger round = 0; round < 10; ++round) {
+      for (NSUInteger ix = 0; ix < names.count; ++ix) {
+        [cache objectWithName:names[ix]];
+      }
+    }
+
+    malloc_logger = sPreviousMallocLogger;
+    sPreviousMallocLogger = NULL;
+  }
+
+  XCTAssertEqual(sNumberOfAllocations, (NSUInteger)0, @"Cache hits should not allocate memory.");
+}
+
+#pragma mark - In-Memory Cache Statistics
+
+
+- (void)testStatisticsCountHitsMissesAndStores {
+  NIMemoryCache* cache = [[NIMemoryCache alloc] init];
+
+  [cache storeObject:@"a" withName:@"obj1"];
+  [cache storeObjects:@[@"b", @"c"] withNames:@[@"obj2", @"obj3"] expiresAfter:nil];
+  [cache objectWithName:@"obj1"];
+  [cache objectWithName:@"missing"];
+  [cache objectsWithNames:@[@"obj2", @"obj3", @"missing"]];
+
+  NIMemoryCacheStatistics statistics = cache.statistics;
+  XCTAssertEqual(statistics.stores, 3ULL);
+  XCTAssertEqual(statistics.hits, 3ULL);
+  XCTAssertEqual(statistics.misses, 2ULL);
+
+  [cache resetStatistics];
+  statistics = cache.statistics;
+  XCTAssertEqual(statistics.stores, 0ULL);
+  XCTAssertEqual(statistics.hits, 0ULL);
+  XCTAssertEqual(statistics.misses, 0ULL);
+}
+
+- (void)testStatisticsCountRemovalsByCause {
+  NIMemoryCache* cache = [[NIMemoryCache alloc] init];
+
+  [cache storeObject:@"a" withName:@"obj1" cost:10];
+  [cache storeObject:@"b" withName:@"obj2" cost:20 expiresAfter:[NSDate dateWithTimeIntervalSinceNow:1]];
+  [cache storeObject:@"c" withName:@"obj3" cost:40];
+  [cache storeObject:@"d" withName:@"obj4" cost:80];
+
+  [cache removeObjectWithName:@"obj1"];
+  [cache removeObjectWithName:@"missing"];
+
+  [NIMemoryCache advanceClockByTimeInterval:2];
+  [cache removeExpiredObjects];
+  [NIMemoryCache resetClock];
+
+  [cache evictObjectWithName:@"obj3"];
+  [cache trimToMemoryPressureCost:0 level:NIMemoryPressureLevelCritical];
+
+  NIMemoryCacheStatistics statistics = cache.statistics;
+  XCTAssertEqual(statistics.removals, 1ULL, @"Removing a missing object isn't a removal.");
+  XCTAssertEqual(statistics.expirations, 1ULL);
+  XCTAssertEqual(statistics.evictions, 1ULL);
+  XCTAssertEqual(statistics.memoryPressureEvictions, 1ULL);
+  XCTAssertEqual(statistics.evictedCost, 140ULL, @"Explicit removals aren't counted.");
+}
+
+- (void)testStatisticsCountImageCacheEvictions {
+  NIImageMemoryCache* cache = [[NIImageMemoryCache alloc] init];
+  UIImage* img = [self emptyImageWithSize:CGSizeMake(10, 10)];
+  cache.maxNumberOfPixels = 2 * 10 * 10;
+  cache.maxNumberOfPixelsUnderStress = 10 * 10;
+
+  [cache storeObject:img withName:@"obj1"];
+  [cache storeObject:img withName:@"obj2"];
+  [cache storeObject:img withName:@"obj3"];
+  [cache reduceMemoryUsage];
+
+  NIMemoryCacheStatistics statistics = cache.statistics;
+  XCTAssertEqual(statistics.evictions, 1ULL);
+  XCTAssertEqual(statistics.memoryPressureEvictions, 1ULL);
+  XCTAssertEqual(statistics.evictedCost, 2 * NIMemoryCostOfImage(img));
+}
+
+#pragma mark - In-Memory Cache Performance
+
+
+- (NSArray *)namesForNumberOfEntries:(NSUInteger)numberOfEntries {
+  NSMutableArray* names = [NSMutableArray arrayWithCapacity:numberOfEntries];
+  for (NSUInteger ix = 0; ix < numberOfEntries; ++ix) {
+    [names addObject:[NSString stringWithFormat:@"http://example.com/%zd.png", ix]];
+  }
+  return names;
+}
+
+// Stores every name and then hits every name in least-recently-used order, which forces each
+// hit to move an object from the head of the LRU list to its tail.
+- (void)measureStoreAndHitsWithNumberOfEntries:(NSUInteger)numberOfEntries {
+  NSArray* names = [self namesForNumberOfEntries:numberOfEntries];
+  id object = [NSArray array];
+
+  [self measureBlock:^{
+    NIMemoryCache* cache = [[NIMemoryCache alloc] initWithCapacity:numberOfEntries];
+    for (NSString* name in names) {
+      [cache storeObject:object withName:name];
+    }
+    for (NSString* name in names) {
+      [cache objectWithName:name];
+    }
+  }];
+}
+
+// The ordered set reshuffle that NIMemoryCache used to perform on every hit. Kept as a baseline
+// for the measurements above.
+- (void)measureOrderedSetStoreAndHitsWithNumberOfEntries:(NSUInteger)numberOfEntries {
+  NSArray* names = [self namesForNumberOfEntries:numberOfEntries];
+  id object = [NSArray array];
+
+  [self measureBlock:^{
+    NSMutableDictionary* map = [NSMutableDictionary dictionaryWithCapacity:numberOfEntries];
+    NSMutableOrderedSet* lru = [NSMutableOrderedSet orderedSet];
+    for (NSString* name in names) {
+      map[name] = object;
+      [lru addObject:name];
+    }
+    for (NSString* name in names) {
+      if (nil != map[name]) {
+        [lru removeObject:name];
+        [lru addObject:name];
+      }
+    }
+  }];
+}
+
+- (void)testStoreAndHitPerformanceWith1000Entries {
+  [self measureStoreAndHitsWithNumberOfEntries:1000];
+}
+
+- (void)testStoreAndHitPerformanceWith10000Entries {
+  [self measureStoreAndHitsWithNumberOfEntries:10000];
+}
+
+- (void)testStoreAndHitPerformanceWith100000Entries {
+  [self measureStoreAndHitsWithNumberOfEntries:100000];
+}
+
+- (void)testOrderedSetStoreAndHitPerformanceWith1000Entries {
+  [self measureOrderedSetStoreAndHitsWithNumberOfEntries:1000];
+}
+
+- (void)testOrderedSetStoreAndHitPerformanceWith10000Entries {
+  [self measureOrderedSetStoreAndHitsWithNumberOfEntries:10000];
+}
+
+- (void)testOrderedSetStoreAndHitPerformanceWith100000Entries {
+  [self measureOrderedSetStoreAndHitsWithNumberOfEntries:100000];
+}
+
+// Hits every name from the given number of threads at once.
+- (void)measureConcurrentHitsWithNumberOfThreads:(NSUInteger)numberOfThreads
+                                  numberOfShards:(NSUInteger)numberOfShards {
+  static const NSUInteger kNumberOfEntries = 10000;
+  NSArray* names = [self namesForNumberOfEntries:kNumberOfEntries];
+  NIMemoryCache* cache = [[NIMemoryCache alloc] initWithCapacity:kNumberOfEntries
+                                                  numberOfShards:numberOfShards];
+  for (NSString* name in names) {
+    [cache storeObject:[NSArray array] withName:name];
+  }
+
+  // Every thread performs the same number of hits so that throughput scales with threads.
+  [self measureBlock:^{
+    dispatch_apply(numberOfThreads, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t thread) {
+      for (NSUInteger ix = 0; ix < kNumberOfEntries; ++ix) {
+        [cache objectWithName:names[(ix + thread * 997) % kNumberOfEntries]];
+      }
+    });
+  }];
+}
+
+- (void)testConcurrentHitPerformanceWith1Thread {
+  [self measureConcurrentHitsWithNumberOfThreads:1 numberOfShards:16];
+}
+
+- (void)testConcurrentHitPerformanceWith2Threads {
+  [self measureConcurrentHitsWithNumberOfThreads:2 numberOfShards:16];
+}
+
+- (void)testConcurrentHitPerformanceWith4Threads {
+  [self measureConcurrentHitsWithNumberOfThreads:4 numberOfShards:16];
+}
+
+- (void)testConcurrentHitPerformanceWith8Threads {
+  [self measureConcurrentHitsWithNumberOfThreads:8 numberOfShards:16];
+}
+
+- (void)testUnshardedConcurrentHitPerformanceWith8Threads {
+  [self measureConcurrentHitsWithNumberOfThreads:8 numberOfShards:1];
+}
+
+// Removes one namespace of 100 objects from a cache of numberOfEntries objects.
+- (void)measureRemovingPrefixWithNumberOfEntries:(NSUInteger)numberOfEntries {
+  NIMemoryCache* cache = [[NIMemoryCache alloc] init];
+  id object = [NSArray array];
+  for (NSUInteger ix = 0; ix < numberOfEntries; ++ix) {
+    NSString* name = [NSString stringWithFormat:@"user/%zd/photo/%zd", ix / 100, ix % 100];
+    [cache storeObject:object withName:name];
+  }
+
+  __block NSUInteger user = 0;
+  [self measureBlock:^{
+    [cache removeAllObjectsWithPrefix:[NSString stringWithFormat:@"user/%zd/", user++]];
+  }];
+}
+
+- (void)testRemovingPrefixPerformanceWith50000Entries {
+  [self measureRemovingPrefixWithNumberOfEntries:50000];
+}
+
+// A data source that looks up a screenful of objects per layout pass.
+- (void)measureLayoutPassesWithNumberOfNamesPerPass:(NSUInteger)numberOfNamesPerPass
+                                             batched:(BOOL)batched {
+  NSArray* names = [self namesForNumberOfEntries:1000];
+  NIMemoryCache* cache = [[NIMemoryCache alloc] initWithCapacity:names.count];
+  NSMutableArray* objects = [NSMutableArray arrayWithCapacity:names.count];
+  for (NSUInteger ix = 0; ix < names.count; ++ix) {
+    [objects addObject:[NSArray array]];
+  }
+  [cache storeObjects:objects withNames:names expiresAfter:nil];
+
+  [self measureBlock:^{
+    for (NSUInteger pass = 0; pass < 1000; ++pass) {
+      NSRange range = NSMakeRange((pass * 7) % (names.count - numberOfNamesPerPass),
+                                  numberOfNamesPerPass);
+      NSArray* passNames = [names subarrayWithRange:range];
+      if (batched) {
+        [cache objectsWithNames:passNames];
+      } else {
+        for (NSString* name in passNames) {
+          [cache objectWithName:name];
+        }
+      }
+    }
+  }];
+}
+
+- (void)testPerKeyLayoutPassPerformance {
+  [self measureLayoutPassesWithNumberOfNamesPerPass:40 batched:NO];
+}
+
+- (void)testBatchedLayoutPassPerformance {
+  [self measureLayoutPassesWithNumberOfNamesPerPass:40 batched:YES];
 }
 
 #pragma mark - Image In-Memory Cache
@@ -620,6 +1275,26 @@
   XCTAssertNotNil([cache objectWithName:@"obj2"], @"Image 2 should still be around.");
 }
 
+- (void)testShardedImageCacheStoreTooMuch {
+  NIImageMemoryCache* cache = [[NIImageMemoryCache alloc] initWithCapacity:0 numberOfShards:4];
+
+  static const NSUInteger numberOfPixelsInOneImage = 100 * 100;
+  cache.maxNumberOfPixels = numberOfPixelsInOneImage * 2;
+
+  UIImage* img = [self emptyImageWithSize:CGSizeMake(100, 100)];
+
+  // The pixel limit applies to the cache as a whole, regardless of which shard an image is in.
+  for (NSInteger ix = 0; ix < 10; ++ix) {
+    [cache storeObject:img withName:[NSString stringWithFormat:@"obj%zd", ix]];
+    [NSThread sleepForTimeInterval:0.001];
+  }
+
+  XCTAssertEqual([cache count], (NSUInteger)2, @"Cache should have two objects.");
+  XCTAssertEqual(cache.numberOfPixels, (unsigned long long)numberOfPixelsInOneImage * 2);
+  XCTAssertNotNil([cache objectWithName:@"obj8"], @"Image 8 should still be around.");
+  XCTAssertNotNil([cache objectWithName:@"obj9"], @"Image 9 should still be around.");
+}
+
 - (void)testImageCacheStoringWithTinyLimit {
   NIImageMemoryCache* cache = [[NIImageMemoryCache alloc] init];
 
@@ -644,4 +1319,182 @@
 
 }
 
+- (void)testImageCacheCountsBackingStoreBytes {
+  NIImageMemoryCache* cache = [[NIImageMemoryCache alloc] init];
+
+  UIImage* img = [self emptyImageWithSize:CGSizeMake(100, 100)];
+  unsigned long long numberOfBytesInOneImage =
+      (unsigned long long)CGImageGetBytesPerRow(img.CGImage) * CGImageGetHeight(img.CGImage);
+  XCTAssertEqual(NIMemoryCostOfImage(img), numberOfBytesInOneImage);
+
+  [cache storeObject:img withName:@"obj1"];
+  [cache storeObject:img withName:@"obj2"];
+  XCTAssertEqual(cache.numberOfBytes, numberOfBytesInOneImage * 2);
+
+  // Replacing an image replaces its cost.
+  [cache storeObject:img withName:@"obj2" cost:1];
+  XCTAssertEqual(cache.numberOfBytes, numberOfBytesInOneImage + 1);
+
+  [cache removeObjectWithName:@"obj1"];
+  XCTAssertEqual(cache.numberOfBytes, (unsigned long long)1);
+
+  [cache removeAllObjects];
+  XCTAssertEqual(cache.numberOfBytes, (unsigned long long)0);
+}
+
+- (void)testImageCacheStoringTooManyBytes {
+  NIImageMemoryCache* cache = [[NIImageMemoryCache alloc] init];
+
+  UIImage* img = [self emptyImageWithSize:CGSizeMake(100, 100)];
+  unsigned long long numberOfBytesInOneImage = NIMemoryCostOfImage(img);
+  cache.maxNumberOfBytes = numberOfBytesInOneImage * 2;
+  cache.maxNumberOfBytesUnderStress = numberOfBytesInOneImage;
+
+  [cache storeObject:img withName:@"obj1"];
+  [cache storeObject:img withName:@"obj2"];
+  [cache storeObject:img withName:@"obj3"];
+
+  XCTAssertEqual([cache count], (NSUInteger)2, @"Cache should have two objects.");
+  XCTAssertNil([cache objectWithName:@"obj1"], @"Image 1 should have been evicted.");
+
+  [cache reduceMemoryUsage];
+
+  XCTAssertEqual([cache count], (NSUInteger)1, @"Cache should have one object.");
+  XCTAssertEqual(cache.numberOfBytes, numberOfBytesInOneImage);
+  XCTAssertNotNil([cache objectWithName:@"obj3"], @"Image 3 should still be around.");
+}
+
+- (void)testImageCacheBatchedStoreEvictsOnce {
+  NIImageMemoryCache* cache = [[NIImageMemoryCache alloc] init];
+
+  UIImage* img = [self emptyImageWithSize:CGSizeMake(100, 100)];
+  cache.maxNumberOfBytes = NIMemoryCostOfImage(img) * 2;
+
+  [cache storeObjects:@[img, img, img]
+            withNames:@[@"obj1", @"obj2", @"obj3"]
+         expiresAfter:nil];
+
+  XCTAssertEqual([cache count], (NSUInteger)2, @"Cache should have two objects.");
+  XCTAssertNil([cache objectWithName:@"obj1"], @"Image 1 should have been evicted.");
+  XCTAssertEqual(cache.numberOfPixels, (unsigned long long)(2 * 100 * 100));
+}
+
+- (void)testImageCacheVariantFamiliesOnlyListResidentImages {
+  NIImageMemoryCache* cache = [[NIImageMemoryCache alloc] init];
+
+  UIImage* img = [self emptyImageWithSize:CGSizeMake(100, 100)];
+  cache.maxNumberOfBytes = NIMemoryCostOfImage(img) * 2;
+
+  [cache storeObject:img withName:@"large"];
+  [cache storeObject:img withName:@"small"];
+  [cache addObjectWithName:@"large" toVariantFamily:@"family" variantInfo:@"large info"];
+  [cache addObjectWithName:@"small" toVariantFamily:@"family" variantInfo:nil];
+  [cache addObjectWithName:@"missing" toVariantFamily:@"family" variantInfo:@"missing info"];
+
+  NSDictionary* expected = @{@"large": @"large info", @"small": [NSNull null]};
+  XCTAssertEqualObjects([cache variantInfosInVariantFamily:@"family"], expected);
+
+  // Evicting a variant takes it out of its family.
+  [cache storeObject:img withName:@"other"];
+  XCTAssertEqualObjects([cache variantInfosInVariantFamily:@"family"], @{@"small": [NSNull null]});
+
+  [cache storeObject:img withName:@"large"];
+  [cache addObjectWithName:@"large" toVariantFamily:@"family" variantInfo:@"large info"];
+  [cache removeObjectsInVariantFamily:@"family"];
+  XCTAssertEqualObjects([cache variantInfosInVariantFamily:@"family"], @{});
+  XCTAssertFalse([cache containsObjectWithName:@"large"]);
+  XCTAssertTrue([cache containsObjectWithName:@"other"]);
+}
+
+- (void)testImageCacheRestoresEvictedImagesInUse {
+  NIImageMemoryCache* cache = [[NIImageMemoryCache alloc] init];
+  cache.keepsEvictedObjectsWhileInUse = YES;
+
+  UIImage* img1 = [self emptyImageWithSize:CGSizeMake(100, 100)];
+  UIImage* img2 = [self emptyImageWithSize:CGSizeMake(100, 100)];
+  cache.maxNumberOfPixels = 100 * 100;
+
+  [cache storeObject:img1 withName:@"obj1"];
+  [cache storeObject:img2 withName:@"obj2"];
+  XCTAssertEqual([cache count], (NSUInteger)1, @"Image 1 should have been evicted.");
+
+  // Going back to image 1 restores it and evicts image 2 instead.
+  XCTAssertEqual([cache objectWithName:@"obj1"], img1);
+  XCTAssertEqual([cache count], (NSUInteger)1, @"Image 2 should have been evicted.");
+  XCTAssertEqual([cache objectWithName:@"obj2"], img2);
+  XCTAssertEqual(cache.numberOfPixels, (unsigned long long)(100 * 100));
+}
+
+- (void)testImageCacheSavesHotSetInRecencyOrder {
+  NSString* path = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+  NIImageMemoryCache* cache = [[NIImageMemoryCache alloc] init];
+  cache.hotSetPath = path;
+  cache.maxNumberOfHotSetNames = 3;
+
+  UIImage* img = [self emptyImageWithSize:CGSizeMake(10, 10)];
+  [cache storeObject:img withName:@"obj1"];
+  [cache storeObject:img withName:@"obj2" expiresAfter:[NSDate dateWithTimeIntervalSince1970:2000000000]];
+  [cache storeObject:img withName:@"obj3"];
+  [cache storeObject:img withName:@"obj4"];
+  [cache objectWithName:@"obj2"];
+
+  XCTAssertTrue([cache saveHotSet]);
+
+  NSDictionary* hotSet = [NSDictionary dictionaryWithContentsOfFile:path];
+  NSArray* expectedNames = @[@"obj2", @"obj4", @"obj3"];
+  XCTAssertEqualObjects(hotSet[@"names"], expectedNames, @"Names should be most recent first.");
+  NSArray* expirations = hotSet[@"expirations"];
+  XCTAssertEqualWithAccuracy([expirations[0] doubleValue], 2000000000, 0.01);
+  XCTAssertEqual([expirations[1] doubleValue], 0.0, @"Images that never expire have no expiration.");
+  XCTAssertEqual([expirations[2] doubleValue], 0.0);
+
+  [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+- (void)testImageCacheWarmStartLoadsHotSetWithinBudget {
+  NSString* path = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+  UIImage* img = [self emptyImageWithSize:CGSizeMake(10, 10)];
+
+  NIImageMemoryCache* cache = [[NIImageMemoryCache alloc] init];
+  cache.hotSetPath = path;
+  for (NSInteger ix = 0; ix < 4; ++ix) {
+    [cache storeObject:img withName:[NSString stringWithFormat:@"obj%zd", ix]];
+  }
+  [cache saveHotSet];
+
+  // As if the app had been relaunched.
+  NSMutableArray* requestedNames = [NSMutableArray array];
+  NIImageMemoryCache* warmCache = [[NIImageMemoryCache alloc] init];
+  warmCache.hotSetPath = path;
+  warmCache.hotSetLoader = ^UIImage *(NSString* name) {
+    @synchronized(requestedNames) {
+      [requestedNames addObject:name];
+    }
+    return img;
+  };
+  [warmCache storeObject:img withName:@"obj3"];
+
+  __block NSArray* loadedNames = nil;
+  [warmCache warmStartWithTimeLimit:0
+                   maxNumberOfBytes:NIMemoryCostOfImage(img) * 2
+                         completion:^(NSArray* names) {
+                           loadedNames = names;
+                         }];
+
+  NSDate* timeout = [NSDate dateWithTimeIntervalSinceNow:2];
+  while (nil == loadedNames && [timeout timeIntervalSinceNow] > 0) {
+    [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode
+                             beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+  }
+
+  // obj3 was already in the cache, and only two more images fit in the budget.
+  NSArray* expectedNames = @[@"obj2", @"obj1"];
+  XCTAssertEqualObjects(loadedNames, expectedNames);
+  XCTAssertEqualObjects(requestedNames, expectedNames);
+  XCTAssertEqual([warmCache count], (NSUInteger)3);
+  XCTAssertFalse([warmCache containsObjectWithName:@"obj0"]);
+
+  [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
 @end
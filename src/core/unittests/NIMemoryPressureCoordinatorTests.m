@@ -0,0 +1,181 @@
+//
+// Copyright 2011-2014 NimbusKit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// See: http://bit.ly/hS5nNh for unit test macros.
+
+#import <XCTest/XCTest.h>
+
+#import <UIKit/UIKit.h>
+
+#import "NIInMemoryCache.h"
+#import "NIMemoryPressureCoordinator.h"
+#import "NIViewRecycler.h"
+
+// Holds a fixed amount of memory and records every trim.
+@interface NIFakeMemoryPressureResponder : NSObject <NIMemoryPressureResponder>
+@property (nonatomic, assign) unsigned long long memoryPressureCost;
+@property (nonatomic, assign) double memoryPressureRecreationPrice;
+@property (nonatomic, strong) NSMutableArray* trimmedCosts;
+@end
+
+@implementation NIFakeMemoryPressureResponder
+
+- (id)init {
+  if ((self = [super init])) {
+    _memoryPressureRecreationPrice = 1;
+    _trimmedCosts = [NSMutableArray array];
+  }
+  return self;
+}
+
+- (void)trimToMemoryPressureCost:(unsigned long long)cost level:(NIMemoryPressureLevel)level {
+  [self.trimmedCosts addObject:@(cost)];
+  self.memoryPressureCost = MIN(self.memoryPressureCost, cost);
+}
+
+@end
+
+@interface NIMemoryPressureCoordinatorTests : XCTestCase
+@end
+
+
+@implementation NIMemoryPressureCoordinatorTests
+
+
+- (void)testTrimsAreSpreadAcrossSteps {
+  NIMemoryPressureCoordinator* coordinator = [[NIMemoryPressureCoordinator alloc] init];
+  NIFakeMemoryPressureResponder* responder = [[NIFakeMemoryPressureResponder alloc] init];
+  responder.memoryPressureCost = 1000;
+  [coordinator addResponder:responder];
+
+  [coordinator simulateMemoryPressureWithLevel:NIMemoryPressureLevelModerate];
+
+  // Only the first step happens right away.
+  XCTAssertTrue(coordinator.isTrimming);
+  XCTAssertEqualObjects(responder.trimmedCosts, @[@(1000 - 250 / 4)]);
+
+  [coordinator finishTrimming];
+
+  XCTAssertFalse(coordinator.isTrimming);
+  XCTAssertEqual(responder.trimmedCosts.count, (NSUInteger)4);
+  XCTAssertEqual(responder.memoryPressureCost, (unsigned long long)750);
+}
+
+- (void)testTrimsContinueOnLaterRunLoopTurns {
+  NIMemoryPressureCoordinator* coordinator = [[NIMemoryPressureCoordinator alloc] init];
+  NIFakeMemoryPressureResponder* responder = [[NIFakeMemoryPressureResponder alloc] init];
+  responder.memoryPressureCost = 1000;
+  [coordinator addResponder:responder];
+
+  [coordinator simulateMemoryPressureWithLevel:NIMemoryPressureLevelBackground];
+
+  NSDate* timeout = [NSDate dateWithTimeIntervalSinceNow:2];
+  while (coordinator.isTrimming && [timeout timeIntervalSinceNow] > 0) {
+    [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode
+                             beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+  }
+
+  XCTAssertFalse(coordinator.isTrimming);
+  XCTAssertEqual(responder.trimmedCosts.count, (NSUInteger)4);
+  XCTAssertEqual(responder.memoryPressureCost, (unsigned long long)250);
+}
+
+- (void)testCriticalTrimsHappenAtOnce {
+  NIMemoryPressureCoordinator* coordinator = [[NIMemoryPressureCoordinator alloc] init];
+  NIFakeMemoryPressureResponder* responder = [[NIFakeMemoryPressureResponder alloc] init];
+  responder.memoryPressureCost = 1000;
+  [coordinator addResponder:responder];
+
+  [coordinator simulateMemoryPressureWithLevel:NIMemoryPressureLevelCritical];
+
+  XCTAssertFalse(coordinator.isTrimming);
+  XCTAssertEqual(responder.memoryPressureCost, (unsigned long long)500);
+}
+
+- (void)testCheapRespondersReleaseMore {
+  NIMemoryPressureCoordinator* coordinator = [[NIMemoryPressureCoordinator alloc] init];
+  NIFakeMemoryPressureResponder* cheap = [[NIFakeMemoryPressureResponder alloc] init];
+  cheap.memoryPressureCost = 1000;
+  cheap.memoryPressureRecreationPrice = 1;
+  NIFakeMemoryPressureResponder* expensive = [[NIFakeMemoryPressureResponder alloc] init];
+  expensive.memoryPressureCost = 1000;
+  expensive.memoryPressureRecreationPrice = 3;
+  [coordinator addResponder:cheap];
+  [coordinator addResponder:expensive];
+
+  [coordinator simulateMemoryPressureWithLevel:NIMemoryPressureLevelModerate];
+  [coordinator finishTrimming];
+
+  // The responders release a quarter of their combined memory, the cheap one three times as much
+  // as the expensive one.
+  XCTAssertEqualWithAccuracy((double)cheap.memoryPressureCost, 625, 1);
+  XCTAssertEqualWithAccuracy((double)expensive.memoryPressureCost, 875, 1);
+}
+
+- (void)testNewTrimReplacesPendingTrim {
+  NIMemoryPressureCoordinator* coordinator = [[NIMemoryPressureCoordinator alloc] init];
+  NIFakeMemoryPressureResponder* responder = [[NIFakeMemoryPressureResponder alloc] init];
+  responder.memoryPressureCost = 1000;
+  [coordinator addResponder:responder];
+
+  [coordinator simulateMemoryPressureWithLevel:NIMemoryPressureLevelModerate];
+  [coordinator simulateMemoryPressureWithLevel:NIMemoryPressureLevelCritical];
+  XCTAssertFalse(coordinator.isTrimming);
+
+  // The critical trim starts from the cost that was left after the first moderate step.
+  XCTAssertEqual(responder.memoryPressureCost, (unsigned long long)(1000 - 250 / 4) / 2);
+}
+
+- (void)testImageCacheTrimsLeastRecentlyUsedImages {
+  NIMemoryPressureCoordinator* coordinator = [[NIMemoryPressureCoordinator alloc] init];
+  NIImageMemoryCache* cache = [[NIImageMemoryCache alloc] init];
+  [coordinator addResponder:cache];
+
+  UIGraphicsBeginImageContext(CGSizeMake(10, 10));
+  UIImage* image = UIGraphicsGetImageFromCurrentImageContext();
+  UIGraphicsEndImageContext();
+
+  for (NSInteger ix = 0; ix < 4; ++ix) {
+    [cache storeObject:image withName:[NSString stringWithFormat:@"obj%zd", ix]];
+  }
+  unsigned long long numberOfBytes = cache.numberOfBytes;
+
+  [coordinator simulateMemoryPressureWithLevel:NIMemoryPressureLevelCritical];
+
+  XCTAssertEqual(cache.count, (NSUInteger)2, @"Half of the images should have been removed.");
+  XCTAssertEqual(cache.numberOfBytes, numberOfBytes / 2);
+  XCTAssertTrue([cache containsObjectWithName:@"obj3"], @"The newest image should remain.");
+}
+
+- (void)testViewRecyclerKeepsSomeViewsOfEveryKind {
+  NIMemoryPressureCoordinator* coordinator = [[NIMemoryPressureCoordinator alloc] init];
+  NIViewRecycler* recycler = [[NIViewRecycler alloc] init];
+  [coordinator addResponder:(id<NIMemoryPressureResponder>)recycler];
+
+  for (NSInteger ix = 0; ix < 6; ++ix) {
+    [recycler recycleView:[[NIRecyclableView alloc] initWithReuseIdentifier:@"common"]];
+  }
+  for (NSInteger ix = 0; ix < 2; ++ix) {
+    [recycler recycleView:[[NIRecyclableView alloc] initWithReuseIdentifier:@"rare"]];
+  }
+
+  [coordinator simulateMemoryPressureWithLevel:NIMemoryPressureLevelCritical];
+
+  XCTAssertNotNil([recycler dequeueReusableViewWithIdentifier:@"common"]);
+  XCTAssertNotNil([recycler dequeueReusableViewWithIdentifier:@"rare"]);
+}
+
+@end
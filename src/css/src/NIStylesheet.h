@@ -39,11 +39,13 @@ extern NSString* const NIStylesheetDidChangeNotification;
  * @ingroup NimbusCSS
  *
  * Use this object to load and parse a CSS stylesheet from disk and then apply the stylesheet
- * to views. Rulesets are cached on demand and cleared when a memory warning is received.
+ * to views. Rulesets are cached on demand.
  *
  * Stylesheets can be merged using the addStylesheet: method.
  *
- * Cached rulesets are released when a memory warning is received.
+ * Cached rulesets are released gradually when the system runs low on memory.
+ *
+ * @see NIMemoryPressureCoordinator
  */
 @interface NIStylesheet : NSObject {
 @private
@@ -28,7 +28,10 @@
 NSString* const NIStylesheetDidChangeNotification = @"NIStylesheetDidChangeNotification";
 static Class _rulesetClass;
 
-@interface NIStylesheet()
+// The approximate number of bytes used by a composed ruleset and the values it has cached.
+static const unsigned long long kComposedRulesetMemoryCost = 1024;
+
+@interface NIStylesheet() <NIMemoryPressureResponder>
 @property (nonatomic, readonly, copy) NSDictionary* rawRulesets;
 @property (nonatomic, readonly, copy) NSDictionary* significantScopeToScopes;
 @end
@@ -37,19 +40,11 @@ static Class _rulesetClass;
 
 
 
-- (void)dealloc {
-  [[NSNotificationCenter defaultCenter] removeObserver:self];
-}
-
 - (id)init {
   if ((self = [super init])) {
     _ruleSets = [[NSMutableDictionary alloc] init];
 
-    NSNotificationCenter* nc = [NSNotificationCenter defaultCenter];
-    [nc addObserver: self
-           selector: @selector(didReceiveMemoryWarning:)
-               name: UIApplicationDidReceiveMemoryWarningNotification
-             object: nil];
+    [[NIMemoryPressureCoordinator sharedCoordinator] addResponder:self];
   }
 
   return self;
@@ -104,15 +99,26 @@ static Class _rulesetClass;
   [self rebuildSignificantScopeToScopes];
 }
 
-#pragma mark - NSNotifications
+#pragma mark - NIMemoryPressureResponder
 
 
-- (void)reduceMemory {
-  _ruleSets = [[NSMutableDictionary alloc] init];
+- (unsigned long long)memoryPressureCost {
+  return [_ruleSets count] * kComposedRulesetMemoryCost;
 }
 
-- (void)didReceiveMemoryWarning:(void*)object {
-  [self reduceMemory];
+- (double)memoryPressureRecreationPrice {
+  // Composed rulesets are rebuilt from the raw rulesets that are already in memory.
+  return 0.25;
+}
+
+- (void)trimToMemoryPressureCost:(unsigned long long)cost level:(NIMemoryPressureLevel)level {
+  NSUInteger numberOfRulesetsToKeep = (NSUInteger)(cost / kComposedRulesetMemoryCost);
+  if ([_ruleSets count] <= numberOfRulesetsToKeep) {
+    return;
+  }
+  NSArray* classNames = [_ruleSets allKeys];
+  NSRange rangeToRemove = NSMakeRange(0, [classNames count] - numberOfRulesetsToKeep);
+  [_ruleSets removeObjectsForKeys:[classNames subarrayWithRange:rangeToRemove]];
 }
 
 #pragma mark - Public
@@ -18,6 +18,7 @@
 #import <UIKit/UIKit.h>
 
 #import "NIActions.h"  /* for NIActionsDataSource */
+#import "NIImagePrefetching.h"  /* for NIImagePrefetcher */
 #import "NIPreprocessorMacros.h" /* for weak */
 
 API_DEPRECATED_BEGIN("🕘 Schedule time to migrate. "
@@ -54,7 +55,7 @@ typedef enum {
  *
  * @ingroup TableViewModels
  */
-@interface NITableViewModel : NSObject <NIActionsDataSource, UITableViewDataSource>
+@interface NITableViewModel : NSObject <NIActionsDataSource, UITableViewDataSource, UITableViewDataSourcePrefetching>
 
 #pragma mark Creating Table View Models
 
@@ -88,6 +89,10 @@ typedef enum {
 @property (nonatomic, copy, nullable) NITableViewModelCellForIndexPathBlock createCellBlock;
 #endif // #if NS_BLOCKS_AVAILABLE
 
+#pragma mark Prefetching Images
+
+@property (nonatomic, strong, nullable) id<NIImagePrefetcher> imagePrefetcher; // Default: nil
+
 @end
 
 /**
@@ -109,6 +114,24 @@ typedef enum {
                                 atIndexPath: (nonnull NSIndexPath *)indexPath
                                  withObject: (nonnull id)object;
 
+@optional
+
+/**
+ * Prefetch one or more table view rows at given index paths with given objects.
+ */
+- (void)tableViewModel:(nonnull NITableViewModel *)tableViewModel
+                   tableView:(nonnull UITableView *)tableView
+    prefetchRowsAtIndexPaths:(nonnull NSArray<NSIndexPath *> *)indexPaths
+                 withObjects:(nonnull NSArray<id> *)objects;
+
+/**
+ * Cancel the running prefetching task for one or more table view rows at given index paths with given objects.
+ */
+- (void)tableViewModel:(nonnull NITableViewModel *)tableViewModel
+                            tableView:(nonnull UITableView *)tableView
+    cancelPrefetchingRowsAtIndexPaths:(nonnull NSArray<NSIndexPath *> *)indexPaths
+                          withObjects:(nonnull NSArray<id> *)objects;
+
 @end
 
 /**
@@ -309,4 +332,21 @@ typedef enum {
 
 #endif // #if NS_BLOCKS_AVAILABLE
 
+
+/** @name Prefetching Images */
+
+/**
+ * Loads the images of rows that are about to be shown.
+ *
+ * When the table view asks the model to prefetch rows, the objects of those rows that conform to
+ * NIImagePrefetchingObject are passed on to the image prefetcher. Their prefetches are cancelled
+ * when the table view cancels prefetching the rows. The model must be the table view's
+ * prefetchDataSource for this to happen.
+ *
+ * By default this is nil.
+ *
+ * @see NINetworkImagePrefetcher
+ * @fn NITableViewModel::imagePrefetcher
+ */
+
 API_DEPRECATED_END
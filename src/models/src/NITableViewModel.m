@@ -321,6 +321,46 @@
   return cell;
 }
 
+#pragma mark - UITableViewDataSourcePrefetching
+
+- (void)tableView:(UITableView *)tableView prefetchRowsAtIndexPaths:(NSArray<NSIndexPath *> *)indexPaths {
+  NSMutableArray<id>* objects = [NSMutableArray array];
+  for (NSIndexPath* indexPath in indexPaths) {
+    id object = [self objectAtIndexPath:indexPath];
+    if (nil == object) {
+      continue;
+    }
+    [objects addObject:object];
+
+    if ([object conformsToProtocol:@protocol(NIImagePrefetchingObject)]) {
+      [self.imagePrefetcher prefetchImagesForObject:object];
+    }
+  }
+
+  if ([self.delegate respondsToSelector:@selector(tableViewModel:tableView:prefetchRowsAtIndexPaths:withObjects:)]) {
+    [self.delegate tableViewModel:self tableView:tableView prefetchRowsAtIndexPaths:indexPaths withObjects:objects];
+  }
+}
+
+- (void)tableView:(UITableView *)tableView cancelPrefetchingForRowsAtIndexPaths:(NSArray<NSIndexPath *> *)indexPaths {
+  NSMutableArray<id>* objects = [NSMutableArray array];
+  for (NSIndexPath* indexPath in indexPaths) {
+    id object = [self objectAtIndexPath:indexPath];
+    if (nil == object) {
+      continue;
+    }
+    [objects addObject:object];
+
+    if ([object conformsToProtocol:@protocol(NIImagePrefetchingObject)]) {
+      [self.imagePrefetcher cancelPrefetchingImagesForObject:object];
+    }
+  }
+
+  if ([self.delegate respondsToSelector:@selector(tableViewModel:tableView:cancelPrefetchingRowsAtIndexPaths:withObjects:)]) {
+    [self.delegate tableViewModel:self tableView:tableView cancelPrefetchingRowsAtIndexPaths:indexPaths withObjects:objects];
+  }
+}
+
 #pragma mark - Public
 
 
@@ -27,6 +27,44 @@
 
 @end
 
+@interface NITestPrefetchingObject : NSObject <NIImagePrefetchingObject>
+@end
+
+@implementation NITestPrefetchingObject
+
+- (NSArray *)imagePrefetchRequests {
+  return @[[NIImagePrefetchRequest requestWithPath:@"http://example.com/image.png"
+                                       displaySize:CGSizeMake(40, 40)
+                                       contentMode:UIViewContentModeScaleAspectFill]];
+}
+
+@end
+
+@interface NITestImagePrefetcher : NSObject <NIImagePrefetcher>
+@property (nonatomic, strong) NSMutableArray* prefetchedObjects;
+@property (nonatomic, strong) NSMutableArray* cancelledObjects;
+@end
+
+@implementation NITestImagePrefetcher
+
+- (id)init {
+  if ((self = [super init])) {
+    _prefetchedObjects = [NSMutableArray array];
+    _cancelledObjects = [NSMutableArray array];
+  }
+  return self;
+}
+
+- (void)prefetchImagesForObject:(id<NIImagePrefetchingObject>)object {
+  [self.prefetchedObjects addObject:object];
+}
+
+- (void)cancelPrefetchingImagesForObject:(id<NIImagePrefetchingObject>)object {
+  [self.cancelledObjects addObject:object];
+}
+
+@end
+
 
 @implementation NITableViewModelTests
 
@@ -257,4 +295,21 @@
   }
 }
 
+- (void)testImagePrefetching {
+  NITestPrefetchingObject* prefetchingObject = [[NITestPrefetchingObject alloc] init];
+  NSArray* contents = @[@"Title", prefetchingObject];
+  NITableViewModel* model = [[NITableViewModel alloc] initWithListArray:contents delegate:nil];
+  NITestImagePrefetcher* prefetcher = [[NITestImagePrefetcher alloc] init];
+  model.imagePrefetcher = prefetcher;
+
+  NSArray* indexPaths = @[[NSIndexPath indexPathForRow:0 inSection:0],
+                          [NSIndexPath indexPathForRow:1 inSection:0]];
+  [model tableView:nil prefetchRowsAtIndexPaths:indexPaths];
+  XCTAssertEqualObjects(prefetcher.prefetchedObjects, @[prefetchingObject],
+                        @"Only objects with images should be prefetched.");
+
+  [model tableView:nil cancelPrefetchingForRowsAtIndexPaths:indexPaths];
+  XCTAssertEqualObjects(prefetcher.cancelledObjects, @[prefetchingObject]);
+}
+
 @end
@@ -15,6 +15,7 @@
 //
 
 #import <Foundation/Foundation.h>
+#import <ImageIO/ImageIO.h>
 #import <UIKit/UIKit.h>
 
 #import "NINetworkImageView.h"  // For NINetworkImageViewScaleOptions
@@ -50,4 +51,123 @@
                 scaleOptions:(NINetworkImageViewScaleOptions)scaleOptions
         interpolationQuality:(CGInterpolationQuality)interpolationQuality;
 
+/**
+ * Takes a source image and resizes/crops it according to a set of display properties, storing
+ * the result in the given pixel format.
+ *
+ * Images are converted to the pixel format even when no display size is given. The formats
+ * without alpha fill transparent areas of the result with black.
+ *
+ * @param src                  The source image.
+ * @param contentMode          The content mode to use when cropping and resizing the image.
+ * @param cropRect             An initial crop rect to apply to the src image.
+ * @param displaySize          The requested display size for the image.
+ * @param scaleOptions         See the NINetworkImageViewScaleOptions documentation for more
+ *                                  details.
+ * @param interpolationQuality The interpolation quality to use when resizing the image.
+ * @param pixelFormat          The pixel format of the resulting image's bitmap.
+ *
+ * @returns The resized and cropped image.
+ */
++ (UIImage *)imageFromSource:(UIImage *)src
+             withContentMode:(UIViewContentMode)contentMode
+                    cropRect:(CGRect)cropRect
+                 displaySize:(CGSize)displaySize
+                scaleOptions:(NINetworkImageViewScaleOptions)scaleOptions
+        interpolationQuality:(CGInterpolationQuality)interpolationQuality
+                 pixelFormat:(NIImagePixelFormat)pixelFormat;
+
+/** @name Decoding Images */
+
+/**
+ * Decodes an image into a bitmap in the pixel format that the display uses.
+ *
+ * Images made from encoded data are only decoded the first time they are drawn, which usually
+ * happens on the main thread. Images that are drawn in a format other than the display's are
+ * also converted every time they are drawn. The returned image is backed by a bitmap in
+ * 32 bit host-endian BGRA, with or without alpha, so that it can be displayed as it is.
+ *
+ * Images that are already backed by such a bitmap are returned as they are, as are the decoded
+ * bitmaps that NIImageProcessing makes when it crops, resizes or converts an image, so images
+ * that NIImageResponseSerializer has processed are not drawn a second time.
+ *
+ * This method may be called from any thread.
+ *
+ * @param image  The image to decode.
+ * @returns The decoded image, with the scale and orientation of the given image, or the given
+ *               image if it is animated or could not be decoded.
+ */
++ (UIImage *)imageDecodedForDisplayFromImage:(UIImage *)image;
+
+/**
+ * Decodes encoded image data straight to the smallest resolution that the given display
+ * properties need.
+ *
+ * The image is decoded as a thumbnail whose largest dimension is just big enough for the cropped
+ * portion of the image to cover the display size at the screen's scale. JPEG images are
+ * subsampled while they are decoded, so the full resolution bitmap never exists. The returned
+ * image has already been rotated according to its EXIF orientation and is meant to be passed to
+ * imageFromSource:withContentMode:cropRect:displaySize:scaleOptions:interpolationQuality:.
+ *
+ * @param data         The encoded image.
+ * @param contentMode  The content mode that the image will be displayed with.
+ * @param cropRect     The portion of the image that will be displayed.
+ * @param displaySize  The size that the image will be displayed at.
+ *
+ * @returns The decoded image, or nil if the image is not larger than it will be displayed, if
+ *               the content mode does not scale the image, or if the data could not be decoded.
+ *               Such images should be decoded as they are.
+ */
++ (UIImage *)imageFromData:(NSData *)data
+     decodedForContentMode:(UIViewContentMode)contentMode
+                  cropRect:(CGRect)cropRect
+               displaySize:(CGSize)displaySize;
+
+/**
+ * Creates an image from the first image in an image source, oriented according to its EXIF
+ * orientation.
+ *
+ * Works with incremental image sources, in which case the image contains as much of the image
+ * as has been received.
+ *
+ * @param source  The image source to read from.
+ * @param decode  Whether to decode the image now rather than the first time it is drawn.
+ * @returns The image at scale 1, or nil if the source does not contain an image yet.
+ */
++ (UIImage *)imageFromImageSource:(CGImageSourceRef)source decode:(BOOL)decode;
+
+/** @name Loading Local Images */
+
+/**
+ * Loads an image file, crops and resizes it according to a set of display properties, and
+ * stores the result in the given pixel format.
+ *
+ * The file is memory mapped rather than read, and large images are decoded straight to the
+ * size that they are displayed at, as with imageFromData:decodedForContentMode:cropRect:displaySize:.
+ * The returned image has already been decoded, so drawing it does not decode it again.
+ *
+ * This method does its work on the calling thread and is meant to be called in the background.
+ *
+ * @param path                 The path of the image file.
+ * @param contentMode          The content mode to use when cropping and resizing the image.
+ * @param cropRect             An initial crop rect to apply to the image.
+ * @param displaySize          The requested display size for the image. CGSizeZero keeps the
+ *                                  image at its full size.
+ * @param scaleOptions         See the NINetworkImageViewScaleOptions documentation for more
+ *                                  details.
+ * @param interpolationQuality The interpolation quality to use when resizing the image.
+ * @param pixelFormat          The pixel format of the resulting image's bitmap.
+ * @param error                Set if the file could not be read or is not an image. May be NULL.
+ *
+ * @returns The resized and cropped image, or nil if the file could not be loaded.
+ */
++ (UIImage *)imageFromContentsOfFile:(NSString *)path
+                     withContentMode:(UIViewContentMode)contentMode
+                            cropRect:(CGRect)cropRect
+                         displaySize:(CGSize)displaySize
+                        scaleOptions:(NINetworkImageViewScaleOptions)scaleOptions
+                interpolationQuality:(CGInterpolationQuality)interpolationQuality
+                         pixelFormat:(NIImagePixelFormat)pixelFormat
+                               error:(NSError **)error;
+
 @end
@@ -15,12 +15,70 @@
 //
 
 #import "NIImageProcessing.h"
+#import "NIImageResampling.h"
 #import "NimbusCore.h"
 
+#import <ImageIO/ImageIO.h>
+#import <objc/runtime.h>
+
 #if !defined(__has_feature) || !__has_feature(objc_arc)
 #error "Nimbus requires ARC support."
 #endif
 
+static char kDecodedForDisplayKey;
+
+/**
+ * Mark an image that is backed by a decoded bitmap, so that it isn't drawn into another bitmap
+ * before it is displayed.
+ */
+static UIImage* NIMarkImageAsDecoded(UIImage* image) {
+  if (nil != image) {
+    objc_setAssociatedObject(image, &kDecodedForDisplayKey, @YES, OBJC_ASSOCIATION_RETAIN_NONATOMIC);
+  }
+  return image;
+}
+
+static BOOL NIIsImageMarkedAsDecoded(UIImage* image) {
+  return [objc_getAssociatedObject(image, &kDecodedForDisplayKey) boolValue];
+}
+
+/**
+ * Create a bitmap context that stores its pixels in the given pixel format.
+ *
+ * See table "Supported Pixel Formats" in the following guide for support iOS bitmap formats:
+ * http://developer.apple.com/library/mac/#documentation/GraphicsImaging/Conceptual/drawingwithquartz2d/dq_context/dq_context.html
+ */
+static CGContextRef NICreateBitmapContext(size_t width, size_t height, NIImagePixelFormat pixelFormat) {
+  size_t bitsPerComponent = 8;
+  CGBitmapInfo bmi = (CGBitmapInfo)kCGImageAlphaPremultipliedLast;
+  CGColorSpaceRef colorSpace = NULL;
+
+  switch (pixelFormat) {
+    case NIImagePixelFormatRGBX:
+      bmi = (CGBitmapInfo)kCGImageAlphaNoneSkipLast;
+      break;
+    case NIImagePixelFormatRGB565:
+      bitsPerComponent = 5;
+      bmi = kCGBitmapByteOrder16Host | kCGImageAlphaNoneSkipFirst;
+      break;
+    case NIImagePixelFormatGray:
+      bmi = (CGBitmapInfo)kCGImageAlphaNone;
+      colorSpace = CGColorSpaceCreateDeviceGray();
+      break;
+    case NIImagePixelFormatRGBA:
+    default:
+      break;
+  }
+  if (NULL == colorSpace) {
+    colorSpace = CGColorSpaceCreateDeviceRGB();
+  }
+
+  CGContextRef context = CGBitmapContextCreate(NULL, width, height, bitsPerComponent, 0,
+                                               colorSpace, bmi);
+  CGColorSpaceRelease(colorSpace);
+  return context;
+}
+
 @implementation NIImageProcessing
 
 /**
@@ -151,12 +209,212 @@
   }
 }
 
+/**
+ * Whether the bitmap stores 8 bit RGB pixels with the alpha, or an unused byte, last. These are
+ * the layouts of NIImagePixelFormatRGBA and NIImagePixelFormatRGBX.
+ */
+static BOOL NIIsRGBXBitmapInfo(CGBitmapInfo bitmapInfo, size_t bitsPerComponent, size_t bitsPerPixel) {
+  CGBitmapInfo byteOrder = bitmapInfo & kCGBitmapByteOrderMask;
+  CGImageAlphaInfo alphaInfo = (CGImageAlphaInfo)(bitmapInfo & kCGBitmapAlphaInfoMask);
+  return (8 == bitsPerComponent
+          && 32 == bitsPerPixel
+          && 0 == (bitmapInfo & kCGBitmapFloatComponents)
+          && (kCGBitmapByteOrderDefault == byteOrder || kCGBitmapByteOrder32Big == byteOrder)
+          && (kCGImageAlphaPremultipliedLast == alphaInfo || kCGImageAlphaNoneSkipLast == alphaInfo));
+}
+
+/**
+ * Scale the given rect of the image into the given rect of an RGBA bitmap context with
+ * NIResampleRGBA.
+ *
+ * Images whose pixels are already laid out like the context's are resampled straight from their
+ * bitmap. Other images are first drawn into a bitmap of the size of the source rect.
+ *
+ * Returns NO without touching the context if either rect doesn't lie on whole pixels within the
+ * image or the context, in which case the image should be drawn with Core Graphics instead.
+ */
++ (BOOL)resampleImage:(CGImageRef)image
+           sourceRect:(CGRect)sourceRect
+          intoContext:(CGContextRef)context
+                 rect:(CGRect)rect
+ interpolationQuality:(CGInterpolationQuality)interpolationQuality {
+  if (nil == image || nil == context) {
+    return NO;
+  }
+  size_t imageWidth = CGImageGetWidth(image);
+  size_t imageHeight = CGImageGetHeight(image);
+  size_t contextWidth = CGBitmapContextGetWidth(context);
+  size_t contextHeight = CGBitmapContextGetHeight(context);
+  if (CGRectIsEmpty(rect)
+      || !CGRectEqualToRect(rect, CGRectIntegral(rect))
+      || !CGRectContainsRect(CGRectMake(0, 0, contextWidth, contextHeight), rect)
+      || CGRectIsEmpty(sourceRect)
+      || !CGRectEqualToRect(sourceRect, CGRectIntegral(sourceRect))
+      || !CGRectContainsRect(CGRectMake(0, 0, imageWidth, imageHeight), sourceRect)
+      || !NIIsRGBXBitmapInfo(CGBitmapContextGetBitmapInfo(context),
+                             CGBitmapContextGetBitsPerComponent(context),
+                             CGBitmapContextGetBitsPerPixel(context))
+      || NULL == CGBitmapContextGetData(context)) {
+    return NO;
+  }
+
+  NIResamplingFilter filter = NIResamplingFilterBilinear;
+  if (kCGInterpolationNone == interpolationQuality || kCGInterpolationLow == interpolationQuality) {
+    filter = NIResamplingFilterBox;
+  } else if (kCGInterpolationHigh == interpolationQuality) {
+    filter = NIResamplingFilterLanczos3;
+  }
+
+  // Bitmap rows are stored top first while Core Graphics rects start at the bottom.
+  size_t dstBytesPerRow = CGBitmapContextGetBytesPerRow(context);
+  size_t dstTop = contextHeight - (size_t)CGRectGetMaxY(rect);
+  NIResamplingBuffer dst = {
+    (uint8_t *)CGBitmapContextGetData(context) + dstTop * dstBytesPerRow + (size_t)rect.origin.x * 4,
+    (size_t)rect.size.width,
+    (size_t)rect.size.height,
+    dstBytesPerRow,
+  };
+  BOOL isPremultipliedContext = (kCGImageAlphaPremultipliedLast == CGBitmapContextGetAlphaInfo(context));
+
+  // Images are processed on an image decoding queue, so each one is resampled on one thread.
+  BOOL didResample = NO;
+  CGImageAlphaInfo imageAlphaInfo = CGImageGetAlphaInfo(image);
+  CGColorSpaceRef imageColorSpace = CGImageGetColorSpace(image);
+  if (NIIsRGBXBitmapInfo(CGImageGetBitmapInfo(image),
+                         CGImageGetBitsPerComponent(image),
+                         CGImageGetBitsPerPixel(image))
+      && NULL == CGImageGetDecode(image)
+      && NULL != imageColorSpace
+      && kCGColorSpaceModelRGB == CGColorSpaceGetModel(imageColorSpace)) {
+    // Copying the pixels decodes images that haven't been decoded yet, and is a plain copy of
+    // the ones that have.
+    CFDataRef pixels = CGDataProviderCopyData(CGImageGetDataProvider(image));
+    size_t bytesPerRow = CGImageGetBytesPerRow(image);
+    if (NULL != pixels && (size_t)CFDataGetLength(pixels) == bytesPerRow * imageHeight) {
+      NIResamplingBuffer src = {
+        (uint8_t *)CFDataGetBytePtr(pixels),
+        imageWidth,
+        imageHeight,
+        bytesPerRow,
+      };
+      BOOL isOpaqueImage = (kCGImageAlphaNoneSkipLast == imageAlphaInfo);
+      didResample = NIResampleRGBA(&src,
+                                   (NIResamplingRect){
+                                     sourceRect.origin.x, sourceRect.origin.y,
+                                     sourceRect.size.width, sourceRect.size.height
+                                   },
+                                   &dst, filter, 1,
+                                   ((isPremultipliedContext && !isOpaqueImage)
+                                    ? NIResamplingOptionPremultiplied
+                                    : NIResamplingOptionNone));
+
+      // The unused bytes of opaque images mean nothing, so they become opaque alpha.
+      if (didResample && isPremultipliedContext && isOpaqueImage) {
+        for (size_t row = 0; row < dst.height; ++row) {
+          uint8_t* pixel = dst.data + row * dst.bytesPerRow;
+          for (size_t column = 0; column < dst.width; ++column, pixel += 4) {
+            pixel[3] = 255;
+          }
+        }
+      }
+    }
+    if (NULL != pixels) {
+      CFRelease(pixels);
+    }
+  }
+  if (didResample) {
+    return YES;
+  }
+
+  // Decode the source rect of the image into a bitmap with the same pixel format as the context.
+  CGImageRef sourceImage = (CGRectEqualToRect(sourceRect, CGRectMake(0, 0, imageWidth, imageHeight))
+                            ? CGImageRetain(image)
+                            : CGImageCreateWithImageInRect(image, sourceRect));
+  if (nil == sourceImage) {
+    return NO;
+  }
+  size_t srcWidth = (size_t)sourceRect.size.width;
+  size_t srcHeight = (size_t)sourceRect.size.height;
+  CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+  CGContextRef srcBmp = CGBitmapContextCreate(NULL, srcWidth, srcHeight, 8, 0, colorSpace,
+                                              (CGBitmapInfo)kCGImageAlphaPremultipliedLast);
+  CGColorSpaceRelease(colorSpace);
+  if (nil == srcBmp) {
+    CGImageRelease(sourceImage);
+    return NO;
+  }
+  CGContextDrawImage(srcBmp, CGRectMake(0, 0, srcWidth, srcHeight), sourceImage);
+  CGImageRelease(sourceImage);
+
+  NIResamplingBuffer src = {
+    CGBitmapContextGetData(srcBmp),
+    srcWidth,
+    srcHeight,
+    CGBitmapContextGetBytesPerRow(srcBmp),
+  };
+
+  // Keep the colors of translucent edges within their alpha.
+  didResample = NIResampleRGBA(&src, (NIResamplingRect){0, 0, srcWidth, srcHeight}, &dst, filter, 1,
+                               (isPremultipliedContext
+                                ? NIResamplingOptionPremultiplied
+                                : NIResamplingOptionNone));
+  CGContextRelease(srcBmp);
+  return didResample;
+}
+
 + (UIImage *)imageFromSource:(UIImage *)src
              withContentMode:(UIViewContentMode)contentMode
                     cropRect:(CGRect)cropRect
                  displaySize:(CGSize)displaySize
                 scaleOptions:(NINetworkImageViewScaleOptions)scaleOptions
         interpolationQuality:(CGInterpolationQuality)interpolationQuality {
+  return [self imageFromSource:src
+               withContentMode:contentMode
+                      cropRect:cropRect
+                   displaySize:displaySize
+                  scaleOptions:scaleOptions
+          interpolationQuality:interpolationQuality
+                   pixelFormat:NIImagePixelFormatRGBA];
+}
+
+/**
+ * Redraw an image at its full size into a bitmap with the given pixel format.
+ */
++ (UIImage *)imageFromImage:(UIImage *)image withPixelFormat:(NIImagePixelFormat)pixelFormat {
+  CGImageRef imageRef = image.CGImage;
+  if (nil == imageRef) {
+    return image;
+  }
+
+  size_t width = CGImageGetWidth(imageRef);
+  size_t height = CGImageGetHeight(imageRef);
+  CGContextRef bitmap = NICreateBitmapContext(width, height, pixelFormat);
+  NIDASSERT(nil != bitmap);
+  if (nil == bitmap) {
+    return image;
+  }
+
+  CGContextDrawImage(bitmap, CGRectMake(0, 0, width, height), imageRef);
+  CGImageRef convertedImageRef = CGBitmapContextCreateImage(bitmap);
+  CGContextRelease(bitmap);
+  if (nil == convertedImageRef) {
+    return image;
+  }
+
+  UIImage* convertedImage = [UIImage imageWithCGImage:convertedImageRef
+                                                scale:image.scale
+                                          orientation:image.imageOrientation];
+  CGImageRelease(convertedImageRef);
+  return NIMarkImageAsDecoded(convertedImage);
+}
+
++ (UIImage *)imageFromSource:(UIImage *)src
+             withContentMode:(UIViewContentMode)contentMode
+                    cropRect:(CGRect)cropRect
+                 displaySize:(CGSize)displaySize
+                scaleOptions:(NINetworkImageViewScaleOptions)scaleOptions
+        interpolationQuality:(CGInterpolationQuality)interpolationQuality
+                 pixelFormat:(NIImagePixelFormat)pixelFormat {
 
   UIImage* resultImage = src;
 
@@ -166,6 +424,10 @@
 
   CGRect srcRect = CGRectMake(0, 0, src.size.width, src.size.height);
 
+  // The part of the original bitmap that srcImageRef shows, clipped and rounded the way
+  // CGImageCreateWithImageInRect does, so that it can be resampled without the cropped copies.
+  CGRect srcBitmapRect = CGRectMake(0, 0, CGImageGetWidth(srcImageRef), CGImageGetHeight(srcImageRef));
+
   // Cropping
   if (!CGRectIsEmpty(cropRect)
       && !CGRectEqualToRect(cropRect, CGRectMake(0, 0, 1, 1))) {
@@ -177,6 +439,10 @@
     // Create a new image containing only the cropped inner rect.
     srcImageRef = CGImageCreateWithImageInRect(srcImageRef, innerRect);
     croppedImageRef = srcImageRef;
+    srcBitmapRect = CGRectIntersection(CGRectIntegral(CGRectOffset(innerRect,
+                                                                   srcBitmapRect.origin.x,
+                                                                   srcBitmapRect.origin.y)),
+                                       srcBitmapRect);
 
     // This new image will likely have a different width and height, so we have to update
     // the source rect as a result.
@@ -234,6 +500,10 @@
     if (!CGRectEqualToRect(srcCropRect, srcRect)) {
       srcImageRef = CGImageCreateWithImageInRect(srcImageRef, srcCropRect);
       trimmedImageRef = srcImageRef;
+      srcBitmapRect = CGRectIntersection(CGRectIntegral(CGRectOffset(srcCropRect,
+                                                                     srcBitmapRect.origin.x,
+                                                                     srcBitmapRect.origin.y)),
+                                         srcBitmapRect);
 
       srcRect = CGRectMake(0, 0,
                            CGRectGetWidth(srcCropRect),
@@ -258,23 +528,14 @@
     // Round any remainder on the display size dimensions.
     displaySize = CGSizeMake(roundf(displaySize.width), roundf(displaySize.height));
 
-    // See table "Supported Pixel Formats" in the following guide for support iOS bitmap formats:
-    // http://developer.apple.com/library/mac/#documentation/GraphicsImaging/Conceptual/drawingwithquartz2d/dq_context/dq_context.html
-    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
-    CGBitmapInfo bmi = (CGBitmapInfo)kCGImageAlphaPremultipliedLast;
-
     // For screen sizes with higher resolutions, we create a larger image with a scale value
     // so that it appears crisper on the screen.
     CGFloat screenScale = NIScreenScale();
 
     // Create our final composite image.
-    CGContextRef dstBmp = CGBitmapContextCreate(NULL,
-                                                displaySize.width * screenScale,
+    CGContextRef dstBmp = NICreateBitmapContext(displaySize.width * screenScale,
                                                 displaySize.height * screenScale,
-                                                8,
-                                                0,
-                                                colorSpace,
-                                                bmi);
+                                                pixelFormat);
 
     // If this fails then we're likely creating an invalid bitmap and shit's about to go down.
     // In production this will fail somewhat gracefully, in that we'll end up just using the
@@ -294,24 +555,35 @@
                                          dstBlitRect.origin.y * screenScale,
                                          dstBlitRect.size.width * screenScale,
                                          dstBlitRect.size.height * screenScale);
-      CGContextDrawImage(dstBmp, scaledBlitRect, srcImageRef);
+      if (![self resampleImage:src.CGImage
+                   sourceRect:srcBitmapRect
+                  intoContext:dstBmp
+                         rect:scaledBlitRect
+         interpolationQuality:interpolationQuality]) {
+        CGContextDrawImage(dstBmp, scaledBlitRect, srcImageRef);
+      }
 
       CGImageRef resultImageRef = CGBitmapContextCreateImage(dstBmp);
 
       if (nil != resultImageRef) {
-        resultImage = [UIImage imageWithCGImage:resultImageRef
-                                          scale:screenScale
-                                    orientation:src.imageOrientation];
+        resultImage = NIMarkImageAsDecoded([UIImage imageWithCGImage:resultImageRef
+                                                               scale:screenScale
+                                                         orientation:src.imageOrientation]);
         CGImageRelease(resultImageRef);
       }
 
       CGContextRelease(dstBmp);
     }
 
-    CGColorSpaceRelease(colorSpace);
+  } else {
+    if (nil != croppedImageRef) {
+      resultImage = [UIImage imageWithCGImage:srcImageRef];
+    }
 
-  } else if (nil != croppedImageRef) {
-    resultImage = [UIImage imageWithCGImage:srcImageRef];
+    // Images that aren't resized are still stored in the requested pixel format.
+    if (NIImagePixelFormatRGBA != pixelFormat) {
+      resultImage = [self imageFromImage:resultImage withPixelFormat:pixelFormat];
+    }
   }
 
   // Memory cleanup.
@@ -325,4 +597,217 @@
   return resultImage;
 }
 
++ (UIImage *)imageDecodedForDisplayFromImage:(UIImage *)image {
+  CGImageRef imageRef = image.CGImage;
+  if (nil == imageRef || nil != image.images || NIIsImageMarkedAsDecoded(image)) {
+    return image;
+  }
+
+  size_t width = CGImageGetWidth(imageRef);
+  size_t height = CGImageGetHeight(imageRef);
+  CGImageAlphaInfo alphaInfo = CGImageGetAlphaInfo(imageRef);
+  BOOL isOpaque = (kCGImageAlphaNone == alphaInfo
+                   || kCGImageAlphaNoneSkipFirst == alphaInfo
+                   || kCGImageAlphaNoneSkipLast == alphaInfo);
+
+  // Core Animation displays host-endian BGRA bitmaps without converting them, so bitmaps that
+  // are already in that format are displayed as they are.
+  CGBitmapInfo bitmapInfo = (kCGBitmapByteOrder32Host
+                             | (isOpaque ? kCGImageAlphaNoneSkipFirst : kCGImageAlphaPremultipliedFirst));
+  CGBitmapInfo imageBitmapInfo = CGImageGetBitmapInfo(imageRef);
+  if (8 == CGImageGetBitsPerComponent(imageRef)
+      && 32 == CGImageGetBitsPerPixel(imageRef)
+      && (kCGBitmapByteOrderMask & imageBitmapInfo) == kCGBitmapByteOrder32Host
+      && (kCGImageAlphaNoneSkipFirst == alphaInfo || kCGImageAlphaPremultipliedFirst == alphaInfo)
+      && NULL == CGImageGetDecode(imageRef)) {
+    return NIMarkImageAsDecoded(image);
+  }
+  CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+  CGContextRef bitmap = CGBitmapContextCreate(NULL, width, height, 8, 0, colorSpace, bitmapInfo);
+  CGColorSpaceRelease(colorSpace);
+  if (nil == bitmap) {
+    return image;
+  }
+
+  CGContextDrawImage(bitmap, CGRectMake(0, 0, width, height), imageRef);
+  CGImageRef decodedImageRef = CGBitmapContextCreateImage(bitmap);
+  CGContextRelease(bitmap);
+  if (nil == decodedImageRef) {
+    return image;
+  }
+
+  UIImage* decodedImage = [UIImage imageWithCGImage:decodedImageRef
+                                              scale:image.scale
+                                        orientation:image.imageOrientation];
+  CGImageRelease(decodedImageRef);
+  return NIMarkImageAsDecoded(decodedImage);
+}
+
+/**
+ * Calculate how much the source image may be shrunk while still covering the display at the
+ * screen's scale once it has been cropped. Returns 1 or more if it may not be shrunk.
+ */
++ (CGFloat)decodingScaleWithImageSize:(CGSize)imageSize
+                             cropRect:(CGRect)cropRect
+                          displaySize:(CGSize)displaySize
+                          contentMode:(UIViewContentMode)contentMode {
+  if (!CGRectIsEmpty(cropRect)) {
+    imageSize = CGSizeMake(imageSize.width * cropRect.size.width,
+                           imageSize.height * cropRect.size.height);
+  }
+  if (imageSize.width <= 0 || imageSize.height <= 0) {
+    return 1;
+  }
+
+  CGFloat screenScale = NIScreenScale();
+  CGFloat widthScale = displaySize.width * screenScale / imageSize.width;
+  CGFloat heightScale = displaySize.height * screenScale / imageSize.height;
+
+  if (UIViewContentModeScaleAspectFit == contentMode) {
+    // The whole image must fit within the display.
+    return MIN(widthScale, heightScale);
+
+  } else if (UIViewContentModeScaleToFill == contentMode
+             || UIViewContentModeScaleAspectFill == contentMode) {
+    // The image must cover the display along both dimensions.
+    return MAX(widthScale, heightScale);
+
+  } else {
+    // The remaining content modes cut a display sized hole out of the image at its original
+    // resolution.
+    return 1;
+  }
+}
+
++ (UIImage *)imageFromData:(NSData *)data
+     decodedForContentMode:(UIViewContentMode)contentMode
+                  cropRect:(CGRect)cropRect
+               displaySize:(CGSize)displaySize {
+  if (nil == data || displaySize.width <= 0 || displaySize.height <= 0) {
+    return nil;
+  }
+
+  CGImageSourceRef source = CGImageSourceCreateWithData((__bridge CFDataRef)data, NULL);
+  if (NULL == source) {
+    return nil;
+  }
+
+  UIImage* image = nil;
+
+  // Reading the properties only parses the image's header.
+  NSDictionary* properties = (__bridge_transfer NSDictionary *)CGImageSourceCopyPropertiesAtIndex(source, 0, NULL);
+  CGFloat pixelWidth = [properties[(__bridge NSString *)kCGImagePropertyPixelWidth] floatValue];
+  CGFloat pixelHeight = [properties[(__bridge NSString *)kCGImagePropertyPixelHeight] floatValue];
+  NSInteger orientation = [properties[(__bridge NSString *)kCGImagePropertyOrientation] integerValue];
+
+  // The crop rect and display size apply to the image once it has been rotated upright.
+  // Orientations 5 through 8 swap the image's width and height.
+  CGSize imageSize = (orientation >= 5 && orientation <= 8
+                      ? CGSizeMake(pixelHeight, pixelWidth)
+                      : CGSizeMake(pixelWidth, pixelHeight));
+
+  CGFloat scale = [self decodingScaleWithImageSize:imageSize
+                                          cropRect:cropRect
+                                       displaySize:displaySize
+                                       contentMode:contentMode];
+  if (scale < 1) {
+    CGFloat maxPixelSize = ceil(MAX(imageSize.width, imageSize.height) * scale);
+    NSDictionary* options = @{
+      (__bridge NSString *)kCGImageSourceCreateThumbnailFromImageAlways: @YES,
+      (__bridge NSString *)kCGImageSourceCreateThumbnailWithTransform: @YES,
+      (__bridge NSString *)kCGImageSourceThumbnailMaxPixelSize: @(MAX(1, maxPixelSize)),
+      (__bridge NSString *)kCGImageSourceShouldCacheImmediately: @YES,
+    };
+    CGImageRef thumbnailRef = CGImageSourceCreateThumbnailAtIndex(source, 0, (__bridge CFDictionaryRef)options);
+    if (NULL != thumbnailRef) {
+      image = NIMarkImageAsDecoded([UIImage imageWithCGImage:thumbnailRef]);
+      CGImageRelease(thumbnailRef);
+    }
+  }
+
+  CFRelease(source);
+
+  return image;
+}
+
+// Maps an EXIF orientation to the UIImage orientation that displays the image upright.
+static UIImageOrientation NIImageOrientationFromEXIFOrientation(NSInteger orientation) {
+  switch (orientation) {
+    case 2: return UIImageOrientationUpMirrored;
+    case 3: return UIImageOrientationDown;
+    case 4: return UIImageOrientationDownMirrored;
+    case 5: return UIImageOrientationLeftMirrored;
+    case 6: return UIImageOrientationRight;
+    case 7: return UIImageOrientationRightMirrored;
+    case 8: return UIImageOrientationLeft;
+    default: return UIImageOrientationUp;
+  }
+}
+
++ (UIImage *)imageFromImageSource:(CGImageSourceRef)source decode:(BOOL)decode {
+  if (NULL == source || CGImageSourceGetCount(source) == 0) {
+    return nil;
+  }
+
+  NSDictionary* options = @{
+    (__bridge NSString *)kCGImageSourceShouldCacheImmediately: @(decode),
+  };
+  CGImageRef imageRef = CGImageSourceCreateImageAtIndex(source, 0, (__bridge CFDictionaryRef)options);
+  if (NULL == imageRef) {
+    return nil;
+  }
+
+  NSDictionary* properties = (__bridge_transfer NSDictionary *)CGImageSourceCopyPropertiesAtIndex(source, 0, NULL);
+  NSInteger orientation = [properties[(__bridge NSString *)kCGImagePropertyOrientation] integerValue];
+  UIImage* image = [UIImage imageWithCGImage:imageRef
+                                       scale:1
+                                 orientation:NIImageOrientationFromEXIFOrientation(orientation)];
+  CGImageRelease(imageRef);
+  return decode ? NIMarkImageAsDecoded(image) : image;
+}
+
++ (UIImage *)imageFromContentsOfFile:(NSString *)path
+                     withContentMode:(UIViewContentMode)contentMode
+                            cropRect:(CGRect)cropRect
+                         displaySize:(CGSize)displaySize
+                        scaleOptions:(NINetworkImageViewScaleOptions)scaleOptions
+                interpolationQuality:(CGInterpolationQuality)interpolationQuality
+                         pixelFormat:(NIImagePixelFormat)pixelFormat
+                               error:(NSError **)error {
+  // Mapping the file lets the decoder read the pages it needs straight from disk, without ever
+  // copying the encoded image into memory.
+  NSData* data = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:error];
+  if (nil == data) {
+    return nil;
+  }
+
+  UIImage* image = [self imageFromData:data
+                 decodedForContentMode:contentMode
+                              cropRect:cropRect
+                           displaySize:displaySize];
+  if (nil == image) {
+    CGImageSourceRef source = CGImageSourceCreateWithData((__bridge CFDataRef)data, NULL);
+    image = [self imageFromImageSource:source decode:YES];
+    if (NULL != source) {
+      CFRelease(source);
+    }
+  }
+  if (nil == image) {
+    if (NULL != error) {
+      *error = [NSError errorWithDomain:NSCocoaErrorDomain
+                                   code:NSFileReadCorruptFileError
+                               userInfo:@{NSFilePathErrorKey: path}];
+    }
+    return nil;
+  }
+
+  return [self imageFromSource:image
+               withContentMode:contentMode
+                      cropRect:cropRect
+                   displaySize:displaySize
+                  scaleOptions:scaleOptions
+          interpolationQuality:interpolationQuality
+                   pixelFormat:pixelFormat];
+}
+
 @end
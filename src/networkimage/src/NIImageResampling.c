@@ -0,0 +1,646 @@
+//
+// Copyright 2011-2014 NimbusKit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "NIImageResampling.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define NI_RESAMPLING_AVX2 1
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define NI_RESAMPLING_SSE2 1
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define NI_RESAMPLING_NEON 1
+#endif
+
+// M_PI is not part of C99.
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Weights are fixed point numbers with this many fractional bits. Pixels are accumulated in 32
+// bits, which leaves room for weights whose absolute values add up to more than 100.
+#define NI_RESAMPLING_PRECISION_BITS 14
+#define NI_RESAMPLING_ONE (1 << NI_RESAMPLING_PRECISION_BITS)
+#define NI_RESAMPLING_HALF (1 << (NI_RESAMPLING_PRECISION_BITS - 1))
+
+// Each thread resamples at least this many rows.
+#define NI_RESAMPLING_MINIMUM_ROWS_PER_BAND 32
+#define NI_RESAMPLING_MAXIMUM_NUMBER_OF_THREADS 8
+
+// For every destination pixel along one dimension, the run of source pixels that it is made of
+// and the weight of each of them.
+typedef struct {
+  size_t count;
+  size_t maxNumberOfTaps;
+  size_t* starts;
+  size_t* numberOfTaps;
+  int16_t* weights; // maxNumberOfTaps weights per destination pixel.
+} NIResamplingCoefficients;
+
+// MARK: - Filters
+
+static double NIResamplingSinc(double x) {
+  if (0 == x) {
+    return 1;
+  }
+  x *= M_PI;
+  return sin(x) / x;
+}
+
+static double NIResamplingFilterSupport(NIResamplingFilter filter) {
+  switch (filter) {
+    case NIResamplingFilterBox:
+      return 0.5;
+    case NIResamplingFilterBilinear:
+      return 1;
+    case NIResamplingFilterLanczos3:
+      return 3;
+  }
+  return 1;
+}
+
+static double NIResamplingFilterWeight(NIResamplingFilter filter, double x) {
+  switch (filter) {
+    case NIResamplingFilterBox:
+      return (x > -0.5 && x <= 0.5) ? 1 : 0;
+    case NIResamplingFilterBilinear:
+      x = fabs(x);
+      return (x < 1) ? 1 - x : 0;
+    case NIResamplingFilterLanczos3:
+      return (x > -3 && x < 3) ? NIResamplingSinc(x) * NIResamplingSinc(x / 3) : 0;
+  }
+  return 0;
+}
+
+// MARK: - Coefficients
+
+static void NIResamplingCoefficientsFree(NIResamplingCoefficients* coefficients) {
+  free(coefficients->starts);
+  free(coefficients->numberOfTaps);
+  free(coefficients->weights);
+  memset(coefficients, 0, sizeof(*coefficients));
+}
+
+// Calculates the weights for scaling [start, start + length) to count pixels, sampling only
+// pixels in [minimum, maximum).
+static bool NIResamplingCoefficientsCreate(NIResamplingCoefficients* coefficients,
+                                           double start, double length,
+                                           size_t minimum, size_t maximum,
+                                           size_t count,
+                                           NIResamplingFilter filter) {
+  memset(coefficients, 0, sizeof(*coefficients));
+
+  double scale = length / (double)count;
+  // Shrinking widens the filter so that every source pixel contributes.
+  double filterScale = (scale > 1) ? scale : 1;
+  double support = NIResamplingFilterSupport(filter) * filterScale;
+  size_t maxNumberOfTaps = (size_t)ceil(support) * 2 + 1;
+
+  coefficients->count = count;
+  coefficients->maxNumberOfTaps = maxNumberOfTaps;
+  coefficients->starts = malloc(count * sizeof(size_t));
+  coefficients->numberOfTaps = malloc(count * sizeof(size_t));
+  coefficients->weights = calloc(count * maxNumberOfTaps, sizeof(int16_t));
+  double* weights = malloc(maxNumberOfTaps * sizeof(double));
+  if (NULL == coefficients->starts || NULL == coefficients->numberOfTaps
+      || NULL == coefficients->weights || NULL == weights) {
+    free(weights);
+    NIResamplingCoefficientsFree(coefficients);
+    return false;
+  }
+
+  for (size_t ix = 0; ix < count; ++ix) {
+    double center = start + ((double)ix + 0.5) * scale;
+    double first = floor(center - support + 0.5);
+    double last = floor(center + support + 0.5);
+    if (first < (double)minimum) {
+      first = (double)minimum;
+    }
+    if (last > (double)maximum) {
+      last = (double)maximum;
+    }
+    size_t tapStart = (size_t)first;
+    size_t numberOfTaps = (last > first) ? (size_t)(last - first) : 0;
+    if (numberOfTaps > maxNumberOfTaps) {
+      numberOfTaps = maxNumberOfTaps;
+    }
+
+    double total = 0;
+    for (size_t tap = 0; tap < numberOfTaps; ++tap) {
+      double x = ((double)(tapStart + tap) + 0.5 - center) / filterScale;
+      weights[tap] = NIResamplingFilterWeight(filter, x);
+      total += weights[tap];
+    }
+
+    if (0 == numberOfTaps || 0 == total) {
+      // The filter missed every pixel, which only happens at the edges. Use the nearest pixel.
+      double nearest = floor(center);
+      if (nearest < (double)minimum) {
+        nearest = (double)minimum;
+      }
+      if (nearest > (double)maximum - 1) {
+        nearest = (double)maximum - 1;
+      }
+      tapStart = (size_t)nearest;
+      numberOfTaps = 1;
+      weights[0] = 1;
+      total = 1;
+    }
+
+    // Round the weights to fixed point while making sure they still add up to exactly one, so
+    // that areas of a single color keep that color.
+    int16_t* fixedWeights = coefficients->weights + ix * maxNumberOfTaps;
+    int fixedTotal = 0;
+    size_t largestTap = 0;
+    for (size_t tap = 0; tap < numberOfTaps; ++tap) {
+      fixedWeights[tap] = (int16_t)lround(weights[tap] / total * NI_RESAMPLING_ONE);
+      fixedTotal += fixedWeights[tap];
+      if (fixedWeights[tap] > fixedWeights[largestTap]) {
+        largestTap = tap;
+      }
+    }
+    fixedWeights[largestTap] += (int16_t)(NI_RESAMPLING_ONE - fixedTotal);
+
+    coefficients->starts[ix] = tapStart;
+    coefficients->numberOfTaps[ix] = numberOfTaps;
+  }
+
+  free(weights);
+  return true;
+}
+
+// MARK: - Kernels
+
+static inline uint8_t NIResamplingClamp(int32_t value) {
+  value >>= NI_RESAMPLING_PRECISION_BITS;
+  return (value < 0) ? 0 : ((value > 255) ? 255 : (uint8_t)value);
+}
+
+// Clamps the color channels of each pixel to its alpha, which is the fourth byte.
+static void NIResamplingClampToAlpha(uint8_t* pixels, size_t numberOfPixels) {
+  for (size_t ix = 0; ix < numberOfPixels; ++ix) {
+    uint8_t* pixel = pixels + ix * 4;
+    uint8_t alpha = pixel[3];
+    pixel[0] = (pixel[0] > alpha) ? alpha : pixel[0];
+    pixel[1] = (pixel[1] > alpha) ? alpha : pixel[1];
+    pixel[2] = (pixel[2] > alpha) ? alpha : pixel[2];
+  }
+}
+
+// Resamples one row of pixels along its length.
+static void NIResampleRowScalar(const uint8_t* src, uint8_t* dst,
+                                const NIResamplingCoefficients* coefficients) {
+  for (size_t ix = 0; ix < coefficients->count; ++ix) {
+    const uint8_t* pixels = src + coefficients->starts[ix] * 4;
+    const int16_t* weights = coefficients->weights + ix * coefficients->maxNumberOfTaps;
+    size_t numberOfTaps = coefficients->numberOfTaps[ix];
+
+    int32_t r = NI_RESAMPLING_HALF, g = NI_RESAMPLING_HALF;
+    int32_t b = NI_RESAMPLING_HALF, a = NI_RESAMPLING_HALF;
+    for (size_t tap = 0; tap < numberOfTaps; ++tap) {
+      int32_t weight = weights[tap];
+      r += pixels[tap * 4 + 0] * weight;
+      g += pixels[tap * 4 + 1] * weight;
+      b += pixels[tap * 4 + 2] * weight;
+      a += pixels[tap * 4 + 3] * weight;
+    }
+    dst[ix * 4 + 0] = NIResamplingClamp(r);
+    dst[ix * 4 + 1] = NIResamplingClamp(g);
+    dst[ix * 4 + 2] = NIResamplingClamp(b);
+    dst[ix * 4 + 3] = NIResamplingClamp(a);
+  }
+}
+
+// Blends the given rows into one. Works on the rows' bytes from start onwards.
+static void NIResampleColumnsScalar(const uint8_t* const* rows, const int16_t* weights,
+                                    size_t numberOfTaps, uint8_t* dst,
+                                    size_t start, size_t length) {
+  for (size_t ix = start; ix < length; ++ix) {
+    int32_t value = NI_RESAMPLING_HALF;
+    for (size_t tap = 0; tap < numberOfTaps; ++tap) {
+      value += rows[tap][ix] * weights[tap];
+    }
+    dst[ix] = NIResamplingClamp(value);
+  }
+}
+
+#if NI_RESAMPLING_SSE2
+
+static void NIResampleRowSSE2(const uint8_t* src, uint8_t* dst,
+                              const NIResamplingCoefficients* coefficients) {
+  const __m128i zero = _mm_setzero_si128();
+  for (size_t ix = 0; ix < coefficients->count; ++ix) {
+    const uint8_t* pixels = src + coefficients->starts[ix] * 4;
+    const int16_t* weights = coefficients->weights + ix * coefficients->maxNumberOfTaps;
+    size_t numberOfTaps = coefficients->numberOfTaps[ix];
+
+    __m128i sum = _mm_set1_epi32(NI_RESAMPLING_HALF);
+    size_t tap = 0;
+    for (; tap + 1 < numberOfTaps; tap += 2) {
+      // Interleave the channels of two pixels so that one multiply-add weighs both of them.
+      __m128i pair = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(pixels + tap * 4)), zero);
+      pair = _mm_unpacklo_epi16(pair, _mm_srli_si128(pair, 8));
+      __m128i weightPair = _mm_set1_epi32((int32_t)((uint32_t)(uint16_t)weights[tap]
+                                                    | ((uint32_t)(uint16_t)weights[tap + 1] << 16)));
+      sum = _mm_add_epi32(sum, _mm_madd_epi16(pair, weightPair));
+    }
+    if (tap < numberOfTaps) {
+      int32_t pixel;
+      memcpy(&pixel, pixels + tap * 4, sizeof(pixel));
+      __m128i single = _mm_unpacklo_epi8(_mm_cvtsi32_si128(pixel), zero);
+      single = _mm_unpacklo_epi16(single, zero);
+      sum = _mm_add_epi32(sum, _mm_madd_epi16(single, _mm_set1_epi32((uint16_t)weights[tap])));
+    }
+
+    sum = _mm_srai_epi32(sum, NI_RESAMPLING_PRECISION_BITS);
+    sum = _mm_packs_epi32(sum, sum);
+    sum = _mm_packus_epi16(sum, sum);
+    int32_t result = _mm_cvtsi128_si32(sum);
+    memcpy(dst + ix * 4, &result, sizeof(result));
+  }
+}
+
+// Returns the number of bytes that were blended.
+static size_t NIResampleColumnsSSE2(const uint8_t* const* rows, const int16_t* weights,
+                                    size_t numberOfTaps, uint8_t* dst,
+                                    size_t start, size_t length) {
+  const __m128i zero = _mm_setzero_si128();
+  size_t ix = start;
+  for (; ix + 8 <= length; ix += 8) {
+    __m128i low = _mm_set1_epi32(NI_RESAMPLING_HALF);
+    __m128i high = low;
+    size_t tap = 0;
+    for (; tap + 1 < numberOfTaps; tap += 2) {
+      __m128i first = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(rows[tap] + ix)), zero);
+      __m128i second = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(rows[tap + 1] + ix)), zero);
+      __m128i weightPair = _mm_set1_epi32((int32_t)((uint32_t)(uint16_t)weights[tap]
+                                                    | ((uint32_t)(uint16_t)weights[tap + 1] << 16)));
+      low = _mm_add_epi32(low, _mm_madd_epi16(_mm_unpacklo_epi16(first, second), weightPair));
+      high = _mm_add_epi32(high, _mm_madd_epi16(_mm_unpackhi_epi16(first, second), weightPair));
+    }
+    if (tap < numberOfTaps) {
+      __m128i single = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(rows[tap] + ix)), zero);
+      __m128i weight = _mm_set1_epi32((uint16_t)weights[tap]);
+      low = _mm_add_epi32(low, _mm_madd_epi16(_mm_unpacklo_epi16(single, zero), weight));
+      high = _mm_add_epi32(high, _mm_madd_epi16(_mm_unpackhi_epi16(single, zero), weight));
+    }
+
+    low = _mm_srai_epi32(low, NI_RESAMPLING_PRECISION_BITS);
+    high = _mm_srai_epi32(high, NI_RESAMPLING_PRECISION_BITS);
+    __m128i result = _mm_packs_epi32(low, high);
+    _mm_storel_epi64((__m128i*)(dst + ix), _mm_packus_epi16(result, result));
+  }
+  return ix;
+}
+
+#endif // NI_RESAMPLING_SSE2
+
+#if NI_RESAMPLING_AVX2
+
+// Returns the number of bytes that were blended.
+static size_t NIResampleColumnsAVX2(const uint8_t* const* rows, const int16_t* weights,
+                                    size_t numberOfTaps, uint8_t* dst,
+                                    size_t start, size_t length) {
+  const __m256i zero = _mm256_setzero_si256();
+  size_t ix = start;
+  for (; ix + 16 <= length; ix += 16) {
+    // The unpacks work within each 128 bit lane, which the packs below undo.
+    __m256i low = _mm256_set1_epi32(NI_RESAMPLING_HALF);
+    __m256i high = low;
+    size_t tap = 0;
+    for (; tap + 1 < numberOfTaps; tap += 2) {
+      __m256i first = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(rows[tap] + ix)));
+      __m256i second = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(rows[tap + 1] + ix)));
+      __m256i weightPair = _mm256_set1_epi32((int32_t)((uint32_t)(uint16_t)weights[tap]
+                                                       | ((uint32_t)(uint16_t)weights[tap + 1] << 16)));
+      low = _mm256_add_epi32(low, _mm256_madd_epi16(_mm256_unpacklo_epi16(first, second), weightPair));
+      high = _mm256_add_epi32(high, _mm256_madd_epi16(_mm256_unpackhi_epi16(first, second), weightPair));
+    }
+    if (tap < numberOfTaps) {
+      __m256i single = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(rows[tap] + ix)));
+      __m256i weight = _mm256_set1_epi32((uint16_t)weights[tap]);
+      low = _mm256_add_epi32(low, _mm256_madd_epi16(_mm256_unpacklo_epi16(single, zero), weight));
+      high = _mm256_add_epi32(high, _mm256_madd_epi16(_mm256_unpackhi_epi16(single, zero), weight));
+    }
+
+    low = _mm256_srai_epi32(low, NI_RESAMPLING_PRECISION_BITS);
+    high = _mm256_srai_epi32(high, NI_RESAMPLING_PRECISION_BITS);
+    __m256i result = _mm256_packus_epi16(_mm256_packs_epi32(low, high), zero);
+    // Gather the low 8 bytes of each lane.
+    result = _mm256_permute4x64_epi64(result, 0xD8);
+    _mm_storeu_si128((__m128i*)(dst + ix), _mm256_castsi256_si128(result));
+  }
+  return ix;
+}
+
+#endif // NI_RESAMPLING_AVX2
+
+#if NI_RESAMPLING_NEON
+
+static void NIResampleRowNEON(const uint8_t* src, uint8_t* dst,
+                              const NIResamplingCoefficients* coefficients) {
+  for (size_t ix = 0; ix < coefficients->count; ++ix) {
+    const uint8_t* pixels = src + coefficients->starts[ix] * 4;
+    const int16_t* weights = coefficients->weights + ix * coefficients->maxNumberOfTaps;
+    size_t numberOfTaps = coefficients->numberOfTaps[ix];
+
+    int32x4_t sum = vdupq_n_s32(NI_RESAMPLING_HALF);
+    for (size_t tap = 0; tap < numberOfTaps; ++tap) {
+      uint32_t pixel;
+      memcpy(&pixel, pixels + tap * 4, sizeof(pixel));
+      int16x4_t channels = vget_low_s16(vreinterpretq_s16_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(pixel)))));
+      sum = vmlal_n_s16(sum, channels, weights[tap]);
+    }
+
+    int16x4_t narrowed = vqshrn_n_s32(sum, NI_RESAMPLING_PRECISION_BITS);
+    uint8x8_t result = vqmovun_s16(vcombine_s16(narrowed, narrowed));
+    uint32_t resultPixel = vget_lane_u32(vreinterpret_u32_u8(result), 0);
+    memcpy(dst + ix * 4, &resultPixel, sizeof(resultPixel));
+  }
+}
+
+// Returns the number of bytes that were blended.
+static size_t NIResampleColumnsNEON(const uint8_t* const* rows, const int16_t* weights,
+                                    size_t numberOfTaps, uint8_t* dst,
+                                    size_t start, size_t length) {
+  size_t ix = start;
+  for (; ix + 8 <= length; ix += 8) {
+    int32x4_t low = vdupq_n_s32(NI_RESAMPLING_HALF);
+    int32x4_t high = low;
+    for (size_t tap = 0; tap < numberOfTaps; ++tap) {
+      int16x8_t values = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(rows[tap] + ix)));
+      low = vmlal_n_s16(low, vget_low_s16(values), weights[tap]);
+      high = vmlal_n_s16(high, vget_high_s16(values), weights[tap]);
+    }
+    int16x8_t result = vcombine_s16(vqshrn_n_s32(low, NI_RESAMPLING_PRECISION_BITS),
+                                      vqshrn_n_s32(high, NI_RESAMPLING_PRECISION_BITS));
+    vst1_u8(dst + ix, vqmovun_s16(result));
+  }
+  return ix;
+}
+
+#endif // NI_RESAMPLING_NEON
+
+typedef void (*NIResampleRowFunction)(const uint8_t*, uint8_t*, const NIResamplingCoefficients*);
+
+static NIResampleRowFunction NIResampleRowFunctionForOptions(NIResamplingOptions options) {
+  if (options & NIResamplingOptionScalar) {
+    return NIResampleRowScalar;
+  }
+#if NI_RESAMPLING_SSE2
+  return NIResampleRowSSE2;
+#elif NI_RESAMPLING_NEON
+  return NIResampleRowNEON;
+#else
+  return NIResampleRowScalar;
+#endif
+}
+
+static void NIResampleColumns(const uint8_t* const* rows, const int16_t* weights,
+                              size_t numberOfTaps, uint8_t* dst, size_t length,
+                              NIResamplingOptions options) {
+  size_t ix = 0;
+  if (!(options & NIResamplingOptionScalar)) {
+#if NI_RESAMPLING_AVX2
+    ix = NIResampleColumnsAVX2(rows, weights, numberOfTaps, dst, ix, length);
+#endif
+#if NI_RESAMPLING_SSE2
+    ix = NIResampleColumnsSSE2(rows, weights, numberOfTaps, dst, ix, length);
+#elif NI_RESAMPLING_NEON
+    ix = NIResampleColumnsNEON(rows, weights, numberOfTaps, dst, ix, length);
+#endif
+  }
+  NIResampleColumnsScalar(rows, weights, numberOfTaps, dst, ix, length);
+}
+
+const char* NIResamplingImplementationName(NIResamplingOptions options) {
+  if (options & NIResamplingOptionScalar) {
+    return "scalar";
+  }
+#if NI_RESAMPLING_AVX2
+  return "avx2";
+#elif NI_RESAMPLING_SSE2
+  return "sse2";
+#elif NI_RESAMPLING_NEON
+  return "neon";
+#else
+  return "scalar";
+#endif
+}
+
+// MARK: - Bands
+
+// The state shared by every band of one resampling pass.
+typedef struct {
+  const NIResamplingBuffer* src;
+  const NIResamplingBuffer* dst;
+  const NIResamplingCoefficients* horizontal;
+  const NIResamplingCoefficients* vertical;
+  // Rows of the source resampled along their length, starting at source row firstRow.
+  uint8_t* intermediate;
+  size_t intermediateBytesPerRow;
+  size_t firstRow;
+  NIResamplingOptions options;
+  // Whether the band resamples rows of the source or rows of the destination.
+  bool horizontalPass;
+} NIResamplingPass;
+
+typedef struct {
+  const NIResamplingPass* pass;
+  size_t start;
+  size_t end;
+  // Room for the vertical pass to point at the rows that each destination row is made of.
+  const uint8_t** rows;
+} NIResamplingBand;
+
+static void NIResampleBand(const NIResamplingBand* band) {
+  const NIResamplingPass* pass = band->pass;
+  if (pass->horizontalPass) {
+    NIResampleRowFunction resampleRow = NIResampleRowFunctionForOptions(pass->options);
+    for (size_t row = band->start; row < band->end; ++row) {
+      resampleRow(pass->src->data + (pass->firstRow + row) * pass->src->bytesPerRow,
+                  pass->intermediate + row * pass->intermediateBytesPerRow,
+                  pass->horizontal);
+    }
+
+  } else {
+    const NIResamplingCoefficients* vertical = pass->vertical;
+    for (size_t row = band->start; row < band->end; ++row) {
+      size_t numberOfTaps = vertical->numberOfTaps[row];
+      for (size_t tap = 0; tap < numberOfTaps; ++tap) {
+        size_t intermediateRow = vertical->starts[row] + tap - pass->firstRow;
+        band->rows[tap] = pass->intermediate + intermediateRow * pass->intermediateBytesPerRow;
+      }
+      uint8_t* dstRow = pass->dst->data + row * pass->dst->bytesPerRow;
+      NIResampleColumns(band->rows, vertical->weights + row * vertical->maxNumberOfTaps,
+                        numberOfTaps, dstRow, pass->dst->width * 4, pass->options);
+      if (pass->options & NIResamplingOptionPremultiplied) {
+        NIResamplingClampToAlpha(dstRow, pass->dst->width);
+      }
+    }
+  }
+}
+
+static void* NIResampleBandThread(void* band) {
+  NIResampleBand(band);
+  return NULL;
+}
+
+// Splits the rows between up to numberOfThreads threads, including the calling thread.
+// Returns false if memory could not be allocated, before any rows have been resampled.
+static bool NIResampleBands(const NIResamplingPass* pass, size_t numberOfRows, size_t numberOfThreads) {
+  size_t numberOfBands = numberOfRows / NI_RESAMPLING_MINIMUM_ROWS_PER_BAND;
+  if (numberOfBands > numberOfThreads) {
+    numberOfBands = numberOfThreads;
+  }
+  if (numberOfBands < 1) {
+    numberOfBands = 1;
+  }
+
+  size_t maxNumberOfTaps = pass->vertical->maxNumberOfTaps;
+  const uint8_t** rows = malloc(numberOfBands * maxNumberOfTaps * sizeof(*rows));
+  if (NULL == rows) {
+    return false;
+  }
+
+  NIResamplingBand bands[NI_RESAMPLING_MAXIMUM_NUMBER_OF_THREADS];
+  pthread_t threads[NI_RESAMPLING_MAXIMUM_NUMBER_OF_THREADS];
+  bool started[NI_RESAMPLING_MAXIMUM_NUMBER_OF_THREADS];
+  for (size_t ix = 0; ix < numberOfBands; ++ix) {
+    bands[ix].pass = pass;
+    bands[ix].start = numberOfRows * ix / numberOfBands;
+    bands[ix].end = numberOfRows * (ix + 1) / numberOfBands;
+    bands[ix].rows = rows + ix * maxNumberOfTaps;
+  }
+
+  // The first band is resampled on this thread. Bands whose thread can't be started are too.
+  for (size_t ix = 1; ix < numberOfBands; ++ix) {
+    started[ix] = (0 == pthread_create(&threads[ix], NULL, NIResampleBandThread, &bands[ix]));
+  }
+  NIResampleBand(&bands[0]);
+  for (size_t ix = 1; ix < numberOfBands; ++ix) {
+    if (started[ix]) {
+      pthread_join(threads[ix], NULL);
+    } else {
+      NIResampleBand(&bands[ix]);
+    }
+  }
+
+  free(rows);
+  return true;
+}
+
+// MARK: - Public
+
+bool NIResampleRGBA(const NIResamplingBuffer* src,
+                    NIResamplingRect srcRect,
+                    const NIResamplingBuffer* dst,
+                    NIResamplingFilter filter,
+                    size_t numberOfThreads,
+                    NIResamplingOptions options) {
+  if (NULL == src || NULL == dst || NULL == src->data || NULL == dst->data
+      || 0 == src->width || 0 == src->height || 0 == dst->width || 0 == dst->height
+      || src->bytesPerRow < src->width * 4 || dst->bytesPerRow < dst->width * 4) {
+    return false;
+  }
+
+  // Clip the rect to the source and find the whole pixels that it touches.
+  double left = fmax(srcRect.x, 0);
+  double top = fmax(srcRect.y, 0);
+  double right = fmin(srcRect.x + srcRect.width, (double)src->width);
+  double bottom = fmin(srcRect.y + srcRect.height, (double)src->height);
+  if (!(right > left) || !(bottom > top)) {
+    return false;
+  }
+  size_t minimumX = (size_t)floor(left);
+  size_t maximumX = (size_t)ceil(right);
+  size_t minimumY = (size_t)floor(top);
+  size_t maximumY = (size_t)ceil(bottom);
+
+  NIResamplingCoefficients horizontal;
+  NIResamplingCoefficients vertical;
+  if (!NIResamplingCoefficientsCreate(&horizontal, left, right - left, minimumX, maximumX,
+                                      dst->width, filter)) {
+    return false;
+  }
+  if (!NIResamplingCoefficientsCreate(&vertical, top, bottom - top, minimumY, maximumY,
+                                      dst->height, filter)) {
+    NIResamplingCoefficientsFree(&horizontal);
+    return false;
+  }
+
+  // Only the source rows that the vertical pass reads are resampled along their length.
+  size_t firstRow = vertical.starts[0];
+  size_t lastRow = firstRow;
+  for (size_t row = 0; row < vertical.count; ++row) {
+    if (vertical.starts[row] < firstRow) {
+      firstRow = vertical.starts[row];
+    }
+    if (vertical.starts[row] + vertical.numberOfTaps[row] > lastRow) {
+      lastRow = vertical.starts[row] + vertical.numberOfTaps[row];
+    }
+  }
+
+  NIResamplingPass pass;
+  memset(&pass, 0, sizeof(pass));
+  pass.src = src;
+  pass.dst = dst;
+  pass.horizontal = &horizontal;
+  pass.vertical = &vertical;
+  pass.intermediateBytesPerRow = dst->width * 4;
+  pass.firstRow = firstRow;
+  pass.options = options;
+  pass.intermediate = malloc((lastRow - firstRow) * pass.intermediateBytesPerRow);
+  if (NULL == pass.intermediate) {
+    NIResamplingCoefficientsFree(&horizontal);
+    NIResamplingCoefficientsFree(&vertical);
+    return false;
+  }
+
+  if (0 == numberOfThreads) {
+    long numberOfProcessors = sysconf(_SC_NPROCESSORS_ONLN);
+    numberOfThreads = (numberOfProcessors > 0) ? (size_t)numberOfProcessors : 1;
+  }
+  if (numberOfThreads > NI_RESAMPLING_MAXIMUM_NUMBER_OF_THREADS) {
+    numberOfThreads = NI_RESAMPLING_MAXIMUM_NUMBER_OF_THREADS;
+  }
+
+  // The first pass only writes to the intermediate rows, so the destination is untouched if
+  // either pass fails.
+  pass.horizontalPass = true;
+  bool success = NIResampleBands(&pass, lastRow - firstRow, numberOfThreads);
+  if (success) {
+    pass.horizontalPass = false;
+    success = NIResampleBands(&pass, dst->height, numberOfThreads);
+  }
+
+  free(pass.intermediate);
+  NIResamplingCoefficientsFree(&horizontal);
+  NIResamplingCoefficientsFree(&vertical);
+  return success;
+}
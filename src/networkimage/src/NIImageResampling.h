@@ -0,0 +1,139 @@
+//
+// Copyright 2011-2014 NimbusKit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef NIIMAGERESAMPLING_H
+#define NIIMAGERESAMPLING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+/**
+ * For scaling raw RGBA bitmaps.
+ *
+ * @ingroup NimbusNetworkImage
+ * @defgroup Image-Resampling Image Resampling
+ * @{
+ *
+ * A portable C resampling engine that works on 8 bit per channel, four channel bitmaps such as
+ * the premultiplied RGBA bitmaps of CGBitmapContexts. Images are resampled in two separable
+ * passes, first along rows and then along columns, using fixed point weights so that every
+ * implementation produces exactly the same bytes.
+ *
+ * The inner loops are vectorized with NEON on ARM and with SSE2, or AVX2 when the compiler
+ * targets it, on x86. A scalar implementation is used everywhere else. Large images are split
+ * into bands of rows that are resampled on several threads.
+ *
+ * The engine only depends on the C standard library and POSIX threads, so it can be built and
+ * benchmarked outside of iOS. Run make check or make bench in networkimage/unittests/resampling.
+ */
+
+typedef enum {
+  /**
+   * Averages the source pixels that each destination pixel covers. Nearest neighbor when
+   * enlarging.
+   */
+  NIResamplingFilterBox,
+
+  /**
+   * Linear interpolation, widened to a triangle filter when shrinking.
+   */
+  NIResamplingFilterBilinear,
+
+  /**
+   * A windowed sinc filter with three lobes. The sharpest and the slowest of the filters.
+   */
+  NIResamplingFilterLanczos3,
+} NIResamplingFilter;
+
+typedef enum {
+  NIResamplingOptionNone = 0,
+
+  /**
+   * Uses the scalar implementation even when a vectorized one is available.
+   */
+  NIResamplingOptionScalar = 1 << 0,
+
+  /**
+   * The fourth byte of each pixel is alpha and the other channels are premultiplied by it.
+   *
+   * Filters with negative lobes can ring past a pixel's alpha at hard edges. With this option
+   * the color channels of each destination pixel are clamped to its alpha so that the result is
+   * still validly premultiplied.
+   */
+  NIResamplingOptionPremultiplied = 1 << 1,
+} NIResamplingOptions;
+
+/**
+ * A four channel, 8 bit per channel bitmap.
+ */
+typedef struct {
+  uint8_t* data;
+  size_t width;
+  size_t height;
+  size_t bytesPerRow;
+} NIResamplingBuffer;
+
+/**
+ * A rectangle in source pixels. May have fractional edges.
+ */
+typedef struct {
+  double x;
+  double y;
+  double width;
+  double height;
+} NIResamplingRect;
+
+/**
+ * Scales a rectangle of the source bitmap to fill the whole destination bitmap.
+ *
+ * Only source pixels within the rectangle, rounded outwards to whole pixels, are sampled.
+ *
+ * @param src              The bitmap to read from.
+ * @param srcRect          The portion of the source to scale. Clipped to the source's bounds.
+ * @param dst              The bitmap to write to. Must not overlap the source.
+ * @param filter           The filter to resample with.
+ * @param numberOfThreads  The number of threads to split the work between. 0 uses one thread
+ *                         per processor for images that are large enough to benefit.
+ * @param options          NIResamplingOptionNone or a combination of NIResamplingOptions.
+ * @returns false if the arguments are invalid or memory could not be allocated, in which case
+ *               the destination is left untouched.
+ */
+bool NIResampleRGBA(const NIResamplingBuffer* src,
+                    NIResamplingRect srcRect,
+                    const NIResamplingBuffer* dst,
+                    NIResamplingFilter filter,
+                    size_t numberOfThreads,
+                    NIResamplingOptions options);
+
+/**
+ * The name of the implementation that NIResampleRGBA uses with the given options.
+ *
+ * One of "avx2", "sse2", "neon" or "scalar".
+ */
+const char* NIResamplingImplementationName(NIResamplingOptions options);
+
+/**@}*/// End of Image Resampling //////////////////////////////////////////////////////////////////
+
+#if defined __cplusplus
+};
+#endif
+
+#endif // NIIMAGERESAMPLING_H
@@ -32,4 +32,12 @@
 @property (nonatomic, assign) CGSize displaySize;
 @property (nonatomic, assign) NINetworkImageViewScaleOptions scaleOptions;
 @property (nonatomic, assign) CGInterpolationQuality interpolationQuality;
+@property (nonatomic, assign) NIImagePixelFormat pixelFormat;
+
+// Crops and scales an already decoded image the same way a response would be.
+- (UIImage *)imageForDisplayFromImage:(UIImage *)image;
+
+// Serializers with equal processing keys turn the same response into the same image. Subclasses
+// that process images differently must include their own settings in the key.
+- (NSString *)processingKey;
 @end
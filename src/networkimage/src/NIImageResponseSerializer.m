@@ -23,16 +23,40 @@
 - (id)responseObjectForResponse:(NSURLResponse *)response
                            data:(NSData *)data
                           error:(NSError *__autoreleasing *)error {
+  // Images that will be displayed smaller than they are are decoded straight to the size they
+  // are needed at, so the full resolution bitmap is never created.
+  if ([self validateResponse:(NSHTTPURLResponse *)response data:data error:NULL]) {
+    UIImage* image = [NIImageProcessing imageFromData:data
+                                decodedForContentMode:self.contentMode
+                                             cropRect:self.cropRect
+                                          displaySize:self.displaySize];
+    if (nil != image) {
+      return [self imageForDisplayFromImage:image];
+    }
+  }
+
   id responseObject = [super responseObjectForResponse:response data:data error:error];
   if (nil != responseObject && [responseObject isKindOfClass:[UIImage class]]) {
-    responseObject = [NIImageProcessing imageFromSource:responseObject
-                                        withContentMode:self.contentMode
-                                               cropRect:self.cropRect
-                                            displaySize:self.displaySize
-                                           scaleOptions:self.scaleOptions
-                                   interpolationQuality:self.interpolationQuality];
+    responseObject = [self imageForDisplayFromImage:responseObject];
   }
   return responseObject;
 }
 
+- (UIImage *)imageForDisplayFromImage:(UIImage *)image {
+  return [NIImageProcessing imageFromSource:image
+                            withContentMode:self.contentMode
+                                   cropRect:self.cropRect
+                                displaySize:self.displaySize
+                               scaleOptions:self.scaleOptions
+                       interpolationQuality:self.interpolationQuality
+                                pixelFormat:self.pixelFormat];
+}
+
+- (NSString *)processingKey {
+  return [NSString stringWithFormat:@"%@%@{%@,%@,%@,%@}",
+          NSStringFromCGSize(self.displaySize), NSStringFromCGRect(self.cropRect),
+          [@(self.contentMode) stringValue], [@(self.scaleOptions) stringValue],
+          [@(self.interpolationQuality) stringValue], [@(self.pixelFormat) stringValue]];
+}
+
 @end
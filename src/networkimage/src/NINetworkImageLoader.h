@@ -0,0 +1,335 @@
+//
+// Copyright 2011-2014 NimbusKit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+#import <UIKit/UIKit.h>
+
+@class AFHTTPResponseSerializer;
+@class NIDiskCache;
+@class NINetworkImageLoaderRequest;
+
+// See the priority property of NINetworkImageLoaderRequest for more documentation related to
+// this enumeration.
+typedef enum {
+  /**
+   * The image is not near the viewport yet but is likely to be shown soon.
+   */
+  NINetworkImagePriorityPrefetch,
+
+  /**
+   * The image is just outside of the viewport and will be shown if the user keeps scrolling.
+   */
+  NINetworkImagePriorityNearVisible,
+
+  /**
+   * The image is on screen.
+   */
+  NINetworkImagePriorityVisible,
+} NINetworkImagePriority;
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Returns the operation queue priority that work done for an image of the given priority, such
+ * as processing or decoding it, is queued at.
+ *
+ * Use this for every operation that is queued on behalf of an image so that the work for
+ * visible images always runs first.
+ *
+ * @ingroup NimbusNetworkImage
+ */
+NSOperationQueuePriority NINetworkImageQueuePriorityForPriority(NINetworkImagePriority priority);
+
+#if defined __cplusplus
+};
+#endif
+
+typedef void (^NINetworkImageLoaderProgressBlock)(long long readBytes, long long totalBytes);
+typedef void (^NINetworkImageLoaderPartialImageBlock)(UIImage* image);
+typedef void (^NINetworkImageLoaderCompletionBlock)(UIImage* image, NSError* error);
+
+/**
+ * Loads images for any number of image views over a single URL session.
+ *
+ * Creating a URL session for every image means that every image opens its own connections and
+ * negotiates its own TLS handshakes. A loader owns one session that every request shares, so
+ * connections to a host are kept alive and reused from one image to the next.
+ *
+ * Requests are queued per host. No more than maxNumberOfConcurrentRequestsPerHost requests to
+ * a host are sent at once, and the rest are sent as earlier requests finish, highest priority
+ * first and otherwise in the order they were made. Responses are decoded and processed on a
+ * background queue and handed back to the caller on the main queue.
+ *
+ * Requests for a URL that is already being loaded wait on the existing download rather than
+ * starting another one. When the download finishes the response is processed once for every
+ * distinct display size, content mode, crop rect and scale options that were asked for, and the
+ * resulting images are shared by every request that asked for them.
+ *
+ * A loader with a responseCache keeps every downloaded image on disk along with its ETag and
+ * Last-Modified validators. Stored images are used as they are until they expire, after which
+ * the server is asked to send the image only if it has changed. A 304 Not Modified response
+ * costs a few hundred bytes rather than the whole image.
+ *
+ * NINetworkImageView uses the shared loader by default.
+ *
+ * @ingroup NimbusNetworkImage
+ */
+@interface NINetworkImageLoader : NSObject
+
++ (NINetworkImageLoader *)sharedLoader;
++ (void)setSharedLoader:(NINetworkImageLoader *)loader;
+
+// Designated initializer.
+- (id)initWithSessionConfiguration:(NSURLSessionConfiguration *)configuration;
+
+@property (nonatomic, assign) NSUInteger maxNumberOfConcurrentRequestsPerHost; // Default: 6
+@property (nonatomic, assign) BOOL suspendsLowerPriorityRequests;             // Default: NO
+@property (nonatomic, strong) NIDiskCache* responseCache;                      // Default: nil
+@property (nonatomic, strong) NSOperationQueue* imageProcessingQueue;          // Default: [Nimbus imageDecodingQueue]
+
+- (NINetworkImageLoaderRequest *)loadImageWithURL:(NSURL *)url
+                               responseSerializer:(AFHTTPResponseSerializer *)responseSerializer
+                                         progress:(NINetworkImageLoaderProgressBlock)progress
+                                       completion:(NINetworkImageLoaderCompletionBlock)completion;
+- (NINetworkImageLoaderRequest *)loadImageWithURL:(NSURL *)url
+                               responseSerializer:(AFHTTPResponseSerializer *)responseSerializer
+                                         progress:(NINetworkImageLoaderProgressBlock)progress
+                                     partialImage:(NINetworkImageLoaderPartialImageBlock)partialImage
+                                       completion:(NINetworkImageLoaderCompletionBlock)completion;
+
+@property (nonatomic, assign) NSTimeInterval minimumPartialImageInterval; // Default: 0.1
+
+- (void)invalidate;
+
+@property (nonatomic, readonly) NSUInteger numberOfResponseCacheHits;
+@property (nonatomic, readonly) NSUInteger numberOfNotModifiedResponses;
+@property (nonatomic, readonly) unsigned long long numberOfBytesSavedByResponseCache;
+
+@end
+
+/**
+ * A single request made with an NINetworkImageLoader.
+ *
+ * @ingroup NimbusNetworkImage
+ */
+@interface NINetworkImageLoaderRequest : NSObject
+
+@property (nonatomic, readonly, copy) NSURL* url;
+@property (nonatomic, assign) NINetworkImagePriority priority; // Default: NINetworkImagePriorityVisible
+
+- (void)cancel;
+
+@end
+
+/** @name Accessing the Shared Loader */
+
+/**
+ * Returns the loader that image views use by default.
+ *
+ * The shared loader is created with the default session configuration the first time it is
+ * needed.
+ *
+ * @fn NINetworkImageLoader::sharedLoader
+ */
+
+/**
+ * Replaces the shared loader.
+ *
+ * Image views that have already been created keep using the loader they were created with.
+ * Passing nil restores a default loader the next time sharedLoader is called.
+ *
+ * @fn NINetworkImageLoader::setSharedLoader:
+ */
+
+/** @name Creating a Loader */
+
+/**
+ * Initializes a newly allocated loader with a session that uses the given configuration.
+ *
+ * The configuration's HTTPMaximumConnectionsPerHost is raised to
+ * maxNumberOfConcurrentRequestsPerHost if it is lower, so that queued requests are never held
+ * back by the session as well.
+ *
+ * @param configuration  The configuration of the loader's session. nil uses
+ *                       <code>+[NSURLSessionConfiguration defaultSessionConfiguration]</code>.
+ * @fn NINetworkImageLoader::initWithSessionConfiguration:
+ */
+
+/**
+ * The number of requests to a single host that may be in flight at once.
+ *
+ * Changes apply to requests that are started afterwards.
+ *
+ * By default this is 6.
+ *
+ * @fn NINetworkImageLoader::maxNumberOfConcurrentRequestsPerHost
+ */
+
+/**
+ * Whether visible requests may take the place of lower priority requests that are in flight.
+ *
+ * When a visible request is waiting for a host whose limit has been reached, a lower priority
+ * request to that host is suspended to make room for it. Suspended requests are resumed where
+ * they left off as soon as the host has room again.
+ *
+ * By default this is NO.
+ *
+ * @fn NINetworkImageLoader::suspendsLowerPriorityRequests
+ */
+
+/**
+ * The queue that responses are turned into images on by the requests' serializers.
+ *
+ * Serializers decode, crop and resize images, so the queue's maxConcurrentOperationCount limits
+ * how many images are processed at once. Responses are processed in the order of the most
+ * urgent request waiting on them, and responses whose requests have all been cancelled are not
+ * processed at all.
+ *
+ * By default this is [Nimbus imageDecodingQueue], which image views also decode images on.
+ *
+ * @fn NINetworkImageLoader::imageProcessingQueue
+ */
+
+/** @name Revalidating Images */
+
+/**
+ * The disk cache that downloaded images and their validators are stored in.
+ *
+ * Responses are stored if they have an ETag, a Last-Modified date or an expiration date in the
+ * future, and are never stored if they are marked no-store. A stored response is used without
+ * contacting the server until its Cache-Control max-age or Expires date has passed. After that
+ * the request is sent with If-None-Match and If-Modified-Since headers, and a 304 Not Modified
+ * response is answered with the stored image.
+ *
+ * The response cache replaces the session's URL cache for the loader's requests. File URLs are
+ * never stored. The response cache is read in the background, never on the thread that asked for
+ * the image.
+ *
+ * By default this is nil and responses are only cached by the session.
+ *
+ * @fn NINetworkImageLoader::responseCache
+ */
+
+/**
+ * The number of images that were served from the response cache without contacting the server.
+ *
+ * @fn NINetworkImageLoader::numberOfResponseCacheHits
+ */
+
+/**
+ * The number of stored images that the server confirmed were still current.
+ *
+ * @fn NINetworkImageLoader::numberOfNotModifiedResponses
+ */
+
+/**
+ * The number of image bytes that did not have to be downloaded thanks to the response cache.
+ *
+ * Counts the full size of every image served from the response cache, whether or not the
+ * server was asked to revalidate it.
+ *
+ * @fn NINetworkImageLoader::numberOfBytesSavedByResponseCache
+ */
+
+/** @name Loading Images */
+
+/**
+ * Loads the image at the given URL.
+ *
+ * The response is turned into an image by the response serializer on a background queue, so
+ * an NIImageResponseSerializer may crop and resize the image there as well.
+ *
+ * @param url                 The URL of the image. File URLs are supported.
+ * @param responseSerializer  Turns the response into an image. nil uses an
+ *                            AFImageResponseSerializer.
+ * @param progress            Called on the main queue as the image downloads. May be nil.
+ * @param completion          Called on the main queue with the image or an error. Not called
+ *                            if the request is cancelled.
+ *
+ * If the URL is already being loaded this request waits on that download. Requests whose
+ * serializers are NIImageResponseSerializers with equal processing keys, or plain
+ * AFImageResponseSerializers, are given the same image. Any other serializer processes the
+ * response on its own.
+ *
+ * @returns A request that may be used to cancel loading the image.
+ * @fn NINetworkImageLoader::loadImageWithURL:responseSerializer:progress:completion:
+ */
+
+/**
+ * Loads the image at the given URL, handing out partially downloaded images along the way.
+ *
+ * As the image downloads, the bytes received so far are decoded in the background. Progressive
+ * JPEGs are decoded one scan at a time, so each partial image is the whole image at a lower
+ * quality. Other images are decoded as far as their rows have arrived. Each partial image is
+ * processed by the response serializer the same way the complete image will be, so an
+ * NIImageResponseSerializer crops and scales it for display as well.
+ *
+ * Partial images are decoded at most once every minimumPartialImageInterval. The partial image
+ * block is never called after the completion block, nor once the request has been cancelled.
+ * Images that are served from the response cache are not loaded incrementally.
+ *
+ * @param partialImage  Called on the main queue with each partial image. May be nil.
+ * @fn NINetworkImageLoader::loadImageWithURL:responseSerializer:progress:partialImage:completion:
+ */
+
+/**
+ * The least amount of time between two partial images of the same download.
+ *
+ * Decoding an image is expensive, so partial images are only decoded once this much time has
+ * passed since the last one.
+ *
+ * By default this is 0.1 seconds.
+ *
+ * @fn NINetworkImageLoader::minimumPartialImageInterval
+ */
+
+/**
+ * Cancels every request and invalidates the loader's session.
+ *
+ * The loader's session keeps the loader alive until it is invalidated, so loaders other than
+ * the shared loader must be invalidated once they are no longer needed.
+ *
+ * @fn NINetworkImageLoader::invalidate
+ */
+
+/** @name Prioritizing a Request */
+
+/**
+ * How urgently the image is needed.
+ *
+ * Pending requests are sent highest priority first, and the priority of requests in flight is
+ * passed on to their URL session tasks. Requests for the same URL share the priority of the most
+ * urgent one. The priority may be changed at any time from the main thread, for example as the
+ * image scrolls in and out of view.
+ *
+ * By default this is NINetworkImagePriorityVisible.
+ *
+ * @fn NINetworkImageLoaderRequest::priority
+ */
+
+/** @name Cancelling a Request */
+
+/**
+ * Cancels the request.
+ *
+ * The request's completion block is not called. The download that the request was waiting on
+ * is only cancelled once no other requests are waiting on it. A download that has not been
+ * sent yet is then removed from its host's queue.
+ *
+ * @fn NINetworkImageLoaderRequest::cancel
+ */
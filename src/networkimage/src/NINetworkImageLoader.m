@@ -0,0 +1,1000 @@
+//
+// Copyright 2011-2014 NimbusKit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import "NINetworkImageLoader.h"
+
+#import "AFNetworking.h"
+#import "NIImageProcessing.h"
+#import "NIImageResponseSerializer.h"
+#import "NimbusCore.h"
+
+#import <ImageIO/ImageIO.h>
+#import <QuartzCore/QuartzCore.h>
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "Nimbus requires ARC support."
+#endif
+
+static NINetworkImageLoader* sSharedLoader = nil;
+
+NSOperationQueuePriority NINetworkImageQueuePriorityForPriority(NINetworkImagePriority priority) {
+  switch (priority) {
+    case NINetworkImagePriorityVisible:
+      return NSOperationQueuePriorityHigh;
+    case NINetworkImagePriorityNearVisible:
+      return NSOperationQueuePriorityNormal;
+    case NINetworkImagePriorityPrefetch:
+      return NSOperationQueuePriorityLow;
+  }
+  return NSOperationQueuePriorityNormal;
+}
+
+// Validators are stored next to the response data under this prefix.
+static NSString* const kResponseMetadataPrefix = @"NINetworkImageLoaderMetadata:";
+
+// A response stored in the loader's response cache, and the validators needed to revalidate it.
+@interface NINetworkImageLoaderCachedResponse : NSObject
++ (instancetype)cachedResponseForURL:(NSURL *)url inCache:(NIDiskCache *)cache;
+// Returns nil if the response may not be cached.
+- (id)initWithURL:(NSURL *)url response:(NSHTTPURLResponse *)response data:(NSData *)data;
+@property (nonatomic, readonly, copy) NSURL* url;
+@property (nonatomic, readonly, copy) NSData* data;
+@property (nonatomic, readonly, copy) NSDictionary* headers;
+@property (nonatomic, readonly, strong) NSDate* expirationDate;
+// A 200 response with the stored headers.
+- (NSHTTPURLResponse *)response;
+- (BOOL)isFresh;
+- (NSString *)entityTag;
+- (NSString *)lastModified;
+// Applies the headers of a 304 response. Returns NO if the response may no longer be cached.
+- (BOOL)updateWithNotModifiedResponse:(NSHTTPURLResponse *)response;
+- (void)storeInCache:(NIDiskCache *)cache includingData:(BOOL)includingData;
+@end
+
+// A single download of a URL that any number of requests may be waiting on.
+@interface NINetworkImageLoaderFetch : NSObject
+- (id)initWithURL:(NSURL *)url host:(NSString *)host;
+@property (nonatomic, readonly, copy) NSURL* url;
+@property (nonatomic, readonly, copy) NSString* host;
+// The requests waiting on this fetch that have not been cancelled. Guarded by the loader.
+@property (nonatomic, readonly, strong) NSMutableArray* requests;
+// Set once the fetch has been sent. Guarded by the loader.
+@property (nonatomic, strong) NSURLSessionDataTask* task;
+// The stored response that the fetch is revalidating, if any.
+@property (nonatomic, strong) NINetworkImageLoaderCachedResponse* cachedResponse;
+// Whether the task was suspended to make room for a more urgent fetch. Guarded by the loader.
+@property (nonatomic, assign, getter=isSuspended) BOOL suspended;
+// Whether the response cache is being read for the fetch. The fetch holds its slot, but has no
+// task yet. Guarded by the loader.
+@property (nonatomic, assign, getter=isLookingUpCachedResponse) BOOL lookingUpCachedResponse;
+// The priority of the most urgent request waiting on this fetch. Guarded by the loader.
+- (NINetworkImagePriority)priority;
+
+// The body received so far. Only kept while a request wants partial images, and set to NSNull
+// if bytes were missed before any request wanted them. Guarded by the loader.
+@property (nonatomic, strong) id receivedData;
+// When the last partial image was decoded. Guarded by the loader.
+@property (nonatomic, assign) CFTimeInterval partialImageTime;
+// Whether a partial image is being decoded now. Guarded by the loader.
+@property (nonatomic, assign, getter=isDecodingPartialImage) BOOL decodingPartialImage;
+// Whether any request waiting on this fetch wants partial images. Guarded by the loader.
+- (BOOL)wantsPartialImages;
+// Decodes the received data incrementally. Only used on the loader's partial image queue.
+- (CGImageSourceRef)incrementalImageSource;
+@end
+
+@interface NINetworkImageLoaderRequest()
+- (id)initWithURL:(NSURL *)url loader:(NINetworkImageLoader *)loader;
+@property (nonatomic, readonly, copy) NSString* host;
+@property (nonatomic, weak) NINetworkImageLoader* loader;
+@property (nonatomic, strong) AFHTTPResponseSerializer* responseSerializer;
+@property (nonatomic, copy) NINetworkImageLoaderProgressBlock progress;
+@property (nonatomic, copy) NINetworkImageLoaderPartialImageBlock partialImage;
+@property (nonatomic, copy) NINetworkImageLoaderCompletionBlock completion;
+// The fetch this request is waiting on. Guarded by the loader.
+@property (nonatomic, strong) NINetworkImageLoaderFetch* fetch;
+// Read from the loader's queues without holding the loader's lock.
+@property (atomic, assign, getter=isCancelled) BOOL cancelled;
+@end
+
+@interface NINetworkImageLoader()
+@property (nonatomic, strong) AFHTTPSessionManager* sessionManager;
+// Every fetch that still has requests waiting on it, by URL. New requests for one of these URLs
+// wait on the existing fetch instead of starting another.
+@property (nonatomic, strong) NSMutableDictionary* fetches;
+// Fetches that have not been sent yet, by host, in the order they were made.
+@property (nonatomic, strong) NSMutableDictionary* pendingFetches;
+// The fetches in flight and their hosts, counted once per fetch.
+@property (nonatomic, strong) NSMutableSet* activeFetches;
+@property (nonatomic, strong) NSCountedSet* activeHosts;
+@property (nonatomic, assign) NSUInteger numberOfResponseCacheHits;
+@property (nonatomic, assign) NSUInteger numberOfNotModifiedResponses;
+@property (nonatomic, assign) unsigned long long numberOfBytesSavedByResponseCache;
+// Decodes partial images one at a time, in the background.
+@property (nonatomic, strong) dispatch_queue_t partialImageQueue;
+- (void)cancelRequest:(NINetworkImageLoaderRequest *)request;
+- (void)requestPriorityDidChange:(NINetworkImageLoaderRequest *)request;
+@end
+
+
+@implementation NINetworkImageLoader
+
++ (NINetworkImageLoader *)sharedLoader {
+  @synchronized(self) {
+    if (nil == sSharedLoader) {
+      sSharedLoader = [[NINetworkImageLoader alloc] initWithSessionConfiguration:nil];
+    }
+    return sSharedLoader;
+  }
+}
+
++ (void)setSharedLoader:(NINetworkImageLoader *)loader {
+  @synchronized(self) {
+    sSharedLoader = loader;
+  }
+}
+
+- (id)init {
+  return [self initWithSessionConfiguration:nil];
+}
+
+- (id)initWithSessionConfiguration:(NSURLSessionConfiguration *)configuration {
+  if ((self = [super init])) {
+    _maxNumberOfConcurrentRequestsPerHost = 6;
+
+    if (nil == configuration) {
+      configuration = [NSURLSessionConfiguration defaultSessionConfiguration];
+    }
+    configuration.HTTPMaximumConnectionsPerHost = MAX(configuration.HTTPMaximumConnectionsPerHost,
+                                                      (NSInteger)_maxNumberOfConcurrentRequestsPerHost);
+
+    _sessionManager = [[AFHTTPSessionManager alloc] initWithSessionConfiguration:configuration];
+    // Responses are turned into images by each request's own serializer.
+    _sessionManager.responseSerializer = [AFHTTPResponseSerializer serializer];
+    // Decoding and resizing images must not happen on the main queue.
+    _sessionManager.completionQueue = dispatch_get_global_queue(QOS_CLASS_UTILITY, 0);
+
+    _imageProcessingQueue = [Nimbus imageDecodingQueue];
+    _minimumPartialImageInterval = 0.1;
+    _partialImageQueue = dispatch_queue_create("com.nimbuskit.networkimageloader.partialimages",
+                                               DISPATCH_QUEUE_SERIAL);
+    dispatch_set_target_queue(_partialImageQueue, dispatch_get_global_queue(QOS_CLASS_UTILITY, 0));
+
+    // The session manager keeps the whole body for the completion handler. This sees each chunk
+    // as it arrives.
+    __weak NINetworkImageLoader* weakSelf = self;
+    [_sessionManager setDataTaskDidReceiveDataBlock:^(NSURLSession* session,
+                                                      NSURLSessionDataTask* dataTask,
+                                                      NSData* data) {
+      [weakSelf dataTask:dataTask didReceiveData:data];
+    }];
+
+    _fetches = [[NSMutableDictionary alloc] init];
+    _pendingFetches = [[NSMutableDictionary alloc] init];
+    _activeFetches = [[NSMutableSet alloc] init];
+    _activeHosts = [[NSCountedSet alloc] init];
+  }
+  return self;
+}
+
+- (NSString *)description {
+  @synchronized(self) {
+    return [NSString stringWithFormat:
+            @"<%@"
+            @" activeHosts: %@"
+            @" fetches: %@"
+            @">",
+            [super description],
+            self.activeHosts,
+            self.fetches];
+  }
+}
+
+#pragma mark - Private
+
+// Requests whose serializers have equal processing keys are given the same image, so the
+// response only needs to be processed once for all of them.
++ (id<NSCopying>)processingKeyForResponseSerializer:(AFHTTPResponseSerializer *)serializer {
+  if ([serializer isKindOfClass:[NIImageResponseSerializer class]]) {
+    return [(NIImageResponseSerializer *)serializer processingKey];
+  }
+  if ([serializer isMemberOfClass:[AFImageResponseSerializer class]]) {
+    return NSStringFromClass([serializer class]);
+  }
+  // Nothing is known about other serializers, so each one processes the response on its own.
+  return [NSValue valueWithNonretainedObject:serializer];
+}
+
++ (float)taskPriorityForPriority:(NINetworkImagePriority)priority {
+  switch (priority) {
+    case NINetworkImagePriorityVisible:
+      return NSURLSessionTaskPriorityHigh;
+    case NINetworkImagePriorityNearVisible:
+      return NSURLSessionTaskPriorityDefault;
+    case NINetworkImagePriorityPrefetch:
+      return NSURLSessionTaskPriorityLow;
+  }
+  return NSURLSessionTaskPriorityDefault;
+}
+
+// Sends as many of the host's pending fetches as the host's limit allows, most urgent first.
+- (void)sendPendingFetchesForHost:(NSString *)host {
+  @synchronized(self) {
+    NSMutableArray* pendingFetches = self.pendingFetches[host];
+    while (pendingFetches.count > 0) {
+      // The earliest of the most urgent fetches.
+      NINetworkImageLoaderFetch* fetch = nil;
+      for (NINetworkImageLoaderFetch* pendingFetch in pendingFetches) {
+        if (nil == fetch || pendingFetch.priority > fetch.priority) {
+          fetch = pendingFetch;
+        }
+      }
+
+      if ([self.activeHosts countForObject:host] >= self.maxNumberOfConcurrentRequestsPerHost
+          && ![self suspendFetchForHost:host toMakeRoomForFetch:fetch]) {
+        break;
+      }
+      [pendingFetches removeObjectIdenticalTo:fetch];
+      [self sendFetch:fetch];
+    }
+    if (0 == pendingFetches.count) {
+      [self.pendingFetches removeObjectForKey:host];
+    }
+  }
+}
+
+// Suspends the least urgent fetch in flight to the host if it is less urgent than the given
+// visible fetch. Returns NO if nothing was suspended.
+- (BOOL)suspendFetchForHost:(NSString *)host toMakeRoomForFetch:(NINetworkImageLoaderFetch *)fetch {
+  @synchronized(self) {
+    if (!self.suspendsLowerPriorityRequests || NINetworkImagePriorityVisible != fetch.priority) {
+      return NO;
+    }
+
+    NINetworkImageLoaderFetch* leastUrgentFetch = nil;
+    for (NINetworkImageLoaderFetch* activeFetch in self.activeFetches) {
+      if ([activeFetch.host isEqualToString:host]
+          && !activeFetch.isLookingUpCachedResponse
+          && (nil == leastUrgentFetch || activeFetch.priority < leastUrgentFetch.priority)) {
+        leastUrgentFetch = activeFetch;
+      }
+    }
+    if (nil == leastUrgentFetch || leastUrgentFetch.priority >= fetch.priority) {
+      return NO;
+    }
+
+    [leastUrgentFetch.task suspend];
+    leastUrgentFetch.suspended = YES;
+    [self.activeFetches removeObject:leastUrgentFetch];
+    [self.activeHosts removeObject:host];
+
+    // Suspended fetches are resumed before fetches of the same priority that were never sent.
+    [self.pendingFetches[host] insertObject:leastUrgentFetch atIndex:0];
+    return YES;
+  }
+}
+
+- (void)sendFetch:(NINetworkImageLoaderFetch *)fetch {
+  @synchronized(self) {
+    [self.activeFetches addObject:fetch];
+    [self.activeHosts addObject:fetch.host];
+
+    if (fetch.isSuspended) {
+      fetch.suspended = NO;
+      fetch.task.priority = [[self class] taskPriorityForPriority:fetch.priority];
+      [fetch.task resume];
+      return;
+    }
+
+    NIDiskCache* responseCache = self.responseCache;
+    if (nil == responseCache || fetch.url.isFileURL) {
+      [self startTaskForFetch:fetch responseCache:nil cachedResponse:nil];
+      return;
+    }
+
+    // Reading the response cache touches the disk, so it is done in the background while the
+    // fetch holds its slot.
+    fetch.lookingUpCachedResponse = YES;
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+      NINetworkImageLoaderCachedResponse* cachedResponse =
+          [NINetworkImageLoaderCachedResponse cachedResponseForURL:fetch.url inCache:responseCache];
+      @synchronized(self) {
+        fetch.lookingUpCachedResponse = NO;
+
+        // Every request was cancelled, or the loader was invalidated, while the cache was read.
+        if (self.fetches[fetch.url] != fetch) {
+          [self.activeFetches removeObject:fetch];
+          [self.activeHosts removeObject:fetch.host];
+          [self sendPendingFetchesForHost:fetch.host];
+          return;
+        }
+
+        if (![cachedResponse isFresh]) {
+          [self startTaskForFetch:fetch responseCache:responseCache cachedResponse:cachedResponse];
+          return;
+        }
+        self.numberOfResponseCacheHits++;
+        self.numberOfBytesSavedByResponseCache += cachedResponse.data.length;
+      }
+      [self finishFetch:fetch withResponse:[cachedResponse response] data:cachedResponse.data error:nil];
+    });
+  }
+}
+
+// Sends the fetch's task. If the fetch has a stale response in the response cache, the server is
+// asked to only send the image if it has changed.
+- (void)startTaskForFetch:(NINetworkImageLoaderFetch *)fetch
+            responseCache:(NIDiskCache *)responseCache
+           cachedResponse:(NINetworkImageLoaderCachedResponse *)cachedResponse {
+  @synchronized(self) {
+    NSMutableURLRequest* urlRequest = [NSMutableURLRequest requestWithURL:fetch.url];
+    if (nil != responseCache) {
+      // The response cache takes the place of the session's URL cache.
+      urlRequest.cachePolicy = NSURLRequestReloadIgnoringLocalCacheData;
+
+      // Ask the server to only send the image if it has changed.
+      fetch.cachedResponse = cachedResponse;
+      NSString* entityTag = [cachedResponse entityTag];
+      NSString* lastModified = [cachedResponse lastModified];
+      if (nil != entityTag) {
+        [urlRequest setValue:entityTag forHTTPHeaderField:@"If-None-Match"];
+      }
+      if (nil != lastModified) {
+        [urlRequest setValue:lastModified forHTTPHeaderField:@"If-Modified-Since"];
+      }
+    }
+
+    fetch.task = [self.sessionManager dataTaskWithRequest:urlRequest
+                                           uploadProgress:nil
+                                         downloadProgress:^(NSProgress* downloadProgress) {
+      NSArray* requests = nil;
+      @synchronized(self) {
+        requests = [fetch.requests copy];
+      }
+      int64_t readBytes = downloadProgress.completedUnitCount;
+      int64_t totalBytes = downloadProgress.totalUnitCount;
+      for (NINetworkImageLoaderRequest* request in requests) {
+        NINetworkImageLoaderProgressBlock progress = request.progress;
+        if (nil != progress) {
+          dispatch_async(dispatch_get_main_queue(), ^{
+            if (!request.isCancelled) {
+              progress(readBytes, totalBytes);
+            }
+          });
+        }
+      }
+    } completionHandler:^(NSURLResponse* response, id responseObject, NSError* error) {
+      // This runs on the session manager's completion queue, in the background.
+      NSData* data = responseObject;
+      NSHTTPURLResponse* httpResponse = ([response isKindOfClass:[NSHTTPURLResponse class]]
+                                         ? (NSHTTPURLResponse *)response
+                                         : nil);
+      NINetworkImageLoaderCachedResponse* cachedResponse = fetch.cachedResponse;
+
+      if (nil != cachedResponse && 304 == httpResponse.statusCode) {
+        // The stored image is still current. The session's serializer reports 304 as an error.
+        if ([cachedResponse updateWithNotModifiedResponse:httpResponse]) {
+          [cachedResponse storeInCache:responseCache includingData:NO];
+        } else {
+          NSString* name = cachedResponse.url.absoluteString;
+          [responseCache removeDataWithName:name];
+          [responseCache removeDataWithName:[kResponseMetadataPrefix stringByAppendingString:name]];
+        }
+        @synchronized(self) {
+          self.numberOfNotModifiedResponses++;
+          self.numberOfBytesSavedByResponseCache += cachedResponse.data.length;
+        }
+        response = [cachedResponse response];
+        data = cachedResponse.data;
+        error = nil;
+
+      } else if (nil == error && nil != responseCache && nil != httpResponse) {
+        NINetworkImageLoaderCachedResponse* newCachedResponse =
+            [[NINetworkImageLoaderCachedResponse alloc] initWithURL:fetch.url
+                                                           response:httpResponse
+                                                               data:data];
+        [newCachedResponse storeInCache:responseCache includingData:YES];
+      }
+
+      [self finishFetch:fetch withResponse:response data:data error:error];
+    }];
+    fetch.task.priority = [[self class] taskPriorityForPriority:fetch.priority];
+    [fetch.task resume];
+  }
+}
+
+// Keeps the bytes of fetches that have requests waiting for partial images, and decodes a partial
+// image whenever enough time has passed since the last one. Called on the session's queue.
+- (void)dataTask:(NSURLSessionDataTask *)dataTask didReceiveData:(NSData *)data {
+  NINetworkImageLoaderFetch* fetch = nil;
+  NSData* receivedData = nil;
+  @synchronized(self) {
+    for (NINetworkImageLoaderFetch* activeFetch in self.activeFetches) {
+      if (activeFetch.task == dataTask) {
+        fetch = activeFetch;
+        break;
+      }
+    }
+    if (nil == fetch || ![fetch wantsPartialImages] || [fetch.receivedData isKindOfClass:[NSNull class]]) {
+      return;
+    }
+
+    // Error pages and 304 responses are not images.
+    NSHTTPURLResponse* response = (NSHTTPURLResponse *)dataTask.response;
+    if ([response isKindOfClass:[NSHTTPURLResponse class]]
+        && (response.statusCode < 200 || response.statusCode >= 300)) {
+      return;
+    }
+
+    if (nil == fetch.receivedData) {
+      // A request that wants partial images joined after the download had started.
+      if (dataTask.countOfBytesReceived > (int64_t)data.length) {
+        fetch.receivedData = [NSNull null];
+        return;
+      }
+      fetch.receivedData = [NSMutableData data];
+    }
+    [fetch.receivedData appendData:data];
+
+    CFTimeInterval now = CACurrentMediaTime();
+    if (fetch.isDecodingPartialImage || now - fetch.partialImageTime < self.minimumPartialImageInterval) {
+      return;
+    }
+    fetch.decodingPartialImage = YES;
+    fetch.partialImageTime = now;
+    receivedData = [fetch.receivedData copy];
+  }
+
+  dispatch_async(self.partialImageQueue, ^{
+    [self decodePartialImageForFetch:fetch fromData:receivedData];
+  });
+}
+
+// Decodes as much of the image as has been received and hands it to every request waiting on the
+// fetch for partial images, processed as each of them asked. Called on the partial image queue.
+- (void)decodePartialImageForFetch:(NINetworkImageLoaderFetch *)fetch fromData:(NSData *)data {
+  // Progressive JPEGs decode to a blurry image that sharpens with each scan. Other images decode
+  // as far down as their rows have arrived.
+  CGImageSourceRef source = [fetch incrementalImageSource];
+  CGImageSourceUpdateData(source, (__bridge CFDataRef)data, false);
+
+  UIImage* image = [NIImageProcessing imageFromImageSource:source decode:NO];
+
+  NSMutableArray* requests = [NSMutableArray array];
+  @synchronized(self) {
+    fetch.decodingPartialImage = NO;
+    for (NINetworkImageLoaderRequest* request in fetch.requests) {
+      if (nil != request.partialImage) {
+        [requests addObject:request];
+      }
+    }
+  }
+  if (nil == image) {
+    return;
+  }
+
+  NSMutableDictionary* processedImages = [NSMutableDictionary dictionary];
+  for (NINetworkImageLoaderRequest* request in requests) {
+    id<NSCopying> key = [[self class] processingKeyForResponseSerializer:request.responseSerializer];
+    UIImage* processedImage = processedImages[key];
+    if (nil == processedImage) {
+      processedImage = image;
+      if ([request.responseSerializer isKindOfClass:[NIImageResponseSerializer class]]) {
+        processedImage = [(NIImageResponseSerializer *)request.responseSerializer imageForDisplayFromImage:image];
+      }
+      processedImages[key] = processedImage;
+    }
+
+    dispatch_async(dispatch_get_main_queue(), ^{
+      // The complete image may have been handed out while this one was being decoded.
+      BOOL isWaiting = NO;
+      @synchronized(self) {
+        isWaiting = (request.fetch == fetch && nil != fetch.task);
+      }
+      NINetworkImageLoaderPartialImageBlock partialImage = request.partialImage;
+      if (isWaiting && !request.isCancelled && nil != partialImage) {
+        partialImage(processedImage);
+      }
+    });
+  }
+}
+
+// Processes the response for every request waiting on the fetch. Called in the background.
+- (void)finishFetch:(NINetworkImageLoaderFetch *)fetch
+       withResponse:(NSURLResponse *)response
+               data:(NSData *)data
+              error:(NSError *)error {
+  NSArray* requests = [self didFinishFetch:fetch];
+
+  // Group the waiting requests by the image they asked for, keeping the order they were made.
+  NSMutableDictionary* groups = [NSMutableDictionary dictionary];
+  NSMutableArray* processingKeys = [NSMutableArray array];
+  for (NINetworkImageLoaderRequest* request in requests) {
+    id<NSCopying> key = [[self class] processingKeyForResponseSerializer:request.responseSerializer];
+    NSMutableArray* group = groups[key];
+    if (nil == group) {
+      group = [NSMutableArray array];
+      groups[key] = group;
+      [processingKeys addObject:key];
+    }
+    [group addObject:request];
+  }
+
+  // Processing decodes and resizes the image, so it is done on the bounded processing queue
+  // rather than on the session's completion queue, most urgent images first.
+  for (id<NSCopying> key in processingKeys) {
+    NSArray* group = groups[key];
+    NINetworkImageLoaderRequest* firstRequest = group[0];
+    NINetworkImagePriority priority = NINetworkImagePriorityPrefetch;
+    for (NINetworkImageLoaderRequest* request in group) {
+      priority = MAX(priority, request.priority);
+    }
+
+    NSBlockOperation* processingOperation = [NSBlockOperation blockOperationWithBlock:^{
+      BOOL isCancelled = YES;
+      for (NINetworkImageLoaderRequest* request in group) {
+        isCancelled = isCancelled && request.isCancelled;
+      }
+      if (isCancelled) {
+        return;
+      }
+
+      UIImage* image = nil;
+      NSError* groupError = error;
+      if (nil == groupError) {
+        image = [firstRequest.responseSerializer responseObjectForResponse:response
+                                                                      data:data
+                                                                     error:&groupError];
+      }
+
+      dispatch_async(dispatch_get_main_queue(), ^{
+        for (NINetworkImageLoaderRequest* request in group) {
+          NINetworkImageLoaderCompletionBlock completion = request.completion;
+          if (!request.isCancelled && nil != completion) {
+            completion(image, groupError);
+          }
+        }
+      });
+    }];
+    processingOperation.queuePriority = NINetworkImageQueuePriorityForPriority(priority);
+    [self.imageProcessingQueue addOperation:processingOperation];
+  }
+}
+
+// Frees up the fetch's slot and returns the requests that were still waiting on it.
+- (NSArray *)didFinishFetch:(NINetworkImageLoaderFetch *)fetch {
+  @synchronized(self) {
+    NSArray* requests = [fetch.requests copy];
+    for (NINetworkImageLoaderRequest* request in requests) {
+      request.fetch = nil;
+    }
+    [fetch.requests removeAllObjects];
+    fetch.receivedData = nil;
+
+    // A fetch whose requests were all cancelled may already have been replaced by a new one.
+    if (self.fetches[fetch.url] == fetch) {
+      [self.fetches removeObjectForKey:fetch.url];
+    }
+    fetch.task = nil;
+    if ([self.activeFetches containsObject:fetch]) {
+      [self.activeFetches removeObject:fetch];
+      [self.activeHosts removeObject:fetch.host];
+    }
+    [self sendPendingFetchesForHost:fetch.host];
+    return requests;
+  }
+}
+
+- (void)cancelRequest:(NINetworkImageLoaderRequest *)request {
+  @synchronized(self) {
+    if (request.isCancelled) {
+      return;
+    }
+    request.cancelled = YES;
+
+    NINetworkImageLoaderFetch* fetch = request.fetch;
+    request.fetch = nil;
+    [fetch.requests removeObjectIdenticalTo:request];
+
+    // The fetch is only cancelled once nothing is waiting on it anymore.
+    if (nil == fetch || fetch.requests.count > 0) {
+      return;
+    }
+    [self.fetches removeObjectForKey:fetch.url];
+
+    // The task's completion handler frees up the slot of a fetch in flight.
+    [fetch.task cancel];
+
+    if (nil == fetch.task || fetch.isSuspended) {
+      NSMutableArray* pendingFetches = self.pendingFetches[fetch.host];
+      [pendingFetches removeObjectIdenticalTo:fetch];
+      if (0 == pendingFetches.count) {
+        [self.pendingFetches removeObjectForKey:fetch.host];
+      }
+    }
+  }
+}
+
+- (void)requestPriorityDidChange:(NINetworkImageLoaderRequest *)request {
+  @synchronized(self) {
+    NINetworkImageLoaderFetch* fetch = request.fetch;
+    if (nil == fetch) {
+      return;
+    }
+    if (nil != fetch.task && !fetch.isSuspended) {
+      fetch.task.priority = [[self class] taskPriorityForPriority:fetch.priority];
+    }
+    [self sendPendingFetchesForHost:fetch.host];
+  }
+}
+
+#pragma mark - Public
+
+- (void)setImageProcessingQueue:(NSOperationQueue *)queue {
+  // Don't allow a nil processing queue.
+  NIDASSERT(nil != queue);
+  if (nil == queue) {
+    queue = [Nimbus imageDecodingQueue];
+  }
+  _imageProcessingQueue = queue;
+}
+
+- (NINetworkImageLoaderRequest *)loadImageWithURL:(NSURL *)url
+                               responseSerializer:(AFHTTPResponseSerializer *)responseSerializer
+                                         progress:(NINetworkImageLoaderProgressBlock)progress
+                                       completion:(NINetworkImageLoaderCompletionBlock)completion {
+  return [self loadImageWithURL:url
+             responseSerializer:responseSerializer
+                       progress:progress
+                   partialImage:nil
+                     completion:completion];
+}
+
+- (NINetworkImageLoaderRequest *)loadImageWithURL:(NSURL *)url
+                               responseSerializer:(AFHTTPResponseSerializer *)responseSerializer
+                                         progress:(NINetworkImageLoaderProgressBlock)progress
+                                     partialImage:(NINetworkImageLoaderPartialImageBlock)partialImage
+                                       completion:(NINetworkImageLoaderCompletionBlock)completion {
+  NIDASSERT(nil != url);
+  if (nil == url) {
+    return nil;
+  }
+
+  NINetworkImageLoaderRequest* request = [[NINetworkImageLoaderRequest alloc] initWithURL:url
+                                                                                   loader:self];
+  request.responseSerializer = (nil != responseSerializer
+                                ? responseSerializer
+                                : [AFImageResponseSerializer serializer]);
+  request.progress = progress;
+  request.partialImage = partialImage;
+  request.completion = completion;
+
+  @synchronized(self) {
+    NSURL* fetchURL = [url absoluteURL];
+    NINetworkImageLoaderFetch* fetch = self.fetches[fetchURL];
+    if (nil == fetch) {
+      fetch = [[NINetworkImageLoaderFetch alloc] initWithURL:fetchURL host:request.host];
+      self.fetches[fetchURL] = fetch;
+
+      NSMutableArray* pendingFetches = self.pendingFetches[fetch.host];
+      if (nil == pendingFetches) {
+        pendingFetches = [NSMutableArray array];
+        self.pendingFetches[fetch.host] = pendingFetches;
+      }
+      [pendingFetches addObject:fetch];
+    }
+    [fetch.requests addObject:request];
+    request.fetch = fetch;
+
+    [self sendPendingFetchesForHost:fetch.host];
+  }
+  return request;
+}
+
+- (void)invalidate {
+  @synchronized(self) {
+    for (NINetworkImageLoaderFetch* fetch in [self.fetches allValues]) {
+      for (NINetworkImageLoaderRequest* request in fetch.requests) {
+        request.cancelled = YES;
+        request.fetch = nil;
+      }
+      [fetch.requests removeAllObjects];
+    }
+    [self.fetches removeAllObjects];
+    [self.pendingFetches removeAllObjects];
+    [self.sessionManager invalidateSessionCancelingTasks:YES];
+  }
+}
+
+- (NSUInteger)numberOfResponseCacheHits {
+  @synchronized(self) {
+    return _numberOfResponseCacheHits;
+  }
+}
+
+- (NSUInteger)numberOfNotModifiedResponses {
+  @synchronized(self) {
+    return _numberOfNotModifiedResponses;
+  }
+}
+
+- (unsigned long long)numberOfBytesSavedByResponseCache {
+  @synchronized(self) {
+    return _numberOfBytesSavedByResponseCache;
+  }
+}
+
+@end
+
+
+@implementation NINetworkImageLoaderFetch {
+  CGImageSourceRef _incrementalImageSource;
+}
+
+- (void)dealloc {
+  if (NULL != _incrementalImageSource) {
+    CFRelease(_incrementalImageSource);
+  }
+}
+
+- (id)initWithURL:(NSURL *)url host:(NSString *)host {
+  if ((self = [super init])) {
+    _url = [url copy];
+    _host = [host copy];
+    _requests = [[NSMutableArray alloc] init];
+  }
+  return self;
+}
+
+- (NINetworkImagePriority)priority {
+  NINetworkImagePriority priority = NINetworkImagePriorityPrefetch;
+  for (NINetworkImageLoaderRequest* request in self.requests) {
+    priority = MAX(priority, request.priority);
+  }
+  return priority;
+}
+
+- (BOOL)wantsPartialImages {
+  for (NINetworkImageLoaderRequest* request in self.requests) {
+    if (nil != request.partialImage) {
+      return YES;
+    }
+  }
+  return NO;
+}
+
+- (CGImageSourceRef)incrementalImageSource {
+  if (NULL == _incrementalImageSource) {
+    _incrementalImageSource = CGImageSourceCreateIncremental(NULL);
+  }
+  return _incrementalImageSource;
+}
+
+- (NSString *)description {
+  return [NSString stringWithFormat:
+          @"<%@"
+          @" url: %@"
+          @" numberOfRequests: %zd"
+          @">",
+          [super description],
+          self.url,
+          self.requests.count];
+}
+
+@end
+
+
+@implementation NINetworkImageLoaderRequest
+
+- (id)initWithURL:(NSURL *)url loader:(NINetworkImageLoader *)loader {
+  if ((self = [super init])) {
+    _url = [url copy];
+    _loader = loader;
+    _priority = NINetworkImagePriorityVisible;
+
+    // Requests without a host, such as file requests, share a queue.
+    _host = [url.host lowercaseString] ?: @"";
+  }
+  return self;
+}
+
+- (NSString *)description {
+  return [NSString stringWithFormat:
+          @"<%@"
+          @" url: %@"
+          @" cancelled: %@"
+          @">",
+          [super description],
+          self.url,
+          self.isCancelled ? @"YES" : @"NO"];
+}
+
+- (void)setPriority:(NINetworkImagePriority)priority {
+  if (_priority != priority) {
+    _priority = priority;
+    [self.loader requestPriorityDidChange:self];
+  }
+}
+
+- (void)cancel {
+  [self.loader cancelRequest:self];
+}
+
+@end
+
+
+@implementation NINetworkImageLoaderCachedResponse
+
++ (NSDateFormatter *)HTTPDateFormatter {
+  static NSDateFormatter* formatter = nil;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    formatter = [[NSDateFormatter alloc] init];
+    formatter.locale = [NSLocale localeWithLocaleIdentifier:@"en_US_POSIX"];
+    formatter.timeZone = [NSTimeZone timeZoneWithAbbreviation:@"GMT"];
+    formatter.dateFormat = @"EEE',' dd MMM yyyy HH':'mm':'ss 'GMT'";
+  });
+  return formatter;
+}
+
+// Returns the header's value regardless of the case of its name.
++ (NSString *)valueForHeader:(NSString *)header inHeaders:(NSDictionary *)headers {
+  for (NSString* name in headers) {
+    if (NSOrderedSame == [name caseInsensitiveCompare:header]) {
+      return headers[name];
+    }
+  }
+  return nil;
+}
+
+// Returns nil if the headers forbid storing the response, or the date after which the response
+// must be revalidated.
++ (NSDate *)expirationDateForHeaders:(NSDictionary *)headers {
+  NSString* cacheControl = [[self valueForHeader:@"Cache-Control" inHeaders:headers] lowercaseString];
+  if ([cacheControl rangeOfString:@"no-store"].length > 0) {
+    return nil;
+  }
+  if ([cacheControl rangeOfString:@"no-cache"].length > 0) {
+    return [NSDate date];
+  }
+
+  NSRange maxAgeRange = [cacheControl rangeOfString:@"max-age="];
+  if (maxAgeRange.length > 0) {
+    NSScanner* scanner = [NSScanner scannerWithString:cacheControl];
+    scanner.scanLocation = NSMaxRange(maxAgeRange);
+    NSInteger maxAge = 0;
+    if ([scanner scanInteger:&maxAge]) {
+      return [NSDate dateWithTimeIntervalSinceNow:MAX(0, maxAge)];
+    }
+  }
+
+  NSString* expires = [self valueForHeader:@"Expires" inHeaders:headers];
+  NSDate* expirationDate = (nil != expires
+                            ? [[self HTTPDateFormatter] dateFromString:expires]
+                            : nil);
+  // Responses without freshness information are revalidated every time they are used.
+  return expirationDate ?: [NSDate date];
+}
+
++ (instancetype)cachedResponseForURL:(NSURL *)url inCache:(NIDiskCache *)cache {
+  NSString* name = url.absoluteString;
+  NSData* metadata = [cache dataWithName:[kResponseMetadataPrefix stringByAppendingString:name]];
+  NSData* data = [cache dataWithName:name];
+  if (nil == metadata || nil == data) {
+    return nil;
+  }
+
+  NSDictionary* dictionary = [NSPropertyListSerialization propertyListWithData:metadata
+                                                                       options:NSPropertyListImmutable
+                                                                        format:NULL
+                                                                         error:NULL];
+  NSDictionary* headers = dictionary[@"headers"];
+  NSNumber* expirationTime = dictionary[@"expires"];
+  if (![headers isKindOfClass:[NSDictionary class]] || ![expirationTime isKindOfClass:[NSNumber class]]) {
+    return nil;
+  }
+
+  NINetworkImageLoaderCachedResponse* cachedResponse = [[self alloc] init];
+  cachedResponse->_url = [url copy];
+  cachedResponse->_data = data;
+  cachedResponse->_headers = [headers copy];
+  cachedResponse->_expirationDate = [NSDate dateWithTimeIntervalSince1970:[expirationTime doubleValue]];
+  return cachedResponse;
+}
+
+- (id)initWithURL:(NSURL *)url response:(NSHTTPURLResponse *)response data:(NSData *)data {
+  NSDate* expirationDate = [[self class] expirationDateForHeaders:response.allHeaderFields];
+  if (200 != response.statusCode || nil == data || nil == expirationDate) {
+    return nil;
+  }
+  if ((self = [super init])) {
+    _url = [url copy];
+    _data = [data copy];
+    _headers = [response.allHeaderFields copy];
+    _expirationDate = expirationDate;
+
+    // Responses that can neither be used as they are nor revalidated aren't worth keeping.
+    if (![self isFresh] && nil == [self entityTag] && nil == [self lastModified]) {
+      return nil;
+    }
+  }
+  return self;
+}
+
+- (NSHTTPURLResponse *)response {
+  return [[NSHTTPURLResponse alloc] initWithURL:self.url
+                                     statusCode:200
+                                    HTTPVersion:@"HTTP/1.1"
+                                   headerFields:self.headers];
+}
+
+- (BOOL)isFresh {
+  return [self.expirationDate timeIntervalSinceNow] > 0;
+}
+
+- (NSString *)entityTag {
+  return [[self class] valueForHeader:@"ETag" inHeaders:self.headers];
+}
+
+- (NSString *)lastModified {
+  return [[self class] valueForHeader:@"Last-Modified" inHeaders:self.headers];
+}
+
+- (BOOL)updateWithNotModifiedResponse:(NSHTTPURLResponse *)response {
+  // A 304 response's headers replace the stored ones, except for those describing the body.
+  NSMutableDictionary* headers = [self.headers mutableCopy];
+  [response.allHeaderFields enumerateKeysAndObjectsUsingBlock:^(NSString* name, NSString* value, BOOL* stop) {
+    if (NSOrderedSame == [name caseInsensitiveCompare:@"Content-Length"]
+        || NSOrderedSame == [name caseInsensitiveCompare:@"Content-Type"]) {
+      return;
+    }
+    for (NSString* existingName in [headers allKeys]) {
+      if (NSOrderedSame == [existingName caseInsensitiveCompare:name]) {
+        [headers removeObjectForKey:existingName];
+      }
+    }
+    headers[name] = value;
+  }];
+
+  NSDate* expirationDate = [[self class] expirationDateForHeaders:headers];
+  if (nil == expirationDate) {
+    return NO;
+  }
+  _headers = [headers copy];
+  _expirationDate = expirationDate;
+  return YES;
+}
+
+- (void)storeInCache:(NIDiskCache *)cache includingData:(BOOL)includingData {
+  NSDictionary* metadata = @{
+    @"headers": self.headers,
+    @"expires": @([self.expirationDate timeIntervalSince1970]),
+  };
+  NSData* metadataData = [NSPropertyListSerialization dataWithPropertyList:metadata
+                                                                    format:NSPropertyListBinaryFormat_v1_0
+                                                                   options:0
+                                                                     error:NULL];
+  if (nil == metadataData) {
+    return;
+  }
+  NSString* name = self.url.absoluteString;
+  if (includingData) {
+    [cache storeData:self.data withName:name];
+  }
+  [cache storeData:metadataData withName:[kResponseMetadataPrefix stringByAppendingString:name]];
+}
+
+@end
@@ -0,0 +1,129 @@
+//
+// Copyright 2011-2014 NimbusKit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+#import <UIKit/UIKit.h>
+
+#import "NINetworkImageView.h"
+#import "NimbusCore.h"
+
+@class NINetworkImageLoader;
+
+/**
+ * Loads the images of cells that show NINetworkImageViews before the cells are shown.
+ *
+ * Each image is loaded at NINetworkImagePriorityPrefetch, processed for the display size,
+ * content mode and crop rect of its NIImagePrefetchRequest, decoded on the imageDecodingQueue and
+ * stored in the memory cache under the name and variant info that a NINetworkImageView would
+ * use. An image view that is given the same path, size
+ * and content mode finds the decoded image in the memory cache. If the image is still loading
+ * when the image view asks for it, the image view's request waits on the prefetch and raises
+ * its priority.
+ *
+ * Assign a prefetcher to the imagePrefetcher property of NITableViewModel or
+ * NICollectionViewModel.
+ *
+ * @ingroup NimbusNetworkImage
+ */
+@interface NINetworkImagePrefetcher : NSObject <NIImagePrefetcher>
+
+@property (nonatomic, strong) NINetworkImageLoader* imageLoader;       // Default: [NINetworkImageLoader sharedLoader]
+@property (nonatomic, strong) NIImageMemoryCache* imageMemoryCache;    // Default: [Nimbus imageMemoryCache]
+@property (nonatomic, strong) NSOperationQueue* imageDecodingQueue;    // Default: [Nimbus imageDecodingQueue]
+
+// These must match the image views that will show the images.
+@property (nonatomic, assign) BOOL sizeForDisplay;                         // Default: YES
+@property (nonatomic, assign) NINetworkImageViewScaleOptions scaleOptions; // Default: NINetworkImageViewScaleToFitLeavesExcessAndScaleToFillCropsExcess
+@property (nonatomic, assign) CGInterpolationQuality interpolationQuality; // Default: kCGInterpolationDefault
+@property (nonatomic, assign) NIImagePixelFormat pixelFormat;               // Default: NIImagePixelFormatRGBA
+@property (nonatomic, assign) NSTimeInterval maxAge;                       // Default: 0
+
+- (void)prefetchImagesForObject:(id<NIImagePrefetchingObject>)object;
+- (void)cancelPrefetchingImagesForObject:(id<NIImagePrefetchingObject>)object;
+- (void)cancelAllPrefetching;
+
+@end
+
+/** @name Configuring the Prefetcher */
+
+/**
+ * The loader used to load images.
+ *
+ * Use the same loader as the image views so that image views can wait on prefetches that are
+ * still in flight.
+ *
+ * @fn NINetworkImagePrefetcher::imageLoader
+ */
+
+/**
+ * The memory cache that prefetched images are stored in.
+ *
+ * @fn NINetworkImagePrefetcher::imageMemoryCache
+ */
+
+/**
+ * The queue that prefetched images in NIImagePixelFormatRGBA are decoded on before they are
+ * stored in the memory cache.
+ *
+ * Prefetched images are decoded at the queue priority of NINetworkImagePriorityPrefetch so that
+ * they don't hold up images that are being displayed.
+ *
+ * @see NINetworkImageView::imageDecodingQueue
+ * @fn NINetworkImagePrefetcher::imageDecodingQueue
+ */
+
+/**
+ * Whether images are resized for display.
+ *
+ * This must match the sizeForDisplay of the image views that show the prefetched images. When
+ * disabled, the display size and content mode of each NIImagePrefetchRequest are ignored and the
+ * full image is stored under the name that such an image view looks up.
+ *
+ * By default this is YES.
+ *
+ * @see NINetworkImageView::sizeForDisplay
+ * @fn NINetworkImagePrefetcher::sizeForDisplay
+ */
+
+/**
+ * The maximum amount of time that a prefetched image will stay in memory.
+ *
+ * A value of 0 keeps the image until it is evicted.
+ *
+ * @fn NINetworkImagePrefetcher::maxAge
+ */
+
+/** @name Prefetching */
+
+/**
+ * Loads each of the object's images that is not in the memory cache yet.
+ *
+ * @fn NINetworkImagePrefetcher::prefetchImagesForObject:
+ */
+
+/**
+ * Cancels loading the object's images.
+ *
+ * Images that have already been loaded stay in the memory cache.
+ *
+ * @fn NINetworkImagePrefetcher::cancelPrefetchingImagesForObject:
+ */
+
+/**
+ * Cancels every prefetch that is in flight.
+ *
+ * @fn NINetworkImagePrefetcher::cancelAllPrefetching
+ */
@@ -0,0 +1,210 @@
+//
+// Copyright 2011-2014 NimbusKit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import "NINetworkImagePrefetcher.h"
+
+#import "NIImageProcessing.h"
+#import "NIImageResponseSerializer.h"
+#import "NINetworkImageLoader.h"
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "Nimbus requires ARC support."
+#endif
+
+@interface NINetworkImagePrefetcher()
+// The loader requests in flight for each object, keyed by the object's identity.
+@property (nonatomic, strong) NSMapTable* requestsByObject;
+@end
+
+
+@implementation NINetworkImagePrefetcher
+
+- (id)init {
+  if ((self = [super init])) {
+    _imageLoader = [NINetworkImageLoader sharedLoader];
+    _imageMemoryCache = [Nimbus imageMemoryCache];
+    _sizeForDisplay = YES;
+    _scaleOptions = NINetworkImageViewScaleToFitLeavesExcessAndScaleToFillCropsExcess;
+    _interpolationQuality = kCGInterpolationDefault;
+    _pixelFormat = NIImagePixelFormatRGBA;
+    _imageDecodingQueue = [Nimbus imageDecodingQueue];
+
+    _requestsByObject = [NSMapTable mapTableWithKeyOptions:(NSPointerFunctionsStrongMemory
+                                                            | NSPointerFunctionsObjectPointerPersonality)
+                                              valueOptions:NSPointerFunctionsStrongMemory];
+  }
+  return self;
+}
+
+- (void)dealloc {
+  [self cancelAllPrefetching];
+}
+
+- (void)setImageLoader:(NINetworkImageLoader *)imageLoader {
+  // Don't allow a nil image loader.
+  NIDASSERT(nil != imageLoader);
+  if (nil == imageLoader) {
+    imageLoader = [NINetworkImageLoader sharedLoader];
+  }
+  _imageLoader = imageLoader;
+}
+
+- (void)setImageDecodingQueue:(NSOperationQueue *)queue {
+  // Don't allow a nil decoding queue.
+  NIDASSERT(nil != queue);
+  if (nil == queue) {
+    queue = [Nimbus imageDecodingQueue];
+  }
+  _imageDecodingQueue = queue;
+}
+
+#pragma mark - NIImagePrefetcher
+
+- (void)prefetchImagesForObject:(id<NIImagePrefetchingObject>)object {
+  NIDASSERT([NSThread isMainThread]);
+  if (nil == self.imageMemoryCache || nil != [self.requestsByObject objectForKey:object]) {
+    return;
+  }
+
+  NSMutableArray* requests = [NSMutableArray array];
+  for (NIImagePrefetchRequest* prefetchRequest in [object imagePrefetchRequests]) {
+    NSURL* url = [NINetworkImageView URLForPathToNetworkImage:prefetchRequest.path];
+    if (nil == url) {
+      continue;
+    }
+    BOOL sizeForDisplay = self.sizeForDisplay;
+    NSString* cacheKey = nil;
+    if (sizeForDisplay) {
+      cacheKey = [NINetworkImageView cacheKeyForPathToNetworkImage:prefetchRequest.path
+                                                       displaySize:prefetchRequest.displaySize
+                                                          cropRect:prefetchRequest.cropRect
+                                                       contentMode:prefetchRequest.contentMode
+                                                      scaleOptions:self.scaleOptions
+                                                       pixelFormat:self.pixelFormat];
+    } else {
+      cacheKey = [NINetworkImageView cacheKeyForPathToNetworkImage:prefetchRequest.path
+                                                       pixelFormat:self.pixelFormat];
+    }
+    if ([self.imageMemoryCache containsObjectWithName:cacheKey]) {
+      continue;
+    }
+
+    // Process the image exactly as an image view would.
+    NIImageResponseSerializer* serializer = [NIImageResponseSerializer serializer];
+    serializer.imageScale = 1;
+    serializer.contentMode = sizeForDisplay ? prefetchRequest.contentMode : UIViewContentModeScaleToFill;
+    serializer.cropRect = prefetchRequest.cropRect;
+    serializer.displaySize = sizeForDisplay ? prefetchRequest.displaySize : CGSizeZero;
+    serializer.scaleOptions = self.scaleOptions;
+    serializer.interpolationQuality = self.interpolationQuality;
+    serializer.pixelFormat = self.pixelFormat;
+
+    NIImageMemoryCache* imageMemoryCache = self.imageMemoryCache;
+    NSOperationQueue* imageDecodingQueue = self.imageDecodingQueue;
+    NIImagePixelFormat pixelFormat = self.pixelFormat;
+    NINetworkImageViewScaleOptions scaleOptions = self.scaleOptions;
+    NSDate* expirationDate = (self.maxAge != 0) ? [NSDate dateWithTimeIntervalSinceNow:self.maxAge] : nil;
+    __weak NINetworkImagePrefetcher* weakSelf = self;
+    __block __weak NINetworkImageLoaderRequest* weakRequest = nil;
+    NINetworkImageLoaderRequest* request =
+        [self.imageLoader loadImageWithURL:url
+                        responseSerializer:serializer
+                                  progress:nil
+                                completion:^(UIImage* image, NSError* error) {
+      [weakSelf requestDidFinish:weakRequest forObject:object];
+      if (nil == image) {
+        return;
+      }
+
+      void (^storeImage)(UIImage *) = ^(UIImage* decodedImage) {
+        if (!sizeForDisplay) {
+          [NINetworkImageView storeImage:decodedImage
+                      inImageMemoryCache:imageMemoryCache
+                   forPathToNetworkImage:prefetchRequest.path
+                                cropRect:prefetchRequest.cropRect
+                            scaleOptions:scaleOptions
+                             pixelFormat:pixelFormat
+                            expiresAfter:expirationDate];
+          return;
+        }
+        [NINetworkImageView storeImage:decodedImage
+                    inImageMemoryCache:imageMemoryCache
+                 forPathToNetworkImage:prefetchRequest.path
+                           displaySize:prefetchRequest.displaySize
+                              cropRect:prefetchRequest.cropRect
+                           contentMode:prefetchRequest.contentMode
+                          scaleOptions:scaleOptions
+                           pixelFormat:pixelFormat
+                          expiresAfter:expirationDate];
+      };
+
+      // Images in the reduced pixel formats were drawn into a bitmap when they were processed.
+      if (NIImagePixelFormatRGBA != pixelFormat) {
+        storeImage(image);
+        return;
+      }
+
+      // Decode the image the way an image view would so that the image view that shows it
+      // doesn't decode it on the main thread.
+      NSBlockOperation* decodingOperation = [NSBlockOperation blockOperationWithBlock:^{
+        UIImage* decodedImage = [NIImageProcessing imageDecodedForDisplayFromImage:image];
+        dispatch_async(dispatch_get_main_queue(), ^{
+          storeImage(decodedImage);
+        });
+      }];
+      decodingOperation.queuePriority =
+          NINetworkImageQueuePriorityForPriority(NINetworkImagePriorityPrefetch);
+      [imageDecodingQueue addOperation:decodingOperation];
+    }];
+    request.priority = NINetworkImagePriorityPrefetch;
+    weakRequest = request;
+    if (nil != request) {
+      [requests addObject:request];
+    }
+  }
+
+  if (requests.count > 0) {
+    [self.requestsByObject setObject:requests forKey:object];
+  }
+}
+
+- (void)cancelPrefetchingImagesForObject:(id<NIImagePrefetchingObject>)object {
+  NIDASSERT([NSThread isMainThread]);
+  NSArray* requests = [self.requestsByObject objectForKey:object];
+  [self.requestsByObject removeObjectForKey:object];
+  [requests makeObjectsPerformSelector:@selector(cancel)];
+}
+
+#pragma mark - Private
+
+- (void)requestDidFinish:(NINetworkImageLoaderRequest *)request forObject:(id)object {
+  NSMutableArray* requests = [self.requestsByObject objectForKey:object];
+  [requests removeObjectIdenticalTo:request];
+  if (0 == requests.count) {
+    [self.requestsByObject removeObjectForKey:object];
+  }
+}
+
+#pragma mark - Public
+
+- (void)cancelAllPrefetching {
+  for (NSArray* requests in [[self.requestsByObject objectEnumerator] allObjects]) {
+    [requests makeObjectsPerformSelector:@selector(cancel)];
+  }
+  [self.requestsByObject removeAllObjects];
+}
+
+@end
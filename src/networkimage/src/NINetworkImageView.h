@@ -18,6 +18,7 @@
 #import <UIKit/UIKit.h>
 
 #import "NIInMemoryCache.h"
+#import "NINetworkImageLoader.h"
 #import "NIOperations.h"
 #import "NimbusCore.h"
 
@@ -45,6 +46,32 @@ typedef enum {
   NINetworkImageViewScaleToFillLeavesExcess  = 0x02,
 } NINetworkImageViewScaleOptions;
 
+// See the pixelFormat property for more documentation related to this enumeration.
+typedef enum {
+  /**
+   * 32 bits per pixel with premultiplied alpha. Suits every image.
+   */
+  NIImagePixelFormatRGBA,
+
+  /**
+   * 32 bits per pixel without alpha. Uses as much memory as NIImagePixelFormatRGBA, but the
+   * image is composited as an opaque layer.
+   */
+  NIImagePixelFormatRGBX,
+
+  /**
+   * 16 bits per pixel without alpha, with 5 bits for each color component. Halves the memory
+   * used by photos at the cost of visible banding in smooth gradients.
+   */
+  NIImagePixelFormatRGB565,
+
+  /**
+   * 8 bits per pixel of luminance without alpha. Uses a quarter of the memory of
+   * NIImagePixelFormatRGBA. Color is discarded.
+   */
+  NIImagePixelFormatGray,
+} NIImagePixelFormat;
+
 /**
  * A protocol defining the set of characteristics for an operation to be used with
  * NINetworkImageView.
@@ -58,6 +85,8 @@ typedef enum {
 @property (assign) CGInterpolationQuality interpolationQuality;
 @property (assign) UIViewContentMode imageContentMode;
 @property (strong) UIImage* imageCroppedAndSizedForDisplay;
+@optional
+@property (assign) NIImagePixelFormat pixelFormat;
 @end
 
 /**
@@ -80,11 +109,16 @@ typedef enum {
 @property (nonatomic, assign) BOOL sizeForDisplay;       // Default: YES
 @property (nonatomic, assign) NINetworkImageViewScaleOptions scaleOptions; // Default: NINetworkImageViewScaleToFitLeavesExcessAndScaleToFillCropsExcess
 @property (nonatomic, assign) CGInterpolationQuality interpolationQuality; // Default: kCGInterpolationDefault
+@property (nonatomic, assign) BOOL predecodesImages;     // Default: YES
+@property (nonatomic, assign) NIImagePixelFormat pixelFormat; // Default: NIImagePixelFormatRGBA
+@property (nonatomic, assign) BOOL rendersImagesIncrementally; // Default: NO
 
 #pragma mark Configurable Properties
 
 @property (nonatomic, strong) NIImageMemoryCache* imageMemoryCache;    // Default: [Nimbus imageMemoryCache]
 @property (nonatomic, strong) NSOperationQueue* networkOperationQueue; // Default: [Nimbus networkOperationQueue]
+@property (nonatomic, strong) NINetworkImageLoader* imageLoader;       // Default: [NINetworkImageLoader sharedLoader]
+@property (nonatomic, strong) NSOperationQueue* imageDecodingQueue;    // Default: [Nimbus imageDecodingQueue]
 
 @property (nonatomic, assign) NSTimeInterval maxAge;     // Default: 0
 
@@ -103,10 +137,24 @@ typedef enum {
 
 @property (nonatomic, readonly, assign, getter=isLoading) BOOL loading;
 
+#pragma mark Prioritizing
+
+@property (nonatomic, assign) NINetworkImagePriority priority; // Default: NINetworkImagePriorityVisible
+- (void)updatePriorityInScrollView:(UIScrollView *)scrollView;
+
 #pragma mark Reusable View
 
 - (void)prepareForReuse;
 
+#pragma mark Cache Keys
+
++ (NSString *)cacheKeyForPathToNetworkImage:(NSString *)pathToNetworkImage displaySize:(CGSize)displaySize cropRect:(CGRect)cropRect contentMode:(UIViewContentMode)contentMode scaleOptions:(NINetworkImageViewScaleOptions)scaleOptions;
++ (NSString *)cacheKeyForPathToNetworkImage:(NSString *)pathToNetworkImage displaySize:(CGSize)displaySize cropRect:(CGRect)cropRect contentMode:(UIViewContentMode)contentMode scaleOptions:(NINetworkImageViewScaleOptions)scaleOptions pixelFormat:(NIImagePixelFormat)pixelFormat;
++ (NSString *)cacheKeyForPathToNetworkImage:(NSString *)pathToNetworkImage pixelFormat:(NIImagePixelFormat)pixelFormat;
++ (void)storeImage:(UIImage *)image inImageMemoryCache:(NIImageMemoryCache *)imageMemoryCache forPathToNetworkImage:(NSString *)pathToNetworkImage displaySize:(CGSize)displaySize cropRect:(CGRect)cropRect contentMode:(UIViewContentMode)contentMode scaleOptions:(NINetworkImageViewScaleOptions)scaleOptions pixelFormat:(NIImagePixelFormat)pixelFormat expiresAfter:(NSDate *)expirationDate;
++ (void)storeImage:(UIImage *)image inImageMemoryCache:(NIImageMemoryCache *)imageMemoryCache forPathToNetworkImage:(NSString *)pathToNetworkImage cropRect:(CGRect)cropRect scaleOptions:(NINetworkImageViewScaleOptions)scaleOptions pixelFormat:(NIImagePixelFormat)pixelFormat expiresAfter:(NSDate *)expirationDate;
++ (NSURL *)URLForPathToNetworkImage:(NSString *)pathToNetworkImage;
+
 #pragma mark Delegation
 
 @property (nonatomic, weak) id<NINetworkImageViewDelegate> delegate;
@@ -409,6 +457,53 @@ typedef enum {
  * @fn NINetworkImageView::interpolationQuality
  */
 
+/**
+ * Whether loaded images are decoded on the imageDecodingQueue before they are displayed.
+ *
+ * Images that have not been decoded yet are decoded on the main thread the first time they are
+ * drawn, which can drop frames while scrolling. When this is YES every loaded image is drawn
+ * into a bitmap in the display's pixel format in the background, and only then stored in the
+ * memory cache and displayed. The image view keeps loading until the image has been decoded.
+ *
+ * By default this is YES.
+ *
+ * @see NIImageProcessing::imageDecodedForDisplayFromImage:
+ * @fn NINetworkImageView::predecodesImages
+ */
+
+/**
+ * Whether the image is displayed as it downloads.
+ *
+ * When this is YES the part of the image that has been received so far is displayed, at most
+ * once every NINetworkImageLoader::minimumPartialImageInterval. Progressive JPEGs sharpen with
+ * every scan while other images fill in from the top. Partial images are cropped and scaled
+ * exactly like the complete image, so the image does not jump when the download finishes.
+ *
+ * Partial images replace the initialImage but are never stored in the memory cache, and the
+ * delegate is only told about the complete image.
+ *
+ * By default this is NO.
+ *
+ * @fn NINetworkImageView::rendersImagesIncrementally
+ */
+
+/**
+ * The pixel format that loaded images are stored in.
+ *
+ * Thumbnails and avatars rarely need 32 bits per pixel. Storing opaque photos as
+ * NIImagePixelFormatRGB565, or black and white images as NIImagePixelFormatGray, halves or
+ * quarters the memory they use in the memory cache and on screen.
+ *
+ * The formats without alpha fill any part of the image that would have been transparent with
+ * black, such as the excess left by UIViewContentModeScaleAspectFit, so they should only be used
+ * with opaque images that fill the display. Images in these formats are drawn into a bitmap
+ * while they are processed, so they are not predecoded again.
+ *
+ * By default this is NIImagePixelFormatRGBA.
+ *
+ * @fn NINetworkImageView::pixelFormat
+ */
+
 
 /** @name Configurable Properties */
 
@@ -420,6 +515,11 @@ typedef enum {
  * and do not want the image being placed in the global memory cache, potentially pushing out
  * other images.
  *
+ * Each image is recorded as a variant of its path in the memory cache. When an image isn't in
+ * the memory cache but a larger variant of it is, such as the same photo sized for a bigger
+ * view, or the original image, the image is scaled down from that variant on the
+ * imageDecodingQueue instead of being loaded again.
+ *
  * By default this is [Nimbus imageMemoryCache].
  *
  * @attention Setting this to nil will disable the memory cache. This will force the
@@ -462,6 +562,36 @@ typedef enum {
  * @fn NINetworkImageView::networkOperationQueue
  */
 
+/**
+ * The loader used by this image view to load images with setPathToNetworkImage:.
+ *
+ * Every image view shares the same loader by default, so images from the same host are loaded
+ * over the same connections.
+ *
+ * By default this is [NINetworkImageLoader sharedLoader].
+ *
+ * @attention This property must be non-nil. If you attempt to set it to nil, a debug
+ *                 assertion will fire and the shared loader will be set.
+ *
+ * @see NINetworkImageLoader
+ * @fn NINetworkImageView::imageLoader
+ */
+
+/**
+ * The queue that loaded images are decoded on when predecodesImages is YES.
+ *
+ * Local images are also loaded and processed on this queue. The queue's
+ * maxConcurrentOperationCount limits how many images are decoded at once.
+ *
+ * By default this is [Nimbus imageDecodingQueue].
+ *
+ * @attention This property must be non-nil. If you attempt to set it to nil, a debug
+ *                 assertion will fire and Nimbus' global image decoding queue will be set.
+ *
+ * @see Nimbus::imageDecodingQueue
+ * @fn NINetworkImageView::imageDecodingQueue
+ */
+
 /**
  * The maximum amount of time that an image will stay in memory after the request completes.
  *
@@ -517,6 +647,44 @@ typedef enum {
  */
 
 
+/** @name Prioritizing */
+
+/**
+ * How urgently this image view's image is needed.
+ *
+ * The priority is passed on to the image's request, and may be changed while the image is
+ * loading. Requests made with setNetworkImageOperation: are given a matching queue priority.
+ *
+ * The priority is lowered to NINetworkImagePriorityPrefetch when the view is removed from its
+ * window and raised to NINetworkImagePriorityVisible when it is added to one. Views in scroll
+ * views should also call updatePriorityInScrollView: as their scroll view scrolls.
+ *
+ * By default this is NINetworkImagePriorityVisible.
+ *
+ * @see NINetworkImageLoaderRequest::priority
+ * @fn NINetworkImageView::priority
+ */
+
+/**
+ * Updates the priority from where this view is in relation to the scroll view's viewport.
+ *
+ * Views that intersect the viewport are visible. Views within one viewport's width or height
+ * of the viewport are near visible, and every other view is prefetched.
+ *
+ * Example:
+ *
+ * @code
+ * - (void)scrollViewDidScroll:(UIScrollView *)scrollView {
+ *   for (UITableViewCell* cell in self.tableView.visibleCells) {
+ *     [[(MyCell *)cell imageView] updatePriorityInScrollView:scrollView];
+ *   }
+ * }
+ * @endcode
+ *
+ * @fn NINetworkImageView::updatePriorityInScrollView:
+ */
+
+
 /** @name Delegation */
 
 /**
@@ -538,6 +706,75 @@ typedef enum {
  */
 
 
+/** @name Cache Keys */
+
+/**
+ * Returns the name that an image view with sizeForDisplay enabled stores the given image under
+ * in its memory cache.
+ *
+ * This may be used to load images into the memory cache before an image view asks for them.
+ *
+ * @see NINetworkImagePrefetcher
+ * @fn NINetworkImageView::cacheKeyForPathToNetworkImage:displaySize:cropRect:contentMode:scaleOptions:
+ */
+
+/**
+ * Returns the name that an image view with sizeForDisplay enabled and the given pixelFormat
+ * stores the given image under in its memory cache.
+ *
+ * Images in NIImagePixelFormatRGBA have the same name as the one returned by
+ * cacheKeyForPathToNetworkImage:displaySize:cropRect:contentMode:scaleOptions:.
+ *
+ * @fn NINetworkImageView::cacheKeyForPathToNetworkImage:displaySize:cropRect:contentMode:scaleOptions:pixelFormat:
+ */
+
+/**
+ * Returns the name that an image view with sizeForDisplay disabled and the given pixelFormat
+ * stores the given image under in its memory cache.
+ *
+ * @fn NINetworkImageView::cacheKeyForPathToNetworkImage:pixelFormat:
+ */
+
+/**
+ * Stores an image in the memory cache the way an image view with sizeForDisplay enabled and the
+ * given pixelFormat would.
+ *
+ * The image is stored under the name returned by
+ * cacheKeyForPathToNetworkImage:displaySize:cropRect:contentMode:scaleOptions:pixelFormat: and is
+ * recorded as a variant of the path, so image views can make smaller variants from it.
+ *
+ * The image should already be decoded for display.
+ *
+ * @see NINetworkImagePrefetcher
+ * @fn NINetworkImageView::storeImage:inImageMemoryCache:forPathToNetworkImage:displaySize:cropRect:contentMode:scaleOptions:pixelFormat:expiresAfter:
+ */
+
+/**
+ * Stores an image in the memory cache the way an image view with sizeForDisplay disabled and
+ * the given pixelFormat would.
+ *
+ * The image is stored under the name returned by cacheKeyForPathToNetworkImage:pixelFormat: and
+ * is recorded as the original variant of the path.
+ *
+ * The image should already be decoded for display.
+ *
+ * @see NINetworkImagePrefetcher
+ * @fn NINetworkImageView::storeImage:inImageMemoryCache:forPathToNetworkImage:cropRect:scaleOptions:pixelFormat:expiresAfter:
+ */
+
+/**
+ * Returns the URL that an image view loads for the given path.
+ *
+ * Paths that start with a slash are file paths. Every other path is percent escaped and treated
+ * as a URL.
+ *
+ * Image views load file paths themselves rather than with the imageLoader. The file is memory
+ * mapped and decoded, cropped and resized on the imageDecodingQueue.
+ *
+ * @fn NINetworkImageView::URLForPathToNetworkImage:
+ */
+
+
 /**
  * @name Requesting a Network Image
  */
@@ -27,9 +27,18 @@
 #error "Nimbus requires ARC support."
 #endif
 
+// The variant info that image views record for each image they store in the memory cache.
+static NSString* const kVariantDisplaySizeKey = @"displaySize";
+static NSString* const kVariantCropRectKey = @"cropRect";
+static NSString* const kVariantContentModeKey = @"contentMode";
+static NSString* const kVariantScaleOptionsKey = @"scaleOptions";
+static NSString* const kVariantPixelFormatKey = @"pixelFormat";
+
 @interface NINetworkImageView()
 @property (nonatomic, strong) NSOperation* operation;
-@property (nonatomic, strong) AFHTTPSessionManager *httpSessionManager;
+@property (nonatomic, strong) NINetworkImageLoaderRequest* loaderRequest;
+// Decodes the loaded image, or makes it from another variant, before it is displayed.
+@property (nonatomic, strong) NSOperation* decodingOperation;
 @end
 
 
@@ -45,7 +54,10 @@
     request.delegate = nil;
   }
   [self.operation cancel];
-  [self.httpSessionManager invalidateSessionCancelingTasks:YES];
+  [self.loaderRequest cancel];
+  self.loaderRequest = nil;
+  [self.decodingOperation cancel];
+  self.decodingOperation = nil;
 }
 
 - (void)dealloc {
@@ -56,9 +68,14 @@
   self.sizeForDisplay = YES;
   self.scaleOptions = NINetworkImageViewScaleToFitLeavesExcessAndScaleToFillCropsExcess;
   self.interpolationQuality = kCGInterpolationDefault;
+  self.predecodesImages = YES;
+  self.pixelFormat = NIImagePixelFormatRGBA;
 
   self.imageMemoryCache = [Nimbus imageMemoryCache];
   self.networkOperationQueue = [Nimbus networkOperationQueue];
+  self.imageLoader = [NINetworkImageLoader sharedLoader];
+  self.imageDecodingQueue = [Nimbus imageDecodingQueue];
+  self.priority = NINetworkImagePriorityVisible;
 }
 
 - (id)initWithImage:(UIImage *)image {
@@ -92,27 +109,162 @@
   return [self initWithImage:nil];
 }
 
-- (NSString *)cacheKeyForCacheIdentifier:(NSString *)cacheIdentifier
-                               imageSize:(CGSize)imageSize
-                                cropRect:(CGRect)cropRect
-                             contentMode:(UIViewContentMode)contentMode
-                            scaleOptions:(NINetworkImageViewScaleOptions)scaleOptions {
-  NIDASSERT(NIIsStringWithAnyText(cacheIdentifier));
++ (NSString *)cacheKeyForPathToNetworkImage:(NSString *)pathToNetworkImage
+                                displaySize:(CGSize)displaySize
+                                   cropRect:(CGRect)cropRect
+                                contentMode:(UIViewContentMode)contentMode
+                               scaleOptions:(NINetworkImageViewScaleOptions)scaleOptions {
+  return [self cacheKeyForPathToNetworkImage:pathToNetworkImage
+                                 displaySize:displaySize
+                                    cropRect:cropRect
+                                 contentMode:contentMode
+                                scaleOptions:scaleOptions
+                                 pixelFormat:NIImagePixelFormatRGBA];
+}
 
-  NSString* cacheKey = cacheIdentifier;
++ (NSString *)cacheKeyForPathToNetworkImage:(NSString *)pathToNetworkImage
+                                displaySize:(CGSize)displaySize
+                                   cropRect:(CGRect)cropRect
+                                contentMode:(UIViewContentMode)contentMode
+                               scaleOptions:(NINetworkImageViewScaleOptions)scaleOptions
+                                pixelFormat:(NIImagePixelFormat)pixelFormat {
+  NIDASSERT(NIIsStringWithAnyText(pathToNetworkImage));
 
   // Append the size to the key. This allows us to differentiate cache keys by image dimension.
   // If the display size ever changes, we want to ensure that we're fetching the correct image
   // from the cache.
-  if (self.sizeForDisplay) {
-    cacheKey = [cacheKey stringByAppendingFormat:@"%@%@{%@,%@}",
-                NSStringFromCGSize(imageSize), NSStringFromCGRect(cropRect), [@(contentMode) stringValue], [@(scaleOptions) stringValue]];
-  }
-
   // The resulting cache key will look like:
   // /path/to/image({width,height}{contentMode,cropImageForDisplay})
+  NSString* cacheKey = [pathToNetworkImage stringByAppendingFormat:@"%@%@{%@,%@}",
+                        NSStringFromCGSize(displaySize), NSStringFromCGRect(cropRect), [@(contentMode) stringValue], [@(scaleOptions) stringValue]];
+  return [self cacheKey:cacheKey withPixelFormat:pixelFormat];
+}
+
++ (NSString *)cacheKeyForPathToNetworkImage:(NSString *)pathToNetworkImage
+                                pixelFormat:(NIImagePixelFormat)pixelFormat {
+  NIDASSERT(NIIsStringWithAnyText(pathToNetworkImage));
 
-  return cacheKey;
+  return [self cacheKey:pathToNetworkImage withPixelFormat:pixelFormat];
+}
+
++ (NSString *)cacheKey:(NSString *)cacheKey withPixelFormat:(NIImagePixelFormat)pixelFormat {
+  // Images in the default format keep the keys they have always had.
+  if (NIImagePixelFormatRGBA == pixelFormat) {
+    return cacheKey;
+  }
+  return [cacheKey stringByAppendingFormat:@"<%@>", [@(pixelFormat) stringValue]];
+}
+
++ (void)storeImage:(UIImage *)image
+inImageMemoryCache:(NIImageMemoryCache *)imageMemoryCache
+forPathToNetworkImage:(NSString *)pathToNetworkImage
+       displaySize:(CGSize)displaySize
+          cropRect:(CGRect)cropRect
+       contentMode:(UIViewContentMode)contentMode
+      scaleOptions:(NINetworkImageViewScaleOptions)scaleOptions
+       pixelFormat:(NIImagePixelFormat)pixelFormat
+      expiresAfter:(NSDate *)expirationDate {
+  NSString* cacheKey = [self cacheKeyForPathToNetworkImage:pathToNetworkImage
+                                               displaySize:displaySize
+                                                  cropRect:cropRect
+                                               contentMode:contentMode
+                                              scaleOptions:scaleOptions
+                                               pixelFormat:pixelFormat];
+  [self storeImage:image
+            withName:cacheKey
+  inImageMemoryCache:imageMemoryCache
+     cacheIdentifier:pathToNetworkImage
+         displaySize:displaySize
+            cropRect:cropRect
+         contentMode:contentMode
+        scaleOptions:scaleOptions
+         pixelFormat:pixelFormat
+        expiresAfter:expirationDate];
+}
+
++ (void)storeImage:(UIImage *)image
+inImageMemoryCache:(NIImageMemoryCache *)imageMemoryCache
+forPathToNetworkImage:(NSString *)pathToNetworkImage
+          cropRect:(CGRect)cropRect
+      scaleOptions:(NINetworkImageViewScaleOptions)scaleOptions
+       pixelFormat:(NIImagePixelFormat)pixelFormat
+      expiresAfter:(NSDate *)expirationDate {
+  NSString* cacheKey = [self cacheKeyForPathToNetworkImage:pathToNetworkImage
+                                               pixelFormat:pixelFormat];
+  [self storeImage:image
+            withName:cacheKey
+  inImageMemoryCache:imageMemoryCache
+     cacheIdentifier:pathToNetworkImage
+         displaySize:CGSizeZero
+            cropRect:cropRect
+         contentMode:UIViewContentModeScaleToFill
+        scaleOptions:scaleOptions
+         pixelFormat:pixelFormat
+        expiresAfter:expirationDate];
+}
+
+// Stores the image under the given name and records how it was made in the cache identifier's
+// variant family, so that smaller variants can be made from it later. A zero display size means
+// that the image was not sized for display.
++ (void)storeImage:(UIImage *)image
+          withName:(NSString *)cacheKey
+inImageMemoryCache:(NIImageMemoryCache *)imageMemoryCache
+   cacheIdentifier:(NSString *)cacheIdentifier
+       displaySize:(CGSize)displaySize
+          cropRect:(CGRect)cropRect
+       contentMode:(UIViewContentMode)contentMode
+      scaleOptions:(NINetworkImageViewScaleOptions)scaleOptions
+       pixelFormat:(NIImagePixelFormat)pixelFormat
+      expiresAfter:(NSDate *)expirationDate {
+  // Store the image in the memory cache, possibly with an expiration date.
+  [imageMemoryCache storeObject: image
+                       withName: cacheKey
+                   expiresAfter: expirationDate];
+
+  NSDictionary* variantInfo = @{
+    kVariantDisplaySizeKey: [NSValue valueWithCGSize:displaySize],
+    kVariantCropRectKey: [NSValue valueWithCGRect:cropRect],
+    kVariantContentModeKey: @(contentMode),
+    kVariantScaleOptionsKey: @(scaleOptions),
+    kVariantPixelFormatKey: @(pixelFormat),
+  };
+  [imageMemoryCache addObjectWithName:cacheKey
+                      toVariantFamily:cacheIdentifier
+                          variantInfo:variantInfo];
+}
+
++ (NSURL *)URLForPathToNetworkImage:(NSString *)pathToNetworkImage {
+  if (!NIIsStringWithAnyText(pathToNetworkImage)) {
+    return nil;
+  }
+
+  // Check for file URLs.
+  if ([pathToNetworkImage hasPrefix:@"/"]) {
+    // If the url starts with / then it's likely a file URL, so treat it accordingly.
+    return [NSURL fileURLWithPath:pathToNetworkImage];
+
+  } else {
+    // Otherwise we assume it's a regular URL.
+    return [NSURL URLWithString:[pathToNetworkImage stringByAddingPercentEscapesUsingEncoding:NSUTF8StringEncoding]];
+  }
+}
+
+- (NSString *)cacheKeyForCacheIdentifier:(NSString *)cacheIdentifier
+                               imageSize:(CGSize)imageSize
+                                cropRect:(CGRect)cropRect
+                             contentMode:(UIViewContentMode)contentMode
+                            scaleOptions:(NINetworkImageViewScaleOptions)scaleOptions {
+  NIDASSERT(NIIsStringWithAnyText(cacheIdentifier));
+
+  if (!self.sizeForDisplay) {
+    return [[self class] cacheKeyForPathToNetworkImage:cacheIdentifier pixelFormat:self.pixelFormat];
+  }
+  return [[self class] cacheKeyForPathToNetworkImage:cacheIdentifier
+                                         displaySize:imageSize
+                                            cropRect:cropRect
+                                         contentMode:contentMode
+                                        scaleOptions:scaleOptions
+                                         pixelFormat:self.pixelFormat];
 }
 
 - (NSDate *)expirationDate {
@@ -137,6 +289,79 @@
                        contentMode:(UIViewContentMode)contentMode
                       scaleOptions:(NINetworkImageViewScaleOptions)scaleOptions
                     expirationDate:(NSDate *)expirationDate {
+  // Images in the reduced pixel formats were drawn into a bitmap when they were processed, and
+  // decoding them for display would widen them to 32 bits per pixel again.
+  if (self.predecodesImages && NIImagePixelFormatRGBA == self.pixelFormat && nil != image) {
+    // Decode the image in the background so that drawing it doesn't decode it on the main thread.
+    [self _decodeImageInBackground:^UIImage *(NSError** error) {
+      return [NIImageProcessing imageDecodedForDisplayFromImage:image];
+    }
+                   cacheIdentifier:cacheIdentifier
+                       displaySize:displaySize
+                          cropRect:cropRect
+                       contentMode:contentMode
+                      scaleOptions:scaleOptions
+                    expirationDate:expirationDate];
+    return;
+  }
+
+  [self _didDecodeImage:image
+        cacheIdentifier:cacheIdentifier
+            displaySize:displaySize
+               cropRect:cropRect
+            contentMode:contentMode
+           scaleOptions:scaleOptions
+         expirationDate:expirationDate];
+}
+
+// Runs the block on the image decoding queue and hands the image it returns to
+// _didDecodeImage:... on the main thread, unless another image has been requested since. If the
+// block returns nil along with an error, the error is reported instead.
+- (void)_decodeImageInBackground:(UIImage* (^)(NSError** error))decodeImage
+                 cacheIdentifier:(NSString *)cacheIdentifier
+                     displaySize:(CGSize)displaySize
+                        cropRect:(CGRect)cropRect
+                     contentMode:(UIViewContentMode)contentMode
+                    scaleOptions:(NINetworkImageViewScaleOptions)scaleOptions
+                  expirationDate:(NSDate *)expirationDate {
+  __weak NINetworkImageView* weakSelf = self;
+  __block __weak NSOperation* weakOperation = nil;
+  NSBlockOperation* decodingOperation = [NSBlockOperation blockOperationWithBlock:^{
+    NSError* error = nil;
+    UIImage* decodedImage = decodeImage(&error);
+    dispatch_async(dispatch_get_main_queue(), ^{
+      NINetworkImageView* strongSelf = weakSelf;
+      // Only keep this result if it's for the most recent request.
+      if (nil == strongSelf || nil == weakOperation || weakOperation != strongSelf.decodingOperation) {
+        return;
+      }
+      strongSelf.decodingOperation = nil;
+      if (nil == decodedImage && nil != error) {
+        [strongSelf _didFailToLoadWithError:error];
+        return;
+      }
+      [strongSelf _didDecodeImage:decodedImage
+                  cacheIdentifier:cacheIdentifier
+                      displaySize:displaySize
+                         cropRect:cropRect
+                      contentMode:contentMode
+                     scaleOptions:scaleOptions
+                   expirationDate:expirationDate];
+    });
+  }];
+  decodingOperation.queuePriority = NINetworkImageQueuePriorityForPriority(self.priority);
+  weakOperation = decodingOperation;
+  self.decodingOperation = decodingOperation;
+  [self.imageDecodingQueue addOperation:decodingOperation];
+}
+
+- (void)_didDecodeImage:(UIImage *)image
+        cacheIdentifier:(NSString *)cacheIdentifier
+            displaySize:(CGSize)displaySize
+               cropRect:(CGRect)cropRect
+            contentMode:(UIViewContentMode)contentMode
+           scaleOptions:(NINetworkImageViewScaleOptions)scaleOptions
+         expirationDate:(NSDate *)expirationDate {
   // Store the result image in the memory cache.
   if (nil != self.imageMemoryCache && nil != image) {
     NSString* cacheKey = [self cacheKeyForCacheIdentifier:cacheIdentifier
@@ -145,10 +370,16 @@
                                               contentMode:contentMode
                                              scaleOptions:scaleOptions];
 
-    // Store the image in the memory cache, possibly with an expiration date.
-    [self.imageMemoryCache storeObject: image
-                              withName: cacheKey
-                          expiresAfter: expirationDate];
+    [[self class] storeImage:image
+                    withName:cacheKey
+          inImageMemoryCache:self.imageMemoryCache
+             cacheIdentifier:cacheIdentifier
+                 displaySize:self.sizeForDisplay ? displaySize : CGSizeZero
+                    cropRect:cropRect
+                 contentMode:contentMode
+                scaleOptions:scaleOptions
+                 pixelFormat:self.pixelFormat
+                expiresAfter:expirationDate];
   }
 
   if (nil != image) {
@@ -160,7 +391,7 @@
   }
 
   self.operation = nil;
-  self.httpSessionManager = nil;
+  self.loaderRequest = nil;
 
   if ([self.delegate respondsToSelector:@selector(networkImageView:didLoadImage:)]) {
     [self.delegate networkImageView:self didLoadImage:self.image];
@@ -169,9 +400,174 @@
   [self networkImageViewDidLoadImage:image];
 }
 
+/**
+ * Whether an image made with the given variant info can be scaled down to the requested image.
+ *
+ * Originals, which were stored without being cropped or sized, can make any image. Sized images
+ * can only make smaller images of the same aspect ratio that were cropped, scaled and stored the
+ * same way, since the parts of the original that they left out can't be brought back.
+ */
+static BOOL NIVariantCanBeScaledDown(NSDictionary* variantInfo,
+                                     CGSize displaySize,
+                                     CGRect cropRect,
+                                     UIViewContentMode contentMode,
+                                     NINetworkImageViewScaleOptions scaleOptions,
+                                     NIImagePixelFormat pixelFormat,
+                                     BOOL* isOriginal) {
+  if (![variantInfo isKindOfClass:[NSDictionary class]]) {
+    return NO;
+  }
+
+  // Converting to a smaller pixel format is fine, but the precision that was thrown away is gone.
+  NIImagePixelFormat variantPixelFormat = [variantInfo[kVariantPixelFormatKey] intValue];
+  if (variantPixelFormat != pixelFormat && NIImagePixelFormatRGBA != variantPixelFormat) {
+    return NO;
+  }
+
+  CGSize variantDisplaySize = [variantInfo[kVariantDisplaySizeKey] CGSizeValue];
+  CGRect variantCropRect = [variantInfo[kVariantCropRectKey] CGRectValue];
+  if (CGSizeEqualToSize(variantDisplaySize, CGSizeZero)) {
+    *isOriginal = YES;
+    return (CGRectIsEmpty(variantCropRect)
+            || CGRectEqualToRect(variantCropRect, CGRectMake(0, 0, 1, 1)));
+  }
+  *isOriginal = NO;
+
+  if (UIViewContentModeScaleToFill != contentMode
+      && UIViewContentModeScaleAspectFit != contentMode
+      && UIViewContentModeScaleAspectFill != contentMode) {
+    return NO;
+  }
+  if ([variantInfo[kVariantContentModeKey] integerValue] != contentMode
+      || [variantInfo[kVariantScaleOptionsKey] intValue] != scaleOptions
+      || !CGRectEqualToRect(variantCropRect, cropRect)
+      || variantDisplaySize.width < displaySize.width
+      || variantDisplaySize.height < displaySize.height) {
+    return NO;
+  }
+
+  CGFloat aspectRatio = displaySize.width / displaySize.height;
+  CGFloat variantAspectRatio = variantDisplaySize.width / variantDisplaySize.height;
+  return fabs(variantAspectRatio - aspectRatio) <= aspectRatio * 0.01;
+}
+
+// Starts making the requested image from a larger variant of it in the memory cache, which is
+// much cheaper than loading it again. Returns NO if there is no variant to make it from.
+- (BOOL)_deriveImageForCacheIdentifier:(NSString *)cacheIdentifier
+                           displaySize:(CGSize)displaySize
+                              cropRect:(CGRect)cropRect
+                           contentMode:(UIViewContentMode)contentMode {
+  if (nil == self.imageMemoryCache || !self.sizeForDisplay
+      || displaySize.width <= 0 || displaySize.height <= 0) {
+    return NO;
+  }
+
+  NINetworkImageViewScaleOptions scaleOptions = self.scaleOptions;
+  NIImagePixelFormat pixelFormat = self.pixelFormat;
+  CGInterpolationQuality interpolationQuality = self.interpolationQuality;
+
+  // The smallest suitable variant is the cheapest to scale down. Originals are usually the
+  // largest, so they're only used when there's nothing else.
+  NSString* variantName = nil;
+  BOOL isVariantOriginal = NO;
+  CGFloat variantArea = 0;
+  NSDictionary* variantInfos = [self.imageMemoryCache variantInfosInVariantFamily:cacheIdentifier];
+  for (NSString* name in variantInfos) {
+    BOOL isOriginal = NO;
+    if (!NIVariantCanBeScaledDown(variantInfos[name], displaySize, cropRect, contentMode,
+                                  scaleOptions, pixelFormat, &isOriginal)) {
+      continue;
+    }
+    CGSize size = [variantInfos[name][kVariantDisplaySizeKey] CGSizeValue];
+    CGFloat area = isOriginal ? CGFLOAT_MAX : size.width * size.height;
+    if (nil == variantName || area < variantArea) {
+      variantName = name;
+      isVariantOriginal = isOriginal;
+      variantArea = area;
+    }
+  }
+
+  UIImage* variant = (nil != variantName) ? [self.imageMemoryCache objectWithName:variantName] : nil;
+  if (nil == variant.CGImage) {
+    return NO;
+  }
+
+  // The derived image is only as fresh as the variant it's made from, so it must not outlive it.
+  NSDate* expirationDate = [self expirationDate];
+  NSDate* variantExpirationDate = [self.imageMemoryCache expirationDateOfObjectWithName:variantName];
+  if (nil != variantExpirationDate) {
+    expirationDate = (nil != expirationDate
+                      ? [expirationDate earlierDate:variantExpirationDate]
+                      : variantExpirationDate);
+  }
+
+  // Sized variants are measured in pixels and have already been cropped.
+  CGRect variantCropRect = cropRect;
+  if (!isVariantOriginal) {
+    variant = [UIImage imageWithCGImage:variant.CGImage scale:1 orientation:variant.imageOrientation];
+    variantCropRect = CGRectZero;
+  }
+
+  [self _decodeImageInBackground:^UIImage *(NSError** error) {
+    return [NIImageProcessing imageFromSource:variant
+                              withContentMode:contentMode
+                                     cropRect:variantCropRect
+                                  displaySize:displaySize
+                                 scaleOptions:scaleOptions
+                         interpolationQuality:interpolationQuality
+                                  pixelFormat:pixelFormat];
+  }
+                 cacheIdentifier:cacheIdentifier
+                     displaySize:displaySize
+                        cropRect:cropRect
+                     contentMode:contentMode
+                    scaleOptions:scaleOptions
+                  expirationDate:expirationDate];
+  [self _didStartLoading];
+  return YES;
+}
+
+// Loads a local image straight from disk on the image decoding queue. Local files don't benefit
+// from the loader's connection sharing or response caching, so the file is mapped and processed
+// directly rather than being sent through the URL loading system.
+- (void)_loadImageFromFileURL:(NSURL *)url
+              cacheIdentifier:(NSString *)cacheIdentifier
+                  displaySize:(CGSize)displaySize
+                     cropRect:(CGRect)cropRect
+                  contentMode:(UIViewContentMode)contentMode {
+  if (!self.sizeForDisplay) {
+    displaySize = CGSizeZero;
+    contentMode = UIViewContentModeScaleToFill;
+  }
+
+  NSString* path = url.path;
+  NINetworkImageViewScaleOptions scaleOptions = self.scaleOptions;
+  CGInterpolationQuality interpolationQuality = self.interpolationQuality;
+  NIImagePixelFormat pixelFormat = self.pixelFormat;
+
+  // The image is decoded as it is loaded, so it never needs to be predecoded as well.
+  [self _decodeImageInBackground:^UIImage *(NSError** error) {
+    return [NIImageProcessing imageFromContentsOfFile:path
+                                      withContentMode:contentMode
+                                             cropRect:cropRect
+                                          displaySize:displaySize
+                                         scaleOptions:scaleOptions
+                                 interpolationQuality:interpolationQuality
+                                          pixelFormat:pixelFormat
+                                                error:error];
+  }
+                 cacheIdentifier:cacheIdentifier
+                     displaySize:displaySize
+                        cropRect:cropRect
+                     contentMode:contentMode
+                    scaleOptions:scaleOptions
+                  expirationDate:[self expirationDate]];
+  [self _didStartLoading];
+}
+
 - (void)_didFailToLoadWithError:(NSError *)error {
   self.operation = nil;
-  self.httpSessionManager = nil;
+  self.loaderRequest = nil;
 
   if ([self.delegate respondsToSelector:@selector(networkImageView:didFailWithError:)]) {
     [self.delegate networkImageView:self didFailWithError:error];
@@ -261,17 +657,7 @@
   [self cancelOperation];
 
   if (NIIsStringWithAnyText(pathToNetworkImage)) {
-    NSURL* url = nil;
-
-    // Check for file URLs.
-    if ([pathToNetworkImage hasPrefix:@"/"]) {
-      // If the url starts with / then it's likely a file URL, so treat it accordingly.
-      url = [NSURL fileURLWithPath:pathToNetworkImage];
-
-    } else {
-      // Otherwise we assume it's a regular URL.
-      url = [NSURL URLWithString:[pathToNetworkImage stringByAddingPercentEscapesUsingEncoding:NSUTF8StringEncoding]];
-    }
+    NSURL* url = [[self class] URLForPathToNetworkImage:pathToNetworkImage];
 
     // If the URL failed to be created, there's not much we can do here.
     if (nil == url) {
@@ -311,6 +697,19 @@
       
       [self networkImageViewDidLoadImage:image];
 
+    } else if ([self _deriveImageForCacheIdentifier:pathToNetworkImage
+                                        displaySize:displaySize
+                                           cropRect:cropRect
+                                        contentMode:contentMode]) {
+      // A larger variant of the image is being scaled down instead of loading it again.
+
+    } else if (url.isFileURL) {
+      [self _loadImageFromFileURL:url
+                  cacheIdentifier:pathToNetworkImage
+                      displaySize:displaySize
+                         cropRect:cropRect
+                      contentMode:contentMode];
+
     } else {
       if (!self.sizeForDisplay) {
         displaySize = CGSizeZero;
@@ -326,45 +725,56 @@
       serializer.displaySize = displaySize;
       serializer.scaleOptions = self.scaleOptions;
       serializer.interpolationQuality = self.interpolationQuality;
-
-      NSString* originalCacheKey = [self cacheKeyForCacheIdentifier:pathToNetworkImage
-                                                          imageSize:displaySize
-                                                           cropRect:cropRect
-                                                        contentMode:contentMode
-                                                       scaleOptions:self.scaleOptions];
-
-      self.httpSessionManager = [AFHTTPSessionManager manager];
-      self.httpSessionManager.responseSerializer = serializer;
-      [self.httpSessionManager GET:url.absoluteString
-        parameters:nil
-          progress:^(NSProgress * _Nonnull downloadProgress) {
-            if ([self.delegate respondsToSelector:@selector(networkImageView:readBytes:totalBytes:)]) {
-              [self.delegate networkImageView:self
-                                    readBytes:downloadProgress.completedUnitCount
-                                   totalBytes:downloadProgress.totalUnitCount];
-            }
+      serializer.pixelFormat = self.pixelFormat;
+
+      // The loader shares one session, and therefore its connections, between every image view.
+      __weak NINetworkImageView* weakSelf = self;
+      // The request holds on to its completion block, so the block must not hold on to the request.
+      __block __weak NINetworkImageLoaderRequest* weakRequest = nil;
+      NINetworkImageLoaderPartialImageBlock partialImage = nil;
+      if (self.rendersImagesIncrementally) {
+        partialImage = ^(UIImage* image) {
+          NINetworkImageView* strongSelf = weakSelf;
+
+          // The complete image may already be decoding, in which case it is about to be displayed.
+          if (nil == strongSelf || nil == weakRequest || weakRequest != strongSelf.loaderRequest
+              || nil != strongSelf.decodingOperation) {
+            return;
           }
-           success:^(NSURLSessionDataTask * _Nonnull task, id  _Nullable responseObject) {
-             NSString* blockCacheKey = [self cacheKeyForCacheIdentifier:pathToNetworkImage
-                                                              imageSize:displaySize
-                                                               cropRect:cropRect
-                                                            contentMode:contentMode
-                                                           scaleOptions:self.scaleOptions];
-
-             // Only keep this result if it's for the most recent request.
-             if ([blockCacheKey isEqualToString:originalCacheKey]) {
-               [self _didFinishLoadingWithImage:responseObject
-                                cacheIdentifier:pathToNetworkImage
-                                    displaySize:displaySize
-                                       cropRect:cropRect
-                                    contentMode:contentMode
-                                   scaleOptions:self.scaleOptions
-                                 expirationDate:[self expirationDate]];
-             }
-
-           } failure:^(NSURLSessionDataTask * _Nullable task, NSError * _Nonnull error) {
-             [self _didFailToLoadWithError:error];
-           }];
+          [strongSelf setImage:image];
+        };
+      }
+      NINetworkImageLoaderRequest* request =
+          [self.imageLoader loadImageWithURL:url
+                          responseSerializer:serializer
+                                    progress:^(long long readBytes, long long totalBytes) {
+        NINetworkImageView* strongSelf = weakSelf;
+        if ([strongSelf.delegate respondsToSelector:@selector(networkImageView:readBytes:totalBytes:)]) {
+          [strongSelf.delegate networkImageView:strongSelf readBytes:readBytes totalBytes:totalBytes];
+        }
+      } partialImage:partialImage completion:^(UIImage* image, NSError* error) {
+        NINetworkImageView* strongSelf = weakSelf;
+
+        // Only keep this result if it's for the most recent request.
+        if (nil == strongSelf || nil == weakRequest || weakRequest != strongSelf.loaderRequest) {
+          return;
+        }
+        if (nil != error) {
+          [strongSelf _didFailToLoadWithError:error];
+
+        } else {
+          [strongSelf _didFinishLoadingWithImage:image
+                                 cacheIdentifier:pathToNetworkImage
+                                     displaySize:displaySize
+                                        cropRect:cropRect
+                                     contentMode:contentMode
+                                    scaleOptions:serializer.scaleOptions
+                                  expirationDate:[strongSelf expirationDate]];
+        }
+      }];
+      request.priority = self.priority;
+      weakRequest = request;
+      self.loaderRequest = request;
 
       [self _didStartLoading];
     }
@@ -415,12 +825,16 @@
       operation.imageCropRect = cropRect;
       operation.scaleOptions = self.scaleOptions;
       operation.interpolationQuality = self.interpolationQuality;
+      if ([operation respondsToSelector:@selector(setPixelFormat:)]) {
+        operation.pixelFormat = self.pixelFormat;
+      }
       if (self.sizeForDisplay) {
         operation.imageDisplaySize = displaySize;
         operation.imageContentMode = contentMode;
       }
 
       self.operation = operation;
+      self.operation.queuePriority = NINetworkImageQueuePriorityForPriority(self.priority);
 
       [self.networkOperationQueue addOperation:self.operation];
     }
@@ -433,6 +847,33 @@
   [self setImage:self.initialImage];
 }
 
+- (void)updatePriorityInScrollView:(UIScrollView *)scrollView {
+  CGRect frame = [self convertRect:self.bounds toView:scrollView];
+  CGRect viewport = scrollView.bounds;
+
+  if (CGRectIntersectsRect(frame, viewport)) {
+    self.priority = NINetworkImagePriorityVisible;
+
+  } else if (CGRectIntersectsRect(frame, CGRectInset(viewport,
+                                                     -viewport.size.width,
+                                                     -viewport.size.height))) {
+    self.priority = NINetworkImagePriorityNearVisible;
+
+  } else {
+    self.priority = NINetworkImagePriorityPrefetch;
+  }
+}
+
+#pragma mark - UIView
+
+- (void)didMoveToWindow {
+  [super didMoveToWindow];
+
+  self.priority = (nil != self.window
+                   ? NINetworkImagePriorityVisible
+                   : NINetworkImagePriorityPrefetch);
+}
+
 #pragma mark - Properties
 
 
@@ -449,7 +890,7 @@
 }
 
 - (BOOL)isLoading {
-  return [self.operation isExecuting];
+  return [self.operation isExecuting] || nil != self.loaderRequest || nil != self.decodingOperation;
 }
 
 - (void)setNetworkOperationQueue:(NSOperationQueue *)queue {
@@ -461,5 +902,33 @@
   _networkOperationQueue = queue;
 }
 
+- (void)setImageDecodingQueue:(NSOperationQueue *)queue {
+  // Don't allow a nil image decoding queue.
+  NIDASSERT(nil != queue);
+  if (nil == queue) {
+    queue = [Nimbus imageDecodingQueue];
+  }
+  _imageDecodingQueue = queue;
+}
+
+- (void)setPriority:(NINetworkImagePriority)priority {
+  _priority = priority;
+
+  self.loaderRequest.priority = priority;
+  self.decodingOperation.queuePriority = NINetworkImageQueuePriorityForPriority(priority);
+  if (![self.operation isExecuting]) {
+    self.operation.queuePriority = NINetworkImageQueuePriorityForPriority(priority);
+  }
+}
+
+- (void)setImageLoader:(NINetworkImageLoader *)imageLoader {
+  // Don't allow a nil image loader.
+  NIDASSERT(nil != imageLoader);
+  if (nil == imageLoader) {
+    imageLoader = [NINetworkImageLoader sharedLoader];
+  }
+  _imageLoader = imageLoader;
+}
+
 @end
 
@@ -69,6 +69,9 @@
 
 #import "NimbusCore.h"
 #import "NIImageProcessing.h"
+#import "NIImageResampling.h"
+#import "NINetworkImageLoader.h"
+#import "NINetworkImagePrefetcher.h"
 #import "NINetworkImageView.h"
 
 /**@}*/
@@ -0,0 +1,293 @@
+//
+// Copyright 2011-2014 NimbusKit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// See: http://bit.ly/hS5nNh for unit test macros.
+
+#import <XCTest/XCTest.h>
+
+#import "NimbusNetworkImage.h"
+
+static const NIResamplingFilter kFilters[] = {
+  NIResamplingFilterBox,
+  NIResamplingFilterBilinear,
+  NIResamplingFilterLanczos3,
+};
+static const size_t kNumberOfFilters = sizeof(kFilters) / sizeof(kFilters[0]);
+
+@interface NIImageResamplingTests : XCTestCase
+@end
+
+
+@implementation NIImageResamplingTests
+
+// Row padding makes sure that bytesPerRow is respected. The data must outlive the buffer, so
+// callers keep it with NS_VALID_UNTIL_END_OF_SCOPE.
+- (NSMutableData *)dataForBufferWithWidth:(size_t)width height:(size_t)height {
+  return [NSMutableData dataWithLength:(width * 4 + 12) * height];
+}
+
+- (NIResamplingBuffer)bufferWithData:(NSMutableData *)data width:(size_t)width height:(size_t)height {
+  return (NIResamplingBuffer){ data.mutableBytes, width, height, width * 4 + 12 };
+}
+
+- (void)fillBuffer:(NIResamplingBuffer)buffer withRandomBytesSeed:(unsigned int)seed {
+  srand(seed);
+  for (size_t ix = 0; ix < buffer.height * buffer.bytesPerRow; ++ix) {
+    buffer.data[ix] = (uint8_t)rand();
+  }
+}
+
+- (BOOL)buffer:(NIResamplingBuffer)buffer isEqualToBuffer:(NIResamplingBuffer)otherBuffer {
+  for (size_t row = 0; row < buffer.height; ++row) {
+    if (0 != memcmp(buffer.data + row * buffer.bytesPerRow,
+                    otherBuffer.data + row * otherBuffer.bytesPerRow,
+                    buffer.width * 4)) {
+      return NO;
+    }
+  }
+  return YES;
+}
+
+// An 8x1 gradient whose blue channel alternates between 0 and 255.
+- (NIResamplingBuffer)gradientBufferWithBytes:(uint8_t *)bytes {
+  for (int x = 0; x < 8; ++x) {
+    bytes[x * 4 + 0] = (uint8_t)(x * 32);
+    bytes[x * 4 + 1] = (uint8_t)(255 - x * 32);
+    bytes[x * 4 + 2] = (uint8_t)((x % 2) * 255);
+    bytes[x * 4 + 3] = 255;
+  }
+  return (NIResamplingBuffer){ bytes, 8, 1, 32 };
+}
+
+#pragma mark - Golden Images
+
+- (void)testShrinkingGradientMatchesGoldenImage {
+  static const uint8_t kGoldenImages[3][12] = {
+    { 32, 223, 85, 255,  112, 143, 128, 255,  192, 63, 170, 255 },
+    { 35, 220, 121, 255,  112, 143, 128, 255,  189, 66, 134, 255 },
+    { 26, 229, 112, 255,  112, 143, 128, 255,  198, 57, 143, 255 },
+  };
+
+  uint8_t bytes[32];
+  NIResamplingBuffer src = [self gradientBufferWithBytes:bytes];
+  for (size_t ix = 0; ix < kNumberOfFilters; ++ix) {
+    uint8_t result[12];
+    NIResamplingBuffer dst = { result, 3, 1, 12 };
+    XCTAssertTrue(NIResampleRGBA(&src, (NIResamplingRect){0, 0, 8, 1}, &dst, kFilters[ix], 1,
+                                 NIResamplingOptionNone));
+    XCTAssertEqual(memcmp(result, kGoldenImages[ix], sizeof(result)), 0, @"Filter %zu", ix);
+  }
+}
+
+- (void)testEnlargingGradientMatchesGoldenImage {
+  static const uint8_t kGoldenImages[3][40] = {
+    { 0, 255, 0, 255,  32, 223, 255, 255,  64, 191, 0, 255,  64, 191, 0, 255,  96, 159, 255, 255,
+      128, 127, 0, 255,  160, 95, 255, 255,  192, 63, 0, 255,  192, 63, 0, 255,  224, 31, 255, 255 },
+    { 0, 255, 0, 255,  22, 233, 179, 255,  48, 207, 128, 255,  74, 181, 76, 255,  99, 156, 230, 255,
+      125, 130, 25, 255,  150, 105, 179, 255,  176, 79, 128, 255,  202, 53, 76, 255,  224, 31, 255, 255 },
+    { 0, 255, 0, 255,  20, 235, 209, 255,  50, 205, 124, 255,  73, 182, 52, 255,  99, 156, 249, 255,
+      125, 130, 6, 255,  151, 104, 203, 255,  174, 81, 131, 255,  204, 51, 46, 255,  225, 30, 255, 255 },
+  };
+
+  uint8_t bytes[32];
+  NIResamplingBuffer src = [self gradientBufferWithBytes:bytes];
+  for (size_t ix = 0; ix < kNumberOfFilters; ++ix) {
+    uint8_t result[40];
+    NIResamplingBuffer dst = { result, 10, 1, 40 };
+    XCTAssertTrue(NIResampleRGBA(&src, (NIResamplingRect){0, 0, 8, 1}, &dst, kFilters[ix], 1,
+                                 NIResamplingOptionNone));
+    XCTAssertEqual(memcmp(result, kGoldenImages[ix], sizeof(result)), 0, @"Filter %zu", ix);
+  }
+}
+
+// An 8x1 half transparent edge, premultiplied, from red on the left to green on the right.
+- (NIResamplingBuffer)translucentEdgeBufferWithBytes:(uint8_t *)bytes {
+  for (int x = 0; x < 8; ++x) {
+    bytes[x * 4 + 0] = (x < 4) ? 128 : 0;
+    bytes[x * 4 + 1] = (x < 4) ? 0 : 128;
+    bytes[x * 4 + 2] = 64;
+    bytes[x * 4 + 3] = 128;
+  }
+  return (NIResamplingBuffer){ bytes, 8, 1, 32 };
+}
+
+- (void)testPremultipliedEdgeMatchesGoldenImage {
+  // Without clamping, Lanczos rings to a red and a green of 137 at an alpha of 128.
+  static const uint8_t kGoldenImages[3][40] = {
+    { 128, 0, 64, 128,  128, 0, 64, 128,  128, 0, 64, 128,  128, 0, 64, 128,  128, 0, 64, 128,
+      0, 128, 64, 128,  0, 128, 64, 128,  0, 128, 64, 128,  0, 128, 64, 128,  0, 128, 64, 128 },
+    { 128, 0, 64, 128,  128, 0, 64, 128,  128, 0, 64, 128,  128, 0, 64, 128,  115, 13, 64, 128,
+      13, 115, 64, 128,  0, 128, 64, 128,  0, 128, 64, 128,  0, 128, 64, 128,  0, 128, 64, 128 },
+    { 128, 0, 64, 128,  128, 0, 64, 128,  125, 3, 64, 128,  128, 0, 64, 128,  119, 9, 64, 128,
+      9, 119, 64, 128,  0, 128, 64, 128,  3, 125, 64, 128,  0, 128, 64, 128,  0, 128, 64, 128 },
+  };
+
+  uint8_t bytes[32];
+  NIResamplingBuffer src = [self translucentEdgeBufferWithBytes:bytes];
+  for (size_t ix = 0; ix < kNumberOfFilters; ++ix) {
+    uint8_t result[40];
+    NIResamplingBuffer dst = { result, 10, 1, 40 };
+    XCTAssertTrue(NIResampleRGBA(&src, (NIResamplingRect){0, 0, 8, 1}, &dst, kFilters[ix], 1,
+                                 NIResamplingOptionPremultiplied));
+    XCTAssertEqual(memcmp(result, kGoldenImages[ix], sizeof(result)), 0, @"Filter %zu", ix);
+  }
+}
+
+- (void)testPremultipliedColorsNeverExceedAlpha {
+  NS_VALID_UNTIL_END_OF_SCOPE NSMutableData* srcData = [self dataForBufferWithWidth:37 height:23];
+  NIResamplingBuffer src = [self bufferWithData:srcData width:37 height:23];
+  [self fillBuffer:src withRandomBytesSeed:1];
+  for (size_t row = 0; row < src.height; ++row) {
+    for (size_t column = 0; column < src.width; ++column) {
+      uint8_t* pixel = src.data + row * src.bytesPerRow + column * 4;
+      pixel[0] = MIN(pixel[0], pixel[3]);
+      pixel[1] = MIN(pixel[1], pixel[3]);
+      pixel[2] = MIN(pixel[2], pixel[3]);
+    }
+  }
+
+  for (size_t ix = 0; ix < kNumberOfFilters; ++ix) {
+    NS_VALID_UNTIL_END_OF_SCOPE NSMutableData* dstData = [self dataForBufferWithWidth:80 height:50];
+    NIResamplingBuffer dst = [self bufferWithData:dstData width:80 height:50];
+    XCTAssertTrue(NIResampleRGBA(&src, (NIResamplingRect){0, 0, 37, 23}, &dst, kFilters[ix], 0,
+                                 NIResamplingOptionPremultiplied));
+    for (size_t row = 0; row < dst.height; ++row) {
+      for (size_t column = 0; column < dst.width; ++column) {
+        const uint8_t* pixel = dst.data + row * dst.bytesPerRow + column * 4;
+        XCTAssertTrue(pixel[0] <= pixel[3] && pixel[1] <= pixel[3] && pixel[2] <= pixel[3]);
+      }
+    }
+  }
+}
+
+- (void)testSameSizeIsExact {
+  NS_VALID_UNTIL_END_OF_SCOPE NSMutableData* srcData = [self dataForBufferWithWidth:37 height:23];
+  NIResamplingBuffer src = [self bufferWithData:srcData width:37 height:23];
+  [self fillBuffer:src withRandomBytesSeed:1];
+
+  for (size_t ix = 0; ix < kNumberOfFilters; ++ix) {
+    NS_VALID_UNTIL_END_OF_SCOPE NSMutableData* dstData = [self dataForBufferWithWidth:37 height:23];
+    NIResamplingBuffer dst = [self bufferWithData:dstData width:37 height:23];
+    XCTAssertTrue(NIResampleRGBA(&src, (NIResamplingRect){0, 0, 37, 23}, &dst, kFilters[ix], 0,
+                                 NIResamplingOptionNone));
+    XCTAssertTrue([self buffer:src isEqualToBuffer:dst], @"Filter %zu", ix);
+  }
+}
+
+- (void)testSolidColorStaysSolid {
+  NS_VALID_UNTIL_END_OF_SCOPE NSMutableData* srcData = [self dataForBufferWithWidth:37 height:23];
+  NIResamplingBuffer src = [self bufferWithData:srcData width:37 height:23];
+  for (size_t row = 0; row < src.height; ++row) {
+    for (size_t column = 0; column < src.width; ++column) {
+      uint8_t* pixel = src.data + row * src.bytesPerRow + column * 4;
+      pixel[0] = 200; pixel[1] = 100; pixel[2] = 50; pixel[3] = 255;
+    }
+  }
+
+  for (size_t ix = 0; ix < kNumberOfFilters; ++ix) {
+    NS_VALID_UNTIL_END_OF_SCOPE NSMutableData* dstData = [self dataForBufferWithWidth:80 height:5];
+    NIResamplingBuffer dst = [self bufferWithData:dstData width:80 height:5];
+    XCTAssertTrue(NIResampleRGBA(&src, (NIResamplingRect){0, 0, 37, 23}, &dst, kFilters[ix], 0,
+                                 NIResamplingOptionNone));
+    for (size_t row = 0; row < dst.height; ++row) {
+      for (size_t column = 0; column < dst.width; ++column) {
+        const uint8_t* pixel = dst.data + row * dst.bytesPerRow + column * 4;
+        XCTAssertTrue(pixel[0] == 200 && pixel[1] == 100 && pixel[2] == 50 && pixel[3] == 255);
+      }
+    }
+  }
+}
+
+#pragma mark - Implementations
+
+- (void)testVectorizedAndThreadedMatchScalar {
+  for (unsigned int seed = 0; seed < 20; ++seed) {
+    srand(seed);
+    size_t srcWidth = 1 + (size_t)rand() % 200;
+    size_t srcHeight = 1 + (size_t)rand() % 200;
+    size_t dstWidth = 1 + (size_t)rand() % 150;
+    size_t dstHeight = 1 + (size_t)rand() % 150;
+
+    NS_VALID_UNTIL_END_OF_SCOPE NSMutableData* srcData =
+        [self dataForBufferWithWidth:srcWidth height:srcHeight];
+    NIResamplingBuffer src = [self bufferWithData:srcData width:srcWidth height:srcHeight];
+    [self fillBuffer:src withRandomBytesSeed:seed];
+    NIResamplingRect rect = { srcWidth * 0.1, srcHeight * 0.2, srcWidth * 0.7, srcHeight * 0.5 };
+
+    for (size_t ix = 0; ix < kNumberOfFilters; ++ix) {
+      NS_VALID_UNTIL_END_OF_SCOPE NSMutableData* scalarData =
+          [self dataForBufferWithWidth:dstWidth height:dstHeight];
+      NS_VALID_UNTIL_END_OF_SCOPE NSMutableData* vectorizedData =
+          [self dataForBufferWithWidth:dstWidth height:dstHeight];
+      NS_VALID_UNTIL_END_OF_SCOPE NSMutableData* threadedData =
+          [self dataForBufferWithWidth:dstWidth height:dstHeight];
+      NIResamplingBuffer scalar = [self bufferWithData:scalarData width:dstWidth height:dstHeight];
+      NIResamplingBuffer vectorized = [self bufferWithData:vectorizedData width:dstWidth height:dstHeight];
+      NIResamplingBuffer threaded = [self bufferWithData:threadedData width:dstWidth height:dstHeight];
+      XCTAssertTrue(NIResampleRGBA(&src, rect, &scalar, kFilters[ix], 1, NIResamplingOptionScalar));
+      XCTAssertTrue(NIResampleRGBA(&src, rect, &vectorized, kFilters[ix], 1, NIResamplingOptionNone));
+      XCTAssertTrue(NIResampleRGBA(&src, rect, &threaded, kFilters[ix], 4, NIResamplingOptionNone));
+      XCTAssertTrue([self buffer:scalar isEqualToBuffer:vectorized], @"Seed %u filter %zu", seed, ix);
+      XCTAssertTrue([self buffer:scalar isEqualToBuffer:threaded], @"Seed %u filter %zu", seed, ix);
+    }
+  }
+}
+
+- (void)testInvalidArgumentsAreRejected {
+  uint8_t bytes[32];
+  NIResamplingBuffer src = [self gradientBufferWithBytes:bytes];
+  uint8_t result[12] = { 0 };
+  NIResamplingBuffer dst = { result, 3, 1, 12 };
+  XCTAssertFalse(NIResampleRGBA(&src, (NIResamplingRect){8, 0, 4, 1}, &dst,
+                                NIResamplingFilterBilinear, 1, NIResamplingOptionNone));
+  NIResamplingBuffer emptyDst = { result, 0, 1, 12 };
+  XCTAssertFalse(NIResampleRGBA(&src, (NIResamplingRect){0, 0, 8, 1}, &emptyDst,
+                                NIResamplingFilterBilinear, 1, NIResamplingOptionNone));
+}
+
+#pragma mark - Performance
+
+- (void)testResamplingPerformance {
+  NS_VALID_UNTIL_END_OF_SCOPE NSMutableData* srcData =
+      [self dataForBufferWithWidth:2048 height:1536];
+  NIResamplingBuffer src = [self bufferWithData:srcData width:2048 height:1536];
+  [self fillBuffer:src withRandomBytesSeed:1];
+  NS_VALID_UNTIL_END_OF_SCOPE NSMutableData* dstData = [self dataForBufferWithWidth:256 height:192];
+  NIResamplingBuffer dst = [self bufferWithData:dstData width:256 height:192];
+
+  for (size_t ix = 0; ix < kNumberOfFilters; ++ix) {
+    NSTimeInterval durations[3];
+    struct { size_t numberOfThreads; NIResamplingOptions options; } configurations[3] = {
+      { 1, NIResamplingOptionScalar },
+      { 1, NIResamplingOptionNone },
+      { 0, NIResamplingOptionNone },
+    };
+    for (size_t configuration = 0; configuration < 3; ++configuration) {
+      NSDate* start = [NSDate date];
+      for (NSInteger iteration = 0; iteration < 5; ++iteration) {
+        NIResampleRGBA(&src, (NIResamplingRect){0, 0, 2048, 1536}, &dst, kFilters[ix],
+                       configurations[configuration].numberOfThreads,
+                       configurations[configuration].options);
+      }
+      durations[configuration] = [[NSDate date] timeIntervalSinceDate:start] / 5;
+    }
+    NSLog(@"Filter %zu, 2048x1536 to 256x192: scalar %.1f ms, %s %.1f ms, threaded %.1f ms.",
+          ix, durations[0] * 1000, NIResamplingImplementationName(NIResamplingOptionNone),
+          durations[1] * 1000, durations[2] * 1000);
+  }
+}
+
+@end
@@ -0,0 +1,56 @@
+//
+// Copyright 2011-2014 NimbusKit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ * A minimal HTTP/1.1 server on the loopback interface that stands in for an image host.
+ *
+ * Every GET request is answered with the same image after an optional delay. Connections are
+ * kept alive, so the server's counters show how many connections clients really opened.
+ *
+ * When the image has validators, conditional requests that match them are answered with
+ * 304 Not Modified and no body.
+ */
+@interface NIImageTestServer : NSObject
+
+- (id)initWithImageData:(NSData *)imageData responseDelay:(NSTimeInterval)responseDelay;
+
+// http://127.0.0.1:<port>/
+@property (nonatomic, readonly, copy) NSURL* baseURL;
+
+// Validators sent with every image. Default: nil
+@property (copy) NSString* entityTag;
+@property (copy) NSString* lastModified;
+// The value of the Cache-Control header. Default: nil
+@property (copy) NSString* cacheControl;
+// When set, the body of each image is written in eight parts this far apart, so that clients
+// see the image arrive a piece at a time. Default: 0
+@property (assign) NSTimeInterval bodyPartInterval;
+
+- (NSUInteger)numberOfConnections;
+- (NSUInteger)numberOfRequests;
+- (NSUInteger)numberOfNotModifiedResponses;
+
+// The number of response bytes written, headers included.
+- (unsigned long long)numberOfBytesSent;
+
+// The largest number of requests that were waiting for a response at the same time.
+- (NSUInteger)maxNumberOfOutstandingRequests;
+
+- (void)stop;
+
+@end
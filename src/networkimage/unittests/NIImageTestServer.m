@@ -0,0 +1,287 @@
+//
+// Copyright 2011-2014 NimbusKit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#import "NIImageTestServer.h"
+
+#import <arpa/inet.h>
+#import <netinet/in.h>
+#import <sys/socket.h>
+#import <unistd.h>
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "Nimbus requires ARC support."
+#endif
+
+@interface NIImageTestServer()
+@property (nonatomic, copy) NSData* imageData;
+@property (nonatomic, assign) NSTimeInterval responseDelay;
+@property (nonatomic, copy) NSURL* baseURL;
+// Everything below is only touched on the queue.
+@property (nonatomic, strong) dispatch_queue_t queue;
+@property (nonatomic, strong) dispatch_source_t listenSource;
+@property (nonatomic, strong) NSMutableSet* connectionSources;
+@property (nonatomic, assign) NSUInteger connectionCount;
+@property (nonatomic, assign) NSUInteger requestCount;
+@property (nonatomic, assign) NSUInteger notModifiedCount;
+@property (nonatomic, assign) unsigned long long bytesSentCount;
+@property (nonatomic, assign) NSUInteger outstandingRequestCount;
+@property (nonatomic, assign) NSUInteger maxOutstandingRequestCount;
+@end
+
+
+@implementation NIImageTestServer
+
+- (id)initWithImageData:(NSData *)imageData responseDelay:(NSTimeInterval)responseDelay {
+  if ((self = [super init])) {
+    _imageData = [imageData copy];
+    _responseDelay = responseDelay;
+    _queue = dispatch_queue_create("com.nimbuskit.imagetestserver", DISPATCH_QUEUE_SERIAL);
+    _connectionSources = [NSMutableSet set];
+
+    int listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+    int yes = 1;
+    setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_len = sizeof(address);
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    if (0 != bind(listenSocket, (struct sockaddr *)&address, sizeof(address))
+        || 0 != listen(listenSocket, 128)) {
+      close(listenSocket);
+      return nil;
+    }
+    socklen_t addressLength = sizeof(address);
+    getsockname(listenSocket, (struct sockaddr *)&address, &addressLength);
+    _baseURL = [NSURL URLWithString:[NSString stringWithFormat:@"http://127.0.0.1:%d/",
+                                     ntohs(address.sin_port)]];
+
+    _listenSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, listenSocket, 0, _queue);
+    __weak NIImageTestServer* weakSelf = self;
+    dispatch_source_set_event_handler(_listenSource, ^{
+      int connectionSocket = accept(listenSocket, NULL, NULL);
+      if (connectionSocket >= 0) {
+        [weakSelf serveConnection:connectionSocket];
+      }
+    });
+    dispatch_source_set_cancel_handler(_listenSource, ^{
+      close(listenSocket);
+    });
+    dispatch_resume(_listenSource);
+  }
+  return self;
+}
+
+- (void)dealloc {
+  [self stop];
+}
+
+- (void)serveConnection:(int)connectionSocket {
+  int yes = 1;
+  setsockopt(connectionSocket, SOL_SOCKET, SO_NOSIGPIPE, &yes, sizeof(yes));
+  self.connectionCount++;
+
+  NSMutableData* buffer = [NSMutableData data];
+  NSData* headerTerminator = [@"\r\n\r\n" dataUsingEncoding:NSASCIIStringEncoding];
+  dispatch_source_t source = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, connectionSocket,
+                                                    0, self.queue);
+  __weak NIImageTestServer* weakSelf = self;
+  __weak dispatch_source_t weakSource = source;
+  dispatch_source_set_event_handler(source, ^{
+    uint8_t bytes[4096];
+    ssize_t length = read(connectionSocket, bytes, sizeof(bytes));
+    if (length <= 0) {
+      dispatch_source_cancel(weakSource);
+      return;
+    }
+    [buffer appendBytes:bytes length:(NSUInteger)length];
+
+    // Requests have no bodies, so every header block is one request.
+    NSRange range = [buffer rangeOfData:headerTerminator options:0 range:NSMakeRange(0, buffer.length)];
+    while (NSNotFound != range.location) {
+      NSString* request = [[NSString alloc] initWithData:[buffer subdataWithRange:NSMakeRange(0, range.location)]
+                                                encoding:NSASCIIStringEncoding];
+      [buffer replaceBytesInRange:NSMakeRange(0, NSMaxRange(range)) withBytes:NULL length:0];
+      [weakSelf respondOnSocket:connectionSocket toRequest:request];
+      range = [buffer rangeOfData:headerTerminator options:0 range:NSMakeRange(0, buffer.length)];
+    }
+  });
+  dispatch_source_set_cancel_handler(source, ^{
+    close(connectionSocket);
+    [weakSelf.connectionSources removeObject:weakSource];
+  });
+  [self.connectionSources addObject:source];
+  dispatch_resume(source);
+}
+
+// Returns the value of the given header in the request, or nil.
++ (NSString *)valueForHeader:(NSString *)header inRequest:(NSString *)request {
+  NSString* prefix = [header stringByAppendingString:@":"];
+  for (NSString* line in [request componentsSeparatedByString:@"\r\n"]) {
+    if (line.length > prefix.length
+        && NSOrderedSame == [line compare:prefix
+                                  options:NSCaseInsensitiveSearch
+                                    range:NSMakeRange(0, prefix.length)]) {
+      return [[line substringFromIndex:prefix.length]
+              stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+    }
+  }
+  return nil;
+}
+
+- (void)respondOnSocket:(int)connectionSocket toRequest:(NSString *)request {
+  self.requestCount++;
+  self.outstandingRequestCount++;
+  self.maxOutstandingRequestCount = MAX(self.maxOutstandingRequestCount,
+                                        self.outstandingRequestCount);
+
+  NSString* entityTag = self.entityTag;
+  NSString* lastModified = self.lastModified;
+  NSString* ifNoneMatch = [[self class] valueForHeader:@"If-None-Match" inRequest:request];
+  NSString* ifModifiedSince = [[self class] valueForHeader:@"If-Modified-Since" inRequest:request];
+  BOOL notModified = ((nil != entityTag && [ifNoneMatch isEqualToString:entityTag])
+                      || (nil == ifNoneMatch && nil != lastModified
+                          && [ifModifiedSince isEqualToString:lastModified]));
+
+  NSMutableString* headers = [NSMutableString string];
+  if (nil != entityTag) {
+    [headers appendFormat:@"ETag: %@\r\n", entityTag];
+  }
+  if (nil != lastModified) {
+    [headers appendFormat:@"Last-Modified: %@\r\n", lastModified];
+  }
+  if (nil != self.cacheControl) {
+    [headers appendFormat:@"Cache-Control: %@\r\n", self.cacheControl];
+  }
+
+  NSData* body = notModified ? [NSData data] : self.imageData;
+  NSMutableData* response = [[[NSString stringWithFormat:
+                               @"%@\r\n"
+                               @"Content-Type: image/png\r\n"
+                               @"Content-Length: %zd\r\n"
+                               @"Connection: keep-alive\r\n"
+                               @"%@"
+                               @"\r\n",
+                               notModified ? @"HTTP/1.1 304 Not Modified" : @"HTTP/1.1 200 OK",
+                               body.length,
+                               headers]
+                              dataUsingEncoding:NSASCIIStringEncoding] mutableCopy];
+  [response appendData:body];
+  if (notModified) {
+    self.notModifiedCount++;
+  }
+  self.bytesSentCount += response.length;
+
+  // Responses on a connection are sent in order because they all wait equally long on a serial
+  // queue.
+  dispatch_time_t time = dispatch_time(DISPATCH_TIME_NOW,
+                                       (int64_t)(self.responseDelay * NSEC_PER_SEC));
+  NSTimeInterval bodyPartInterval = self.bodyPartInterval;
+  if (bodyPartInterval <= 0 || 0 == body.length) {
+    dispatch_after(time, self.queue, ^{
+      self.outstandingRequestCount--;
+      [[self class] writeData:response toSocket:connectionSocket];
+    });
+    return;
+  }
+
+  static const NSUInteger kNumberOfBodyParts = 8;
+  NSUInteger headerLength = response.length - body.length;
+  NSUInteger partLength = (body.length + kNumberOfBodyParts - 1) / kNumberOfBodyParts;
+  for (NSUInteger ix = 0; ix < kNumberOfBodyParts; ++ix) {
+    NSUInteger location = (0 == ix) ? 0 : headerLength + ix * partLength;
+    NSUInteger end = MIN(headerLength + (ix + 1) * partLength, response.length);
+    if (location >= end) {
+      break;
+    }
+    NSData* part = [response subdataWithRange:NSMakeRange(location, end - location)];
+    dispatch_time_t partTime = dispatch_time(time, (int64_t)(ix * bodyPartInterval * NSEC_PER_SEC));
+    dispatch_after(partTime, self.queue, ^{
+      if (0 == ix) {
+        self.outstandingRequestCount--;
+      }
+      [[self class] writeData:part toSocket:connectionSocket];
+    });
+  }
+}
+
++ (void)writeData:(NSData *)data toSocket:(int)connectionSocket {
+  const uint8_t* bytes = data.bytes;
+  NSUInteger written = 0;
+  while (written < data.length) {
+    ssize_t length = write(connectionSocket, bytes + written, data.length - written);
+    if (length <= 0) {
+      break;
+    }
+    written += (NSUInteger)length;
+  }
+}
+
+- (NSUInteger)numberOfConnections {
+  __block NSUInteger count = 0;
+  dispatch_sync(self.queue, ^{
+    count = self.connectionCount;
+  });
+  return count;
+}
+
+- (NSUInteger)numberOfRequests {
+  __block NSUInteger count = 0;
+  dispatch_sync(self.queue, ^{
+    count = self.requestCount;
+  });
+  return count;
+}
+
+- (NSUInteger)numberOfNotModifiedResponses {
+  __block NSUInteger count = 0;
+  dispatch_sync(self.queue, ^{
+    count = self.notModifiedCount;
+  });
+  return count;
+}
+
+- (unsigned long long)numberOfBytesSent {
+  __block unsigned long long count = 0;
+  dispatch_sync(self.queue, ^{
+    count = self.bytesSentCount;
+  });
+  return count;
+}
+
+- (NSUInteger)maxNumberOfOutstandingRequests {
+  __block NSUInteger count = 0;
+  dispatch_sync(self.queue, ^{
+    count = self.maxOutstandingRequestCount;
+  });
+  return count;
+}
+
+- (void)stop {
+  dispatch_source_t listenSource = _listenSource;
+  NSSet* connectionSources = [_connectionSources copy];
+  _listenSource = nil;
+  if (nil != listenSource) {
+    dispatch_source_cancel(listenSource);
+  }
+  for (dispatch_source_t source in connectionSources) {
+    dispatch_source_cancel(source);
+  }
+}
+
+@end
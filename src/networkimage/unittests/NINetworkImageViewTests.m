@@ -16,18 +16,1305 @@
 
 // See: http://bit.ly/hS5nNh for unit test macros.
 
+#import <ImageIO/ImageIO.h>
 #import <XCTest/XCTest.h>
 
 #import "NimbusNetworkImage.h"
+#import "NIImageTestServer.h"
+
+static const NSUInteger kNumberOfGridImages = 60;
+
+// Counts how many times responses are processed into images.
+@interface NICountingImageResponseSerializer : NIImageResponseSerializer
+@end
+
+static NSInteger sNumberOfProcessedResponses = 0;
+
+@implementation NICountingImageResponseSerializer
+
+- (id)responseObjectForResponse:(NSURLResponse *)response
+                           data:(NSData *)data
+                          error:(NSError *__autoreleasing *)error {
+  @synchronized([NICountingImageResponseSerializer class]) {
+    sNumberOfProcessedResponses++;
+  }
+  return [super responseObjectForResponse:response data:data error:error];
+}
+
+@end
+
+// Counts how many times data is read on the main thread.
+@interface NIMainThreadCountingDiskCache : NIDiskCache
+@property (atomic, assign) NSUInteger numberOfMainThreadReads;
+@end
+
+@implementation NIMainThreadCountingDiskCache
+
+- (NSData *)dataWithName:(NSString *)name {
+  if ([NSThread isMainThread]) {
+    self.numberOfMainThreadReads++;
+  }
+  return [super dataWithName:name];
+}
+
+@end
+
+// A model object whose images are set by the test.
+@interface NIImagePrefetchingTestObject : NSObject <NIImagePrefetchingObject>
+@property (nonatomic, copy) NSArray* requests;
+@end
+
+@implementation NIImagePrefetchingTestObject
+
+- (NSArray *)imagePrefetchRequests {
+  return self.requests;
+}
+
+@end
 
 @interface NINetworkImageViewTests : XCTestCase
+@property (nonatomic, copy) NSData* imageData;
+@property (nonatomic, strong) NIImageTestServer* server;
 @end
 
 
 @implementation NINetworkImageViewTests
 
+- (void)setUp {
+  [super setUp];
+
+  UIGraphicsBeginImageContextWithOptions(CGSizeMake(32, 32), YES, 1);
+  [[UIColor redColor] setFill];
+  UIRectFill(CGRectMake(0, 0, 32, 32));
+  UIImage* image = UIGraphicsGetImageFromCurrentImageContext();
+  UIGraphicsEndImageContext();
+  self.imageData = UIImagePNGRepresentation(image);
+
+  self.server = [self newServer];
+}
+
+- (void)tearDown {
+  [self.server stop];
+  self.server = nil;
+  [super tearDown];
+}
+
+- (NIImageTestServer *)newServer {
+  // A short delay keeps several requests in flight at once, like a real image host would.
+  return [[NIImageTestServer alloc] initWithImageData:self.imageData responseDelay:0.05];
+}
+
+- (NINetworkImageLoader *)newLoader {
+  NSURLSessionConfiguration* configuration = [NSURLSessionConfiguration ephemeralSessionConfiguration];
+  return [[NINetworkImageLoader alloc] initWithSessionConfiguration:configuration];
+}
+
+- (NSURL *)imageURLAtIndex:(NSUInteger)index {
+  return [NSURL URLWithString:[NSString stringWithFormat:@"image%zd.png", index]
+                relativeToURL:self.server.baseURL];
+}
+
+- (BOOL)waitForCondition:(BOOL (^)(void))condition timeout:(NSTimeInterval)timeout {
+  NSDate* deadline = [NSDate dateWithTimeIntervalSinceNow:timeout];
+  while (!condition() && [deadline timeIntervalSinceNow] > 0) {
+    [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode
+                             beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+  }
+  return condition();
+}
+
+// Loads a grid of image views, giving each view the loader returned by loaderForIndex, and
+// returns how long it took for every view to show its image.
+- (NSTimeInterval)loadGridWithLoader:(NINetworkImageLoader* (^)(NSUInteger index))loaderForIndex {
+  NSMutableArray* imageViews = [NSMutableArray array];
+  NSDate* start = [NSDate date];
+  for (NSUInteger ix = 0; ix < kNumberOfGridImages; ++ix) {
+    NINetworkImageView* imageView = [[NINetworkImageView alloc] initWithFrame:CGRectMake(0, 0, 32, 32)];
+    imageView.imageMemoryCache = nil;
+    imageView.imageLoader = loaderForIndex(ix);
+    [imageView setPathToNetworkImage:[[self imageURLAtIndex:ix] absoluteString]];
+    [imageViews addObject:imageView];
+  }
+
+  BOOL finished = [self waitForCondition:^BOOL{
+    for (NINetworkImageView* imageView in imageViews) {
+      if (nil == imageView.image) {
+        return NO;
+      }
+    }
+    return YES;
+  } timeout:30];
+  XCTAssertTrue(finished, @"Every image view should have loaded its image.");
+  return [[NSDate date] timeIntervalSinceDate:start];
+}
+
+#pragma mark - Connection Reuse
+
+- (void)testSharedLoaderReusesConnections {
+  NINetworkImageLoader* loader = [self newLoader];
+  NSTimeInterval duration = [self loadGridWithLoader:^NINetworkImageLoader *(NSUInteger index) {
+    return loader;
+  }];
+  [loader invalidate];
+
+  NSLog(@"Shared loader: %zd connections for %zd images in %.3fs",
+        self.server.numberOfConnections, kNumberOfGridImages, duration);
+  XCTAssertEqual(self.server.numberOfRequests, kNumberOfGridImages);
+  XCTAssertLessThanOrEqual(self.server.numberOfConnections, loader.maxNumberOfConcurrentRequestsPerHost,
+                           @"Every request should have gone over one of the host's connections.");
+}
+
+- (void)testLoaderPerViewOpensMoreConnections {
+  // Giving every view its own session is how image views used to load images.
+  NSMutableArray* loaders = [NSMutableArray array];
+  NSTimeInterval duration = [self loadGridWithLoader:^NINetworkImageLoader *(NSUInteger index) {
+    NINetworkImageLoader* loader = [self newLoader];
+    [loaders addObject:loader];
+    return loader;
+  }];
+  [loaders makeObjectsPerformSelector:@selector(invalidate)];
+  NSUInteger perViewConnections = self.server.numberOfConnections;
+
+  // Load the same grid from a fresh server so that no connections carry over.
+  [self.server stop];
+  self.server = [self newServer];
+  NINetworkImageLoader* loader = [self newLoader];
+  NSTimeInterval sharedDuration = [self loadGridWithLoader:^NINetworkImageLoader *(NSUInteger index) {
+    return loader;
+  }];
+  [loader invalidate];
+
+  NSLog(@"Loader per view: %zd connections in %.3fs. Shared loader: %zd connections in %.3fs",
+        perViewConnections, duration, self.server.numberOfConnections, sharedDuration);
+  XCTAssertGreaterThan(perViewConnections, self.server.numberOfConnections);
+}
+
+- (void)testRequestsPerHostAreLimited {
+  NINetworkImageLoader* loader = [self newLoader];
+  loader.maxNumberOfConcurrentRequestsPerHost = 2;
+  [self loadGridWithLoader:^NINetworkImageLoader *(NSUInteger index) {
+    return loader;
+  }];
+  [loader invalidate];
+
+  XCTAssertEqual(self.server.numberOfRequests, kNumberOfGridImages);
+  XCTAssertLessThanOrEqual(self.server.maxNumberOfOutstandingRequests, (NSUInteger)2);
+}
+
+- (void)testCancelledRequestDoesNotComplete {
+  NINetworkImageLoader* loader = [self newLoader];
+  __block BOOL cancelledDidComplete = NO;
+  __block BOOL didComplete = NO;
+  NINetworkImageLoaderRequest* request =
+  [loader loadImageWithURL:[self imageURLAtIndex:0]
+        responseSerializer:nil
+                  progress:nil
+                completion:^(UIImage* image, NSError* error) {
+                  cancelledDidComplete = YES;
+                }];
+  [request cancel];
+  [loader loadImageWithURL:[self imageURLAtIndex:1]
+        responseSerializer:nil
+                  progress:nil
+                completion:^(UIImage* image, NSError* error) {
+                  XCTAssertNotNil(image);
+                  didComplete = YES;
+                }];
+
+  // The second request is sent after the first one, so once it has completed the first one
+  // would have completed as well.
+  XCTAssertTrue([self waitForCondition:^BOOL{ return didComplete; } timeout:10]);
+  XCTAssertFalse(cancelledDidComplete);
+  [loader invalidate];
+}
+
+#pragma mark - Request Coalescing
+
+- (void)testIdenticalURLsShareOneFetch {
+  NINetworkImageLoader* loader = [self newLoader];
+  NSURL* avatarURL = [self imageURLAtIndex:0];
+  NSMutableArray* imageViews = [NSMutableArray array];
+  for (NSUInteger ix = 0; ix < 30; ++ix) {
+    NINetworkImageView* imageView = [[NINetworkImageView alloc] initWithFrame:CGRectMake(0, 0, 32, 32)];
+    imageView.imageMemoryCache = nil;
+    imageView.imageLoader = loader;
+    [imageView setPathToNetworkImage:[avatarURL absoluteString]];
+    [imageViews addObject:imageView];
+  }
+
+  BOOL finished = [self waitForCondition:^BOOL{
+    for (NINetworkImageView* imageView in imageViews) {
+      if (nil == imageView.image) {
+        return NO;
+      }
+    }
+    return YES;
+  } timeout:10];
+  [loader invalidate];
+
+  XCTAssertTrue(finished);
+  XCTAssertEqual(self.server.numberOfRequests, (NSUInteger)1);
+}
+
+- (void)testResponseIsProcessedOncePerProcessingKey {
+  NINetworkImageLoader* loader = [self newLoader];
+  sNumberOfProcessedResponses = 0;
+  __block NSInteger numberOfCompletions = 0;
+  NSMutableSet* images = [NSMutableSet set];
+  for (NSUInteger ix = 0; ix < 10; ++ix) {
+    NICountingImageResponseSerializer* serializer = [NICountingImageResponseSerializer serializer];
+    // Two distinct display sizes.
+    serializer.displaySize = (ix % 2) ? CGSizeMake(16, 16) : CGSizeMake(8, 8);
+    serializer.contentMode = UIViewContentModeScaleAspectFill;
+    [loader loadImageWithURL:[self imageURLAtIndex:0]
+          responseSerializer:serializer
+                    progress:nil
+                  completion:^(UIImage* image, NSError* error) {
+                    XCTAssertNotNil(image);
+                    if (nil != image) {
+                      [images addObject:image];
+                    }
+                    numberOfCompletions++;
+                  }];
+  }
+
+  XCTAssertTrue([self waitForCondition:^BOOL{ return numberOfCompletions == 10; } timeout:10]);
+  [loader invalidate];
+
+  XCTAssertEqual(self.server.numberOfRequests, (NSUInteger)1);
+  XCTAssertEqual(sNumberOfProcessedResponses, 2);
+  XCTAssertEqual(images.count, (NSUInteger)2, @"Requests with equal keys should share an image.");
+}
+
+- (void)testResponsesAreProcessedOnTheImageProcessingQueue {
+  NINetworkImageLoader* loader = [self newLoader];
+  NSOperationQueue* processingQueue = [[NSOperationQueue alloc] init];
+  processingQueue.maxConcurrentOperationCount = 1;
+  processingQueue.suspended = YES;
+  loader.imageProcessingQueue = processingQueue;
+
+  __block BOOL didComplete = NO;
+  [loader loadImageWithURL:[self imageURLAtIndex:0]
+        responseSerializer:nil
+                  progress:nil
+                completion:^(UIImage* image, NSError* error) {
+                  XCTAssertNotNil(image);
+                  didComplete = YES;
+                }];
+
+  // The response arrives, but isn't processed until the queue lets it.
+  XCTAssertTrue([self waitForCondition:^BOOL{ return processingQueue.operationCount > 0; } timeout:10]);
+  XCTAssertFalse(didComplete);
+  processingQueue.suspended = NO;
+  XCTAssertTrue([self waitForCondition:^BOOL{ return didComplete; } timeout:10]);
+  [loader invalidate];
+}
+
+- (void)testCancellingOneWaiterKeepsTheSharedFetch {
+  NINetworkImageLoader* loader = [self newLoader];
+  __block BOOL cancelledDidComplete = NO;
+  __block BOOL didComplete = NO;
+  NINetworkImageLoaderRequest* request =
+  [loader loadImageWithURL:[self imageURLAtIndex:0]
+        responseSerializer:nil
+                  progress:nil
+                completion:^(UIImage* image, NSError* error) {
+                  cancelledDidComplete = YES;
+                }];
+  [loader loadImageWithURL:[self imageURLAtIndex:0]
+        responseSerializer:nil
+                  progress:nil
+                completion:^(UIImage* image, NSError* error) {
+                  XCTAssertNotNil(image);
+                  XCTAssertNil(error);
+                  didComplete = YES;
+                }];
+  [request cancel];
+
+  XCTAssertTrue([self waitForCondition:^BOOL{ return didComplete; } timeout:10]);
+  XCTAssertFalse(cancelledDidComplete);
+  XCTAssertEqual(self.server.numberOfRequests, (NSUInteger)1);
+  [loader invalidate];
+}
+
+#pragma mark - Prioritization
+
+- (void)testPendingRequestsAreSentMostUrgentFirst {
+  NINetworkImageLoader* loader = [self newLoader];
+  loader.maxNumberOfConcurrentRequestsPerHost = 1;
+  NSMutableArray* completionOrder = [NSMutableArray array];
+  NINetworkImagePriority priorities[] = {
+    NINetworkImagePriorityVisible,  // Occupies the only slot.
+    NINetworkImagePriorityPrefetch,
+    NINetworkImagePriorityNearVisible,
+    NINetworkImagePriorityPrefetch,
+    NINetworkImagePriorityVisible,
+  };
+  for (NSUInteger ix = 0; ix < sizeof(priorities) / sizeof(priorities[0]); ++ix) {
+    NINetworkImageLoaderRequest* request =
+    [loader loadImageWithURL:[self imageURLAtIndex:ix]
+          responseSerializer:nil
+                    progress:nil
+                  completion:^(UIImage* image, NSError* error) {
+                    [completionOrder addObject:@(ix)];
+                  }];
+    request.priority = priorities[ix];
+  }
+
+  XCTAssertTrue([self waitForCondition:^BOOL{ return completionOrder.count == 5; } timeout:10]);
+  [loader invalidate];
+
+  NSArray* expectedOrder = @[@0, @4, @2, @1, @3];
+  XCTAssertEqualObjects(completionOrder, expectedOrder);
+}
+
+- (void)testVisibleRequestSuspendsPrefetch {
+  NINetworkImageLoader* loader = [self newLoader];
+  loader.maxNumberOfConcurrentRequestsPerHost = 1;
+  loader.suspendsLowerPriorityRequests = YES;
+  NSMutableArray* completionOrder = [NSMutableArray array];
+
+  NINetworkImageLoaderRequest* prefetch =
+  [loader loadImageWithURL:[self imageURLAtIndex:0]
+        responseSerializer:nil
+                  progress:nil
+                completion:^(UIImage* image, NSError* error) {
+                  XCTAssertNotNil(image);
+                  [completionOrder addObject:@0];
+                }];
+  prefetch.priority = NINetworkImagePriorityPrefetch;
+  [loader loadImageWithURL:[self imageURLAtIndex:1]
+        responseSerializer:nil
+                  progress:nil
+                completion:^(UIImage* image, NSError* error) {
+                  XCTAssertNotNil(image);
+                  [completionOrder addObject:@1];
+                }];
+
+  // The suspended prefetch still finishes once the visible request is done.
+  XCTAssertTrue([self waitForCondition:^BOOL{ return completionOrder.count == 2; } timeout:10]);
+  [loader invalidate];
+  XCTAssertEqualObjects(completionOrder, (@[@1, @0]));
+}
+
+// Flings a scroll view of image views from top to bottom, one row per frame, configuring each
+// row as it comes near the viewport like a table view would. Returns how long after the scroll
+// ended the rows in the final viewport took to show their images.
+- (NSTimeInterval)timeToVisibleImagesAfterScrollWithLoader:(NINetworkImageLoader *)loader
+                                          updatePriorities:(BOOL)updatePriorities {
+  const CGFloat rowHeight = 80;
+  UIScrollView* scrollView = [[UIScrollView alloc] initWithFrame:CGRectMake(0, 0, 320, 480)];
+  scrollView.contentSize = CGSizeMake(320, rowHeight * kNumberOfGridImages);
+
+  NSMutableArray* imageViews = [NSMutableArray array];
+  for (NSUInteger ix = 0; ix < kNumberOfGridImages; ++ix) {
+    NINetworkImageView* imageView =
+    [[NINetworkImageView alloc] initWithFrame:CGRectMake(0, rowHeight * ix, 320, rowHeight)];
+    imageView.imageMemoryCache = nil;
+    imageView.imageLoader = loader;
+    [scrollView addSubview:imageView];
+    [imageViews addObject:imageView];
+  }
+
+  NSUInteger numberOfConfiguredRows = 0;
+  CGFloat maxOffset = scrollView.contentSize.height - scrollView.bounds.size.height;
+  for (CGFloat offset = 0; offset <= maxOffset; offset += rowHeight) {
+    scrollView.contentOffset = CGPointMake(0, offset);
+
+    // Configure every row up to one viewport below the visible rows.
+    NSUInteger lastRow = MIN(kNumberOfGridImages,
+                             (NSUInteger)((offset + 2 * scrollView.bounds.size.height) / rowHeight));
+    for (; numberOfConfiguredRows < lastRow; ++numberOfConfiguredRows) {
+      NINetworkImageView* imageView = imageViews[numberOfConfiguredRows];
+      [imageView setPathToNetworkImage:[[self imageURLAtIndex:numberOfConfiguredRows] absoluteString]];
+    }
+    if (updatePriorities) {
+      for (NINetworkImageView* imageView in imageViews) {
+        [imageView updatePriorityInScrollView:scrollView];
+      }
+    }
+
+    // One frame.
+    [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode
+                             beforeDate:[NSDate dateWithTimeIntervalSinceNow:1.0 / 60]];
+  }
+
+  NSDate* scrollEnd = [NSDate date];
+  NSMutableArray* visibleImageViews = [NSMutableArray array];
+  for (NINetworkImageView* imageView in imageViews) {
+    if (CGRectIntersectsRect(imageView.frame, scrollView.bounds)) {
+      [visibleImageViews addObject:imageView];
+    }
+  }
+  BOOL finished = [self waitForCondition:^BOOL{
+    for (NINetworkImageView* imageView in visibleImageViews) {
+      if (nil == imageView.image) {
+        return NO;
+      }
+    }
+    return YES;
+  } timeout:30];
+  XCTAssertTrue(finished);
+  return [[NSDate date] timeIntervalSinceDate:scrollEnd];
+}
+
+- (void)testPrioritizationReducesTimeToVisibleImageDuringFastScroll {
+  // A low limit makes the host the bottleneck, as a slow connection would.
+  NINetworkImageLoader* fifoLoader = [self newLoader];
+  fifoLoader.maxNumberOfConcurrentRequestsPerHost = 2;
+  NSTimeInterval fifoTime = [self timeToVisibleImagesAfterScrollWithLoader:fifoLoader
+                                                          updatePriorities:NO];
+  [fifoLoader invalidate];
+
+  [self.server stop];
+  self.server = [self newServer];
+  NINetworkImageLoader* loader = [self newLoader];
+  loader.maxNumberOfConcurrentRequestsPerHost = 2;
+  loader.suspendsLowerPriorityRequests = YES;
+  NSTimeInterval prioritizedTime = [self timeToVisibleImagesAfterScrollWithLoader:loader
+                                                                 updatePriorities:YES];
+  [loader invalidate];
+
+  NSLog(@"Time to visible images after a fast scroll: FIFO %.3fs, prioritized %.3fs",
+        fifoTime, prioritizedTime);
+  XCTAssertLessThan(prioritizedTime, fifoTime);
+}
+
+#pragma mark - Prefetching
+
+- (void)testPrefetchedImageIsShownImmediately {
+  NINetworkImageLoader* loader = [self newLoader];
+  NIImageMemoryCache* imageMemoryCache = [[NIImageMemoryCache alloc] init];
+  NINetworkImagePrefetcher* prefetcher = [[NINetworkImagePrefetcher alloc] init];
+  prefetcher.imageLoader = loader;
+  prefetcher.imageMemoryCache = imageMemoryCache;
+
+  NSString* path = [[self imageURLAtIndex:0] absoluteString];
+  NIImagePrefetchingTestObject* object = [[NIImagePrefetchingTestObject alloc] init];
+  object.requests = @[[NIImagePrefetchRequest requestWithPath:path
+                                                  displaySize:CGSizeMake(16, 16)
+                                                  contentMode:UIViewContentModeScaleAspectFill]];
+  [prefetcher prefetchImagesForObject:object];
+
+  NSString* cacheKey = [NINetworkImageView cacheKeyForPathToNetworkImage:path
+                                                             displaySize:CGSizeMake(16, 16)
+                                                                cropRect:CGRectZero
+                                                             contentMode:UIViewContentModeScaleAspectFill
+                                                            scaleOptions:prefetcher.scaleOptions];
+  XCTAssertTrue([self waitForCondition:^BOOL{
+    return [imageMemoryCache containsObjectWithName:cacheKey];
+  } timeout:10]);
+
+  NINetworkImageView* imageView = [[NINetworkImageView alloc] initWithFrame:CGRectMake(0, 0, 16, 16)];
+  imageView.imageMemoryCache = imageMemoryCache;
+  imageView.imageLoader = loader;
+  [imageView setPathToNetworkImage:path contentMode:UIViewContentModeScaleAspectFill];
+  XCTAssertNotNil(imageView.image, @"The prefetched image should be shown without loading it.");
+  XCTAssertFalse(imageView.isLoading);
+  XCTAssertEqual(self.server.numberOfRequests, (NSUInteger)1);
+
+  [loader invalidate];
+}
+
+- (void)testPrefetchedImageIsNotSizedForDisplayWhenDisabled {
+  NINetworkImageLoader* loader = [self newLoader];
+  NIImageMemoryCache* imageMemoryCache = [[NIImageMemoryCache alloc] init];
+  NINetworkImagePrefetcher* prefetcher = [[NINetworkImagePrefetcher alloc] init];
+  prefetcher.imageLoader = loader;
+  prefetcher.imageMemoryCache = imageMemoryCache;
+  prefetcher.sizeForDisplay = NO;
+
+  NSString* path = [[self imageURLAtIndex:0] absoluteString];
+  NIImagePrefetchingTestObject* object = [[NIImagePrefetchingTestObject alloc] init];
+  object.requests = @[[NIImagePrefetchRequest requestWithPath:path
+                                                  displaySize:CGSizeMake(16, 16)
+                                                  contentMode:UIViewContentModeScaleAspectFill]];
+  [prefetcher prefetchImagesForObject:object];
+
+  NSString* cacheKey = [NINetworkImageView cacheKeyForPathToNetworkImage:path
+                                                             pixelFormat:prefetcher.pixelFormat];
+  XCTAssertTrue([self waitForCondition:^BOOL{
+    return [imageMemoryCache containsObjectWithName:cacheKey];
+  } timeout:10]);
+
+  NINetworkImageView* imageView = [[NINetworkImageView alloc] initWithFrame:CGRectMake(0, 0, 16, 16)];
+  imageView.imageMemoryCache = imageMemoryCache;
+  imageView.imageLoader = loader;
+  imageView.sizeForDisplay = NO;
+  [imageView setPathToNetworkImage:path contentMode:UIViewContentModeScaleAspectFill];
+  XCTAssertNotNil(imageView.image, @"The prefetched image should be shown without loading it.");
+  XCTAssertFalse(imageView.isLoading);
+  XCTAssertEqual(self.server.numberOfRequests, (NSUInteger)1);
+
+  // A view that doesn't size its images for display shows the full image.
+  XCTAssertEqualWithAccuracy(imageView.image.size.width, 32, 0.001);
+  XCTAssertEqualWithAccuracy(imageView.image.size.height, 32, 0.001);
+
+  [loader invalidate];
+}
+
+- (void)testCancelledPrefetchIsNotCached {
+  NINetworkImageLoader* loader = [self newLoader];
+  NIImageMemoryCache* imageMemoryCache = [[NIImageMemoryCache alloc] init];
+  NINetworkImagePrefetcher* prefetcher = [[NINetworkImagePrefetcher alloc] init];
+  prefetcher.imageLoader = loader;
+  prefetcher.imageMemoryCache = imageMemoryCache;
+
+  NIImagePrefetchingTestObject* object = [[NIImagePrefetchingTestObject alloc] init];
+  object.requests = @[[NIImagePrefetchRequest requestWithPath:[[self imageURLAtIndex:0] absoluteString]
+                                                  displaySize:CGSizeMake(16, 16)
+                                                  contentMode:UIViewContentModeScaleAspectFill]];
+  [prefetcher prefetchImagesForObject:object];
+  [prefetcher cancelPrefetchingImagesForObject:object];
+
+  // Give the response time to arrive.
+  [self waitForCondition:^BOOL{ return NO; } timeout:0.3];
+  XCTAssertEqual(imageMemoryCache.count, (NSUInteger)0);
+  [loader invalidate];
+}
+
+#pragma mark - Revalidation
+
+- (NINetworkImageLoader *)newLoaderWithResponseCacheAtPath:(NSString *)path {
+  NINetworkImageLoader* loader = [self newLoader];
+  loader.responseCache = [[NIDiskCache alloc] initWithPath:path];
+  return loader;
+}
+
+- (NSString *)temporaryResponseCachePath {
+  return [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+}
+
+// Loads the image at the URL and waits for it.
+- (UIImage *)loadImageWithLoader:(NINetworkImageLoader *)loader url:(NSURL *)url {
+  __block UIImage* loadedImage = nil;
+  __block BOOL didComplete = NO;
+  [loader loadImageWithURL:url
+        responseSerializer:nil
+                  progress:nil
+                completion:^(UIImage* image, NSError* error) {
+                  loadedImage = image;
+                  didComplete = YES;
+                }];
+  XCTAssertTrue([self waitForCondition:^BOOL{ return didComplete; } timeout:10]);
+  return loadedImage;
+}
+
+- (void)testStaleImageWithEntityTagIsRevalidated {
+  NSString* path = [self temporaryResponseCachePath];
+  NINetworkImageLoader* loader = [self newLoaderWithResponseCacheAtPath:path];
+  self.server.entityTag = @"\"v1\"";
+
+  XCTAssertNotNil([self loadImageWithLoader:loader url:[self imageURLAtIndex:0]]);
+  unsigned long long bytesForFullResponse = self.server.numberOfBytesSent;
+  XCTAssertNotNil([self loadImageWithLoader:loader url:[self imageURLAtIndex:0]]);
+  unsigned long long bytesForNotModifiedResponse = self.server.numberOfBytesSent - bytesForFullResponse;
+
+  XCTAssertEqual(self.server.numberOfRequests, (NSUInteger)2);
+  XCTAssertEqual(self.server.numberOfNotModifiedResponses, (NSUInteger)1);
+  XCTAssertEqual(loader.numberOfNotModifiedResponses, (NSUInteger)1);
+  XCTAssertEqual(loader.numberOfBytesSavedByResponseCache, (unsigned long long)self.imageData.length);
+  XCTAssertLessThan(bytesForNotModifiedResponse, bytesForFullResponse);
+  NSLog(@"Revalidating the image sent %llu bytes instead of %llu.",
+        bytesForNotModifiedResponse, bytesForFullResponse);
+
+  [loader invalidate];
+  [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+- (void)testStaleImageWithLastModifiedIsRevalidated {
+  NSString* path = [self temporaryResponseCachePath];
+  NINetworkImageLoader* loader = [self newLoaderWithResponseCacheAtPath:path];
+  self.server.lastModified = @"Wed, 21 Oct 2015 07:28:00 GMT";
+
+  XCTAssertNotNil([self loadImageWithLoader:loader url:[self imageURLAtIndex:0]]);
+  XCTAssertNotNil([self loadImageWithLoader:loader url:[self imageURLAtIndex:0]]);
+
+  XCTAssertEqual(self.server.numberOfRequests, (NSUInteger)2);
+  XCTAssertEqual(self.server.numberOfNotModifiedResponses, (NSUInteger)1);
+
+  [loader invalidate];
+  [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+- (void)testChangedImageIsDownloadedAgain {
+  NSString* path = [self temporaryResponseCachePath];
+  NINetworkImageLoader* loader = [self newLoaderWithResponseCacheAtPath:path];
+  self.server.entityTag = @"\"v1\"";
+  XCTAssertNotNil([self loadImageWithLoader:loader url:[self imageURLAtIndex:0]]);
+
+  self.server.entityTag = @"\"v2\"";
+  XCTAssertNotNil([self loadImageWithLoader:loader url:[self imageURLAtIndex:0]]);
+  XCTAssertNotNil([self loadImageWithLoader:loader url:[self imageURLAtIndex:0]]);
+
+  // The second load stores the new version, which the third load then revalidates.
+  XCTAssertEqual(self.server.numberOfRequests, (NSUInteger)3);
+  XCTAssertEqual(self.server.numberOfNotModifiedResponses, (NSUInteger)1);
+
+  [loader invalidate];
+  [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+- (void)testFreshImageIsServedWithoutContactingTheServer {
+  NSString* path = [self temporaryResponseCachePath];
+  NINetworkImageLoader* loader = [self newLoaderWithResponseCacheAtPath:path];
+  self.server.cacheControl = @"max-age=60";
+
+  XCTAssertNotNil([self loadImageWithLoader:loader url:[self imageURLAtIndex:0]]);
+  XCTAssertNotNil([self loadImageWithLoader:loader url:[self imageURLAtIndex:0]]);
+
+  XCTAssertEqual(self.server.numberOfRequests, (NSUInteger)1);
+  XCTAssertEqual(loader.numberOfResponseCacheHits, (NSUInteger)1);
+
+  [loader invalidate];
+  [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+- (void)testResponseCacheIsNotReadOnTheMainThread {
+  NSString* path = [self temporaryResponseCachePath];
+  NINetworkImageLoader* loader = [self newLoader];
+  NIMainThreadCountingDiskCache* responseCache = [[NIMainThreadCountingDiskCache alloc] initWithPath:path];
+  loader.responseCache = responseCache;
+  self.server.cacheControl = @"max-age=60";
+
+  XCTAssertNotNil([self loadImageWithLoader:loader url:[self imageURLAtIndex:0]]);
+  XCTAssertNotNil([self loadImageWithLoader:loader url:[self imageURLAtIndex:0]]);
+
+  XCTAssertEqual(loader.numberOfResponseCacheHits, (NSUInteger)1);
+  XCTAssertEqual(responseCache.numberOfMainThreadReads, (NSUInteger)0);
+
+  [loader invalidate];
+  [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+- (void)testNoStoreImageIsNotCached {
+  NSString* path = [self temporaryResponseCachePath];
+  NINetworkImageLoader* loader = [self newLoaderWithResponseCacheAtPath:path];
+  self.server.entityTag = @"\"v1\"";
+  self.server.cacheControl = @"no-store";
+
+  XCTAssertNotNil([self loadImageWithLoader:loader url:[self imageURLAtIndex:0]]);
+  XCTAssertNotNil([self loadImageWithLoader:loader url:[self imageURLAtIndex:0]]);
+
+  XCTAssertEqual(self.server.numberOfRequests, (NSUInteger)2);
+  XCTAssertEqual(self.server.numberOfNotModifiedResponses, (NSUInteger)0);
+
+  [loader invalidate];
+  [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+#pragma mark - Decoding
+
+// A photo-sized JPEG.
+- (NSData *)JPEGDataWithSize:(CGSize)size {
+  UIGraphicsBeginImageContextWithOptions(size, YES, 1);
+  [[UIColor blueColor] setFill];
+  UIRectFill(CGRectMake(0, 0, size.width, size.height));
+  [[UIColor yellowColor] setFill];
+  UIRectFill(CGRectMake(size.width / 4, size.height / 4, size.width / 2, size.height / 2));
+  UIImage* image = UIGraphicsGetImageFromCurrentImageContext();
+  UIGraphicsEndImageContext();
+  return UIImageJPEGRepresentation(image, 0.8);
+}
+
+- (UIImage *)fullyDecodedImageFromData:(NSData *)data
+                           contentMode:(UIViewContentMode)contentMode
+                           displaySize:(CGSize)displaySize {
+  return [NIImageProcessing imageFromSource:[UIImage imageWithData:data]
+                            withContentMode:contentMode
+                                   cropRect:CGRectZero
+                                displaySize:displaySize
+                               scaleOptions:NINetworkImageViewScaleToFitLeavesExcessAndScaleToFillCropsExcess
+                       interpolationQuality:kCGInterpolationDefault];
+}
+
+- (UIImage *)imageDecodedAtDisplaySizeFromData:(NSData *)data
+                                   contentMode:(UIViewContentMode)contentMode
+                                   displaySize:(CGSize)displaySize {
+  UIImage* image = [NIImageProcessing imageFromData:data
+                              decodedForContentMode:contentMode
+                                           cropRect:CGRectZero
+                                        displaySize:displaySize];
+  return [NIImageProcessing imageFromSource:image
+                            withContentMode:contentMode
+                                   cropRect:CGRectZero
+                                displaySize:displaySize
+                               scaleOptions:NINetworkImageViewScaleToFitLeavesExcessAndScaleToFillCropsExcess
+                       interpolationQuality:kCGInterpolationDefault];
+}
+
+- (void)testLargeImageIsDecodedAtDisplaySize {
+  NSData* data = [self JPEGDataWithSize:CGSizeMake(4000, 3000)];
+  CGFloat screenScale = NIScreenScale();
+
+  UIImage* image = [NIImageProcessing imageFromData:data
+                              decodedForContentMode:UIViewContentModeScaleAspectFill
+                                           cropRect:CGRectZero
+                                        displaySize:CGSizeMake(80, 80)];
+  XCTAssertNotNil(image);
+
+  // Aspect fill needs the image's shorter side to cover the display.
+  size_t width = CGImageGetWidth(image.CGImage);
+  size_t height = CGImageGetHeight(image.CGImage);
+  XCTAssertGreaterThanOrEqual(height, (size_t)(80 * screenScale));
+  XCTAssertLessThan(width, (size_t)4000);
+  XCTAssertEqualWithAccuracy((CGFloat)width / height, 4.0 / 3.0, 0.02);
+}
+
+- (void)testDecodingAtDisplaySizeMatchesFullDecode {
+  NSData* data = [self JPEGDataWithSize:CGSizeMake(4000, 3000)];
+  NSArray* contentModes = @[@(UIViewContentModeScaleAspectFill),
+                            @(UIViewContentModeScaleAspectFit),
+                            @(UIViewContentModeScaleToFill)];
+  for (NSNumber* contentMode in contentModes) {
+    UIImage* fullImage = [self fullyDecodedImageFromData:data
+                                             contentMode:[contentMode integerValue]
+                                             displaySize:CGSizeMake(80, 60)];
+    UIImage* image = [self imageDecodedAtDisplaySizeFromData:data
+                                                 contentMode:[contentMode integerValue]
+                                                 displaySize:CGSizeMake(80, 60)];
+    XCTAssertTrue(CGSizeEqualToSize(image.size, fullImage.size), @"%@", contentMode);
+    XCTAssertEqual(image.scale, fullImage.scale);
+  }
+}
+
+- (void)testSmallImagesAreDecodedAsTheyAre {
+  XCTAssertNil([NIImageProcessing imageFromData:self.imageData
+                          decodedForContentMode:UIViewContentModeScaleAspectFill
+                                       cropRect:CGRectZero
+                                    displaySize:CGSizeMake(320, 320)]);
+
+  // Content modes that don't scale need the image at its original resolution.
+  XCTAssertNil([NIImageProcessing imageFromData:[self JPEGDataWithSize:CGSizeMake(1000, 1000)]
+                          decodedForContentMode:UIViewContentModeCenter
+                                       cropRect:CGRectZero
+                                    displaySize:CGSizeMake(80, 80)]);
+}
+
+- (void)testCroppedImageIsDecodedAtCropResolution {
+  NSData* data = [self JPEGDataWithSize:CGSizeMake(4000, 3000)];
+  CGFloat screenScale = NIScreenScale();
+
+  // Only a tenth of the image's width is shown, so the image must be decoded ten times larger.
+  UIImage* image = [NIImageProcessing imageFromData:data
+                              decodedForContentMode:UIViewContentModeScaleAspectFill
+                                           cropRect:CGRectMake(0, 0, 0.1, 0.1)
+                                        displaySize:CGSizeMake(80, 80)];
+  XCTAssertNotNil(image);
+  XCTAssertGreaterThanOrEqual(CGImageGetHeight(image.CGImage) * 0.1, 80 * screenScale - 1);
+}
+
+- (void)testDecodingAtDisplaySizeReducesMemoryAndLatency {
+  NSArray* fixtureSizes = @[[NSValue valueWithCGSize:CGSizeMake(4000, 3000)],
+                            [NSValue valueWithCGSize:CGSizeMake(3000, 4000)],
+                            [NSValue valueWithCGSize:CGSizeMake(2048, 1536)],
+                            [NSValue valueWithCGSize:CGSizeMake(1280, 720)]];
+  for (NSValue* fixtureSize in fixtureSizes) {
+    CGSize size = [fixtureSize CGSizeValue];
+    NSData* data = [self JPEGDataWithSize:size];
+
+    NSDate* start = [NSDate date];
+    @autoreleasepool {
+      [self fullyDecodedImageFromData:data
+                          contentMode:UIViewContentModeScaleAspectFill
+                          displaySize:CGSizeMake(80, 80)];
+    }
+    NSTimeInterval fullDuration = [[NSDate date] timeIntervalSinceDate:start];
+
+    start = [NSDate date];
+    size_t decodedBytes = 0;
+    @autoreleasepool {
+      UIImage* image = [NIImageProcessing imageFromData:data
+                                  decodedForContentMode:UIViewContentModeScaleAspectFill
+                                               cropRect:CGRectZero
+                                            displaySize:CGSizeMake(80, 80)];
+      decodedBytes = CGImageGetBytesPerRow(image.CGImage) * CGImageGetHeight(image.CGImage);
+      [NIImageProcessing imageFromSource:image
+                         withContentMode:UIViewContentModeScaleAspectFill
+                                cropRect:CGRectZero
+                             displaySize:CGSizeMake(80, 80)
+                            scaleOptions:NINetworkImageViewScaleToFitLeavesExcessAndScaleToFillCropsExcess
+                    interpolationQuality:kCGInterpolationDefault];
+    }
+    NSTimeInterval duration = [[NSDate date] timeIntervalSinceDate:start];
+
+    // A full decode materializes a four byte per pixel bitmap of the whole image.
+    size_t fullBytes = (size_t)(size.width * size.height * 4);
+    XCTAssertLessThan(decodedBytes, fullBytes);
+    NSLog(@"%@ at 80x80: decoded bitmap %zu KB instead of %zu KB, %.1f ms instead of %.1f ms.",
+          NSStringFromCGSize(size), decodedBytes / 1024, fullBytes / 1024,
+          duration * 1000, fullDuration * 1000);
+  }
+}
+
+// An opaque 40x30 gradient stored in the given bitmap layout.
+- (UIImage *)gradientImageWithBitmapInfo:(CGBitmapInfo)bitmapInfo {
+  CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+  CGContextRef context = CGBitmapContextCreate(NULL, 40, 30, 8, 0, colorSpace, bitmapInfo);
+  CGColorSpaceRelease(colorSpace);
+  for (int x = 0; x < 40; ++x) {
+    CGContextSetRGBFillColor(context, x / 40.0, 1 - x / 40.0, (x % 2) ? 1 : 0, 1);
+    CGContextFillRect(context, CGRectMake(x, 0, 1, 30));
+  }
+  CGImageRef imageRef = CGBitmapContextCreateImage(context);
+  CGContextRelease(context);
+  UIImage* image = [UIImage imageWithCGImage:imageRef];
+  CGImageRelease(imageRef);
+  return image;
+}
+
+- (void)testCroppedBitmapImageIsResampledLikeARedrawnImage {
+  // RGBA bitmaps are resampled from their own pixels, BGRA bitmaps are redrawn first.
+  UIImage* rgbaImage = [self gradientImageWithBitmapInfo:(CGBitmapInfo)kCGImageAlphaPremultipliedLast];
+  UIImage* bgraImage = [self gradientImageWithBitmapInfo:(kCGBitmapByteOrder32Little
+                                                          | kCGImageAlphaPremultipliedFirst)];
+
+  UIImage* (^processedImage)(UIImage *) = ^UIImage*(UIImage* source) {
+    return [NIImageProcessing imageFromSource:source
+                              withContentMode:UIViewContentModeScaleAspectFill
+                                     cropRect:CGRectMake(0.25, 0, 0.5, 1)
+                                  displaySize:CGSizeMake(10, 10)
+                                 scaleOptions:NINetworkImageViewScaleToFitLeavesExcessAndScaleToFillCropsExcess
+                         interpolationQuality:kCGInterpolationHigh];
+  };
+  CFDataRef rgbaPixels = CGDataProviderCopyData(CGImageGetDataProvider(processedImage(rgbaImage).CGImage));
+  CFDataRef bgraPixels = CGDataProviderCopyData(CGImageGetDataProvider(processedImage(bgraImage).CGImage));
+  XCTAssertTrue(CFEqual(rgbaPixels, bgraPixels));
+  CFRelease(rgbaPixels);
+  CFRelease(bgraPixels);
+}
+
+#pragma mark - Pixel Formats
+
+- (void)testProcessedImagesUseTheRequestedPixelFormat {
+  UIImage* source = [UIImage imageWithData:[self JPEGDataWithSize:CGSizeMake(400, 300)]];
+  CGSize displaySize = CGSizeMake(100, 100);
+
+  UIImage* (^processedImage)(NIImagePixelFormat) = ^UIImage*(NIImagePixelFormat pixelFormat) {
+    return [NIImageProcessing imageFromSource:source
+                              withContentMode:UIViewContentModeScaleAspectFill
+                                     cropRect:CGRectZero
+                                  displaySize:displaySize
+                                 scaleOptions:NINetworkImageViewScaleToFitLeavesExcessAndScaleToFillCropsExcess
+                         interpolationQuality:kCGInterpolationDefault
+                                  pixelFormat:pixelFormat];
+  };
+
+  UIImage* rgba = processedImage(NIImagePixelFormatRGBA);
+  UIImage* rgbx = processedImage(NIImagePixelFormatRGBX);
+  UIImage* rgb565 = processedImage(NIImagePixelFormatRGB565);
+  UIImage* gray = processedImage(NIImagePixelFormatGray);
+
+  XCTAssertEqual(CGImageGetAlphaInfo(rgbx.CGImage), kCGImageAlphaNoneSkipLast);
+  XCTAssertEqual(CGImageGetBitsPerPixel(rgb565.CGImage), (size_t)16);
+  XCTAssertEqual(CGColorSpaceGetModel(CGImageGetColorSpace(gray.CGImage)), kCGColorSpaceModelMonochrome);
+  for (UIImage* image in @[rgbx, rgb565, gray]) {
+    XCTAssertEqual(CGImageGetWidth(image.CGImage), CGImageGetWidth(rgba.CGImage));
+    XCTAssertEqual(CGImageGetHeight(image.CGImage), CGImageGetHeight(rgba.CGImage));
+  }
+
+  // The memory cache charges the smaller formats for the smaller bitmaps.
+  XCTAssertLessThanOrEqual(NIMemoryCostOfImage(rgb565) * 2, NIMemoryCostOfImage(rgba));
+  XCTAssertLessThanOrEqual(NIMemoryCostOfImage(gray) * 4, NIMemoryCostOfImage(rgba));
+}
+
+- (void)testImageViewStoresImagesInItsPixelFormat {
+  NINetworkImageLoader* loader = [self newLoader];
+  NIImageMemoryCache* memoryCache = [[NIImageMemoryCache alloc] init];
+  NINetworkImageView* imageView = [[NINetworkImageView alloc] initWithFrame:CGRectMake(0, 0, 16, 16)];
+  imageView.imageMemoryCache = memoryCache;
+  imageView.imageLoader = loader;
+  imageView.pixelFormat = NIImagePixelFormatRGB565;
+  NSString* path = [[self imageURLAtIndex:0] absoluteString];
+  [imageView setPathToNetworkImage:path forDisplaySize:CGSizeMake(16, 16) contentMode:UIViewContentModeScaleAspectFill];
+
+  XCTAssertTrue([self waitForCondition:^BOOL{ return nil != imageView.image; } timeout:10]);
+  XCTAssertEqual(CGImageGetBitsPerPixel(imageView.image.CGImage), (size_t)16);
+
+  NSString* cacheKey = [NINetworkImageView cacheKeyForPathToNetworkImage:path
+                                                             displaySize:CGSizeMake(16, 16)
+                                                                cropRect:CGRectZero
+                                                             contentMode:UIViewContentModeScaleAspectFill
+                                                            scaleOptions:imageView.scaleOptions
+                                                             pixelFormat:NIImagePixelFormatRGB565];
+  XCTAssertTrue([memoryCache containsObjectWithName:cacheKey]);
+  XCTAssertFalse([memoryCache containsObjectWithName:
+                  [NINetworkImageView cacheKeyForPathToNetworkImage:path
+                                                        displaySize:CGSizeMake(16, 16)
+                                                           cropRect:CGRectZero
+                                                        contentMode:UIViewContentModeScaleAspectFill
+                                                       scaleOptions:imageView.scaleOptions]]);
+  [loader invalidate];
+}
+
+#pragma mark - Variants
+- (void)testPrefetchedImageIsPredecodedAndRecordedAsAVariant {
+  NINetworkImageLoader* loader = [self newLoader];
+  NIImageMemoryCache* imageMemoryCache = [[NIImageMemoryCache alloc] init];
+  NINetworkImagePrefetcher* prefetcher = [[NINetworkImagePrefetcher alloc] init];
+  prefetcher.imageLoader = loader;
+  prefetcher.imageMemoryCache = imageMemoryCache;
+
+  NSString* path = [[self imageURLAtIndex:0] absoluteString];
+  NIImagePrefetchingTestObject* object = [[NIImagePrefetchingTestObject alloc] init];
+  object.requests = @[[NIImagePrefetchRequest requestWithPath:path
+                                                  displaySize:CGSizeMake(16, 16)
+                                                  contentMode:UIViewContentModeScaleAspectFill]];
+  [prefetcher prefetchImagesForObject:object];
+
+  NSString* cacheKey = [NINetworkImageView cacheKeyForPathToNetworkImage:path
+                                                             displaySize:CGSizeMake(16, 16)
+                                                                cropRect:CGRectZero
+                                                             contentMode:UIViewContentModeScaleAspectFill
+                                                            scaleOptions:prefetcher.scaleOptions];
+  XCTAssertTrue([self waitForCondition:^BOOL{
+    return [imageMemoryCache containsObjectWithName:cacheKey];
+  } timeout:10]);
+
+  UIImage* image = [imageMemoryCache objectWithName:cacheKey];
+  XCTAssertEqual([NIImageProcessing imageDecodedForDisplayFromImage:image], image,
+                 @"Prefetched images should not need to be decoded again.");
+  XCTAssertNotNil([[imageMemoryCache variantInfosInVariantFamily:path] objectForKey:cacheKey],
+                  @"Image views should be able to derive smaller variants from prefetched images.");
+
+  [loader invalidate];
+}
+
+// A loader that always goes to the server, so that the server sees every image that is loaded.
+- (NINetworkImageLoader *)newUncachedLoader {
+  NSURLSessionConfiguration* configuration = [NSURLSessionConfiguration ephemeralSessionConfiguration];
+  configuration.URLCache = nil;
+  configuration.requestCachePolicy = NSURLRequestReloadIgnoringLocalCacheData;
+  return [[NINetworkImageLoader alloc] initWithSessionConfiguration:configuration];
+}
+
+- (void)testSmallerImageIsDerivedFromCachedVariant {
+  NINetworkImageLoader* loader = [self newUncachedLoader];
+  NIImageMemoryCache* memoryCache = [[NIImageMemoryCache alloc] init];
+  NSString* path = [[self imageURLAtIndex:0] absoluteString];
+
+  NINetworkImageView* largeView = [[NINetworkImageView alloc] initWithFrame:CGRectMake(0, 0, 60, 40)];
+  largeView.imageMemoryCache = memoryCache;
+  largeView.imageLoader = loader;
+  [largeView setPathToNetworkImage:path contentMode:UIViewContentModeScaleAspectFill];
+  XCTAssertTrue([self waitForCondition:^BOOL{ return nil != largeView.image; } timeout:10]);
+  NSUInteger numberOfRequests = [self.server numberOfRequests];
+
+  // Same aspect ratio, smaller size.
+  NINetworkImageView* smallView = [[NINetworkImageView alloc] initWithFrame:CGRectMake(0, 0, 30, 20)];
+  smallView.imageMemoryCache = memoryCache;
+  smallView.imageLoader = loader;
+  [smallView setPathToNetworkImage:path contentMode:UIViewContentModeScaleAspectFill];
+  XCTAssertTrue(smallView.isLoading);
+  XCTAssertTrue([self waitForCondition:^BOOL{ return nil != smallView.image; } timeout:10]);
+
+  XCTAssertEqual([self.server numberOfRequests], numberOfRequests);
+  XCTAssertEqualWithAccuracy(smallView.image.size.width, 30, 1);
+  XCTAssertEqualWithAccuracy(smallView.image.size.height, 20, 1);
+  XCTAssertTrue([memoryCache containsObjectWithName:
+                 [NINetworkImageView cacheKeyForPathToNetworkImage:path
+                                                       displaySize:CGSizeMake(30, 20)
+                                                          cropRect:CGRectZero
+                                                       contentMode:UIViewContentModeScaleAspectFill
+                                                      scaleOptions:smallView.scaleOptions]]);
+  [loader invalidate];
+}
+
+- (void)testDerivedImageExpiresWithItsVariant {
+  NINetworkImageLoader* loader = [self newUncachedLoader];
+  NIImageMemoryCache* memoryCache = [[NIImageMemoryCache alloc] init];
+  NSString* path = [[self imageURLAtIndex:0] absoluteString];
+
+  NINetworkImageView* imageView = [[NINetworkImageView alloc] initWithFrame:CGRectMake(0, 0, 30, 20)];
+  imageView.imageMemoryCache = memoryCache;
+  imageView.imageLoader = loader;
+
+  // An original that expires long before anything the image view would store on its own.
+  NSDate* expirationDate = [NSDate dateWithTimeIntervalSinceNow:60];
+  [NINetworkImageView storeImage:[UIImage imageWithData:[self JPEGDataWithSize:CGSizeMake(60, 40)]]
+              inImageMemoryCache:memoryCache
+           forPathToNetworkImage:path
+                     displaySize:CGSizeZero
+                        cropRect:CGRectZero
+                     contentMode:UIViewContentModeScaleAspectFill
+                    scaleOptions:imageView.scaleOptions
+                     pixelFormat:imageView.pixelFormat
+                    expiresAfter:expirationDate];
+
+  NSUInteger numberOfRequests = [self.server numberOfRequests];
+  [imageView setPathToNetworkImage:path contentMode:UIViewContentModeScaleAspectFill];
+  XCTAssertTrue([self waitForCondition:^BOOL{ return nil != imageView.image; } timeout:10]);
+  XCTAssertEqual([self.server numberOfRequests], numberOfRequests);
+
+  NSString* cacheKey = [NINetworkImageView cacheKeyForPathToNetworkImage:path
+                                                             displaySize:CGSizeMake(30, 20)
+                                                                cropRect:CGRectZero
+                                                             contentMode:UIViewContentModeScaleAspectFill
+                                                            scaleOptions:imageView.scaleOptions];
+  NSDate* derivedExpirationDate = [memoryCache expirationDateOfObjectWithName:cacheKey];
+  XCTAssertNotNil(derivedExpirationDate, @"Derived images should expire along with their variant.");
+  XCTAssertLessThanOrEqual([derivedExpirationDate timeIntervalSinceDate:expirationDate], 0.01);
+  [loader invalidate];
+}
+
+- (void)testImageWithDifferentAspectRatioIsNotDerived {
+  NINetworkImageLoader* loader = [self newUncachedLoader];
+  NIImageMemoryCache* memoryCache = [[NIImageMemoryCache alloc] init];
+  NSString* path = [[self imageURLAtIndex:0] absoluteString];
+
+  NINetworkImageView* wideView = [[NINetworkImageView alloc] initWithFrame:CGRectMake(0, 0, 60, 20)];
+  wideView.imageMemoryCache = memoryCache;
+  wideView.imageLoader = loader;
+  [wideView setPathToNetworkImage:path contentMode:UIViewContentModeScaleAspectFill];
+  XCTAssertTrue([self waitForCondition:^BOOL{ return nil != wideView.image; } timeout:10]);
+  NSUInteger numberOfRequests = [self.server numberOfRequests];
+
+  // The wide image has lost the top and bottom of the original, so a square needs the original.
+  NINetworkImageView* squareView = [[NINetworkImageView alloc] initWithFrame:CGRectMake(0, 0, 20, 20)];
+  squareView.imageMemoryCache = memoryCache;
+  squareView.imageLoader = loader;
+  [squareView setPathToNetworkImage:path contentMode:UIViewContentModeScaleAspectFill];
+  XCTAssertTrue([self waitForCondition:^BOOL{ return nil != squareView.image; } timeout:10]);
+
+  XCTAssertEqual([self.server numberOfRequests], numberOfRequests + 1);
+  [loader invalidate];
+}
+
+#pragma mark - Incremental Rendering
+
+// A photo-sized JPEG that is encoded in several scans of increasing quality.
+- (NSData *)progressiveJPEGDataWithSize:(CGSize)size {
+  UIImage* image = [UIImage imageWithData:[self JPEGDataWithSize:size]];
+  NSMutableData* data = [NSMutableData data];
+  CGImageDestinationRef destination = CGImageDestinationCreateWithData((__bridge CFMutableDataRef)data,
+                                                                       CFSTR("public.jpeg"), 1, NULL);
+  NSDictionary* properties = @{
+    (__bridge NSString *)kCGImagePropertyJFIFDictionary: @{
+      (__bridge NSString *)kCGImagePropertyJFIFIsProgressive: @YES
+    },
+    (__bridge NSString *)kCGImageDestinationLossyCompressionQuality: @0.8
+  };
+  CGImageDestinationAddImage(destination, image.CGImage, (__bridge CFDictionaryRef)properties);
+  CGImageDestinationFinalize(destination);
+  CFRelease(destination);
+  return data;
+}
+
+// Serves a progressive JPEG a piece at a time.
+- (void)startSlowProgressiveImageServer {
+  [self.server stop];
+  self.server = [[NIImageTestServer alloc] initWithImageData:[self progressiveJPEGDataWithSize:CGSizeMake(1024, 768)]
+                                               responseDelay:0];
+  self.server.bodyPartInterval = 0.1;
+}
+
+- (void)testPartialImagesAreProcessedLikeTheCompleteImage {
+  [self startSlowProgressiveImageServer];
+  NINetworkImageLoader* loader = [self newUncachedLoader];
+  loader.minimumPartialImageInterval = 0;
+
+  NIImageResponseSerializer* serializer = [NIImageResponseSerializer serializer];
+  serializer.imageScale = 1;
+  serializer.contentMode = UIViewContentModeScaleAspectFill;
+  serializer.displaySize = CGSizeMake(200, 200);
+
+  NSMutableArray* partialImages = [NSMutableArray array];
+  __block UIImage* completeImage = nil;
+  __block NSUInteger numberOfPartialImagesBeforeCompletion = 0;
+  [loader loadImageWithURL:[self imageURLAtIndex:0]
+        responseSerializer:serializer
+                  progress:nil
+              partialImage:^(UIImage* image) {
+                [partialImages addObject:image];
+              } completion:^(UIImage* image, NSError* error) {
+                completeImage = image;
+                numberOfPartialImagesBeforeCompletion = partialImages.count;
+              }];
+  XCTAssertTrue([self waitForCondition:^BOOL{ return nil != completeImage; } timeout:10]);
+
+  // Give any straggling partial images a chance to show up late.
+  [self waitForCondition:^BOOL{ return NO; } timeout:0.2];
+  XCTAssertGreaterThan(partialImages.count, (NSUInteger)0);
+  XCTAssertEqual(partialImages.count, numberOfPartialImagesBeforeCompletion);
+  for (UIImage* image in partialImages) {
+    XCTAssertTrue(CGSizeEqualToSize(image.size, completeImage.size));
+  }
+
+  [loader invalidate];
+}
+
+- (void)testImageViewDisplaysImageWhileItDownloads {
+  [self startSlowProgressiveImageServer];
+  NINetworkImageLoader* loader = [self newUncachedLoader];
+  NINetworkImageView* imageView = [[NINetworkImageView alloc] initWithFrame:CGRectMake(0, 0, 200, 150)];
+  imageView.imageMemoryCache = nil;
+  imageView.imageLoader = loader;
+  imageView.rendersImagesIncrementally = YES;
+  [imageView setPathToNetworkImage:[[self imageURLAtIndex:0] absoluteString]];
+
+  XCTAssertTrue([self waitForCondition:^BOOL{ return nil != imageView.image; } timeout:10]);
+  XCTAssertTrue(imageView.isLoading);
+  XCTAssertTrue([self waitForCondition:^BOOL{ return !imageView.isLoading; } timeout:10]);
+  XCTAssertNotNil(imageView.image);
+
+  [loader invalidate];
+}
+
+#pragma mark - Local Images
+
+- (void)testLocalImageIsLoadedAtDisplaySizeWithoutTheLoader {
+  NSString* path = [[self temporaryResponseCachePath] stringByAppendingPathExtension:@"jpg"];
+  XCTAssertTrue([[self JPEGDataWithSize:CGSizeMake(4000, 3000)] writeToFile:path atomically:YES]);
+
+  // An invalidated loader can't load anything, so the image must come from the file itself.
+  NINetworkImageLoader* loader = [self newLoader];
+  [loader invalidate];
+  NINetworkImageView* imageView = [[NINetworkImageView alloc] initWithFrame:CGRectMake(0, 0, 100, 75)];
+  imageView.imageMemoryCache = nil;
+  imageView.imageLoader = loader;
+  imageView.contentMode = UIViewContentModeScaleAspectFill;
+  [imageView setPathToNetworkImage:path];
+  XCTAssertTrue(imageView.isLoading);
+
+  XCTAssertTrue([self waitForCondition:^BOOL{ return nil != imageView.image; } timeout:10]);
+  XCTAssertFalse(imageView.isLoading);
+  CGFloat scale = [UIScreen mainScreen].scale;
+  XCTAssertEqualWithAccuracy(imageView.image.size.width * imageView.image.scale, 100 * scale, 1);
+  XCTAssertEqualWithAccuracy(imageView.image.size.height * imageView.image.scale, 75 * scale, 1);
+
+  [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+- (void)testMissingLocalImageFails {
+  NSError* error = nil;
+  UIImage* image = [NIImageProcessing imageFromContentsOfFile:[self temporaryResponseCachePath]
+                                              withContentMode:UIViewContentModeScaleAspectFill
+                                                     cropRect:CGRectZero
+                                                  displaySize:CGSizeMake(100, 75)
+                                                 scaleOptions:NINetworkImageViewScaleToFitLeavesExcessAndScaleToFillCropsExcess
+                                         interpolationQuality:kCGInterpolationDefault
+                                                  pixelFormat:NIImagePixelFormatRGBA
+                                                        error:&error];
+  XCTAssertNil(image);
+  XCTAssertNotNil(error);
+}
+
+#pragma mark - Predecoding
+
+- (void)testLoadedImageIsPredecodedForDisplay {
+  NINetworkImageLoader* loader = [self newLoader];
+  NINetworkImageView* imageView = [[NINetworkImageView alloc] initWithFrame:CGRectMake(0, 0, 32, 32)];
+  imageView.imageMemoryCache = nil;
+  imageView.imageLoader = loader;
+  imageView.sizeForDisplay = NO;
+  [imageView setPathToNetworkImage:[[self imageURLAtIndex:0] absoluteString]];
+
+  XCTAssertTrue([self waitForCondition:^BOOL{ return nil != imageView.image; } timeout:10]);
+  XCTAssertFalse(imageView.isLoading);
+  CGBitmapInfo bitmapInfo = CGImageGetBitmapInfo(imageView.image.CGImage);
+  XCTAssertEqual(bitmapInfo & kCGBitmapByteOrderMask, kCGBitmapByteOrder32Host);
+  CGImageAlphaInfo alphaInfo = CGImageGetAlphaInfo(imageView.image.CGImage);
+  XCTAssertTrue(alphaInfo == kCGImageAlphaNoneSkipFirst || alphaInfo == kCGImageAlphaPremultipliedFirst);
+
+  [loader invalidate];
+}
+
+- (void)testDecodedImagesAreNotDecodedAgain {
+  UIImage* lazyImage = [UIImage imageWithData:[self JPEGDataWithSize:CGSizeMake(64, 48)]];
+  UIImage* decodedImage = [NIImageProcessing imageDecodedForDisplayFromImage:lazyImage];
+  XCTAssertNotEqual(decodedImage, lazyImage);
+  XCTAssertEqual([NIImageProcessing imageDecodedForDisplayFromImage:decodedImage], decodedImage);
+
+  // A bitmap in the display's format that Nimbus didn't make.
+  UIGraphicsBeginImageContextWithOptions(CGSizeMake(16, 16), YES, 1);
+  UIImage* bitmapImage = UIGraphicsGetImageFromCurrentImageContext();
+  UIGraphicsEndImageContext();
+  CGBitmapInfo bitmapInfo = CGImageGetBitmapInfo(bitmapImage.CGImage);
+  if ((bitmapInfo & kCGBitmapByteOrderMask) == kCGBitmapByteOrder32Host) {
+    XCTAssertEqual([NIImageProcessing imageDecodedForDisplayFromImage:bitmapImage], bitmapImage);
+  }
+
+  // Images that were resized for display were drawn into a bitmap while they were processed.
+  UIImage* processedImage = [NIImageProcessing imageFromSource:lazyImage
+                                               withContentMode:UIViewContentModeScaleAspectFill
+                                                      cropRect:CGRectZero
+                                                   displaySize:CGSizeMake(16, 16)
+                                                  scaleOptions:NINetworkImageViewScaleToFitLeavesExcessAndScaleToFillCropsExcess
+                                          interpolationQuality:kCGInterpolationDefault];
+  XCTAssertNotEqual(processedImage, lazyImage);
+  XCTAssertEqual([NIImageProcessing imageDecodedForDisplayFromImage:processedImage], processedImage);
+}
+
+- (void)testReplacedImageIsNotDisplayedAfterDecoding {
+  NINetworkImageLoader* loader = [self newLoader];
+  NSOperationQueue* decodingQueue = [[NSOperationQueue alloc] init];
+  NINetworkImageView* imageView = [[NINetworkImageView alloc] initWithFrame:CGRectMake(0, 0, 32, 32)];
+  imageView.imageMemoryCache = nil;
+  imageView.imageLoader = loader;
+  imageView.imageDecodingQueue = decodingQueue;
+  [imageView setPathToNetworkImage:[[self imageURLAtIndex:0] absoluteString]];
+
+  // Hold up decoding until the image view has moved on to another image.
+  decodingQueue.suspended = YES;
+  XCTAssertTrue([self waitForCondition:^BOOL{ return decodingQueue.operationCount > 0; } timeout:10]);
+  XCTAssertTrue(imageView.isLoading);
+  [imageView prepareForReuse];
+  decodingQueue.suspended = NO;
+
+  [self waitForCondition:^BOOL{ return NO; } timeout:0.2];
+  XCTAssertNil(imageView.image);
+  XCTAssertFalse(imageView.isLoading);
+  [loader invalidate];
+}
+
+- (void)testPredecodingMovesDecodingOffTheMainThread {
+  NSData* data = [self JPEGDataWithSize:CGSizeMake(1024, 768)];
+  static const NSInteger kNumberOfImages = 20;
+
+  // Drawing an image that hasn't been decoded decodes it, like displaying it would.
+  NSTimeInterval (^mainThreadTimeToDraw)(NSArray *) = ^NSTimeInterval(NSArray* images) {
+    UIGraphicsBeginImageContextWithOptions(CGSizeMake(1024, 768), YES, 1);
+    NSDate* start = [NSDate date];
+    for (UIImage* image in images) {
+      [image drawInRect:CGRectMake(0, 0, 1024, 768)];
+    }
+    NSTimeInterval duration = [[NSDate date] timeIntervalSinceDate:start];
+    UIGraphicsEndImageContext();
+    return duration / images.count;
+  };
+
+  NSMutableArray* lazyImages = [NSMutableArray array];
+  NSMutableArray* predecodedImages = [NSMutableArray array];
+  NSOperationQueue* decodingQueue = [Nimbus imageDecodingQueue];
+  for (NSInteger ix = 0; ix < kNumberOfImages; ++ix) {
+    [lazyImages addObject:[UIImage imageWithData:data]];
+    UIImage* image = [UIImage imageWithData:data];
+    [decodingQueue addOperationWithBlock:^{
+      UIImage* decodedImage = [NIImageProcessing imageDecodedForDisplayFromImage:image];
+      @synchronized(predecodedImages) {
+        [predecodedImages addObject:decodedImage];
+      }
+    }];
+  }
+  [decodingQueue waitUntilAllOperationsAreFinished];
+
+  NSTimeInterval lazyDuration = mainThreadTimeToDraw(lazyImages);
+  NSTimeInterval predecodedDuration = mainThreadTimeToDraw(predecodedImages);
+  NSLog(@"Main thread time per 1024x768 image: %.2f ms without predecoding, %.2f ms with it.",
+        lazyDuration * 1000, predecodedDuration * 1000);
+  XCTAssertLessThan(predecodedDuration, lazyDuration);
+}
+
+#pragma mark - Performance
 
-- (void)testNothing {
+- (void)testGridLoadPerformance {
+  [self measureBlock:^{
+    NINetworkImageLoader* loader = [self newLoader];
+    [self loadGridWithLoader:^NINetworkImageLoader *(NSUInteger index) {
+      return loader;
+    }];
+    [loader invalidate];
+  }];
 }
 
 @end
@@ -0,0 +1,283 @@
+//
+// Copyright 2011-2014 NimbusKit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Checks and benchmarks NIImageResampling.c outside of iOS.
+//
+// Every check is run with the scalar implementation, with the implementation that the compiler
+// targets (sse2, avx2 or neon) and with several threads. Build with the Makefile in this
+// directory and run with no arguments to check, or with "bench" to time each implementation.
+
+#define _POSIX_C_SOURCE 199309L
+
+#include "NIImageResampling.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const NIResamplingFilter kFilters[] = {
+  NIResamplingFilterBox,
+  NIResamplingFilterBilinear,
+  NIResamplingFilterLanczos3,
+};
+#define NUMBER_OF_FILTERS (sizeof(kFilters) / sizeof(kFilters[0]))
+
+// The ways of running NIResampleRGBA that must produce exactly the same bytes.
+typedef struct {
+  const char* name;
+  size_t numberOfThreads;
+  NIResamplingOptions options;
+} NIResamplingVariant;
+
+static NIResamplingVariant sVariants[3];
+
+static int sNumberOfFailures = 0;
+
+#define CHECK(condition, ...) do { \
+    if (!(condition)) { \
+      ++sNumberOfFailures; \
+      fprintf(stderr, "%s:%d: check failed: %s: ", __FILE__, __LINE__, #condition); \
+      fprintf(stderr, __VA_ARGS__); \
+      fprintf(stderr, "\n"); \
+    } \
+  } while (0)
+
+// Row padding makes sure that bytesPerRow is respected.
+static NIResamplingBuffer NICreateBuffer(size_t width, size_t height) {
+  NIResamplingBuffer buffer = { NULL, width, height, width * 4 + 12 };
+  buffer.data = calloc(buffer.height, buffer.bytesPerRow);
+  if (NULL == buffer.data) {
+    fprintf(stderr, "Out of memory.\n");
+    exit(EXIT_FAILURE);
+  }
+  return buffer;
+}
+
+static void NIFillBufferWithRandomBytes(NIResamplingBuffer buffer, unsigned int seed) {
+  srand(seed);
+  for (size_t ix = 0; ix < buffer.height * buffer.bytesPerRow; ++ix) {
+    buffer.data[ix] = (uint8_t)rand();
+  }
+}
+
+static int NIBuffersAreEqual(NIResamplingBuffer buffer, NIResamplingBuffer otherBuffer) {
+  for (size_t row = 0; row < buffer.height; ++row) {
+    if (0 != memcmp(buffer.data + row * buffer.bytesPerRow,
+                    otherBuffer.data + row * otherBuffer.bytesPerRow,
+                    buffer.width * 4)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// MARK: - Golden Images
+
+// An 8x1 gradient whose blue channel alternates between 0 and 255.
+static NIResamplingBuffer NIGradientBuffer(uint8_t* bytes) {
+  for (int x = 0; x < 8; ++x) {
+    bytes[x * 4 + 0] = (uint8_t)(x * 32);
+    bytes[x * 4 + 1] = (uint8_t)(255 - x * 32);
+    bytes[x * 4 + 2] = (uint8_t)((x % 2) * 255);
+    bytes[x * 4 + 3] = 255;
+  }
+  return (NIResamplingBuffer){ bytes, 8, 1, 32 };
+}
+
+// An 8x1 half transparent edge, premultiplied, from red on the left to green on the right.
+static NIResamplingBuffer NITranslucentEdgeBuffer(uint8_t* bytes) {
+  for (int x = 0; x < 8; ++x) {
+    bytes[x * 4 + 0] = (x < 4) ? 128 : 0;
+    bytes[x * 4 + 1] = (x < 4) ? 0 : 128;
+    bytes[x * 4 + 2] = 64;
+    bytes[x * 4 + 3] = 128;
+  }
+  return (NIResamplingBuffer){ bytes, 8, 1, 32 };
+}
+
+// The same golden images as NIImageResamplingTests.
+static void NICheckGoldenImages(const NIResamplingVariant* variant) {
+  static const uint8_t kShrunkGradients[NUMBER_OF_FILTERS][12] = {
+    { 32, 223, 85, 255,  112, 143, 128, 255,  192, 63, 170, 255 },
+    { 35, 220, 121, 255,  112, 143, 128, 255,  189, 66, 134, 255 },
+    { 26, 229, 112, 255,  112, 143, 128, 255,  198, 57, 143, 255 },
+  };
+  static const uint8_t kEnlargedGradients[NUMBER_OF_FILTERS][40] = {
+    { 0, 255, 0, 255,  32, 223, 255, 255,  64, 191, 0, 255,  64, 191, 0, 255,  96, 159, 255, 255,
+      128, 127, 0, 255,  160, 95, 255, 255,  192, 63, 0, 255,  192, 63, 0, 255,  224, 31, 255, 255 },
+    { 0, 255, 0, 255,  22, 233, 179, 255,  48, 207, 128, 255,  74, 181, 76, 255,  99, 156, 230, 255,
+      125, 130, 25, 255,  150, 105, 179, 255,  176, 79, 128, 255,  202, 53, 76, 255,  224, 31, 255, 255 },
+    { 0, 255, 0, 255,  20, 235, 209, 255,  50, 205, 124, 255,  73, 182, 52, 255,  99, 156, 249, 255,
+      125, 130, 6, 255,  151, 104, 203, 255,  174, 81, 131, 255,  204, 51, 46, 255,  225, 30, 255, 255 },
+  };
+  static const uint8_t kEnlargedEdges[NUMBER_OF_FILTERS][40] = {
+    { 128, 0, 64, 128,  128, 0, 64, 128,  128, 0, 64, 128,  128, 0, 64, 128,  128, 0, 64, 128,
+      0, 128, 64, 128,  0, 128, 64, 128,  0, 128, 64, 128,  0, 128, 64, 128,  0, 128, 64, 128 },
+    { 128, 0, 64, 128,  128, 0, 64, 128,  128, 0, 64, 128,  128, 0, 64, 128,  115, 13, 64, 128,
+      13, 115, 64, 128,  0, 128, 64, 128,  0, 128, 64, 128,  0, 128, 64, 128,  0, 128, 64, 128 },
+    { 128, 0, 64, 128,  128, 0, 64, 128,  125, 3, 64, 128,  128, 0, 64, 128,  119, 9, 64, 128,
+      9, 119, 64, 128,  0, 128, 64, 128,  3, 125, 64, 128,  0, 128, 64, 128,  0, 128, 64, 128 },
+  };
+
+  uint8_t gradientBytes[32];
+  NIResamplingBuffer gradient = NIGradientBuffer(gradientBytes);
+  uint8_t edgeBytes[32];
+  NIResamplingBuffer edge = NITranslucentEdgeBuffer(edgeBytes);
+  for (size_t ix = 0; ix < NUMBER_OF_FILTERS; ++ix) {
+    uint8_t shrunk[12];
+    NIResamplingBuffer shrunkBuffer = { shrunk, 3, 1, 12 };
+    CHECK(NIResampleRGBA(&gradient, (NIResamplingRect){0, 0, 8, 1}, &shrunkBuffer, kFilters[ix],
+                         variant->numberOfThreads, variant->options),
+          "%s filter %zu", variant->name, ix);
+    CHECK(0 == memcmp(shrunk, kShrunkGradients[ix], sizeof(shrunk)),
+          "%s filter %zu shrunk gradient", variant->name, ix);
+
+    uint8_t enlarged[40];
+    NIResamplingBuffer enlargedBuffer = { enlarged, 10, 1, 40 };
+    CHECK(NIResampleRGBA(&gradient, (NIResamplingRect){0, 0, 8, 1}, &enlargedBuffer, kFilters[ix],
+                         variant->numberOfThreads, variant->options),
+          "%s filter %zu", variant->name, ix);
+    CHECK(0 == memcmp(enlarged, kEnlargedGradients[ix], sizeof(enlarged)),
+          "%s filter %zu enlarged gradient", variant->name, ix);
+
+    CHECK(NIResampleRGBA(&edge, (NIResamplingRect){0, 0, 8, 1}, &enlargedBuffer, kFilters[ix],
+                         variant->numberOfThreads,
+                         variant->options | NIResamplingOptionPremultiplied),
+          "%s filter %zu", variant->name, ix);
+    CHECK(0 == memcmp(enlarged, kEnlargedEdges[ix], sizeof(enlarged)),
+          "%s filter %zu enlarged translucent edge", variant->name, ix);
+  }
+}
+
+// MARK: - Implementations
+
+// Images that are large enough to be split between threads and wide enough for every vector
+// width, with the scalar implementation's output as the reference.
+static void NICheckVariantsMatchScalar(void) {
+  for (unsigned int seed = 0; seed < 20; ++seed) {
+    srand(seed);
+    size_t srcWidth = 1 + (size_t)rand() % 300;
+    size_t srcHeight = 1 + (size_t)rand() % 300;
+    size_t dstWidth = 1 + (size_t)rand() % 200;
+    size_t dstHeight = 1 + (size_t)rand() % 200;
+
+    NIResamplingBuffer src = NICreateBuffer(srcWidth, srcHeight);
+    NIFillBufferWithRandomBytes(src, seed);
+    NIResamplingRect rect = { srcWidth * 0.1, srcHeight * 0.2, srcWidth * 0.7, srcHeight * 0.5 };
+
+    for (size_t ix = 0; ix < NUMBER_OF_FILTERS; ++ix) {
+      for (int premultiplied = 0; premultiplied < 2; ++premultiplied) {
+        NIResamplingOptions options = premultiplied ? NIResamplingOptionPremultiplied : NIResamplingOptionNone;
+        NIResamplingBuffer reference = NICreateBuffer(dstWidth, dstHeight);
+        NIResampleRGBA(&src, rect, &reference, kFilters[ix], 1, options | NIResamplingOptionScalar);
+
+        for (size_t variant = 0; variant < sizeof(sVariants) / sizeof(sVariants[0]); ++variant) {
+          NIResamplingBuffer dst = NICreateBuffer(dstWidth, dstHeight);
+          CHECK(NIResampleRGBA(&src, rect, &dst, kFilters[ix], sVariants[variant].numberOfThreads,
+                               options | sVariants[variant].options),
+                "%s seed %u filter %zu", sVariants[variant].name, seed, ix);
+          CHECK(NIBuffersAreEqual(reference, dst),
+                "%s seed %u filter %zu premultiplied %d differs from scalar",
+                sVariants[variant].name, seed, ix, premultiplied);
+          free(dst.data);
+        }
+        free(reference.data);
+      }
+    }
+    free(src.data);
+  }
+}
+
+static void NICheckInvalidArgumentsAreRejected(void) {
+  uint8_t bytes[32];
+  NIResamplingBuffer src = NIGradientBuffer(bytes);
+  uint8_t result[12] = { 0 };
+  NIResamplingBuffer dst = { result, 3, 1, 12 };
+  CHECK(!NIResampleRGBA(&src, (NIResamplingRect){8, 0, 4, 1}, &dst,
+                        NIResamplingFilterBilinear, 1, NIResamplingOptionNone), "rect outside source");
+  NIResamplingBuffer emptyDst = { result, 0, 1, 12 };
+  CHECK(!NIResampleRGBA(&src, (NIResamplingRect){0, 0, 8, 1}, &emptyDst,
+                        NIResamplingFilterBilinear, 1, NIResamplingOptionNone), "empty destination");
+}
+
+// MARK: - Benchmark
+
+static double NICurrentTime(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+static void NIBenchmark(void) {
+  NIResamplingBuffer src = NICreateBuffer(2048, 1536);
+  NIFillBufferWithRandomBytes(src, 1);
+  NIResamplingBuffer dst = NICreateBuffer(256, 192);
+  static const int kNumberOfIterations = 10;
+
+  for (size_t ix = 0; ix < NUMBER_OF_FILTERS; ++ix) {
+    printf("Filter %zu, 2048x1536 to 256x192:", ix);
+    for (size_t variant = 0; variant < sizeof(sVariants) / sizeof(sVariants[0]); ++variant) {
+      double start = NICurrentTime();
+      for (int iteration = 0; iteration < kNumberOfIterations; ++iteration) {
+        NIResampleRGBA(&src, (NIResamplingRect){0, 0, 2048, 1536}, &dst, kFilters[ix],
+                       sVariants[variant].numberOfThreads, sVariants[variant].options);
+      }
+      double duration = (NICurrentTime() - start) / kNumberOfIterations;
+      printf(" %s %.2f ms%s", sVariants[variant].name, duration * 1000,
+             (variant + 1 < sizeof(sVariants) / sizeof(sVariants[0])) ? "," : ".\n");
+    }
+  }
+
+  free(src.data);
+  free(dst.data);
+}
+
+// MARK: - Main
+
+int main(int argc, char** argv) {
+#if defined(__AVX2__) && defined(__GNUC__)
+  // The AVX2 build is made on every x86 machine, but can only run on some of them.
+  if (!__builtin_cpu_supports("avx2")) {
+    printf("%s: skipped, this processor doesn't support AVX2.\n", argv[0]);
+    return EXIT_SUCCESS;
+  }
+#endif
+
+  sVariants[0] = (NIResamplingVariant){ "scalar", 1, NIResamplingOptionScalar };
+  sVariants[1] = (NIResamplingVariant){ NIResamplingImplementationName(NIResamplingOptionNone), 1,
+                                        NIResamplingOptionNone };
+  sVariants[2] = (NIResamplingVariant){ "threaded", 4, NIResamplingOptionNone };
+
+  if (argc > 1 && 0 == strcmp(argv[1], "bench")) {
+    NIBenchmark();
+    return EXIT_SUCCESS;
+  }
+
+  for (size_t variant = 0; variant < sizeof(sVariants) / sizeof(sVariants[0]); ++variant) {
+    NICheckGoldenImages(&sVariants[variant]);
+  }
+  NICheckVariantsMatchScalar();
+  NICheckInvalidArgumentsAreRejected();
+
+  if (sNumberOfFailures > 0) {
+    fprintf(stderr, "%s: %d checks failed.\n", argv[0], sNumberOfFailures);
+    return EXIT_FAILURE;
+  }
+  printf("%s: all checks passed with %s.\n", argv[0],
+         NIResamplingImplementationName(NIResamplingOptionNone));
+  return EXIT_SUCCESS;
+}
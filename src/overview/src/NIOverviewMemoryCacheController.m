@@ -25,7 +25,7 @@
 #endif
 
 @interface NIMemoryCache(Private)
-@property (nonatomic, strong) NSMutableOrderedSet* lruCacheObjects;
+- (NSArray *)lruCacheObjects;
 @end
 
 // Anonymous private category for LRU cache objects.
@@ -75,11 +75,15 @@
   if ([self.cache isKindOfClass:[NIImageMemoryCache class]]) {
     NIImageMemoryCache* imageCache = (NIImageMemoryCache *)self.cache;
     summary = [NSString stringWithFormat:
-               @"Number of images: %zd\nNumber of pixels: %@/%@\nStress limit: %@",
+               @"Number of images: %zd\nNumber of pixels: %@/%@\nStress limit: %@"
+               @"\nNumber of bytes: %@/%@\nStress limit: %@",
                self.cache.count,
                NIStringFromBytes(imageCache.numberOfPixels),
                NIStringFromBytes(imageCache.maxNumberOfPixels),
-               NIStringFromBytes(imageCache.maxNumberOfPixelsUnderStress)];
+               NIStringFromBytes(imageCache.maxNumberOfPixelsUnderStress),
+               NIStringFromBytes(imageCache.numberOfBytes),
+               NIStringFromBytes(imageCache.maxNumberOfBytes),
+               NIStringFromBytes(imageCache.maxNumberOfBytesUnderStress)];
 
   } else {
     summary = [NSString stringWithFormat:
@@ -94,7 +98,7 @@
   [formatter setTimeStyle:NSDateFormatterMediumStyle];
 
   // Add each of the cache objects to the model.
-  for (id cacheObject in self.cache.lruCacheObjects) {
+  for (id cacheObject in [self.cache lruCacheObjects]) {
     NSString* name = nil;
     UIImage* image = nil;
     NSDate* lastAccessTime = nil;
@@ -180,6 +180,28 @@
 @end
 
 
+/**
+ * A page that shows the live statistics of an in-memory cache.
+ *
+ * Shows the hit ratio along with the rates per second of hits, misses, stores, removals by
+ * cause, evicted cost and lock wait time since the page was last updated. Tapping the page
+ * resets the cache's statistics.
+ *
+ * By default the page shows the statistics of the global image memory cache.
+ *
+ * @ingroup Overview-Pages
+ */
+@interface NIOverviewMemoryCacheStatisticsPageView : NIOverviewPageView
+
+/**
+ * Returns an autoreleased instance of this page with the given cache.
+ */
++ (id)pageWithCache:(NIMemoryCache *)cache;
+
+@property (nonatomic, strong) NIMemoryCache* cache;
+@end
+
+
 /**
  * A page that adds run-time inspection features.
  *
@@ -763,6 +763,111 @@ static const CGFloat kGraphRightMargin = 5;
 
 @end
 
+// The change of a statistic per second. Statistics that went down have been reset.
+static double NIRatePerSecond(double value, double previousValue, NSTimeInterval elapsed) {
+  if (elapsed <= 0 || value < previousValue) {
+    return 0;
+  }
+  return (value - previousValue) / elapsed;
+}
+
+@interface NIOverviewMemoryCacheStatisticsPageView()
+@property (nonatomic, strong) UILabel* statisticsLabel;
+@property (nonatomic) NIMemoryCacheStatistics previousStatistics;
+@property (nonatomic, strong) NSDate* previousTimestamp;
+@end
+
+
+@implementation NIOverviewMemoryCacheStatisticsPageView
+
+
+- (id)initWithFrame:(CGRect)frame {
+  if ((self = [super initWithFrame:frame])) {
+    self.pageTitle = NSLocalizedString(@"Cache Statistics", @"Overview Page Title: Cache Statistics");
+    self.cache = [Nimbus imageMemoryCache];
+
+    _statisticsLabel = [self label];
+    _statisticsLabel.font = [UIFont boldSystemFontOfSize:11];
+    _statisticsLabel.numberOfLines = 0;
+    [self addSubview:_statisticsLabel];
+
+    UITapGestureRecognizer* tap = [[UITapGestureRecognizer alloc] initWithTarget:self action:@selector(didTap:)];
+    // We still want to be able to drag the pages.
+    tap.cancelsTouchesInView = NO;
+    [self addGestureRecognizer:tap];
+  }
+  return self;
+}
+
++ (id)pageWithCache:(NIMemoryCache *)cache {
+  NIOverviewMemoryCacheStatisticsPageView* pageView = [[[self class] alloc] initWithFrame:CGRectZero];
+  pageView.cache = cache;
+  return pageView;
+}
+
+- (void)setCache:(NIMemoryCache *)cache {
+  _cache = cache;
+
+  // Rates are measured from the next update.
+  self.previousTimestamp = nil;
+}
+
+- (void)layoutSubviews {
+  [super layoutSubviews];
+
+  CGFloat contentWidth = self.bounds.size.width - kPagePadding.left - kPagePadding.right;
+  CGSize size = [_statisticsLabel sizeThatFits:CGSizeMake(contentWidth, CGFLOAT_MAX)];
+  _statisticsLabel.frame = CGRectMake(kPagePadding.left, kPagePadding.top, contentWidth, size.height);
+}
+
+- (void)update {
+  [super update];
+
+  NIMemoryCacheStatistics statistics = self.cache.statistics;
+  NSDate* timestamp = [NSDate date];
+
+  NIMemoryCacheStatistics previous = self.previousStatistics;
+  NSTimeInterval elapsed = ((nil != self.previousTimestamp)
+                            ? [timestamp timeIntervalSinceDate:self.previousTimestamp]
+                            : 0);
+  unsigned long long lookups = statistics.hits + statistics.misses;
+  double hitRatio = (lookups > 0) ? (double)statistics.hits / (double)lookups : 0;
+
+  NSMutableString* text = [NSMutableString string];
+  [text appendFormat:@"Hit ratio %.1f%% (%llu/%llu)\n", hitRatio * 100, statistics.hits, lookups];
+  [text appendFormat:@"Hits %.1f/s  Misses %.1f/s  Stores %.1f/s\n",
+   NIRatePerSecond(statistics.hits, previous.hits, elapsed),
+   NIRatePerSecond(statistics.misses, previous.misses, elapsed),
+   NIRatePerSecond(statistics.stores, previous.stores, elapsed)];
+  [text appendFormat:@"Evicted %.1f/s  Expired %.1f/s  Pressure %.1f/s  Removed %.1f/s\n",
+   NIRatePerSecond(statistics.evictions, previous.evictions, elapsed),
+   NIRatePerSecond(statistics.expirations, previous.expirations, elapsed),
+   NIRatePerSecond(statistics.memoryPressureEvictions, previous.memoryPressureEvictions, elapsed),
+   NIRatePerSecond(statistics.removals, previous.removals, elapsed)];
+  [text appendFormat:@"Evicted cost %@/s (%@ total)\n",
+   NIStringFromBytes((unsigned long long)NIRatePerSecond(statistics.evictedCost,
+                                                         previous.evictedCost, elapsed)),
+   NIStringFromBytes(statistics.evictedCost)];
+  [text appendFormat:@"Lock wait %.2f ms/s (%.1f ms total)",
+   NIRatePerSecond(statistics.lockWaitTime, previous.lockWaitTime, elapsed) * 1000,
+   statistics.lockWaitTime * 1000];
+
+  _statisticsLabel.text = text;
+
+  self.previousStatistics = statistics;
+  self.previousTimestamp = timestamp;
+
+  [self setNeedsLayout];
+}
+
+- (void)didTap:(UIGestureRecognizer *)gesture {
+  [self.cache resetStatistics];
+  self.previousTimestamp = nil;
+  [self update];
+}
+
+@end
+
 typedef BOOL (^NIViewRecursionBlock)(UIView *view);
 static const CGFloat kButtonSize = 44;
 static const CGFloat kButtonMargin = 5;
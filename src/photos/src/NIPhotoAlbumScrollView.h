@@ -166,5 +166,9 @@
  * The photo at the given index will only be replaced with the given image if photoSize
  * is of a higher quality than the currently-displayed photo's size.
  *
+ * An image with the same photoSize as the currently-displayed photo is treated as a more
+ * complete version of it, such as a partially downloaded photo that has received more data.
+ * It is swapped in without resetting the zoom. See NIPhotoScrollView::updateImage:photoSize:.
+ *
  * @fn NIPhotoAlbumScrollView::didLoadPhoto:atIndex:photoSize:
  */
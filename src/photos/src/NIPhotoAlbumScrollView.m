@@ -91,6 +91,11 @@
     BOOL updateImage = photoSize > page.photoSize;
     if (updateImage) {
       [page setImage:image photoSize:photoSize];
+
+    } else if (NIPhotoScrollViewPhotoSizeUnknown != photoSize && photoSize == page.photoSize
+               && image != page.image) {
+      // A more complete version of the photo that is already being displayed.
+      [page updateImage:image photoSize:photoSize];
     }
 
     // Configure this after the image is set otherwise if the page's image isn't there
@@ -166,6 +171,10 @@
         if (NIPhotoScrollViewPhotoSizeOriginal == photoSize) {
           [self notifyDelegatePhotoDidLoadAtIndex:pageIndex];
         }
+
+      // Partially loaded photos are filled in without resetting the user's zoom.
+      } else if (NIPhotoScrollViewPhotoSizeUnknown != photoSize && photoSize == page.photoSize) {
+        [page updateImage:image photoSize:photoSize];
       }
       break;
     }
@@ -43,6 +43,7 @@
 - (UIImage *)image;
 - (NIPhotoScrollViewPhotoSize)photoSize;
 - (void)setImage:(UIImage *)image photoSize:(NIPhotoScrollViewPhotoSize)photoSize;
+- (void)updateImage:(UIImage *)image photoSize:(NIPhotoScrollViewPhotoSize)photoSize;
 @property (nonatomic, assign, getter = isLoading) BOOL loading;
 
 @property (nonatomic, assign) NSInteger pageIndex;
@@ -122,9 +123,23 @@
  *
  * Resets the current zoom levels and zooms to fit the image.
  *
+ * Use updateImage:photoSize: to replace the photo with a more complete version of itself
+ * without resetting the zoom.
+ *
  * @fn NIPhotoScrollView::setImage:photoSize:
  */
 
+/**
+ * Replace the photo with a more complete version of the displayed photo.
+ *
+ * This is meant for images that fill in over time, such as a partially downloaded image that
+ * has received more data. If the new image is the same size as the displayed one and has the
+ * same photoSize then it is swapped in without changing the current zoom and scroll position.
+ * Otherwise this behaves exactly like setImage:photoSize:.
+ *
+ * @fn NIPhotoScrollView::updateImage:photoSize:
+ */
+
 /**
  * The index of this photo within a photo album.
  *
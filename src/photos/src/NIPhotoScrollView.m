@@ -217,6 +217,18 @@
   [self setNeedsLayout];
 }
 
+- (void)updateImage:(UIImage *)image photoSize:(NIPhotoScrollViewPhotoSize)photoSize {
+  // A more complete version of the displayed image, such as the next scan of a progressive
+  // download, replaces it without disturbing the user's zoom and scroll position.
+  if (nil != image && nil != _imageView.image && photoSize == self.photoSize
+      && CGSizeEqualToSize(image.size, _imageView.image.size)) {
+    _imageView.image = image;
+    return;
+  }
+
+  [self setImage:image photoSize:photoSize];
+}
+
 - (void)setLoading:(BOOL)loading {
   _loading = loading;
 
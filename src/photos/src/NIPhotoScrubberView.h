@@ -117,6 +117,10 @@
  * If you don't have access to thumbnails from whatever API you're using then you should consider
  * not using a scrubber.
  *
+ * Thumbnails are only a few points wide, so they rarely need 32 bits per pixel. If you load them
+ * with NINetworkImageView or NINetworkImagePrefetcher, setting the pixelFormat to
+ * NIImagePixelFormatRGB565 halves the memory that the scrubber's thumbnails use.
+ *
  * @see NIPhotoScrubberView
  */
 @protocol NIPhotoScrubberViewDataSource <NSObject>
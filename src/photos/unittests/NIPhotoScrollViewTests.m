@@ -27,7 +27,33 @@
 @implementation NIPhotoScrollViewTests
 
 
-- (void)testNothing {
+- (UIImage *)imageWithSize:(CGSize)size {
+  UIGraphicsBeginImageContextWithOptions(size, YES, 1);
+  UIImage* image = UIGraphicsGetImageFromCurrentImageContext();
+  UIGraphicsEndImageContext();
+  return image;
+}
+
+- (void)testUpdatingImageWithMoreCompleteVersion {
+  NIPhotoScrollView* photoScrollView = [[NIPhotoScrollView alloc] initWithFrame:CGRectMake(0, 0, 320, 480)];
+  [photoScrollView setImage:[self imageWithSize:CGSizeMake(640, 480)]
+                  photoSize:NIPhotoScrollViewPhotoSizeOriginal];
+
+  UIImage* moreCompleteImage = [self imageWithSize:CGSizeMake(640, 480)];
+  [photoScrollView updateImage:moreCompleteImage photoSize:NIPhotoScrollViewPhotoSizeOriginal];
+  XCTAssertEqual(photoScrollView.image, moreCompleteImage);
+  XCTAssertEqual(photoScrollView.photoSize, NIPhotoScrollViewPhotoSizeOriginal);
+}
+
+- (void)testUpdatingImageWithDifferentSizeReplacesIt {
+  NIPhotoScrollView* photoScrollView = [[NIPhotoScrollView alloc] initWithFrame:CGRectMake(0, 0, 320, 480)];
+  [photoScrollView setImage:[self imageWithSize:CGSizeMake(64, 48)]
+                  photoSize:NIPhotoScrollViewPhotoSizeThumbnail];
+
+  UIImage* image = [self imageWithSize:CGSizeMake(640, 480)];
+  [photoScrollView updateImage:image photoSize:NIPhotoScrollViewPhotoSizeOriginal];
+  XCTAssertEqual(photoScrollView.image, image);
+  XCTAssertEqual(photoScrollView.photoSize, NIPhotoScrollViewPhotoSizeOriginal);
 }
 
 @end